@@ -0,0 +1,311 @@
+#ifndef PROJECT_CONF_H
+#define PROJECT_CONF_H
+
+/*---------------------------------------------------------------------------*/
+/* Network stack */
+/*---------------------------------------------------------------------------*/
+/* The RF core is owned by src/rf-core.c, never let prop-mode open it. */
+#define NETSTACK_CONF_RADIO nullradio_driver
+
+/* Two byte link addresses, taken from the end of the IEEE address */
+#define LINKADDR_CONF_SIZE 2
+
+/*---------------------------------------------------------------------------*/
+/* Radio configuration, resolved at compile time by src/radio-config.hpp */
+/*---------------------------------------------------------------------------*/
+/* Band plan: Eu868 or Us915 */
+#define RADIO_CONF_BAND Eu868
+
+/* PHY mode, one of radio::PhyMode */
+#define RADIO_CONF_PHY_MODE Fsk50kbps
+
+/* Channel number within the band plan */
+#define RADIO_CONF_CHANNEL 0
+
+/* TX power, must be an entry of the RF TX power table */
+#define RADIO_CONF_TX_POWER_DBM 14
+
+/*---------------------------------------------------------------------------*/
+/* RF core */
+/*---------------------------------------------------------------------------*/
+/* Number of pool frames kept queued to the RF core for reception */
+#define RF_CORE_CONF_RX_BUF_CNT 4
+
+/* RX sniff interval at boot in ms, 0 keeps RX always on. The host can
+ * change it at runtime through HOST_PARAM_SNIFF_INTERVAL. */
+#define RF_CORE_CONF_SNIFF_INTERVAL 0
+
+/* Per neighbor TX power control, see src/power-ctrl.h. Unicast frames
+ * aim at arriving with this RSSI, the PHY sensitivity plus a fade margin,
+ * and neighbors heard below the reception ratio get full power. */
+#define POWER_CTRL_CONF_ENABLED 1
+#define POWER_CTRL_CONF_TARGET_RSSI (-95)
+#define POWER_CTRL_CONF_MIN_PRR 230
+
+/* RSSI carrier sense before every transmission, see src/rf-core.h */
+#define RF_CORE_CONF_CCA_ENABLED 1
+#define RF_CORE_CONF_CCA_THRESHOLD (-90)
+
+/*---------------------------------------------------------------------------*/
+/* Frame pool */
+/*---------------------------------------------------------------------------*/
+/* Frame buffers shared by RX, TX and everything holding frames in between */
+#define FRAME_POOL_CONF_SIZE 8
+
+/* Largest PSDU the firmware will send or accept, in bytes */
+#define FRAME_CONF_MAX_LEN 255
+
+/*---------------------------------------------------------------------------*/
+/* TX queue */
+/*---------------------------------------------------------------------------*/
+/* Next hops that can have an aggregate frame pending at the same time */
+#define TX_QUEUE_CONF_SLOTS 4
+
+/* Longest time a payload waits to be aggregated, in clock ticks */
+#define TX_QUEUE_CONF_FLUSH_DELAY (CLOCK_SECOND / 32)
+
+/*---------------------------------------------------------------------------*/
+/* TX scheduler */
+/*---------------------------------------------------------------------------*/
+/* Frames waiting per traffic class, see src/tx-sched.h. They are pool
+ * frames, leave enough of the pool to RX. */
+#define TX_SCHED_CONF_CONTROL_LEN 2
+#define TX_SCHED_CONF_INTERACTIVE_LEN 2
+#define TX_SCHED_CONF_BULK_LEN 1
+
+/* Bytes per round-robin round, interactive traffic gets two thirds of
+ * the channel while a bulk transfer is under way */
+#define TX_SCHED_CONF_INTERACTIVE_QUANTUM 256
+#define TX_SCHED_CONF_BULK_QUANTUM 128
+
+/* CSMA on a busy channel: random backoff of 1 to 2^BE clock ticks */
+#define TX_SCHED_CONF_MIN_BE 1
+#define TX_SCHED_CONF_MAX_BE 4
+#define TX_SCHED_CONF_MAX_BACKOFFS 4
+
+/* Backoff following the busy ratio of the channel, sampled 16 times a
+ * second. An idle channel starts backoffs at TX_SCHED_CONF_MIN_BE and
+ * retries TX_SCHED_CONF_MIN_BACKOFFS times */
+#define TX_SCHED_CONF_ADAPTIVE 1
+#define TX_SCHED_CONF_MIN_BACKOFFS 2
+
+/* Duty cycle of the band accounted over an hour, bursts of up to its
+ * whole airtime allowed after a quiet hour */
+#define TX_SCHED_CONF_DUTY_WINDOW 3600UL
+
+/* MAC mode, TX_SCHED_MODE_SLOTTED for dense deployments, see src/slots.h.
+ * All nodes of a network must use the same mode and slot settings */
+#define TX_SCHED_CONF_MODE TX_SCHED_MODE_CSMA
+#define SLOTS_CONF_SLOTFRAME_LEN 17
+#define SLOTS_CONF_SLOT_LEN 50000UL
+
+/* Survey of 8 channels 800 kHz apart, one every 10 s, and migration of
+ * the mesh to the quietest, see src/chan.h. All nodes of a network must
+ * use the same candidates. Not with the slotted mode */
+#define CHAN_CONF_ENABLED 0
+#define CHAN_CONF_FIRST 0
+#define CHAN_CONF_STRIDE 4
+#define CHAN_CONF_COUNT 8
+#define CHAN_CONF_SCAN_PERIOD (10 * CLOCK_SECOND)
+#define CHAN_CONF_HYSTERESIS 32
+#define CHAN_CONF_DWELL (1800UL * CLOCK_SECOND)
+
+/*---------------------------------------------------------------------------*/
+/* Neighbor table */
+/*---------------------------------------------------------------------------*/
+/* Hash table slots, a power of two. Up to three quarters of them hold
+ * neighbors. */
+#define NEIGHBOR_CONF_SIZE 64
+
+/* Security frame counters taken from a neighbor between two saves of its
+ * entry, a power of two. After a reset, neighbors have to move past the
+ * end of the block, so replayed frames from before it are refused. */
+#define NEIGHBOR_CONF_COUNTER_BLOCK 1024
+
+/* Reception ratio as a moving average over frames weighing 1/8 each, or
+ * over a window of the last 2 to 16 frames, see src/link-metric.h */
+#define LINK_METRIC_CONF_PRR_WINDOW 0
+#define LINK_METRIC_CONF_PRR_SHIFT 3
+
+/*---------------------------------------------------------------------------*/
+/* Link security */
+/*---------------------------------------------------------------------------*/
+/* AES-CCM on every frame, in place on the AES engine, see src/link-sec.h.
+ * Off until a network key is set below, a key shipped in the tree would
+ * be known to everyone. */
+#define LINK_SEC_CONF_ENABLED 0
+
+/* Network key shared by every node, 16 random bytes, for instance from
+ * `od -An -tx1 -N16 /dev/urandom`. The build fails without one while
+ * security is enabled. */
+/* #define LINK_SEC_CONF_KEY { 0x.., ... } */
+
+/* MIC length in bytes, 4, 8 or 16 */
+#define LINK_SEC_CONF_MIC_LEN 8
+
+/* Frame counter values reserved in flash at a time, a reset skips what is
+ * left of the block */
+#define LINK_SEC_CONF_COUNTER_BLOCK 1024
+
+/*---------------------------------------------------------------------------*/
+/* Mesh flooding */
+/*---------------------------------------------------------------------------*/
+/* Hops travelled by the floods this node originates */
+#define MESH_CONF_TTL 4
+
+/* Longest random delay before rebroadcasting a flood, in clock ticks */
+#define MESH_CONF_FORWARD_JITTER (CLOCK_SECOND / 16)
+
+/* Recently seen floods remembered to drop their duplicates. Must cover
+ * the floods that can still be travelling the mesh at the same time. */
+#define DUP_CACHE_CONF_SIZE 32
+
+/*---------------------------------------------------------------------------*/
+/* Fragmentation */
+/*---------------------------------------------------------------------------*/
+/* Largest message sent to a neighbor in fragments, and how many can be
+ * reassembled at the same time */
+#define FRAG_CONF_MAX_LEN 1024
+#define FRAG_CONF_BUFFERS 2
+
+/* Partial messages are evicted after this long without a fragment */
+#define FRAG_CONF_REASSEMBLY_TIMEOUT (5 * CLOCK_SECOND)
+
+/* Wait for an acknowledgement past the time on air of the frames ahead of
+ * it, and rounds repeating the missing fragments before giving up */
+#define FRAG_CONF_ACK_TIMEOUT (CLOCK_SECOND / 4)
+#define FRAG_CONF_RETRIES 4
+
+/*---------------------------------------------------------------------------*/
+/* Routing */
+/*---------------------------------------------------------------------------*/
+/* Destinations in the route cache, and how long an unused route lives */
+#define ROUTE_CONF_SIZE 16
+#define ROUTE_CONF_LIFETIME (60 * CLOCK_SECOND)
+
+/* Route discoveries running at the same time, and payloads parked per
+ * destination meanwhile. Parked payloads hold pool frames. */
+#define ROUTE_CONF_DISCOVERIES 2
+#define ROUTE_CONF_PENDING 2
+
+/* First wait for a route reply, doubled on each of the retries */
+#define ROUTE_CONF_DISCOVERY_TIMEOUT (CLOCK_SECOND / 2)
+#define ROUTE_CONF_DISCOVERY_RETRIES 2
+
+/* Payloads held for destinations out of reach, see src/store.h. They take
+ * a frame worth of arena each and are saved with the rest of the state */
+#define STORE_CONF_ENABLED 1
+#define STORE_CONF_SIZE 8
+#define STORE_CONF_DESTS 4
+#define STORE_CONF_TTL (1800UL * CLOCK_SECOND)
+
+/* Held payloads saved at most 10 s after they came in, and no more often */
+#define STORE_CONF_SAVE_GAP (10 * CLOCK_SECOND)
+
+/*---------------------------------------------------------------------------*/
+/* Persistent state */
+/*---------------------------------------------------------------------------*/
+/* Neighbors, routes, radio settings and the frame counter are kept in the
+ * NVS region of the internal flash, see src/persist.h */
+#define PERSIST_CONF_ENABLED 1
+
+/* Longest a change waits to be saved. Every save appends the states that
+ * changed to the log, 11 bytes per neighbor, and wears the flash. */
+#define PERSIST_CONF_INTERVAL (600UL * CLOCK_SECOND)
+
+/*---------------------------------------------------------------------------*/
+/* Firmware updates */
+/*---------------------------------------------------------------------------*/
+/* Deltas are written to the external flash of the launchpad a page at a
+ * time, the RX path runs between pages, see src/ota.h */
+#define OTA_CONF_WRITE_LEN 256
+
+/* 352 KB of internal flash on the CC1312R, bounds the base of a delta */
+#define OTA_CONF_FLASH_SIZE 0x00058000UL
+
+/* Time for the answer to a commit to go out before the reset */
+#define OTA_CONF_REBOOT_DELAY CLOCK_SECOND
+
+/* Updates are only taken when signed with the private key of
+ * OTA_CONF_PUBLIC_KEY, printed by tools/ota-delta.py --export-key. Left
+ * undefined, every node refuses updates. */
+/* #define OTA_CONF_PUBLIC_KEY { 0x04, ... } */
+
+/*---------------------------------------------------------------------------*/
+/* Payload compression */
+/*---------------------------------------------------------------------------*/
+/* Frames from the TX queue go out compressed whenever that saves airtime,
+ * see src/compress.h. Compressed frames are accepted even when off */
+#define COMPRESS_CONF_ENABLED 1
+
+/*---------------------------------------------------------------------------*/
+/* Host link */
+/*---------------------------------------------------------------------------*/
+/* UART0 carries the framed host link, keep Contiki's console off it */
+#define TI_UART_CONF_ENABLE 0
+
+#define HOST_LINK_CONF_BAUD_RATE 921600
+
+/* Encoded output buffered towards the host, a power of two. Must hold a
+ * whole reassembled message. */
+#define HOST_LINK_CONF_TX_BUF_SIZE 2048
+
+/* Close the UART after this long without host frames, so the CPU can
+ * enter standby. The host wakes it with a lone flag, see src/host-link.h. */
+#define HOST_LINK_CONF_IDLE_TIMEOUT CLOCK_SECOND
+
+/*---------------------------------------------------------------------------*/
+/* Profiling */
+/*---------------------------------------------------------------------------*/
+/* DWT cycle accounting of the hot paths, see src/prof.h */
+#define PROF_CONF_ENABLED 1
+
+/* Event loop latency checked 4 times a second against a 50 ms budget, the
+ * stalls past it captured to RAM kept across resets, see src/monitor.h.
+ * Paused under low-power listening, and off by default in images with a
+ * boot sniff interval. */
+#define MONITOR_CONF_ENABLED (RF_CORE_CONF_SNIFF_INTERVAL == 0)
+#define MONITOR_CONF_PERIOD (CLOCK_SECOND / 4)
+#define MONITOR_CONF_BUDGET 50000UL
+
+/*---------------------------------------------------------------------------*/
+/* Logging */
+/*---------------------------------------------------------------------------*/
+/* Binary log ring size in bytes, a power of two */
+#define LOG_RING_CONF_SIZE 512
+
+/* Log level shared by all application modules */
+#define LOG_LEVEL_APP LOG_LEVEL_INFO
+
+/*---------------------------------------------------------------------------*/
+/* Memory budget */
+/*---------------------------------------------------------------------------*/
+/* Arena quota of every subsystem in bytes, see src/arena.h. Modules check
+ * at compile time that their configuration fits in their quota. */
+#define ARENA_CONF_QUOTA_FRAME_POOL 2368
+#define ARENA_CONF_QUOTA_TX_QUEUE   256
+#define ARENA_CONF_QUOTA_HOST_LINK  2480
+#define ARENA_CONF_QUOTA_LOG_RING   512
+#define ARENA_CONF_QUOTA_NEIGHBOR   1216
+#define ARENA_CONF_QUOTA_DUP_CACHE  128
+#define ARENA_CONF_QUOTA_ROUTE      384
+#define ARENA_CONF_QUOTA_FRAG       3200
+#define ARENA_CONF_QUOTA_OTA        2304
+#define ARENA_CONF_QUOTA_COMPRESS   1152
+#define ARENA_CONF_QUOTA_SLOTS      32
+#define ARENA_CONF_QUOTA_STORE      2304
+#define ARENA_CONF_QUOTA_CHAN       64
+
+/*---------------------------------------------------------------------------*/
+/* Native simulation, see sim/sim.h */
+/*---------------------------------------------------------------------------*/
+#if CONTIKI_TARGET_NATIVE
+/* The host link is a socket, nothing to save by closing it */
+#undef HOST_LINK_CONF_IDLE_TIMEOUT
+#define HOST_LINK_CONF_IDLE_TIMEOUT 0
+
+/* No DWT, profiled sections all read as zero cycles */
+#define PROF_CONF_CYCLES() 0
+#endif
+
+#endif /* PROJECT_CONF_H */
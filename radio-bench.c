@@ -0,0 +1,12 @@
+/**
+ * \file
+ *         Contiki entry point of the benchmark image
+ *
+ *         The benchmark is written in C++ and lives in src/bench.cpp, this
+ *         file only hands its process to the Contiki autostart list.
+ */
+#include "contiki.h"
+/*---------------------------------------------------------------------------*/
+PROCESS_NAME(bench_process);
+AUTOSTART_PROCESSES(&bench_process);
+/*---------------------------------------------------------------------------*/
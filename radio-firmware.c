@@ -1,27 +1,12 @@
+/**
+ * \file
+ *         Contiki entry point
+ *
+ *         The application core is written in C++ and lives in src/main.cpp,
+ *         this file only hands its process to the Contiki autostart list.
+ */
 #include "contiki.h"
-
-#include <stdio.h> /* For printf() */
 /*---------------------------------------------------------------------------*/
-PROCESS(hello_world_process, "Hello world process");
-AUTOSTART_PROCESSES(&hello_world_process);
-/*---------------------------------------------------------------------------*/
-PROCESS_THREAD(hello_world_process, ev, data)
-{
-  static struct etimer timer;
-
-  PROCESS_BEGIN();
-
-  /* Setup a periodic timer that expires after 10 seconds. */
-  etimer_set(&timer, CLOCK_SECOND * 10);
-
-  while(1) {
-    printf("Hello, world\n");
-
-    /* Wait for the periodic timer to expire and then restart the timer. */
-    PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&timer));
-    etimer_reset(&timer);
-  }
-
-  PROCESS_END();
-}
+PROCESS_NAME(app_process);
+AUTOSTART_PROCESSES(&app_process);
 /*---------------------------------------------------------------------------*/
@@ -0,0 +1,30 @@
+/**
+ * \file
+ *         Contiki entry point of the native simulation image
+ *
+ *         Runs the application of radio-firmware.c on the native target,
+ *         see sim/sim.h. The simulation process only takes the link address
+ *         from the environment, before the application starts.
+ */
+#include "contiki.h"
+#include "sim.h"
+
+#include <stdlib.h>
+/*---------------------------------------------------------------------------*/
+PROCESS_NAME(app_process);
+PROCESS(sim_process, "Simulation");
+AUTOSTART_PROCESSES(&sim_process, &app_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(sim_process, ev, data)
+{
+  const char *addr = getenv(SIM_ENV_NODE_ADDR);
+
+  PROCESS_BEGIN();
+
+  if(addr != NULL) {
+    linkaddr_node_addr.u16 = (uint16_t)strtoul(addr, NULL, 0);
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
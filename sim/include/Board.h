@@ -0,0 +1,21 @@
+/**
+ * \file
+ *         Board resources of the simulated node
+ *
+ *         Stand-in for the SimpleLink board file on the native target. The
+ *         indices only have to be valid for the drivers in ti-drivers-sim.c.
+ */
+#ifndef BOARD_H
+#define BOARD_H
+
+#define Board_UART0        0
+#define Board_UART0_RX     0
+#define Board_NVSINTERNAL  0
+/* No external flash, updates are refused */
+#define Board_NVSEXTERNAL  1
+#define Board_AESCCM0      0
+/* Neither opens, see ti-drivers-sim.c */
+#define Board_SHA20        0
+#define Board_ECDSA0       0
+
+#endif /* BOARD_H */
@@ -0,0 +1,66 @@
+/**
+ * \file
+ *         Simulated AES-CCM driver
+ *
+ *         Not a cipher: data is left in the clear and the MIC is a CRC over
+ *         key, nonce, header and data. Frames of a simulated network still
+ *         go through the whole link security path, counters and replay
+ *         checks included, and a frame changed on the way or secured under
+ *         another key does not authenticate. Never use outside simulation.
+ */
+#ifndef ti_drivers_AESCCM__include
+#define ti_drivers_AESCCM__include
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <ti/drivers/cryptoutils/cryptokey/CryptoKeyPlaintext.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct AESCCM_Config_ *AESCCM_Handle;
+
+typedef enum {
+  AESCCM_RETURN_BEHAVIOR_CALLBACK = 1,
+  AESCCM_RETURN_BEHAVIOR_BLOCKING = 2,
+  AESCCM_RETURN_BEHAVIOR_POLLING  = 4,
+} AESCCM_ReturnBehavior;
+
+typedef struct {
+  AESCCM_ReturnBehavior returnBehavior;
+  uint32_t timeout;
+} AESCCM_Params;
+
+typedef struct {
+  CryptoKey *key;
+  uint8_t *aad;
+  uint8_t *input;
+  uint8_t *output;
+  uint8_t *nonce;
+  uint8_t *mac;
+  size_t aadLength;
+  size_t inputLength;
+  uint8_t nonceLength;
+  uint8_t macLength;
+} AESCCM_Operation;
+
+#define AESCCM_STATUS_SUCCESS     0
+#define AESCCM_STATUS_ERROR       (-1)
+#define AESCCM_STATUS_MAC_INVALID (-3)
+
+void AESCCM_init(void);
+void AESCCM_Params_init(AESCCM_Params *params);
+AESCCM_Handle AESCCM_open(uint_least8_t index, AESCCM_Params *params);
+void AESCCM_Operation_init(AESCCM_Operation *operation);
+int_fast16_t AESCCM_oneStepEncrypt(AESCCM_Handle handle,
+                                   AESCCM_Operation *operation);
+int_fast16_t AESCCM_oneStepDecrypt(AESCCM_Handle handle,
+                                   AESCCM_Operation *operation);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ti_drivers_AESCCM__include */
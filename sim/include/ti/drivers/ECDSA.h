@@ -0,0 +1,72 @@
+/**
+ * \file
+ *         Simulated ECDSA driver
+ *
+ *         Like the SHA2 stand-in the driver does not open, and updates are
+ *         refused on the simulated node.
+ */
+#ifndef ti_drivers_ECDSA__include
+#define ti_drivers_ECDSA__include
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <ti/drivers/cryptoutils/cryptokey/CryptoKeyPlaintext.h>
+#include <ti/drivers/cryptoutils/ecc/ECCParams.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct ECDSA_Config_ *ECDSA_Handle;
+
+typedef enum {
+  ECDSA_RETURN_BEHAVIOR_CALLBACK = 1,
+  ECDSA_RETURN_BEHAVIOR_BLOCKING = 2,
+  ECDSA_RETURN_BEHAVIOR_POLLING  = 4,
+} ECDSA_ReturnBehavior;
+
+typedef enum {
+  ECDSA_OPERATION_TYPE_SIGN   = 1,
+  ECDSA_OPERATION_TYPE_VERIFY = 2,
+} ECDSA_OperationType;
+
+typedef struct {
+  const ECCParams_CurveParams *curve;
+  const CryptoKey *theirPublicKey;
+  const uint8_t *hash;
+  const uint8_t *r;
+  const uint8_t *s;
+} ECDSA_OperationVerify;
+
+typedef union {
+  void *generic;
+  ECDSA_OperationVerify *verify;
+} ECDSA_Operation;
+
+typedef void (*ECDSA_CallbackFxn)(ECDSA_Handle handle,
+                                  int_fast16_t returnStatus,
+                                  ECDSA_Operation operation,
+                                  ECDSA_OperationType operationType);
+
+typedef struct {
+  ECDSA_ReturnBehavior returnBehavior;
+  ECDSA_CallbackFxn callbackFxn;
+  uint32_t timeout;
+} ECDSA_Params;
+
+#define ECDSA_STATUS_SUCCESS 0
+#define ECDSA_STATUS_ERROR   (-1)
+
+void ECDSA_init(void);
+void ECDSA_Params_init(ECDSA_Params *params);
+ECDSA_Handle ECDSA_open(uint_least8_t index, const ECDSA_Params *params);
+void ECDSA_OperationVerify_init(ECDSA_OperationVerify *operation);
+int_fast16_t ECDSA_verify(ECDSA_Handle handle,
+                          ECDSA_OperationVerify *operation);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ti_drivers_ECDSA__include */
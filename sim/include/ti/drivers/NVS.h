@@ -0,0 +1,56 @@
+/**
+ * \file
+ *         Simulated NVS driver
+ *
+ *         One region of internal flash, kept in the file named by the
+ *         SIM_NVS_FILE environment variable so that it survives a restart
+ *         of the node. Writes only clear bits and erases set them, as on
+ *         flash. Without SIM_NVS_FILE the region cannot be opened.
+ */
+#ifndef ti_drivers_NVS__include
+#define ti_drivers_NVS__include
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct NVS_Config_ *NVS_Handle;
+
+typedef struct {
+  void *custom;
+} NVS_Params;
+
+typedef struct {
+  size_t regionBase;
+  size_t regionSize;
+  size_t sectorSize;
+} NVS_Attrs;
+
+#define NVS_STATUS_SUCCESS      0
+#define NVS_STATUS_ERROR        (-1)
+#define NVS_STATUS_INV_OFFSET   (-3)
+#define NVS_STATUS_INV_WRITE    (-6)
+
+#define NVS_WRITE_ERASE         0x1
+#define NVS_WRITE_PRE_VERIFY    0x2
+#define NVS_WRITE_POST_VERIFY   0x4
+
+void NVS_init(void);
+void NVS_Params_init(NVS_Params *params);
+NVS_Handle NVS_open(uint_least8_t index, NVS_Params *params);
+void NVS_close(NVS_Handle handle);
+void NVS_getAttrs(NVS_Handle handle, NVS_Attrs *attrs);
+int_fast16_t NVS_read(NVS_Handle handle, size_t offset, void *buffer,
+                      size_t size);
+int_fast16_t NVS_write(NVS_Handle handle, size_t offset, void *buffer,
+                       size_t size, uint_fast16_t flags);
+int_fast16_t NVS_erase(NVS_Handle handle, size_t offset, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ti_drivers_NVS__include */
@@ -0,0 +1,43 @@
+/**
+ * \file
+ *         Simulated PIN driver
+ *
+ *         Pins can be opened and configured but never change, the
+ *         simulated host link has no RX line to wake the UART from.
+ */
+#ifndef ti_drivers_PIN__include
+#define ti_drivers_PIN__include
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint32_t PIN_Config;
+typedef uint32_t PIN_Id;
+
+typedef struct {
+  const PIN_Config *config;
+} PIN_State;
+
+typedef PIN_State *PIN_Handle;
+
+typedef void (*PIN_IntCb)(PIN_Handle handle, PIN_Id pin);
+
+#define PIN_TERMINATE   0xFE
+#define PIN_INPUT_EN    (1UL << 29)
+#define PIN_PULLUP      (1UL << 13)
+#define PIN_IRQ_DIS     (0UL << 16)
+#define PIN_IRQ_NEGEDGE (5UL << 16)
+
+PIN_Handle PIN_open(PIN_State *state, const PIN_Config pin_list[]);
+void PIN_close(PIN_Handle handle);
+int PIN_registerIntCb(PIN_Handle handle, PIN_IntCb callback);
+int PIN_setInterrupt(PIN_Handle handle, PIN_Config pin_config);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ti_drivers_PIN__include */
@@ -0,0 +1,46 @@
+/**
+ * \file
+ *         Simulated SHA2 driver
+ *
+ *         The simulated node has no secondary slot, so nothing is hashed:
+ *         the driver does not open.
+ */
+#ifndef ti_drivers_SHA2__include
+#define ti_drivers_SHA2__include
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct SHA2_Config_ *SHA2_Handle;
+
+typedef enum {
+  SHA2_RETURN_BEHAVIOR_CALLBACK = 1,
+  SHA2_RETURN_BEHAVIOR_BLOCKING = 2,
+  SHA2_RETURN_BEHAVIOR_POLLING  = 4,
+} SHA2_ReturnBehavior;
+
+typedef struct {
+  SHA2_ReturnBehavior returnBehavior;
+  uint32_t timeout;
+} SHA2_Params;
+
+#define SHA2_STATUS_SUCCESS 0
+#define SHA2_STATUS_ERROR   (-1)
+
+void SHA2_init(void);
+void SHA2_Params_init(SHA2_Params *params);
+SHA2_Handle SHA2_open(uint_least8_t index, const SHA2_Params *params);
+void SHA2_reset(SHA2_Handle handle);
+int_fast16_t SHA2_addData(SHA2_Handle handle, const void *data,
+                          size_t length);
+int_fast16_t SHA2_finalize(SHA2_Handle handle, void *digest);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ti_drivers_SHA2__include */
@@ -0,0 +1,75 @@
+/**
+ * \file
+ *         Simulated UART driver
+ *
+ *         The subset of the SimpleLink UART API used by src/host-link.c, in
+ *         callback mode only, on the host link socket of the simulated
+ *         node. See ti-drivers-sim.c.
+ */
+#ifndef ti_drivers_UART__include
+#define ti_drivers_UART__include
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct UART_Config_ *UART_Handle;
+
+typedef void (*UART_Callback)(UART_Handle handle, void *buf, size_t count);
+
+typedef enum {
+  UART_MODE_BLOCKING,
+  UART_MODE_CALLBACK,
+} UART_Mode;
+
+typedef enum {
+  UART_RETURN_FULL,
+  UART_RETURN_NEWLINE,
+} UART_ReturnMode;
+
+typedef enum {
+  UART_DATA_BINARY,
+  UART_DATA_TEXT,
+} UART_DataMode;
+
+typedef enum {
+  UART_ECHO_OFF,
+  UART_ECHO_ON,
+} UART_Echo;
+
+typedef struct {
+  UART_Mode readMode;
+  UART_Mode writeMode;
+  uint32_t readTimeout;
+  uint32_t writeTimeout;
+  UART_Callback readCallback;
+  UART_Callback writeCallback;
+  UART_ReturnMode readReturnMode;
+  UART_DataMode readDataMode;
+  UART_DataMode writeDataMode;
+  UART_Echo readEcho;
+  uint32_t baudRate;
+} UART_Params;
+
+#define UART_STATUS_SUCCESS 0
+#define UART_STATUS_ERROR   (-1)
+
+/** First of the device specific UART_control() commands */
+#define UART_CMD_RESERVED   32
+
+void UART_Params_init(UART_Params *params);
+UART_Handle UART_open(uint_least8_t index, UART_Params *params);
+void UART_close(UART_Handle handle);
+int_fast16_t UART_control(UART_Handle handle, uint_fast16_t cmd, void *arg);
+int_fast32_t UART_read(UART_Handle handle, void *buffer, size_t size);
+void UART_readCancel(UART_Handle handle);
+int_fast32_t UART_write(UART_Handle handle, const void *buffer, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ti_drivers_UART__include */
@@ -0,0 +1,27 @@
+/**
+ * \file
+ *         Simulated plaintext crypto keys
+ */
+#ifndef ti_drivers_cryptoutils_cryptokey_CryptoKeyPlaintext__include
+#define ti_drivers_cryptoutils_cryptokey_CryptoKeyPlaintext__include
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  uint8_t *keyMaterial;
+  uint16_t keyLength;
+} CryptoKey;
+
+int_fast16_t CryptoKeyPlaintext_initKey(CryptoKey *key, uint8_t *material,
+                                        size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ti_drivers_cryptoutils_cryptokey_CryptoKeyPlaintext__include */
@@ -0,0 +1,24 @@
+/**
+ * \file
+ *         Simulated elliptic curve parameters
+ */
+#ifndef ti_drivers_cryptoutils_ecc_ECCParams__include
+#define ti_drivers_cryptoutils_ecc_ECCParams__include
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  uint8_t length;
+} ECCParams_CurveParams;
+
+extern const ECCParams_CurveParams ECCParams_NISTP256;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ti_drivers_cryptoutils_ecc_ECCParams__include */
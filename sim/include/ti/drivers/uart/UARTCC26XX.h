@@ -0,0 +1,16 @@
+/**
+ * \file
+ *         Simulated UART driver, CC26XX specific commands
+ *
+ *         Reads always return what has arrived, the command is accepted
+ *         and ignored.
+ */
+#ifndef ti_drivers_uart_UARTCC26XX__include
+#define ti_drivers_uart_UARTCC26XX__include
+
+#include <ti/drivers/UART.h>
+
+#define UARTCC26XX_CMD_RETURN_PARTIAL_ENABLE  (UART_CMD_RESERVED + 0)
+#define UARTCC26XX_CMD_RETURN_PARTIAL_DISABLE (UART_CMD_RESERVED + 1)
+
+#endif /* ti_drivers_uart_UARTCC26XX__include */
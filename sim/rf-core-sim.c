@@ -0,0 +1,516 @@
+/**
+ * \file
+ *         RF core of the simulated node, on the medium of tools/sim-run.py
+ *
+ *         Implements rf-core.h for the native target. Frames are datagrams
+ *         exchanged with the medium, see sim.h. Transmissions report back
+ *         after their airtime as they do on the RF core, and carrier sense
+ *         asks the medium whether anything is on the air above the
+ *         threshold.
+ *         Channel scans ask it for the RSSI every SCAN_SAMPLE_US.
+ */
+#include "contiki.h"
+#include "rf-core.h"
+#include "byteorder.h"
+#include "frame-pool.h"
+#include "lib/list.h"
+#include "log-ring.h"
+#include "persist.h"
+#include "sim.h"
+#include "stats.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sys/log.h"
+#define LOG_MODULE "RF"
+#define LOG_LEVEL LOG_LEVEL_APP
+/*---------------------------------------------------------------------------*/
+/* Preamble, sync word, PHR and CRC around every frame on air, as set up
+ * by rf/settings.h */
+#define OVERHEAD_BYTES       (4 + 3 + 2 + 2)
+
+/* Received frames held at a time, as many as the RF core queue */
+#define RX_QUEUE_LEN         4
+
+/* Lowest TX power of the CC1312R table */
+#define TX_POWER_MIN         (-20)
+
+/* An unanswered carrier sense counts as a clear channel */
+#define CCA_TIMEOUT_MS       100
+
+/* Time between RSSI samples of a scan, a round trip to the medium */
+#define SCAN_SAMPLE_US       250
+
+#define TX_HDR_LEN           6
+#define RX_HDR_LEN           2
+
+/* Saved as [TX power (1)] [sniff interval (2)], same as the RF core */
+#define SAVED_LEN            3
+/*---------------------------------------------------------------------------*/
+static int sock = -1;
+
+LIST(rx_frames);
+static uint8_t rx_queued;
+
+static rf_core_input_callback_t input_callback;
+static rf_core_tx_callback_t tx_callback;
+
+/* Frame on air, NULL if none, and the outcome told at the end of it */
+static struct frame *tx_frame;
+static int tx_result;
+static struct ctimer tx_timer;
+
+static int8_t default_tx_power_dbm;
+static int8_t tx_power_dbm;
+static uint16_t sniff_interval;
+static uint8_t channel_count;
+static uint8_t channel;
+static uint16_t max_frame_len;
+static uint16_t duty_cycle_permille;
+static uint16_t preamble_byte_us;
+
+static int set_fd(fd_set *rset, fd_set *wset);
+static void handle_fd(fd_set *rset, fd_set *wset);
+
+static const struct select_callback select_callback = { set_fd, handle_fd };
+
+static void save(void);
+static void restore(uint16_t len);
+
+static struct persist_handler persist_handler = {
+  NULL, PERSIST_RADIO, save, restore
+};
+/*---------------------------------------------------------------------------*/
+PROCESS(rf_core_rx_process, "RF core RX");
+/*---------------------------------------------------------------------------*/
+static void
+queue_frame(const uint8_t *msg, size_t len)
+{
+  struct frame *frame;
+
+  if(len < RX_HDR_LEN || len - RX_HDR_LEN > max_frame_len) {
+    return;
+  }
+
+  frame = rx_queued < RX_QUEUE_LEN ? frame_pool_alloc() : NULL;
+  if(frame == NULL) {
+    STATS_INC(RX_NO_BUFFER);
+    return;
+  }
+
+  frame->len = len - RX_HDR_LEN;
+  frame->meta.rssi = (int8_t)msg[1];
+  /* Delivered at the end of the airtime, stamped at the end of the sync
+   * word like on the RF core */
+  frame->meta.timestamp = rf_core_time() -
+    (uint32_t)(2 + frame->len + 2) * preamble_byte_us * RF_CORE_TICKS_PER_US;
+  frame->meta.status = 0;
+  memcpy(frame_payload(frame), &msg[RX_HDR_LEN], frame->len);
+
+  list_add(rx_frames, frame);
+  rx_queued++;
+  process_poll(&rf_core_rx_process);
+}
+/*---------------------------------------------------------------------------*/
+/* Read one datagram from the medium, -1 if none is waiting. The byte of
+ * a result goes to result. */
+static int
+receive(uint8_t *result)
+{
+  uint8_t msg[RX_HDR_LEN + FRAME_MAX_LEN];
+  const ssize_t len = recv(sock, msg, sizeof(msg), 0);
+
+  if(len <= 0) {
+    return -1;
+  }
+
+  if(msg[0] == SIM_MSG_RX) {
+    queue_frame(msg, len);
+  } else if((msg[0] == SIM_MSG_CCA_RESULT || msg[0] == SIM_MSG_RSSI_RESULT) &&
+            len == 2 && result != NULL) {
+    *result = msg[1];
+  }
+
+  return msg[0];
+}
+/*---------------------------------------------------------------------------*/
+static int
+set_fd(fd_set *rset, fd_set *wset)
+{
+  FD_SET(sock, rset);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_fd(fd_set *rset, fd_set *wset)
+{
+  if(FD_ISSET(sock, rset)) {
+    while(receive(NULL) >= 0);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Ask the medium and wait for its answer, -1 if none came */
+static int
+query(const uint8_t *msg, size_t len, uint8_t result_type, uint8_t *result)
+{
+  struct pollfd pfd = { sock, POLLIN, 0 };
+
+  if(send(sock, msg, len, 0) != len) {
+    return -1;
+  }
+
+  /* Frames arriving meanwhile are queued as usual */
+  while(poll(&pfd, 1, CCA_TIMEOUT_MS) > 0) {
+    if(receive(result) == result_type) {
+      return 0;
+    }
+  }
+
+  return -1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+channel_busy(void)
+{
+  const uint8_t msg[2] = { SIM_MSG_CCA, (uint8_t)RF_CORE_CCA_THRESHOLD };
+  uint8_t busy;
+
+  return query(msg, sizeof(msg), SIM_MSG_CCA_RESULT, &busy) == 0 ? busy : 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+tune(uint8_t ch)
+{
+  const uint8_t msg[2] = { SIM_MSG_CHANNEL, ch };
+
+  return send(sock, msg, sizeof(msg), 0) == sizeof(msg) ? 0 : -1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+save(void)
+{
+  uint8_t buf[SAVED_LEN];
+
+  buf[0] = tx_power_dbm;
+  put_le16(&buf[1], sniff_interval);
+  persist_put(buf, sizeof(buf));
+}
+/*---------------------------------------------------------------------------*/
+static void
+restore(uint16_t len)
+{
+  uint8_t buf[SAVED_LEN];
+
+  if(persist_get(buf, sizeof(buf)) != 0) {
+    return;
+  }
+
+  if((int8_t)buf[0] >= TX_POWER_MIN && (int8_t)buf[0] <= tx_power_dbm) {
+    tx_power_dbm = (int8_t)buf[0];
+  }
+  if(get_le16(&buf[1]) <= RF_CORE_SNIFF_INTERVAL_MAX) {
+    sniff_interval = get_le16(&buf[1]);
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+rf_core_init(const struct rf_core_params *params)
+{
+  const char *port = getenv(SIM_ENV_MEDIUM_PORT);
+  struct sockaddr_in medium;
+  uint8_t hello[1 + LINKADDR_SIZE];
+
+  if(port == NULL) {
+    LOG_ERR("%s not set\n", SIM_ENV_MEDIUM_PORT);
+    return -1;
+  }
+
+  memset(&medium, 0, sizeof(medium));
+  medium.sin_family = AF_INET;
+  medium.sin_port = htons(atoi(port));
+  medium.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  sock = socket(AF_INET, SOCK_DGRAM, 0);
+  if(sock < 0 ||
+     connect(sock, (struct sockaddr *)&medium, sizeof(medium)) != 0 ||
+     fcntl(sock, F_SETFL, O_NONBLOCK) != 0) {
+    LOG_ERR("Unable to reach the medium on port %s\n", port);
+    return -1;
+  }
+
+  default_tx_power_dbm = params->tx_power_dbm;
+  tx_power_dbm = params->tx_power_dbm;
+  max_frame_len = MIN(params->max_frame_len, FRAME_MAX_LEN);
+  duty_cycle_permille = params->duty_cycle_permille;
+  preamble_byte_us = params->preamble_byte_us;
+  sniff_interval = RF_CORE_SNIFF_INTERVAL;
+  channel_count = params->channel_count;
+  channel = params->channel;
+
+  list_init(rx_frames);
+  rx_queued = 0;
+  process_start(&rf_core_rx_process, NULL);
+  select_set_callback(sock, &select_callback);
+
+  persist_register(&persist_handler);
+  LOG_RECORD(RF_SNIFF_INTERVAL, sniff_interval);
+
+  hello[0] = SIM_MSG_HELLO;
+  memcpy(&hello[1], &linkaddr_node_addr, LINKADDR_SIZE);
+  if(send(sock, hello, sizeof(hello), 0) != sizeof(hello)) {
+    return -1;
+  }
+
+  return tune(channel);
+}
+/*---------------------------------------------------------------------------*/
+void
+rf_core_set_input_callback(rf_core_input_callback_t callback)
+{
+  input_callback = callback;
+}
+/*---------------------------------------------------------------------------*/
+void
+rf_core_set_tx_callback(rf_core_tx_callback_t callback)
+{
+  tx_callback = callback;
+}
+/*---------------------------------------------------------------------------*/
+int
+rf_core_set_tx_power(int8_t dbm)
+{
+  if(dbm < TX_POWER_MIN || dbm > default_tx_power_dbm) {
+    return -1;
+  }
+
+  tx_power_dbm = dbm;
+  persist_changed();
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+int8_t
+rf_core_get_tx_power(void)
+{
+  return tx_power_dbm;
+}
+/*---------------------------------------------------------------------------*/
+int
+rf_core_set_sniff_interval(uint16_t interval_ms)
+{
+  if(interval_ms > RF_CORE_SNIFF_INTERVAL_MAX) {
+    return -1;
+  }
+
+  sniff_interval = interval_ms;
+  persist_changed();
+  LOG_RECORD(RF_SNIFF_INTERVAL, interval_ms);
+
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+rf_core_get_sniff_interval(void)
+{
+  return sniff_interval;
+}
+/*---------------------------------------------------------------------------*/
+uint32_t
+rf_core_airtime_us(uint16_t len)
+{
+  /* Low-power listening stretches the preamble over a whole interval */
+  return (uint32_t)(OVERHEAD_BYTES + len) * preamble_byte_us +
+         (uint32_t)sniff_interval * 1000;
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+rf_core_get_duty_cycle(void)
+{
+  return duty_cycle_permille;
+}
+/*---------------------------------------------------------------------------*/
+int
+rf_core_set_channel(uint8_t ch)
+{
+  if(ch >= channel_count) {
+    return -1;
+  }
+  if(ch != channel && tune(ch) != 0) {
+    return -1;
+  }
+
+  channel = ch;
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+rf_core_get_channel(void)
+{
+  return channel;
+}
+/*---------------------------------------------------------------------------*/
+int
+rf_core_scan(uint8_t ch, uint32_t duration_us, struct rf_core_scan *scan)
+{
+  const uint8_t msg[1] = { SIM_MSG_RSSI };
+  const uint32_t start = rf_core_time();
+  uint8_t value;
+  int8_t rssi;
+
+  if(sniff_interval != 0 || ch >= channel_count) {
+    return -1;
+  }
+
+  scan->samples = 0;
+  scan->busy = 0;
+  scan->min_rssi = INT8_MAX;
+  scan->max_rssi = INT8_MIN;
+
+  if(ch != channel && tune(ch) != 0) {
+    return -1;
+  }
+
+  while(rf_core_time() - start < duration_us * RF_CORE_TICKS_PER_US) {
+    if(query(msg, sizeof(msg), SIM_MSG_RSSI_RESULT, &value) == 0) {
+      rssi = (int8_t)value;
+      scan->samples++;
+      scan->busy += rssi >= RF_CORE_CCA_THRESHOLD;
+      scan->min_rssi = MIN(scan->min_rssi, rssi);
+      scan->max_rssi = MAX(scan->max_rssi, rssi);
+    }
+    usleep(SCAN_SAMPLE_US);
+  }
+
+  if(ch != channel && tune(channel) != 0) {
+    return -1;
+  }
+
+  return scan->samples > 0 ? 0 : -1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+tx_over(void *ptr)
+{
+  struct frame *frame = tx_frame;
+
+  tx_frame = NULL;
+  if(tx_callback != NULL) {
+    tx_callback(frame, tx_result);
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+rf_core_transmit(struct frame *frame)
+{
+  return rf_core_transmit_at(frame, tx_power_dbm);
+}
+/*---------------------------------------------------------------------------*/
+int
+rf_core_transmit_at(struct frame *frame, int8_t dbm)
+{
+  uint8_t msg[TX_HDR_LEN + FRAME_MAX_LEN];
+  uint32_t airtime_us;
+
+  if(frame->len > max_frame_len || tx_frame != NULL) {
+    return -1;
+  }
+
+  tx_frame = frame;
+  if(RF_CORE_CCA_ENABLED && channel_busy()) {
+    STATS_INC(CCA_BUSY);
+    LOG_RECORD(TX_FRAME, frame->len, RF_CORE_TX_BUSY);
+    tx_result = RF_CORE_TX_BUSY;
+    ctimer_set(&tx_timer, 0, tx_over, NULL);
+    return 0;
+  }
+
+  airtime_us = rf_core_airtime_us(frame->len);
+
+  msg[0] = SIM_MSG_TX;
+  msg[1] = (uint8_t)MIN(MAX(dbm, TX_POWER_MIN), tx_power_dbm);
+  put_le32(&msg[2], airtime_us);
+  memcpy(&msg[TX_HDR_LEN], frame_payload(frame), frame->len);
+
+  if(send(sock, msg, TX_HDR_LEN + frame->len, 0) != TX_HDR_LEN + frame->len) {
+    LOG_WARN("TX failed\n");
+    STATS_INC(TX_ERRORS);
+    LOG_RECORD(TX_FRAME, frame->len, -1);
+    tx_frame = NULL;
+    return -1;
+  }
+
+  /* Done once the medium is through with it, rounded up to a tick */
+  STATS_INC(TX_FRAMES);
+  LOG_RECORD(TX_FRAME, frame->len, 0);
+  tx_result = 0;
+  ctimer_set(&tx_timer,
+             ((uint64_t)airtime_us * CLOCK_SECOND + 999999) / 1000000,
+             tx_over, NULL);
+
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+rf_core_transmit_scheduled(struct frame *frame, int8_t dbm, uint32_t start)
+{
+  const int32_t ahead = (int32_t)(start - rf_core_time());
+
+  /* Frames arriving meanwhile wait in the socket */
+  if(ahead > 0) {
+    usleep(ahead / RF_CORE_TICKS_PER_US);
+  }
+
+  return rf_core_transmit_at(frame, dbm);
+}
+/*---------------------------------------------------------------------------*/
+int
+rf_core_cca(void)
+{
+  if(sniff_interval != 0) {
+    return -1;
+  }
+
+  return channel_busy();
+}
+/*---------------------------------------------------------------------------*/
+uint32_t
+rf_core_time(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)ts.tv_sec * 1000000UL * RF_CORE_TICKS_PER_US +
+         (uint32_t)(ts.tv_nsec / 1000) * RF_CORE_TICKS_PER_US;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(rf_core_rx_process, ev, data)
+{
+  struct frame *frame;
+
+  PROCESS_BEGIN();
+
+  while(1) {
+    PROCESS_YIELD_UNTIL(ev == PROCESS_EVENT_POLL);
+
+    while((frame = list_pop(rx_frames)) != NULL) {
+      rx_queued--;
+      LOG_RECORD(RX_FRAME, frame->len, frame->meta.rssi, frame->meta.status);
+      STATS_INC(RX_FRAMES);
+      if(input_callback != NULL) {
+        input_callback(frame);
+      } else {
+        frame_pool_free(frame);
+      }
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,47 @@
+/**
+ * \file
+ *         Native simulation of a radio node
+ *
+ *         `make TARGET=native radio-sim` builds the application for the
+ *         Contiki-NG native target, with the RF core replaced by
+ *         rf-core-sim.c and the TI drivers by ti-drivers-sim.c. Each node
+ *         is one process, normally started by tools/sim-run.py, configured
+ *         through its environment:
+ *         SIM_NODE_ADDR   link address of the node
+ *         SIM_MEDIUM_PORT UDP port of the simulated medium on the loopback
+ *                         interface
+ *         SIM_HOST_FD     connected socket carrying the host link
+ *         SIM_NVS_FILE    file backing the NVS region, optional
+ *
+ *         Datagrams to and from the medium start with their type:
+ *         node -> medium: SIM_MSG_HELLO [address (2)]
+ *                         SIM_MSG_CCA [threshold (1)]
+ *                         SIM_MSG_TX [TX power (1)] [airtime us (4)] [frame]
+ *                         SIM_MSG_CHANNEL [channel (1)]
+ *                         SIM_MSG_RSSI
+ *         medium -> node: SIM_MSG_CCA_RESULT [busy (1)]
+ *                         SIM_MSG_RX [RSSI (1)] [frame]
+ *                         SIM_MSG_RSSI_RESULT [RSSI (1)]
+ *         The medium computes what every node hears, losses and
+ *         collisions included, and delivers frames at the end of their
+ *         airtime like the RF core does. Nodes only hear each other on the
+ *         same channel, channel 0 until they tell otherwise.
+ */
+#ifndef SIM_H
+#define SIM_H
+
+#define SIM_ENV_NODE_ADDR   "SIM_NODE_ADDR"
+#define SIM_ENV_MEDIUM_PORT "SIM_MEDIUM_PORT"
+#define SIM_ENV_HOST_FD     "SIM_HOST_FD"
+#define SIM_ENV_NVS_FILE    "SIM_NVS_FILE"
+
+#define SIM_MSG_HELLO       0
+#define SIM_MSG_CCA         1
+#define SIM_MSG_TX          2
+#define SIM_MSG_CCA_RESULT  3
+#define SIM_MSG_RX          4
+#define SIM_MSG_CHANNEL     5
+#define SIM_MSG_RSSI        6
+#define SIM_MSG_RSSI_RESULT 7
+
+#endif /* SIM_H */
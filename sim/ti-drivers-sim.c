@@ -0,0 +1,510 @@
+/**
+ * \file
+ *         TI drivers of the simulated node
+ *
+ *         Just enough of the SimpleLink UART, PIN, NVS and AESCCM drivers for
+ *         src/ to run unchanged on the native target, see the headers in
+ *         sim/include. SHA2 and ECDSA only link, they never open.
+ */
+#include "contiki.h"
+#include "lib/crc16.h"
+#include "sim.h"
+
+#include "Board.h"
+
+#include <ti/drivers/AESCCM.h>
+#include <ti/drivers/ECDSA.h>
+#include <ti/drivers/NVS.h>
+#include <ti/drivers/PIN.h>
+#include <ti/drivers/SHA2.h>
+#include <ti/drivers/UART.h>
+#include <ti/drivers/cryptoutils/cryptokey/CryptoKeyPlaintext.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+/*---------------------------------------------------------------------------*/
+/* Two sectors, the size of the NVS region of the launchpad board file */
+#define NVS_SECTOR_SIZE 0x2000
+#define NVS_REGION_SIZE (2 * NVS_SECTOR_SIZE)
+/*---------------------------------------------------------------------------*/
+struct UART_Config_ {
+  int fd;
+  UART_Params params;
+  /* Pending read, NULL if none */
+  void *read_buf;
+  size_t read_size;
+  /* Write completed, its callback still to be called */
+  const void *write_buf;
+  size_t write_size;
+};
+
+struct NVS_Config_ {
+  int fd;
+  uint8_t data[NVS_REGION_SIZE];
+};
+
+struct AESCCM_Config_ {
+  AESCCM_Params params;
+};
+
+static struct UART_Config_ uart;
+static struct NVS_Config_ nvs;
+static struct AESCCM_Config_ aesccm;
+
+static int uart_set_fd(fd_set *rset, fd_set *wset);
+static void uart_handle_fd(fd_set *rset, fd_set *wset);
+
+static const struct select_callback uart_select_callback = {
+  uart_set_fd, uart_handle_fd
+};
+/*---------------------------------------------------------------------------*/
+PROCESS(sim_uart_process, "Simulated UART");
+/*---------------------------------------------------------------------------*/
+void
+UART_Params_init(UART_Params *params)
+{
+  memset(params, 0, sizeof(*params));
+  params->readMode = UART_MODE_BLOCKING;
+  params->writeMode = UART_MODE_BLOCKING;
+  params->baudRate = 115200;
+}
+/*---------------------------------------------------------------------------*/
+UART_Handle
+UART_open(uint_least8_t index, UART_Params *params)
+{
+  const char *fd = getenv(SIM_ENV_HOST_FD);
+
+  if(fd == NULL || params->readMode != UART_MODE_CALLBACK ||
+     params->writeMode != UART_MODE_CALLBACK) {
+    return NULL;
+  }
+
+  uart.fd = atoi(fd);
+  uart.params = *params;
+  uart.read_buf = NULL;
+  uart.write_buf = NULL;
+  if(fcntl(uart.fd, F_SETFL, O_NONBLOCK) != 0) {
+    return NULL;
+  }
+
+  process_start(&sim_uart_process, NULL);
+  select_set_callback(uart.fd, &uart_select_callback);
+
+  return &uart;
+}
+/*---------------------------------------------------------------------------*/
+void
+UART_close(UART_Handle handle)
+{
+  select_set_callback(handle->fd, NULL);
+  process_exit(&sim_uart_process);
+}
+/*---------------------------------------------------------------------------*/
+int_fast16_t
+UART_control(UART_Handle handle, uint_fast16_t cmd, void *arg)
+{
+  return UART_STATUS_SUCCESS;
+}
+/*---------------------------------------------------------------------------*/
+int_fast32_t
+UART_read(UART_Handle handle, void *buffer, size_t size)
+{
+  if(handle->read_buf != NULL) {
+    return UART_STATUS_ERROR;
+  }
+
+  handle->read_buf = buffer;
+  handle->read_size = size;
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+UART_readCancel(UART_Handle handle)
+{
+  void *buf = handle->read_buf;
+
+  if(buf != NULL) {
+    handle->read_buf = NULL;
+    handle->params.readCallback(handle, buf, 0);
+  }
+}
+/*---------------------------------------------------------------------------*/
+int_fast32_t
+UART_write(UART_Handle handle, const void *buffer, size_t size)
+{
+  struct pollfd pfd = { handle->fd, POLLOUT, 0 };
+  const uint8_t *p = buffer;
+  size_t left = size;
+  ssize_t n;
+
+  if(handle->write_buf != NULL) {
+    return UART_STATUS_ERROR;
+  }
+
+  /* The runner reads every node all the time, this never waits long */
+  while(left > 0) {
+    n = write(handle->fd, p, left);
+    if(n > 0) {
+      p += n;
+      left -= n;
+    } else if(n < 0 && errno == EAGAIN) {
+      poll(&pfd, 1, -1);
+    } else {
+      exit(EXIT_SUCCESS);
+    }
+  }
+
+  /* The driver calls back from its interrupt, never from within the
+   * write */
+  handle->write_buf = buffer;
+  handle->write_size = size;
+  process_poll(&sim_uart_process);
+
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+uart_set_fd(fd_set *rset, fd_set *wset)
+{
+  if(uart.read_buf == NULL) {
+    return 0;
+  }
+
+  FD_SET(uart.fd, rset);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+uart_handle_fd(fd_set *rset, fd_set *wset)
+{
+  void *buf = uart.read_buf;
+  ssize_t n;
+
+  if(buf == NULL || !FD_ISSET(uart.fd, rset)) {
+    return;
+  }
+
+  n = read(uart.fd, buf, uart.read_size);
+  if(n == 0 || (n < 0 && errno != EAGAIN)) {
+    /* The host is gone, and with it the node */
+    exit(EXIT_SUCCESS);
+  }
+  if(n > 0) {
+    uart.read_buf = NULL;
+    uart.params.readCallback(&uart, buf, n);
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(sim_uart_process, ev, data)
+{
+  const void *buf;
+
+  PROCESS_BEGIN();
+
+  while(1) {
+    PROCESS_YIELD_UNTIL(ev == PROCESS_EVENT_POLL);
+
+    buf = uart.write_buf;
+    if(buf != NULL) {
+      uart.write_buf = NULL;
+      uart.params.writeCallback(&uart, (void *)buf, uart.write_size);
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+PIN_Handle
+PIN_open(PIN_State *state, const PIN_Config pin_list[])
+{
+  state->config = pin_list;
+  return state;
+}
+/*---------------------------------------------------------------------------*/
+void
+PIN_close(PIN_Handle handle)
+{
+}
+/*---------------------------------------------------------------------------*/
+int
+PIN_registerIntCb(PIN_Handle handle, PIN_IntCb callback)
+{
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+PIN_setInterrupt(PIN_Handle handle, PIN_Config pin_config)
+{
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+NVS_init(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+void
+NVS_Params_init(NVS_Params *params)
+{
+  params->custom = NULL;
+}
+/*---------------------------------------------------------------------------*/
+NVS_Handle
+NVS_open(uint_least8_t index, NVS_Params *params)
+{
+  const char *path = getenv(SIM_ENV_NVS_FILE);
+  ssize_t n;
+
+  if(index != Board_NVSINTERNAL || path == NULL) {
+    return NULL;
+  }
+
+  nvs.fd = open(path, O_RDWR | O_CREAT, 0644);
+  if(nvs.fd < 0) {
+    return NULL;
+  }
+
+  /* A new file is erased flash */
+  memset(nvs.data, 0xFF, sizeof(nvs.data));
+  n = pread(nvs.fd, nvs.data, sizeof(nvs.data), 0);
+  if(n < (ssize_t)sizeof(nvs.data) &&
+     pwrite(nvs.fd, nvs.data, sizeof(nvs.data), 0) !=
+     (ssize_t)sizeof(nvs.data)) {
+    close(nvs.fd);
+    return NULL;
+  }
+
+  return &nvs;
+}
+/*---------------------------------------------------------------------------*/
+void
+NVS_close(NVS_Handle handle)
+{
+  close(handle->fd);
+}
+/*---------------------------------------------------------------------------*/
+void
+NVS_getAttrs(NVS_Handle handle, NVS_Attrs *attrs)
+{
+  attrs->regionBase = 0;
+  attrs->regionSize = NVS_REGION_SIZE;
+  attrs->sectorSize = NVS_SECTOR_SIZE;
+}
+/*---------------------------------------------------------------------------*/
+static int
+nvs_flush(NVS_Handle handle, size_t offset, size_t size)
+{
+  return pwrite(handle->fd, &handle->data[offset], size, offset) ==
+         (ssize_t)size ? NVS_STATUS_SUCCESS : NVS_STATUS_ERROR;
+}
+/*---------------------------------------------------------------------------*/
+int_fast16_t
+NVS_read(NVS_Handle handle, size_t offset, void *buffer, size_t size)
+{
+  if(offset + size > NVS_REGION_SIZE) {
+    return NVS_STATUS_INV_OFFSET;
+  }
+
+  memcpy(buffer, &handle->data[offset], size);
+  return NVS_STATUS_SUCCESS;
+}
+/*---------------------------------------------------------------------------*/
+int_fast16_t
+NVS_write(NVS_Handle handle, size_t offset, void *buffer, size_t size,
+          uint_fast16_t flags)
+{
+  const uint8_t *src = buffer;
+  size_t i;
+
+  if(offset + size > NVS_REGION_SIZE) {
+    return NVS_STATUS_INV_OFFSET;
+  }
+
+  if(flags & NVS_WRITE_PRE_VERIFY) {
+    for(i = 0; i < size; i++) {
+      if((handle->data[offset + i] & src[i]) != src[i]) {
+        return NVS_STATUS_INV_WRITE;
+      }
+    }
+  }
+
+  /* Programming only clears bits */
+  for(i = 0; i < size; i++) {
+    handle->data[offset + i] &= src[i];
+  }
+
+  if(nvs_flush(handle, offset, size) != NVS_STATUS_SUCCESS) {
+    return NVS_STATUS_ERROR;
+  }
+
+  if((flags & NVS_WRITE_POST_VERIFY) &&
+     memcmp(&handle->data[offset], src, size) != 0) {
+    return NVS_STATUS_INV_WRITE;
+  }
+
+  return NVS_STATUS_SUCCESS;
+}
+/*---------------------------------------------------------------------------*/
+int_fast16_t
+NVS_erase(NVS_Handle handle, size_t offset, size_t size)
+{
+  if(offset % NVS_SECTOR_SIZE != 0 || size % NVS_SECTOR_SIZE != 0 ||
+     offset + size > NVS_REGION_SIZE) {
+    return NVS_STATUS_INV_OFFSET;
+  }
+
+  memset(&handle->data[offset], 0xFF, size);
+  return nvs_flush(handle, offset, size);
+}
+/*---------------------------------------------------------------------------*/
+int_fast16_t
+CryptoKeyPlaintext_initKey(CryptoKey *key, uint8_t *material, size_t length)
+{
+  key->keyMaterial = material;
+  key->keyLength = length;
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+AESCCM_init(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+void
+AESCCM_Params_init(AESCCM_Params *params)
+{
+  params->returnBehavior = AESCCM_RETURN_BEHAVIOR_BLOCKING;
+  params->timeout = 0;
+}
+/*---------------------------------------------------------------------------*/
+AESCCM_Handle
+AESCCM_open(uint_least8_t index, AESCCM_Params *params)
+{
+  aesccm.params = *params;
+  return &aesccm;
+}
+/*---------------------------------------------------------------------------*/
+void
+AESCCM_Operation_init(AESCCM_Operation *operation)
+{
+  memset(operation, 0, sizeof(*operation));
+}
+/*---------------------------------------------------------------------------*/
+/* Stand-in for the MIC, over the plaintext */
+static void
+compute_mac(const AESCCM_Operation *op, const uint8_t *plaintext,
+            uint8_t *mac)
+{
+  uint16_t acc = 0;
+  uint8_t i;
+
+  acc = crc16_data(op->key->keyMaterial, op->key->keyLength, acc);
+  acc = crc16_data(op->nonce, op->nonceLength, acc);
+  acc = crc16_data(op->aad, op->aadLength, acc);
+  acc = crc16_data(plaintext, op->inputLength, acc);
+
+  for(i = 0; i < op->macLength; i++) {
+    mac[i] = i & 1 ? acc >> 8 : acc & 0xFF;
+    if(i & 1) {
+      acc = crc16_add(i, acc);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+int_fast16_t
+AESCCM_oneStepEncrypt(AESCCM_Handle handle, AESCCM_Operation *operation)
+{
+  memmove(operation->output, operation->input, operation->inputLength);
+  compute_mac(operation, operation->output, operation->mac);
+  return AESCCM_STATUS_SUCCESS;
+}
+/*---------------------------------------------------------------------------*/
+int_fast16_t
+AESCCM_oneStepDecrypt(AESCCM_Handle handle, AESCCM_Operation *operation)
+{
+  uint8_t mac[16];
+
+  if(operation->macLength > sizeof(mac)) {
+    return AESCCM_STATUS_ERROR;
+  }
+
+  compute_mac(operation, operation->input, mac);
+  if(memcmp(mac, operation->mac, operation->macLength) != 0) {
+    return AESCCM_STATUS_MAC_INVALID;
+  }
+
+  memmove(operation->output, operation->input, operation->inputLength);
+  return AESCCM_STATUS_SUCCESS;
+}
+/*---------------------------------------------------------------------------*/
+void
+SHA2_init(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+void
+SHA2_Params_init(SHA2_Params *params)
+{
+  params->returnBehavior = SHA2_RETURN_BEHAVIOR_BLOCKING;
+  params->timeout = 0;
+}
+/*---------------------------------------------------------------------------*/
+SHA2_Handle
+SHA2_open(uint_least8_t index, const SHA2_Params *params)
+{
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+void
+SHA2_reset(SHA2_Handle handle)
+{
+}
+/*---------------------------------------------------------------------------*/
+int_fast16_t
+SHA2_addData(SHA2_Handle handle, const void *data, size_t length)
+{
+  return SHA2_STATUS_ERROR;
+}
+/*---------------------------------------------------------------------------*/
+int_fast16_t
+SHA2_finalize(SHA2_Handle handle, void *digest)
+{
+  return SHA2_STATUS_ERROR;
+}
+/*---------------------------------------------------------------------------*/
+const ECCParams_CurveParams ECCParams_NISTP256 = { 32 };
+/*---------------------------------------------------------------------------*/
+void
+ECDSA_init(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+void
+ECDSA_Params_init(ECDSA_Params *params)
+{
+  memset(params, 0, sizeof(*params));
+  params->returnBehavior = ECDSA_RETURN_BEHAVIOR_BLOCKING;
+}
+/*---------------------------------------------------------------------------*/
+ECDSA_Handle
+ECDSA_open(uint_least8_t index, const ECDSA_Params *params)
+{
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+void
+ECDSA_OperationVerify_init(ECDSA_OperationVerify *operation)
+{
+  memset(operation, 0, sizeof(*operation));
+}
+/*---------------------------------------------------------------------------*/
+int_fast16_t
+ECDSA_verify(ECDSA_Handle handle, ECDSA_OperationVerify *operation)
+{
+  return ECDSA_STATUS_ERROR;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,67 @@
+/**
+ * \file
+ *         Boot time arena for application state
+ */
+#include "contiki.h"
+#include "arena.h"
+
+#include "sys/log.h"
+#define LOG_MODULE "Arena"
+#define LOG_LEVEL LOG_LEVEL_APP
+/*---------------------------------------------------------------------------*/
+/* One array per region, so that the quotas show up by name in the symbol
+ * table for tools/mem-report.py */
+#define ARENA_REGION_STORAGE(name, quota) \
+  static uint8_t arena_##name[ARENA_SIZEOF(quota)] \
+    __attribute__((aligned(ARENA_ALIGN)));
+ARENA_REGIONS(ARENA_REGION_STORAGE)
+#undef ARENA_REGION_STORAGE
+
+#define ARENA_REGION_BASE(name, quota) arena_##name,
+static uint8_t *const bases[ARENA_REGION_COUNT] = {
+  ARENA_REGIONS(ARENA_REGION_BASE)
+};
+#undef ARENA_REGION_BASE
+
+#define ARENA_REGION_QUOTA(name, quota) ARENA_SIZEOF(quota),
+static const uint16_t quotas[ARENA_REGION_COUNT] = {
+  ARENA_REGIONS(ARENA_REGION_QUOTA)
+};
+#undef ARENA_REGION_QUOTA
+
+static uint16_t used[ARENA_REGION_COUNT];
+/*---------------------------------------------------------------------------*/
+void *
+arena_alloc(uint8_t region, size_t size)
+{
+  void *ptr;
+
+  if(region >= ARENA_REGION_COUNT) {
+    return NULL;
+  }
+
+  size = ARENA_SIZEOF(size);
+  if(used[region] + size > quotas[region]) {
+    LOG_ERR("Region %u out of quota (%u of %u used, %u requested)\n",
+            region, used[region], quotas[region], (unsigned)size);
+    return NULL;
+  }
+
+  ptr = bases[region] + used[region];
+  used[region] += size;
+
+  return ptr;
+}
+/*---------------------------------------------------------------------------*/
+size_t
+arena_used(uint8_t region)
+{
+  return region < ARENA_REGION_COUNT ? used[region] : 0;
+}
+/*---------------------------------------------------------------------------*/
+size_t
+arena_quota(uint8_t region)
+{
+  return region < ARENA_REGION_COUNT ? quotas[region] : 0;
+}
+/*---------------------------------------------------------------------------*/
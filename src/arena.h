@@ -0,0 +1,165 @@
+/**
+ * \file
+ *         Boot time arena for application state
+ *
+ *         Application state that scales with the configuration is not
+ *         declared by the modules owning it but taken from the arena while
+ *         they initialize. The arena is split in one region per subsystem,
+ *         each sized by its ARENA_CONF_QUOTA_* budget in project-conf.h.
+ *         Memory is handed out with a bump pointer and never given back,
+ *         so there is nothing to fragment, and a subsystem outgrowing its
+ *         quota fails at boot instead of starving its neighbours. Modules
+ *         check their needs against their quota at compile time.
+ *
+ *         tools/mem-report.py prints the quotas next to the flash and RAM
+ *         used by every module, `make` runs it after every build.
+ */
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "contiki.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------*/
+/** \name Region quotas, in bytes @{ */
+#ifdef ARENA_CONF_QUOTA_FRAME_POOL
+#define ARENA_QUOTA_FRAME_POOL ARENA_CONF_QUOTA_FRAME_POOL
+#else
+#define ARENA_QUOTA_FRAME_POOL 2368
+#endif
+
+#ifdef ARENA_CONF_QUOTA_TX_QUEUE
+#define ARENA_QUOTA_TX_QUEUE ARENA_CONF_QUOTA_TX_QUEUE
+#else
+#define ARENA_QUOTA_TX_QUEUE 256
+#endif
+
+#ifdef ARENA_CONF_QUOTA_HOST_LINK
+#define ARENA_QUOTA_HOST_LINK ARENA_CONF_QUOTA_HOST_LINK
+#else
+#define ARENA_QUOTA_HOST_LINK 2480
+#endif
+
+#ifdef ARENA_CONF_QUOTA_LOG_RING
+#define ARENA_QUOTA_LOG_RING ARENA_CONF_QUOTA_LOG_RING
+#else
+#define ARENA_QUOTA_LOG_RING 512
+#endif
+
+#ifdef ARENA_CONF_QUOTA_NEIGHBOR
+#define ARENA_QUOTA_NEIGHBOR ARENA_CONF_QUOTA_NEIGHBOR
+#else
+#define ARENA_QUOTA_NEIGHBOR 1216
+#endif
+
+#ifdef ARENA_CONF_QUOTA_DUP_CACHE
+#define ARENA_QUOTA_DUP_CACHE ARENA_CONF_QUOTA_DUP_CACHE
+#else
+#define ARENA_QUOTA_DUP_CACHE 128
+#endif
+
+#ifdef ARENA_CONF_QUOTA_ROUTE
+#define ARENA_QUOTA_ROUTE ARENA_CONF_QUOTA_ROUTE
+#else
+#define ARENA_QUOTA_ROUTE 384
+#endif
+
+#ifdef ARENA_CONF_QUOTA_FRAG
+#define ARENA_QUOTA_FRAG ARENA_CONF_QUOTA_FRAG
+#else
+#define ARENA_QUOTA_FRAG 3200
+#endif
+
+#ifdef ARENA_CONF_QUOTA_OTA
+#define ARENA_QUOTA_OTA ARENA_CONF_QUOTA_OTA
+#else
+#define ARENA_QUOTA_OTA 2304
+#endif
+
+#ifdef ARENA_CONF_QUOTA_COMPRESS
+#define ARENA_QUOTA_COMPRESS ARENA_CONF_QUOTA_COMPRESS
+#else
+#define ARENA_QUOTA_COMPRESS 1152
+#endif
+
+#ifdef ARENA_CONF_QUOTA_SLOTS
+#define ARENA_QUOTA_SLOTS ARENA_CONF_QUOTA_SLOTS
+#else
+#define ARENA_QUOTA_SLOTS 32
+#endif
+
+#ifdef ARENA_CONF_QUOTA_STORE
+#define ARENA_QUOTA_STORE ARENA_CONF_QUOTA_STORE
+#else
+#define ARENA_QUOTA_STORE 2304
+#endif
+
+#ifdef ARENA_CONF_QUOTA_CHAN
+#define ARENA_QUOTA_CHAN ARENA_CONF_QUOTA_CHAN
+#else
+#define ARENA_QUOTA_CHAN 64
+#endif
+/** @} */
+
+/**
+ * Arena regions and their quotas. The region of subsystem FOO is
+ * ARENA_FOO, tools/mem-report.py attributes it to module foo.
+ */
+#define ARENA_REGIONS(X) \
+  X(FRAME_POOL, ARENA_QUOTA_FRAME_POOL) \
+  X(TX_QUEUE,   ARENA_QUOTA_TX_QUEUE) \
+  X(HOST_LINK,  ARENA_QUOTA_HOST_LINK) \
+  X(LOG_RING,   ARENA_QUOTA_LOG_RING) \
+  X(NEIGHBOR,   ARENA_QUOTA_NEIGHBOR) \
+  X(DUP_CACHE,  ARENA_QUOTA_DUP_CACHE) \
+  X(ROUTE,      ARENA_QUOTA_ROUTE) \
+  X(FRAG,       ARENA_QUOTA_FRAG) \
+  X(OTA,        ARENA_QUOTA_OTA) \
+  X(COMPRESS,   ARENA_QUOTA_COMPRESS) \
+  X(SLOTS,      ARENA_QUOTA_SLOTS) \
+  X(STORE,      ARENA_QUOTA_STORE) \
+  X(CHAN,       ARENA_QUOTA_CHAN)
+
+#define ARENA_REGION_ENUM(name, quota) ARENA_##name,
+enum {
+  ARENA_REGIONS(ARENA_REGION_ENUM)
+  ARENA_REGION_COUNT
+};
+#undef ARENA_REGION_ENUM
+
+/** Alignment of every allocation */
+#define ARENA_ALIGN 8
+
+/** Room an allocation of size bytes takes in its region */
+#define ARENA_SIZEOF(size) (((size) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Take zeroed memory from a region, only during initialization.
+ * \param region One of the ARENA_* region IDs
+ * \param size Bytes needed, rounded up to ARENA_ALIGN
+ * \return The memory, or NULL if it would exceed the region quota.
+ */
+void *arena_alloc(uint8_t region, size_t size);
+
+/**
+ * \brief Bytes of a region handed out so far.
+ */
+size_t arena_used(uint8_t region);
+
+/**
+ * \brief Quota of a region, in bytes.
+ */
+size_t arena_quota(uint8_t region);
+/*---------------------------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ARENA_H */
@@ -0,0 +1,540 @@
+/**
+ * \file
+ *         Radio throughput and latency benchmark
+ *
+ *         Core of the radio-bench image. A node started by the host with
+ *         HOST_CMD_BENCH_START sends timestamped requests of a fixed size to
+ *         a peer at a fixed interval, and the peer echoes every request it
+ *         receives. Once the run is over the sender reports with
+ *         HOST_CMD_BENCH_REPORT, the peer answers HOST_CMD_BENCH_GET with
+ *         its own side of the run. RTTs are measured on the sender clock
+ *         only, so the two nodes need no synchronization.
+ *
+ *         Requests go straight to link_send() in the interactive class, one
+ *         frame on air each, the TX queue is not involved.
+ */
+
+extern "C" {
+#include "contiki.h"
+#include "sys/log.h"
+}
+
+#include "byteorder.h"
+#include "frag.h"
+#include "frame-pool.h"
+#include "host-link.h"
+#include "link.h"
+#include "link-sec.h"
+#include "log-ring.h"
+#include "mesh.h"
+#include "neighbor.h"
+#include "persist.h"
+#include "prof.h"
+#include "radio-config.hpp"
+#include "rf-core.h"
+#include "route.h"
+#include "stats.h"
+#include "tx-sched.h"
+
+#include <algorithm>
+#include <string.h>
+
+#define LOG_MODULE "Bench"
+#define LOG_LEVEL LOG_LEVEL_APP
+
+/** RTT samples kept for the percentiles, later echoes only count */
+#ifdef BENCH_CONF_MAX_SAMPLES
+#define BENCH_MAX_SAMPLES BENCH_CONF_MAX_SAMPLES
+#else
+#define BENCH_MAX_SAMPLES 256
+#endif
+
+/** Echoes waiting to be sent, requests arriving on a full queue are lost */
+#ifdef BENCH_CONF_ECHO_QUEUE
+#define BENCH_ECHO_QUEUE BENCH_CONF_ECHO_QUEUE
+#else
+#define BENCH_ECHO_QUEUE 4
+#endif
+
+/** Time the sender keeps waiting for echoes after its last request */
+#ifdef BENCH_CONF_DRAIN_TIME
+#define BENCH_DRAIN_TIME BENCH_CONF_DRAIN_TIME
+#else
+#define BENCH_DRAIN_TIME CLOCK_SECOND
+#endif
+
+extern "C" {
+PROCESS_NAME(bench_process);
+}
+
+namespace
+{
+
+using Radio = radio::ActiveConfig;
+
+constexpr rf_core_params rf_params = radio::rfCoreParams<Radio>();
+
+/* Benchmark payload: [magic (1)] [kind (1)] [seqno (2)] [timestamp (4)],
+ * padded up to the size of the run */
+constexpr uint8_t bench_magic = 0xBE;
+constexpr uint8_t kind_request = 0;
+constexpr uint8_t kind_echo = 1;
+constexpr uint16_t bench_hdr_len = 8;
+
+/* Values of the role field of HOST_CMD_BENCH_REPORT */
+constexpr uint8_t role_echo = 0;
+constexpr uint8_t role_sender = 1;
+
+constexpr uint16_t report_len = 44;
+
+uint32_t rtimerToUs(rtimer_clock_t ticks)
+{
+    return static_cast<uint32_t>((static_cast<uint64_t>(ticks) * 1000000) /
+                                 RTIMER_SECOND);
+}
+
+struct Echo
+{
+    linkaddr_t dst;
+    uint8_t hdr[bench_hdr_len];
+    uint8_t len;
+};
+
+class Bench
+{
+public:
+    int init();
+    void input(const struct link_hdr *hdr, const uint8_t *data, uint16_t len);
+
+    void hostStart(const uint8_t *args, uint16_t len);
+    void hostGet(const uint8_t *args, uint16_t len);
+
+    bool startPending() const
+    {
+        return start_pending_;
+    }
+    clock_time_t interval() const;
+    void begin();
+    bool sendNext();
+    void flushEchoes();
+    void finish();
+
+private:
+    void reset(uint8_t role);
+    void queueEcho(const struct link_hdr *hdr, const uint8_t *data,
+                   uint16_t len);
+    void recordEcho(const uint8_t *data);
+    bool sendFrame(const linkaddr_t &dst, const uint8_t *hdr, uint8_t len);
+    uint32_t percentile(unsigned pct) const;
+    void sendReport();
+
+    /* Run requested by the host */
+    linkaddr_t peer_;
+    uint16_t count_;
+    uint8_t len_;
+    uint16_t interval_ms_;
+    bool start_pending_;
+    bool running_;
+
+    Echo echoes_[BENCH_ECHO_QUEUE];
+    uint8_t echo_head_;
+    uint8_t echo_count_;
+
+    /* Results of the last run, either side */
+    uint8_t role_;
+    uint16_t sent_;
+    uint16_t received_;
+    uint16_t expected_;
+    uint8_t frame_len_;
+    rtimer_clock_t first_;
+    rtimer_clock_t last_;
+    uint32_t rtt_[BENCH_MAX_SAMPLES];
+    uint16_t samples_;
+    uint32_t rtt_min_;
+    uint32_t rtt_max_;
+};
+
+Bench bench;
+
+void inputCallback(const struct link_hdr *hdr, const uint8_t *data,
+                   uint16_t len)
+{
+    bench.input(hdr, data, len);
+}
+
+void startCallback(const uint8_t *args, uint16_t len)
+{
+    bench.hostStart(args, len);
+}
+
+void getCallback(const uint8_t *args, uint16_t len)
+{
+    bench.hostGet(args, len);
+}
+
+host_link_handler start_handler = {
+    nullptr, HOST_CMD_BENCH_START, startCallback
+};
+host_link_handler get_handler = {
+    nullptr, HOST_CMD_BENCH_GET, getCallback
+};
+
+int Bench::init()
+{
+    /* Ahead of every module that counts */
+    stats_init();
+    log_ring_init();
+#if LINK_SEC_ENABLED
+    /* For the frame counter of link security, which must not repeat
+     * across resets */
+    if (persist_init() != 0)
+    {
+        LOG_WARN("NVS region unusable, secured frames refused\n");
+    }
+#endif
+    frame_pool_init();
+    neighbor_init();
+    mesh_init();
+    route_init();
+    frag_init();
+    tx_sched_init();
+
+    if (host_link_init() != 0)
+    {
+        return -1;
+    }
+#if LINK_SEC_ENABLED
+    /* Frames in the clear need no crypto driver */
+    if (link_sec_init() != 0)
+    {
+        return -1;
+    }
+#endif
+    prof_init();
+    host_link_register(&start_handler);
+    host_link_register(&get_handler);
+
+    link_set_input_callback(inputCallback);
+    rf_core_set_input_callback(link_input);
+    return rf_core_init(&rf_params);
+}
+
+void Bench::input(const struct link_hdr *hdr, const uint8_t *data,
+                  uint16_t len)
+{
+    if (len < bench_hdr_len || data[0] != bench_magic)
+    {
+        return;
+    }
+
+    if (data[1] == kind_request)
+    {
+        queueEcho(hdr, data, len);
+    }
+    else if (data[1] == kind_echo)
+    {
+        recordEcho(data);
+    }
+}
+
+void Bench::hostStart(const uint8_t *args, uint16_t len)
+{
+    if (len != 7)
+    {
+        host_link_send_result(HOST_CMD_BENCH_START, HOST_STATUS_INVALID);
+        return;
+    }
+
+    if (running_ || start_pending_)
+    {
+        host_link_send_result(HOST_CMD_BENCH_START, HOST_STATUS_ERROR);
+        return;
+    }
+
+    memcpy(&peer_, args, LINKADDR_SIZE);
+    count_ = get_le16(&args[2]);
+    len_ = args[4];
+    interval_ms_ = get_le16(&args[5]);
+
+    if (count_ == 0 || len_ < bench_hdr_len || len_ > LINK_MAX_DATA_LEN)
+    {
+        host_link_send_result(HOST_CMD_BENCH_START, HOST_STATUS_INVALID);
+        return;
+    }
+
+    start_pending_ = true;
+    process_poll(&bench_process);
+    host_link_send_result(HOST_CMD_BENCH_START, HOST_STATUS_OK);
+}
+
+void Bench::hostGet(const uint8_t *args, uint16_t len)
+{
+    (void)args;
+    (void)len;
+
+    sendReport();
+}
+
+clock_time_t Bench::interval() const
+{
+    /* Rounded up to a whole clock tick, an interval of 0 runs at one
+     * request per tick */
+    const clock_time_t ticks =
+        (static_cast<clock_time_t>(interval_ms_) * CLOCK_SECOND + 999) / 1000;
+
+    return std::max<clock_time_t>(ticks, 1);
+}
+
+void Bench::reset(uint8_t role)
+{
+    role_ = role;
+    sent_ = 0;
+    received_ = 0;
+    expected_ = 0;
+    frame_len_ = 0;
+    first_ = RTIMER_NOW();
+    last_ = first_;
+    samples_ = 0;
+    rtt_min_ = 0;
+    rtt_max_ = 0;
+    prof_reset();
+}
+
+void Bench::begin()
+{
+    start_pending_ = false;
+    running_ = true;
+
+    reset(role_sender);
+    expected_ = count_;
+    frame_len_ = len_;
+}
+
+bool Bench::sendNext()
+{
+    uint8_t hdr[bench_hdr_len];
+
+    if (sent_ == count_)
+    {
+        return false;
+    }
+
+    hdr[0] = bench_magic;
+    hdr[1] = kind_request;
+    put_le16(&hdr[2], sent_);
+    put_le32(&hdr[4], RTIMER_NOW());
+
+    /* A request that could not be sent simply never comes back */
+    sendFrame(peer_, hdr, len_);
+    sent_++;
+
+    return true;
+}
+
+void Bench::flushEchoes()
+{
+    while (echo_count_ > 0)
+    {
+        const Echo &echo = echoes_[echo_head_];
+
+        if (sendFrame(echo.dst, echo.hdr, echo.len) && !running_)
+        {
+            sent_++;
+        }
+
+        echo_head_ = (echo_head_ + 1) % BENCH_ECHO_QUEUE;
+        echo_count_--;
+    }
+}
+
+void Bench::finish()
+{
+    running_ = false;
+
+    std::sort(rtt_, rtt_ + samples_);
+    sendReport();
+}
+
+void Bench::queueEcho(const struct link_hdr *hdr, const uint8_t *data,
+                      uint16_t len)
+{
+    const uint16_t seqno = get_le16(&data[2]);
+
+    /* While running a benchmark of its own a node still echoes, but the
+     * results being collected are those of the sender */
+    if (!running_)
+    {
+        if (seqno == 0 || role_ != role_echo)
+        {
+            reset(role_echo);
+            frame_len_ = len;
+        }
+
+        last_ = RTIMER_NOW();
+        received_++;
+        expected_ = std::max<uint16_t>(expected_, seqno + 1);
+    }
+
+    if (echo_count_ == BENCH_ECHO_QUEUE)
+    {
+        return;
+    }
+
+    Echo &echo = echoes_[(echo_head_ + echo_count_) % BENCH_ECHO_QUEUE];
+    linkaddr_copy(&echo.dst, &hdr->src);
+    memcpy(echo.hdr, data, bench_hdr_len);
+    echo.hdr[1] = kind_echo;
+    echo.len = static_cast<uint8_t>(len);
+    echo_count_++;
+
+    /* Sent from the benchmark process, not from within RX */
+    process_poll(&bench_process);
+}
+
+void Bench::recordEcho(const uint8_t *data)
+{
+    if (!running_ || role_ != role_sender)
+    {
+        return;
+    }
+
+    const rtimer_clock_t now = RTIMER_NOW();
+    const uint32_t rtt = rtimerToUs(now - get_le32(&data[4]));
+
+    if (received_ == 0 || rtt < rtt_min_)
+    {
+        rtt_min_ = rtt;
+    }
+    rtt_max_ = std::max(rtt_max_, rtt);
+    if (samples_ < BENCH_MAX_SAMPLES)
+    {
+        rtt_[samples_++] = rtt;
+    }
+
+    last_ = now;
+    received_++;
+}
+
+bool Bench::sendFrame(const linkaddr_t &dst, const uint8_t *hdr, uint8_t len)
+{
+    struct frame *frame = frame_pool_alloc();
+
+    if (frame == nullptr)
+    {
+        return false;
+    }
+
+    memcpy(link_data(frame), hdr, bench_hdr_len);
+    memset(link_data(frame) + bench_hdr_len, 0x55, len - bench_hdr_len);
+    return link_send(frame, LINK_TYPE_DATA, &dst, len,
+                     TX_CLASS_INTERACTIVE) == 0;
+}
+
+uint32_t Bench::percentile(unsigned pct) const
+{
+    if (samples_ == 0)
+    {
+        return 0;
+    }
+
+    return rtt_[((samples_ - 1) * pct) / 100];
+}
+
+void Bench::sendReport()
+{
+    uint8_t report[report_len];
+    struct prof_stats tx, encrypt, rx_isr, rx_drain;
+    const uint16_t sniff_ms = rf_core_get_sniff_interval();
+    /* The long preamble of low-power listening included, as rf-core.c
+     * sizes it */
+    const uint32_t airtime =
+        Radio::airtimeUs(LINK_HDR_LEN + frame_len_ + LINK_SEC_OVERHEAD) +
+        (sniff_ms ? static_cast<uint32_t>(sniff_ms) * 1000 +
+                    Radio::sniff_window_us : 0);
+
+    /* CPU time only: PROF_RF_TX ends once the TX is posted, the RF core
+     * sends the frame on its own */
+    prof_get(PROF_RF_TX, &tx);
+    prof_get(PROF_LINK_SEC_ENCRYPT, &encrypt);
+    prof_get(PROF_RF_RX_ISR, &rx_isr);
+    prof_get(PROF_RF_RX_DRAIN, &rx_drain);
+
+    report[0] = role_;
+    put_le16(&report[1], sent_);
+    put_le16(&report[3], received_);
+    put_le16(&report[5], expected_);
+    report[7] = frame_len_;
+    put_le32(&report[8], rtimerToUs(last_ - first_));
+    put_le32(&report[12], rtt_min_);
+    put_le32(&report[16], percentile(50));
+    put_le32(&report[20], percentile(90));
+    put_le32(&report[24], percentile(99));
+    put_le32(&report[28], rtt_max_);
+    put_le32(&report[32],
+             static_cast<uint32_t>(sent_ ? (tx.sum + encrypt.sum) / sent_ :
+                                   0));
+    put_le32(&report[36],
+             static_cast<uint32_t>(received_ ?
+                                   (rx_isr.sum + rx_drain.sum) / received_ :
+                                   0));
+    put_le32(&report[40], airtime);
+
+    host_link_send(HOST_CMD_BENCH_REPORT, report, sizeof(report), nullptr, 0);
+}
+
+} // namespace
+
+/*---------------------------------------------------------------------------*/
+extern "C" {
+PROCESS(bench_process, "Radio benchmark");
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(bench_process, ev, data)
+{
+    static struct etimer timer;
+
+    PROCESS_BEGIN();
+
+    if (bench.init() != 0)
+    {
+        LOG_ERR("RF core initialization failed\n");
+        PROCESS_EXIT();
+    }
+
+    LOG_RECORD(BOOT);
+
+    while (1)
+    {
+        PROCESS_WAIT_EVENT();
+        bench.flushEchoes();
+
+        if (!bench.startPending())
+        {
+            continue;
+        }
+
+        bench.begin();
+        while (bench.sendNext())
+        {
+            etimer_set(&timer, bench.interval());
+            do
+            {
+                PROCESS_WAIT_EVENT();
+                bench.flushEchoes();
+            } while (!etimer_expired(&timer));
+        }
+
+        /* Leave the last echoes time to come back */
+        etimer_set(&timer, BENCH_DRAIN_TIME);
+        do
+        {
+            PROCESS_WAIT_EVENT();
+            bench.flushEchoes();
+        } while (!etimer_expired(&timer));
+
+        bench.finish();
+    }
+
+    PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
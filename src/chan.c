@@ -0,0 +1,400 @@
+/**
+ * \file
+ *         Dynamic channel selection
+ */
+#include "contiki.h"
+#include "chan.h"
+#include "arena.h"
+#include "byteorder.h"
+#include "frame-pool.h"
+#include "link.h"
+#include "log-ring.h"
+#include "monitor.h"
+#include "persist.h"
+#include "rf-core.h"
+#include "stats.h"
+#include "tx-sched.h"
+#include "lib/random.h"
+
+#include <stdbool.h>
+#include <string.h>
+/*---------------------------------------------------------------------------*/
+/* [epoch (2)] [origin (2)] [channel (1)] [switch in (2)] */
+#define ANNOUNCE_LEN  (2 + LINKADDR_SIZE + 1 + 2)
+
+#define SWITCH_TICKS  ((clock_time_t)CHAN_SWITCH_DELAY * CLOCK_SECOND / 1000)
+/* Time between the announcements of a node */
+#define REPEAT_GAP    (SWITCH_TICKS / (CHAN_REPEATS + 1))
+
+/* Averages hold 4 fractional bits */
+#define AVG_FRAC_BITS 4
+
+#define NONE          0xFF
+
+/* Saved as [channel (1)] [epoch (2)] */
+#define SAVED_LEN     3
+
+#if CHAN_ENABLED && TX_SCHED_MODE == TX_SCHED_MODE_SLOTTED
+#error "CHAN_CONF_ENABLED does not mix with the slotted MAC mode"
+#endif
+
+_Static_assert(CHAN_COUNT >= 2 && CHAN_COUNT < NONE && CHAN_STRIDE > 0,
+               "CHAN_CONF_COUNT or CHAN_CONF_STRIDE out of range");
+_Static_assert(CHAN_FIRST + (CHAN_COUNT - 1) * CHAN_STRIDE < NONE,
+               "candidate channels do not fit in a byte");
+_Static_assert(CHAN_REPEATS > 0 && CHAN_SWITCH_DELAY <= UINT16_MAX &&
+               REPEAT_GAP > 0,
+               "CHAN_CONF_REPEATS or CHAN_CONF_SWITCH_DELAY out of range");
+_Static_assert(CHAN_AVG_SHIFT > 0 && CHAN_AVG_SHIFT < 8,
+               "CHAN_CONF_AVG_SHIFT out of range");
+/* A scan holds the event loop for its whole sampling time */
+_Static_assert(!CHAN_ENABLED || CHAN_SCAN_TIME < MONITOR_BUDGET,
+               "CHAN_CONF_SCAN_TIME stalls the loop past MONITOR_CONF_BUDGET");
+/*---------------------------------------------------------------------------*/
+struct survey {
+  /* Share of busy samples, in 1/256 with AVG_FRAC_BITS more */
+  uint16_t occupancy;
+  /* Noise floor, in dBm with AVG_FRAC_BITS more */
+  int16_t noise;
+  uint8_t scanned;
+};
+
+/* A migration announced, and the switch it is counting down to */
+struct migration {
+  uint16_t epoch;
+  linkaddr_t origin;
+  uint8_t channel;
+  clock_time_t at;
+  uint8_t repeats;
+};
+
+_Static_assert(ARENA_SIZEOF(CHAN_COUNT * sizeof(struct survey)) <=
+               ARENA_QUOTA_CHAN,
+               "CHAN_CONF_COUNT channels do not fit in ARENA_CONF_QUOTA_CHAN");
+/*---------------------------------------------------------------------------*/
+static struct survey *surveys;
+/* Candidate RX is on */
+static uint8_t current;
+/* Candidate the next scan surveys */
+static uint8_t next_scan;
+/* Epoch of the last migration followed */
+static uint16_t epoch;
+static clock_time_t switched_at;
+/* Consecutive scans a candidate was worth migrating to */
+static uint16_t better_scans;
+
+static struct migration pending;
+static bool migrating;
+
+static clock_time_t last_heard;
+/* Set once the node has been part of a mesh, only then is a silence
+ * worth a search */
+static bool joined;
+static bool searching;
+
+static struct ctimer scan_timer;
+static struct ctimer announce_timer;
+static struct ctimer switch_timer;
+static struct ctimer search_timer;
+
+static void save(void);
+static void restore(uint16_t len);
+
+static struct persist_handler persist_handler = {
+  NULL, PERSIST_CHANNEL, save, restore
+};
+/*---------------------------------------------------------------------------*/
+static uint8_t
+candidate(uint8_t index)
+{
+  return CHAN_FIRST + index * CHAN_STRIDE;
+}
+/*---------------------------------------------------------------------------*/
+/* Candidate of a channel, NONE if it is not one */
+static uint8_t
+index_of(uint8_t channel)
+{
+  if(channel < CHAN_FIRST || (channel - CHAN_FIRST) % CHAN_STRIDE != 0 ||
+     (channel - CHAN_FIRST) / CHAN_STRIDE >= CHAN_COUNT) {
+    return NONE;
+  }
+
+  return (channel - CHAN_FIRST) / CHAN_STRIDE;
+}
+/*---------------------------------------------------------------------------*/
+/* Occupancy in 1/256 plus the noise floor weighed in, the offset making
+ * it positive does not change how channels compare */
+static unsigned
+cost(const struct survey *s)
+{
+  return (s->occupancy >> AVG_FRAC_BITS) +
+         CHAN_NOISE_WEIGHT * ((s->noise >> AVG_FRAC_BITS) + 128);
+}
+/*---------------------------------------------------------------------------*/
+static void
+account(struct survey *s, const struct rf_core_scan *scan)
+{
+  const uint16_t occupancy =
+    ((uint32_t)scan->busy << (8 + AVG_FRAC_BITS)) / scan->samples;
+  const int16_t noise = scan->min_rssi * (1 << AVG_FRAC_BITS);
+
+  if(!s->scanned) {
+    s->occupancy = occupancy;
+    s->noise = noise;
+    s->scanned = 1;
+    return;
+  }
+
+  s->occupancy += ((int32_t)occupancy - s->occupancy) >> CHAN_AVG_SHIFT;
+  s->noise += (noise - s->noise) >> CHAN_AVG_SHIFT;
+}
+/*---------------------------------------------------------------------------*/
+/* Whether an announcement replaces the migration pending or followed */
+static bool
+supersedes(uint16_t e, const linkaddr_t *origin)
+{
+  const int16_t newer = (int16_t)(e - (migrating ? pending.epoch : epoch));
+
+  if(newer != 0) {
+    return newer > 0;
+  }
+
+  return migrating && origin->u16 < pending.origin.u16;
+}
+/*---------------------------------------------------------------------------*/
+static void
+announce(void *ptr)
+{
+  const clock_time_t now = clock_time();
+  struct frame *frame;
+  uint8_t *data;
+
+  if(!migrating || (int32_t)(pending.at - now) <= 0) {
+    return;
+  }
+
+  frame = frame_pool_alloc();
+  if(frame != NULL) {
+    data = link_data(frame);
+    put_le16(&data[0], pending.epoch);
+    memcpy(&data[2], &pending.origin, LINKADDR_SIZE);
+    data[2 + LINKADDR_SIZE] = pending.channel;
+    put_le16(&data[3 + LINKADDR_SIZE],
+             (uint32_t)(pending.at - now) * 1000 / CLOCK_SECOND);
+    link_send(frame, LINK_TYPE_CHANNEL, &linkaddr_null, ANNOUNCE_LEN,
+              TX_CLASS_CONTROL);
+  }
+
+  if(--pending.repeats > 0) {
+    ctimer_set(&announce_timer, REPEAT_GAP, announce, NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+switch_channel(void *ptr)
+{
+  const uint8_t from = rf_core_get_channel();
+
+  migrating = false;
+  ctimer_stop(&announce_timer);
+  epoch = pending.epoch;
+
+  if(pending.channel != from && rf_core_set_channel(pending.channel) == 0) {
+    current = index_of(pending.channel);
+    LOG_RECORD(CHAN_SWITCH, from, pending.channel, epoch);
+    STATS_INC(CHAN_SWITCHES);
+  }
+
+  /* The neighbors need a while to be heard on the new channel */
+  switched_at = clock_time();
+  last_heard = switched_at;
+  better_scans = 0;
+  persist_save(&persist_handler);
+}
+/*---------------------------------------------------------------------------*/
+static void
+follow(uint16_t e, const linkaddr_t *origin, uint8_t channel,
+       uint16_t delay_ms)
+{
+  const clock_time_t delay = (clock_time_t)delay_ms * CLOCK_SECOND / 1000;
+
+  LOG_RECORD(CHAN_ANNOUNCE, e, origin->u16, channel, delay_ms);
+
+  pending.epoch = e;
+  linkaddr_copy(&pending.origin, origin);
+  pending.channel = channel;
+  pending.at = clock_time() + delay;
+  pending.repeats = CHAN_REPEATS;
+  migrating = true;
+
+  ctimer_set(&switch_timer, delay, switch_channel, NULL);
+  /* Jittered, the neighbors that took the same announcement would all
+   * send it on at once */
+  ctimer_set(&announce_timer, 1 + random_rand() % (REPEAT_GAP / 4 + 1),
+             announce, NULL);
+}
+/*---------------------------------------------------------------------------*/
+static void
+evaluate(void)
+{
+  const struct survey *here = &surveys[current];
+  uint8_t best = NONE;
+  uint8_t i;
+
+  STATS_SET(CHAN_OCCUPANCY_NOW, here->occupancy >> AVG_FRAC_BITS);
+
+  for(i = 0; i < CHAN_COUNT; i++) {
+    if(surveys[i].scanned &&
+       (best == NONE || cost(&surveys[i]) < cost(&surveys[best]))) {
+      best = i;
+    }
+  }
+
+  if(!here->scanned || best == current ||
+     cost(&surveys[best]) + CHAN_HYSTERESIS > cost(here) ||
+     clock_time() - switched_at < CHAN_DWELL) {
+    better_scans = 0;
+    return;
+  }
+
+  if(++better_scans < CHAN_CONFIRM * CHAN_COUNT) {
+    return;
+  }
+
+  better_scans = 0;
+  follow(epoch + 1, &linkaddr_node_addr, candidate(best), CHAN_SWITCH_DELAY);
+}
+/*---------------------------------------------------------------------------*/
+static void
+search(void *ptr)
+{
+  current = (current + 1) % CHAN_COUNT;
+  rf_core_set_channel(candidate(current));
+
+  LOG_RECORD(CHAN_SEARCH, candidate(current));
+  STATS_INC(CHAN_SEARCHES);
+
+  ctimer_set(&search_timer, CHAN_SEARCH_DWELL, search, NULL);
+}
+/*---------------------------------------------------------------------------*/
+static void
+scan(void *ptr)
+{
+  struct rf_core_scan result;
+
+  ctimer_set(&scan_timer, CHAN_SCAN_PERIOD, scan, NULL);
+
+  if(migrating || searching) {
+    return;
+  }
+
+  if(joined && clock_time() - last_heard > CHAN_SILENCE) {
+    searching = true;
+    search(NULL);
+    return;
+  }
+
+  if(rf_core_scan(candidate(next_scan), CHAN_SCAN_TIME, &result) == 0) {
+    LOG_RECORD(CHAN_SCAN, candidate(next_scan), result.busy, result.samples,
+               result.min_rssi);
+    STATS_INC(CHAN_SCANS);
+    account(&surveys[next_scan], &result);
+    evaluate();
+  }
+
+  next_scan = (next_scan + 1) % CHAN_COUNT;
+}
+/*---------------------------------------------------------------------------*/
+static void
+save(void)
+{
+  uint8_t buf[SAVED_LEN];
+
+  buf[0] = candidate(current);
+  put_le16(&buf[1], epoch);
+  persist_put(buf, sizeof(buf));
+}
+/*---------------------------------------------------------------------------*/
+/* Runs with RX on the boot channel */
+static void
+restore(uint16_t len)
+{
+  uint8_t buf[SAVED_LEN];
+  const uint8_t index = persist_get(buf, sizeof(buf)) == 0 ?
+                        index_of(buf[0]) : NONE;
+
+  if(index == NONE || rf_core_set_channel(buf[0]) != 0) {
+    return;
+  }
+
+  current = index;
+  epoch = get_le16(&buf[1]);
+  joined = true;
+}
+/*---------------------------------------------------------------------------*/
+int
+chan_init(void)
+{
+  if(!CHAN_ENABLED) {
+    return 0;
+  }
+
+  /* main.cpp checks the boot channel at build time, other callers of
+   * rf_core_init() may not */
+  current = index_of(rf_core_get_channel());
+  if(current == NONE) {
+    return -1;
+  }
+
+  surveys = arena_alloc(ARENA_CHAN, CHAN_COUNT * sizeof(struct survey));
+  next_scan = 0;
+  epoch = 0;
+  migrating = false;
+  searching = false;
+  joined = false;
+
+  persist_register(&persist_handler);
+
+  switched_at = clock_time();
+  last_heard = switched_at;
+  ctimer_set(&scan_timer, CHAN_SCAN_PERIOD, scan, NULL);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+chan_input(struct frame *frame, const struct link_hdr *hdr)
+{
+  const uint8_t *data = link_data(frame);
+  linkaddr_t origin;
+  uint16_t e;
+  uint8_t channel;
+
+  /* Not started, off the candidates */
+  if(surveys != NULL && frame->len - LINK_HDR_LEN >= ANNOUNCE_LEN) {
+    e = get_le16(&data[0]);
+    memcpy(&origin, &data[2], LINKADDR_SIZE);
+    channel = data[2 + LINKADDR_SIZE];
+    if(index_of(channel) != NONE && supersedes(e, &origin)) {
+      follow(e, &origin, channel, get_le16(&data[3 + LINKADDR_SIZE]));
+    }
+  }
+
+  frame_pool_free(frame);
+}
+/*---------------------------------------------------------------------------*/
+void
+chan_heard(void)
+{
+  last_heard = clock_time();
+  joined = true;
+
+  if(searching) {
+    /* Stay wherever the mesh turned out to be */
+    searching = false;
+    ctimer_stop(&search_timer);
+    switched_at = last_heard;
+    better_scans = 0;
+    persist_save(&persist_handler);
+  }
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,184 @@
+/**
+ * \file
+ *         Dynamic channel selection
+ *
+ *         Built with CHAN_CONF_ENABLED, every node surveys CHAN_COUNT
+ *         candidate channels of the band plan, CHAN_FIRST and every
+ *         CHAN_STRIDE after it, one of them every CHAN_SCAN_PERIOD: it
+ *         tunes away for CHAN_SCAN_TIME, samples the RSSI and tunes back,
+ *         see rf_core_scan(). Per channel, the share of samples at or
+ *         above the carrier sense threshold and the lowest one, the noise
+ *         floor, are averaged over scans into a cost: the occupancy in
+ *         1/256 plus CHAN_NOISE_WEIGHT per dB of noise floor.
+ *
+ *         Once a candidate costs CHAN_HYSTERESIS less than the current
+ *         channel for CHAN_CONFIRM sweeps of all candidates in a row, and
+ *         the mesh has been on its channel for CHAN_DWELL, the node
+ *         announces a migration in a broadcast:
+ *         LINK_TYPE_CHANNEL [epoch (2)] [origin (2)] [channel (1)]
+ *                           [switch in (2), ms]
+ *         Every node taking an announcement sends it on CHAN_REPEATS times
+ *         while counting the delay down, so the whole mesh retunes at
+ *         about the same time. Epochs number the migrations: a newer one,
+ *         or the same from a lower origin address, supersedes a pending
+ *         migration, so nodes announcing at once settle on one channel.
+ *
+ *         A node that missed the announcement hears nothing once the
+ *         others have left. After CHAN_SILENCE without a frame it searches
+ *         the candidates, CHAN_SEARCH_DWELL on each, until it hears one
+ *         again. The channel and epoch are saved to flash on every switch,
+ *         see persist.h.
+ *
+ *         Scans need RX to be always on, they are skipped with low-power
+ *         listening. The mode does not mix with slots, whose cells a scan
+ *         would miss.
+ */
+#ifndef CHAN_H
+#define CHAN_H
+
+#include "contiki.h"
+#include "frame-pool.h"
+#include "link.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------*/
+/** Scan the candidates and follow migrations */
+#ifdef CHAN_CONF_ENABLED
+#define CHAN_ENABLED CHAN_CONF_ENABLED
+#else
+#define CHAN_ENABLED 0
+#endif
+
+/** First candidate channel of the band plan */
+#ifdef CHAN_CONF_FIRST
+#define CHAN_FIRST CHAN_CONF_FIRST
+#else
+#define CHAN_FIRST 0
+#endif
+
+/** Channels from one candidate to the next */
+#ifdef CHAN_CONF_STRIDE
+#define CHAN_STRIDE CHAN_CONF_STRIDE
+#else
+#define CHAN_STRIDE 4
+#endif
+
+/** Candidate channels, the boot channel must be one of them */
+#ifdef CHAN_CONF_COUNT
+#define CHAN_COUNT CHAN_CONF_COUNT
+#else
+#define CHAN_COUNT 8
+#endif
+
+/** Time between two scans, in clock ticks */
+#ifdef CHAN_CONF_SCAN_PERIOD
+#define CHAN_SCAN_PERIOD CHAN_CONF_SCAN_PERIOD
+#else
+#define CHAN_SCAN_PERIOD (10 * CLOCK_SECOND)
+#endif
+
+/** RSSI sampling time of a scan, in us, during which RX is off channel.
+ * rf_core_scan() samples in a busy loop, so the event loop stalls and the
+ * CPU stays out of standby for as long, below MONITOR_BUDGET */
+#ifdef CHAN_CONF_SCAN_TIME
+#define CHAN_SCAN_TIME CHAN_CONF_SCAN_TIME
+#else
+#define CHAN_SCAN_TIME 5000
+#endif
+
+/** Weight of a scan in the averages, as a shift: 2 is 1/4 */
+#ifdef CHAN_CONF_AVG_SHIFT
+#define CHAN_AVG_SHIFT CHAN_CONF_AVG_SHIFT
+#else
+#define CHAN_AVG_SHIFT 2
+#endif
+
+/** Cost of one dB of noise floor, in 1/256 of occupancy */
+#ifdef CHAN_CONF_NOISE_WEIGHT
+#define CHAN_NOISE_WEIGHT CHAN_CONF_NOISE_WEIGHT
+#else
+#define CHAN_NOISE_WEIGHT 2
+#endif
+
+/** Cost a candidate must save over the current channel to migrate */
+#ifdef CHAN_CONF_HYSTERESIS
+#define CHAN_HYSTERESIS CHAN_CONF_HYSTERESIS
+#else
+#define CHAN_HYSTERESIS 32
+#endif
+
+/** Sweeps of all candidates the saving must last */
+#ifdef CHAN_CONF_CONFIRM
+#define CHAN_CONFIRM CHAN_CONF_CONFIRM
+#else
+#define CHAN_CONFIRM 3
+#endif
+
+/** Least time on a channel before migrating again, in clock ticks */
+#ifdef CHAN_CONF_DWELL
+#define CHAN_DWELL CHAN_CONF_DWELL
+#else
+#define CHAN_DWELL (1800UL * CLOCK_SECOND)
+#endif
+
+/** Time from an announcement to the switch, in ms */
+#ifdef CHAN_CONF_SWITCH_DELAY
+#define CHAN_SWITCH_DELAY CHAN_CONF_SWITCH_DELAY
+#else
+#define CHAN_SWITCH_DELAY 8000
+#endif
+
+/** Announcements sent by every node before the switch */
+#ifdef CHAN_CONF_REPEATS
+#define CHAN_REPEATS CHAN_CONF_REPEATS
+#else
+#define CHAN_REPEATS 3
+#endif
+
+/** Time without a frame before searching the candidates, in clock ticks */
+#ifdef CHAN_CONF_SILENCE
+#define CHAN_SILENCE CHAN_CONF_SILENCE
+#else
+#define CHAN_SILENCE (300UL * CLOCK_SECOND)
+#endif
+
+/** Time listening on each candidate of a search, in clock ticks */
+#ifdef CHAN_CONF_SEARCH_DWELL
+#define CHAN_SEARCH_DWELL CHAN_CONF_SEARCH_DWELL
+#else
+#define CHAN_SEARCH_DWELL (30 * CLOCK_SECOND)
+#endif
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Allocate the channel survey, restore the saved channel and start
+ *        scanning.
+ *
+ * Must be called after rf_core_init().
+ *
+ * \return 0, or -1 if the boot channel is not a candidate, in which case
+ *         the node neither scans nor follows migrations.
+ */
+int chan_init(void);
+
+/**
+ * \brief Process a received LINK_TYPE_CHANNEL frame, then free it.
+ */
+void chan_input(struct frame *frame, const struct link_hdr *hdr);
+
+/**
+ * \brief Note that a frame of the network was heard, cheap enough for
+ *        every frame.
+ */
+void chan_heard(void);
+/*---------------------------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CHAN_H */
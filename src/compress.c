@@ -0,0 +1,212 @@
+/**
+ * \file
+ *         LZ compression of frame data against a static dictionary
+ */
+#include "contiki.h"
+#include "compress.h"
+#include "arena.h"
+
+#include <string.h>
+/*---------------------------------------------------------------------------*/
+#define MIN_MATCH     3
+#define MAX_MATCH     (MIN_MATCH + 15)
+#define MAX_LITERAL   128
+#define MAX_DISTANCE  2048
+
+/* Index of the dictionary, and of the data compressed so far */
+#define DICT_HASH_BITS 9
+#define HASH_BITS      6
+/*---------------------------------------------------------------------------*/
+/*
+ * What host payloads are made of, the most common last: matches are found
+ * against the latest occurrence of a string. Changing it breaks
+ * compatibility with every node built with the previous one.
+ */
+static const char dict[] =
+  "https://www.http://.com/.org/.jpg.png"
+  "Thank you thanks please sorry where when what how are you? "
+  "I am ok, good morning good night see you later. "
+  "the and that this with for have from not be is it to in of a "
+  "gracias por favor buenos dias buenas noches hasta luego nos vemos "
+  "donde cuando como estas? estoy bien, "
+  "que de la el en los las del por para con una un es no se lo si "
+  "\"latitude\":\"longitude\":\"location\":\"status\":\"name\":"
+  "\"type\":\"data\":\"id\":\"to\":\"from\":\"uid\":\"msgID\":"
+  "\"timestamp\":\"shippingTime\":\"text\":\"msg\":"
+  "true,false,null,\"},{\"\":\"\",\"\":{\"\":[\"0,1,2,3";
+
+#define DICT_LEN (sizeof(dict) - 1)
+
+/* All of it within reach from anywhere in a frame */
+_Static_assert(DICT_LEN + 256 <= MAX_DISTANCE,
+               "Compression dictionary too large for the match distances");
+
+#define INDEX_LEN \
+  (ARENA_SIZEOF((1 << DICT_HASH_BITS) * sizeof(uint16_t)) + \
+   ARENA_SIZEOF((1 << HASH_BITS) * sizeof(uint16_t)))
+
+_Static_assert(INDEX_LEN <= ARENA_QUOTA_COMPRESS,
+               "Compression indexes do not fit in ARENA_CONF_QUOTA_COMPRESS");
+
+/* Latest position + 1 of every hash in the dictionary and the data */
+static uint16_t *dict_head;
+static uint16_t *head;
+/*---------------------------------------------------------------------------*/
+static inline unsigned
+hash(const uint8_t *p, unsigned bits)
+{
+  const uint32_t key = ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+
+  return (uint32_t)(key * 2654435761UL) >> (32 - bits);
+}
+/*---------------------------------------------------------------------------*/
+static inline uint16_t
+match_len(const uint8_t *a, const uint8_t *b, uint16_t limit)
+{
+  uint16_t n;
+
+  for(n = 0; n < limit && a[n] == b[n]; n++);
+
+  return n;
+}
+/*---------------------------------------------------------------------------*/
+void
+compress_init(void)
+{
+  unsigned i;
+
+  dict_head = arena_alloc(ARENA_COMPRESS,
+                          (1 << DICT_HASH_BITS) * sizeof(uint16_t));
+  head = arena_alloc(ARENA_COMPRESS, (1 << HASH_BITS) * sizeof(uint16_t));
+
+  memset(dict_head, 0, (1 << DICT_HASH_BITS) * sizeof(uint16_t));
+  for(i = 0; i + MIN_MATCH <= DICT_LEN; i++) {
+    dict_head[hash((const uint8_t *)&dict[i], DICT_HASH_BITS)] = i + 1;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+put_literals(const uint8_t *p, uint16_t n, uint8_t *out, uint16_t *pos,
+             uint16_t max)
+{
+  uint16_t run;
+
+  while(n > 0) {
+    run = MIN(n, MAX_LITERAL);
+    if(*pos + 1 + run > max) {
+      return -1;
+    }
+    out[(*pos)++] = run - 1;
+    memcpy(&out[*pos], p, run);
+    *pos += run;
+    p += run;
+    n -= run;
+  }
+
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+compress(const uint8_t *in, uint16_t len, uint8_t *out, uint16_t max)
+{
+  uint16_t pos = 0;
+  uint16_t lit = 0;
+  uint16_t i = 0;
+  uint16_t cand, dist, n, best, best_dist;
+
+  memset(head, 0, (1 << HASH_BITS) * sizeof(uint16_t));
+
+  while(i + MIN_MATCH <= len) {
+    const uint16_t limit = MIN(len - i, MAX_MATCH);
+    const unsigned h = hash(&in[i], HASH_BITS);
+
+    /* Distances count back through the data into the dictionary before it */
+    best = 0;
+    best_dist = 0;
+    cand = dict_head[hash(&in[i], DICT_HASH_BITS)];
+    if(cand != 0 && DICT_LEN - cand + 1 + i <= MAX_DISTANCE) {
+      best = match_len((const uint8_t *)&dict[cand - 1], &in[i],
+                       MIN(limit, DICT_LEN - cand + 1));
+      best_dist = DICT_LEN - cand + 1 + i;
+    }
+    cand = head[h];
+    if(cand != 0) {
+      n = match_len(&in[cand - 1], &in[i], limit);
+      if(n >= best) {
+        best = n;
+        best_dist = i - cand + 1;
+      }
+    }
+    head[h] = i + 1;
+
+    if(best < MIN_MATCH) {
+      i++;
+      continue;
+    }
+
+    if(put_literals(&in[lit], i - lit, out, &pos, max) != 0 ||
+       pos + 2 > max) {
+      return -1;
+    }
+    dist = best_dist - 1;
+    out[pos++] = 0x80 | ((best - MIN_MATCH) << 3) | (dist >> 8);
+    out[pos++] = dist & 0xFF;
+
+    /* Index what the match covers, later data often repeats it */
+    for(i++, best--; best > 0; i++, best--) {
+      if(i + MIN_MATCH <= len) {
+        head[hash(&in[i], HASH_BITS)] = i + 1;
+      }
+    }
+    lit = i;
+  }
+
+  if(put_literals(&in[lit], len - lit, out, &pos, max) != 0) {
+    return -1;
+  }
+
+  return pos;
+}
+/*---------------------------------------------------------------------------*/
+int
+decompress(const uint8_t *in, uint16_t len, uint8_t *out, uint16_t max)
+{
+  uint16_t pos = 0;
+  uint16_t olen = 0;
+  uint16_t n, dist, from;
+  uint8_t token;
+
+  while(pos < len) {
+    token = in[pos++];
+
+    if(!(token & 0x80)) {
+      n = token + 1;
+      if(pos + n > len || olen + n > max) {
+        return -1;
+      }
+      memcpy(&out[olen], &in[pos], n);
+      pos += n;
+      olen += n;
+      continue;
+    }
+
+    if(pos >= len) {
+      return -1;
+    }
+    n = ((token >> 3) & 0x0F) + MIN_MATCH;
+    dist = (((token & 0x07) << 8) | in[pos++]) + 1;
+    if(dist > DICT_LEN + olen || olen + n > max) {
+      return -1;
+    }
+
+    /* Byte by byte, a match may overlap the bytes it produces */
+    from = DICT_LEN + olen - dist;
+    for(; n > 0; n--, from++) {
+      out[olen++] = from < DICT_LEN ? (uint8_t)dict[from] :
+                    out[from - DICT_LEN];
+    }
+  }
+
+  return olen;
+}
+/*---------------------------------------------------------------------------*/
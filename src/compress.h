@@ -0,0 +1,65 @@
+/**
+ * \file
+ *         LZ compression of frame data against a static dictionary
+ *
+ *         Text payloads from the host, chat messages and JSON, are short
+ *         and say the same things over and over. Too short to compress on
+ *         their own, they compress well against a dictionary of what such
+ *         payloads are made of, built into every node.
+ *
+ *         The compressed form is a sequence of tokens, each taking the
+ *         bytes it stands for from the window made of the dictionary
+ *         followed by what was decompressed so far:
+ *         [0LLLLLLL] [L + 1 literal bytes]
+ *         [1LLLLDDD] [DDDDDDDD] L + 3 bytes starting D + 1 bytes back into
+ *                               the window, possibly overlapping the output
+ *
+ *         The TX queue compresses the frames it sends whenever that makes
+ *         them shorter, and marks them with LINK_FLAG_COMPRESSED, see
+ *         link.h. Frames without the flag are delivered as they are, so
+ *         nodes with compression disabled still talk to everyone.
+ */
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include "contiki.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------*/
+/** Compress outgoing frames. Compressed frames are accepted regardless. */
+#ifdef COMPRESS_CONF_ENABLED
+#define COMPRESS_ENABLED COMPRESS_CONF_ENABLED
+#else
+#define COMPRESS_ENABLED 1
+#endif
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Index the dictionary.
+ */
+void compress_init(void);
+
+/**
+ * \brief Compress data.
+ * \param max Room in out, compressing fails if the result is any longer
+ * \return The compressed length, -1 if it would not fit in max bytes.
+ */
+int compress(const uint8_t *in, uint16_t len, uint8_t *out, uint16_t max);
+
+/**
+ * \brief Decompress data.
+ * \return The decompressed length, -1 if the data is corrupt or would not
+ *         fit in max bytes.
+ */
+int decompress(const uint8_t *in, uint16_t len, uint8_t *out, uint16_t max);
+/*---------------------------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* COMPRESS_H */
@@ -0,0 +1,50 @@
+/**
+ * \file
+ *         Recently seen cache of flooded packets
+ */
+#include "contiki.h"
+#include "dup-cache.h"
+#include "arena.h"
+#include "prof.h"
+/*---------------------------------------------------------------------------*/
+/* The null address never originates a flood, so 0 marks a free entry */
+#define KEY(origin, seqno) (((uint32_t)(origin)->u16 << 16) | (seqno))
+
+_Static_assert(LINKADDR_SIZE == 2,
+               "duplicate cache keys assume two byte link addresses");
+_Static_assert(ARENA_SIZEOF(DUP_CACHE_SIZE * sizeof(uint32_t)) <=
+               ARENA_QUOTA_DUP_CACHE,
+               "DUP_CACHE_CONF_SIZE entries do not fit in "
+               "ARENA_CONF_QUOTA_DUP_CACHE");
+/*---------------------------------------------------------------------------*/
+static uint32_t *keys;
+/* Next entry to overwrite */
+static uint16_t next;
+/*---------------------------------------------------------------------------*/
+void
+dup_cache_init(void)
+{
+  keys = arena_alloc(ARENA_DUP_CACHE, DUP_CACHE_SIZE * sizeof(*keys));
+  next = 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+dup_cache_check(const linkaddr_t *origin, uint16_t seqno)
+{
+  const uint32_t key = KEY(origin, seqno);
+  unsigned i;
+
+  for(i = 0; i < DUP_CACHE_SIZE; i++) {
+    if(keys[i] == key) {
+      PROF_COUNT(DUP_HIT);
+      return 1;
+    }
+  }
+
+  keys[next] = key;
+  next = (next + 1) % DUP_CACHE_SIZE;
+
+  PROF_COUNT(DUP_MISS);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,47 @@
+/**
+ * \file
+ *         Recently seen cache of flooded packets
+ *
+ *         Remembers the (origin, sequence number) pair of the last
+ *         DUP_CACHE_SIZE flooded packets in a ring, the oldest being
+ *         forgotten first. Keys are packed in 32 bits, a lookup compares
+ *         words and nothing else. Hits and misses are counted as the
+ *         DUP_HIT and DUP_MISS profiling counters.
+ */
+#ifndef DUP_CACHE_H
+#define DUP_CACHE_H
+
+#include "contiki.h"
+#include "net/linkaddr.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------*/
+/** Packets remembered */
+#ifdef DUP_CACHE_CONF_SIZE
+#define DUP_CACHE_SIZE DUP_CACHE_CONF_SIZE
+#else
+#define DUP_CACHE_SIZE 32
+#endif
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Allocate the cache and empty it.
+ */
+void dup_cache_init(void);
+
+/**
+ * \brief Look a packet up, remembering it if it is new.
+ * \return 1 if the packet was seen recently, 0 otherwise.
+ */
+int dup_cache_check(const linkaddr_t *origin, uint16_t seqno);
+/*---------------------------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DUP_CACHE_H */
@@ -0,0 +1,393 @@
+/**
+ * \file
+ *         Fragmentation of messages larger than a frame
+ */
+#include "contiki.h"
+#include "frag.h"
+#include "arena.h"
+#include "byteorder.h"
+#include "frame-pool.h"
+#include "log-ring.h"
+#include "rf-core.h"
+#include "stats.h"
+#include "tx-sched.h"
+
+#include <string.h>
+/*---------------------------------------------------------------------------*/
+#define KIND_MASK      0x0F
+#define KIND_FRAGMENT  0
+#define KIND_ACK       1
+/* Port of a fragment, in the bits between the kind and the flags */
+#define PORT_SHIFT     4
+#define PORT_MASK      0x70
+/* Set on the last fragment of a round */
+#define FLAG_ACK_REQ   0x80
+
+#define ACK_LEN        6
+
+#define ALL(count)     ((count) == 32 ? 0xFFFFFFFFUL : (1UL << (count)) - 1)
+
+/* Pause between two fragments, lets the RF RX process in, and between two
+ * looks at a full bulk queue */
+#define FRAGMENT_GAP   1
+
+enum {
+  BUF_FREE,
+  BUF_PARTIAL,
+  /* Delivered, kept to acknowledge repeated fragments */
+  BUF_DONE,
+};
+
+struct reassembly {
+  linkaddr_t src;
+  uint8_t state;
+  uint8_t port;
+  uint8_t tag;
+  uint8_t count;
+  /* Message length, 0 until the last fragment is in */
+  uint16_t len;
+  uint32_t received;
+  struct ctimer timer;
+  uint8_t *data;
+};
+
+_Static_assert(FRAG_MAX_LEN <= FRAG_MAX_COUNT * FRAG_PAYLOAD_LEN,
+               "FRAG_CONF_MAX_LEN takes more than FRAG_MAX_COUNT fragments");
+_Static_assert(ARENA_SIZEOF(FRAG_BUFFERS * sizeof(struct reassembly)) +
+               (FRAG_BUFFERS + 1) * ARENA_SIZEOF(FRAG_MAX_LEN) <=
+               ARENA_QUOTA_FRAG,
+               "FRAG_CONF_BUFFERS buffers of FRAG_CONF_MAX_LEN bytes do not "
+               "fit in ARENA_CONF_QUOTA_FRAG");
+/*---------------------------------------------------------------------------*/
+static struct reassembly *buffers;
+static link_input_callback_t input_callbacks[FRAG_PORT_COUNT];
+static frag_sent_callback_t sent_callbacks[FRAG_PORT_COUNT];
+
+/* Message being sent */
+static uint8_t *tx_data;
+static uint16_t tx_len;
+static linkaddr_t tx_dst;
+static uint8_t tx_port;
+static uint8_t tx_tag;
+static uint8_t tx_count;
+static uint8_t tx_retries;
+static uint8_t tx_next;
+static uint32_t tx_acked;
+static uint8_t tx_busy;
+static struct ctimer tx_timer;
+/*---------------------------------------------------------------------------*/
+static uint16_t
+fragment_len(uint8_t index, uint16_t len)
+{
+  const uint16_t left = len - index * FRAG_PAYLOAD_LEN;
+
+  return MIN(left, FRAG_PAYLOAD_LEN);
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_ack(const linkaddr_t *dst, uint8_t tag, uint32_t received)
+{
+  struct frame *frame = frame_pool_alloc();
+  uint8_t *p;
+
+  if(frame == NULL) {
+    return;
+  }
+
+  p = link_data(frame);
+  p[0] = KIND_ACK;
+  p[1] = tag;
+  put_le32(&p[2], received);
+
+  link_send(frame, LINK_TYPE_FRAG, dst, ACK_LEN, TX_CLASS_CONTROL);
+}
+/*---------------------------------------------------------------------------*/
+static void
+tx_done(int status)
+{
+  ctimer_stop(&tx_timer);
+  tx_busy = 0;
+
+  LOG_RECORD(FRAG_SENT, tx_dst.u16, tx_len, tx_retries, status);
+
+  if(sent_callbacks[tx_port] != NULL) {
+    sent_callbacks[tx_port](&tx_dst, status);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void tx_timeout(void *ptr);
+
+/* The timer starts with the last fragment queued, not once it is on air:
+ * the bulk queue may hold as many fragments ahead of it, and the
+ * acknowledgement has to come back, each made longer by the preamble of
+ * low-power listening */
+static clock_time_t
+ack_timeout(void)
+{
+  const uint32_t us =
+    (TX_SCHED_BULK_LEN + 2) * rf_core_airtime_us(LINK_MAX_FRAME_LEN);
+
+  return FRAG_ACK_TIMEOUT +
+         ((uint64_t)us * CLOCK_SECOND + 999999) / 1000000;
+}
+
+/* Send the next fragment still unacknowledged, one per timer expiry */
+static void
+send_next(void *ptr)
+{
+  struct frame *frame;
+  uint16_t len;
+  uint8_t last;
+  uint8_t *p;
+
+  while(tx_next < tx_count && (tx_acked & (1UL << tx_next))) {
+    tx_next++;
+  }
+
+  /* A late acknowledgement covered the rest of the round, and no
+   * fragment of it asked for another one */
+  if(tx_next == tx_count) {
+    ctimer_set(&tx_timer, ack_timeout(), tx_timeout, NULL);
+    return;
+  }
+
+  /* Only as fast as the bulk class drains, a fragment sent to a full
+   * queue is only dropped */
+  if(tx_sched_queued(TX_CLASS_BULK) >= TX_SCHED_BULK_LEN) {
+    ctimer_set(&tx_timer, FRAGMENT_GAP, send_next, NULL);
+    return;
+  }
+
+  /* Is anything left after this one? */
+  for(last = tx_next + 1;
+      last < tx_count && (tx_acked & (1UL << last)); last++);
+
+  frame = frame_pool_alloc();
+  if(frame != NULL) {
+    len = fragment_len(tx_next, tx_len);
+    p = link_data(frame);
+    p[0] = KIND_FRAGMENT | tx_port << PORT_SHIFT |
+           (last == tx_count ? FLAG_ACK_REQ : 0);
+    p[1] = tx_tag;
+    p[2] = tx_next;
+    p[3] = tx_count;
+    memcpy(p + FRAG_HDR_LEN, tx_data + tx_next * FRAG_PAYLOAD_LEN, len);
+
+    link_send(frame, LINK_TYPE_FRAG, &tx_dst, FRAG_HDR_LEN + len,
+              TX_CLASS_BULK);
+  }
+  /* A fragment not sent for a lack of frames is repeated next round */
+
+  tx_next++;
+  if(last == tx_count) {
+    ctimer_set(&tx_timer, ack_timeout(), tx_timeout, NULL);
+  } else {
+    ctimer_set(&tx_timer, FRAGMENT_GAP, send_next, NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+start_round(void)
+{
+  tx_next = 0;
+  send_next(NULL);
+}
+/*---------------------------------------------------------------------------*/
+static void
+tx_timeout(void *ptr)
+{
+  if(tx_retries++ == FRAG_RETRIES) {
+    tx_done(-1);
+    return;
+  }
+
+  start_round();
+}
+/*---------------------------------------------------------------------------*/
+static void
+ack_input(const struct link_hdr *hdr, const uint8_t *p)
+{
+  if(!tx_busy || p[1] != tx_tag || !linkaddr_cmp(&hdr->src, &tx_dst)) {
+    return;
+  }
+
+  tx_acked |= get_le32(&p[2]) & ALL(tx_count);
+  if(tx_acked == ALL(tx_count)) {
+    tx_done(0);
+    return;
+  }
+
+  /* Only an answer to the end of a round starts the next one, not an
+   * acknowledgement arriving late while a round is under way */
+  if(tx_next == tx_count) {
+    if(tx_retries++ == FRAG_RETRIES) {
+      tx_done(-1);
+      return;
+    }
+    start_round();
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+reassembly_timeout(void *ptr)
+{
+  struct reassembly *r = ptr;
+
+  if(r->state == BUF_PARTIAL) {
+    LOG_RECORD(FRAG_TIMEOUT, r->src.u16, r->tag, r->received);
+  }
+  r->state = BUF_FREE;
+}
+/*---------------------------------------------------------------------------*/
+static struct reassembly *
+find_buffer(const linkaddr_t *src, uint8_t port, uint8_t tag, uint8_t count)
+{
+  struct reassembly *r;
+  struct reassembly *spare = NULL;
+  unsigned i;
+
+  for(i = 0; i < FRAG_BUFFERS; i++) {
+    r = &buffers[i];
+    if(r->state != BUF_FREE && r->tag == tag &&
+       linkaddr_cmp(&r->src, src)) {
+      return r;
+    }
+    /* Free buffers first, then delivered ones */
+    if(r->state == BUF_FREE && (spare == NULL || spare->state != BUF_FREE)) {
+      spare = r;
+    } else if(r->state == BUF_DONE && spare == NULL) {
+      spare = r;
+    }
+  }
+
+  if(spare == NULL) {
+    return NULL;
+  }
+
+  linkaddr_copy(&spare->src, src);
+  spare->state = BUF_PARTIAL;
+  spare->port = port;
+  spare->tag = tag;
+  spare->count = count;
+  spare->len = 0;
+  spare->received = 0;
+
+  return spare;
+}
+/*---------------------------------------------------------------------------*/
+static void
+fragment_input(const struct link_hdr *hdr, const uint8_t *p, uint16_t len)
+{
+  const uint8_t port = (p[0] & PORT_MASK) >> PORT_SHIFT;
+  const uint8_t index = p[2];
+  const uint8_t count = p[3];
+  struct reassembly *r;
+
+  len -= FRAG_HDR_LEN;
+  if(port >= FRAG_PORT_COUNT ||
+     count == 0 || count > FRAG_MAX_COUNT || index >= count ||
+     (index + 1 < count && len != FRAG_PAYLOAD_LEN) ||
+     index * FRAG_PAYLOAD_LEN + len > FRAG_MAX_LEN) {
+    LOG_RECORD(FRAG_BAD, hdr->src.u16, index, count, len);
+    return;
+  }
+
+  r = find_buffer(&hdr->src, port, p[1], count);
+  if(r == NULL) {
+    LOG_RECORD(FRAG_NO_BUFFER, hdr->src.u16, p[1]);
+    return;
+  }
+
+  if(r->state == BUF_PARTIAL && count == r->count) {
+    memcpy(r->data + index * FRAG_PAYLOAD_LEN, p + FRAG_HDR_LEN, len);
+    r->received |= 1UL << index;
+    if(index + 1 == count) {
+      r->len = index * FRAG_PAYLOAD_LEN + len;
+    }
+    ctimer_set(&r->timer, FRAG_REASSEMBLY_TIMEOUT, reassembly_timeout, r);
+
+    if(r->received == ALL(count)) {
+      r->state = BUF_DONE;
+      if(input_callbacks[r->port] != NULL) {
+        input_callbacks[r->port](hdr, r->data, r->len);
+      }
+      send_ack(&r->src, r->tag, r->received);
+      return;
+    }
+  }
+
+  if(p[0] & FLAG_ACK_REQ) {
+    send_ack(&r->src, r->tag, r->received);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+frag_init(void)
+{
+  unsigned i;
+
+  buffers = arena_alloc(ARENA_FRAG, FRAG_BUFFERS * sizeof(struct reassembly));
+  for(i = 0; i < FRAG_BUFFERS; i++) {
+    buffers[i].data = arena_alloc(ARENA_FRAG, FRAG_MAX_LEN);
+  }
+  tx_data = arena_alloc(ARENA_FRAG, FRAG_MAX_LEN);
+}
+/*---------------------------------------------------------------------------*/
+void
+frag_set_input_callback(uint8_t port, link_input_callback_t callback)
+{
+  input_callbacks[port] = callback;
+}
+/*---------------------------------------------------------------------------*/
+void
+frag_set_sent_callback(uint8_t port, frag_sent_callback_t callback)
+{
+  sent_callbacks[port] = callback;
+}
+/*---------------------------------------------------------------------------*/
+void
+frag_input(struct frame *frame, const struct link_hdr *hdr)
+{
+  const uint8_t *p = link_data(frame);
+  uint16_t len = frame->len - LINK_HDR_LEN;
+
+  if(len > FRAG_HDR_LEN && (p[0] & KIND_MASK) == KIND_FRAGMENT) {
+    fragment_input(hdr, p, len);
+  } else if(len == ACK_LEN && (p[0] & KIND_MASK) == KIND_ACK) {
+    ack_input(hdr, p);
+  } else {
+    LOG_RECORD(LINK_RUNT, frame->len);
+    STATS_INC(DROP_RUNT);
+  }
+
+  frame_pool_free(frame);
+}
+/*---------------------------------------------------------------------------*/
+uint8_t *
+frag_buffer(void)
+{
+  return tx_busy ? NULL : tx_data;
+}
+/*---------------------------------------------------------------------------*/
+int
+frag_send(const linkaddr_t *dst, uint8_t port, uint16_t len)
+{
+  if(tx_busy || len == 0 || len > FRAG_MAX_LEN || port >= FRAG_PORT_COUNT ||
+     linkaddr_cmp(dst, &linkaddr_null)) {
+    return -1;
+  }
+
+  linkaddr_copy(&tx_dst, dst);
+  tx_port = port;
+  tx_len = len;
+  tx_tag++;
+  tx_count = (len + FRAG_PAYLOAD_LEN - 1) / FRAG_PAYLOAD_LEN;
+  tx_acked = 0;
+  tx_retries = 0;
+  tx_busy = 1;
+
+  start_round();
+
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,135 @@
+/**
+ * \file
+ *         Fragmentation of messages larger than a frame
+ *
+ *         A message of up to FRAG_MAX_LEN bytes is cut into fragments sent
+ *         one after the other to a neighbor in LINK_TYPE_FRAG frames, each
+ *         carrying [kind, port and flags (1)] [tag (1)] [index (1)]
+ *         [count (1)] and FRAG_PAYLOAD_LEN bytes of the message, except for
+ *         the last
+ *         one. The last fragment sent in every round asks for an
+ *         acknowledgement, [kind (1)] [tag (1)] [received bitmap (4)], and
+ *         the next round only repeats the fragments the bitmap lacks. A
+ *         round a late acknowledgement leaves nothing to send waits for
+ *         the acknowledgement timeout all the same.
+ *         Fragments go out in the bulk class, one whenever its queue has
+ *         room, so a round takes as long as the channel needs.
+ *
+ *         The receiver reassembles into one of FRAG_BUFFERS buffers, taken
+ *         from the arena. A buffer is evicted FRAG_REASSEMBLY_TIMEOUT after
+ *         its last fragment, and once its message is delivered it stays
+ *         around that long to acknowledge repeated fragments.
+ *
+ *         Messages are addressed to one of FRAG_PORT_COUNT ports, each with
+ *         its own input and sent callbacks. One message is sent at a time,
+ *         whatever its port.
+ */
+#ifndef FRAG_H
+#define FRAG_H
+
+#include "contiki.h"
+#include "frame-pool.h"
+#include "link.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------*/
+/** Largest message, in bytes */
+#ifdef FRAG_CONF_MAX_LEN
+#define FRAG_MAX_LEN FRAG_CONF_MAX_LEN
+#else
+#define FRAG_MAX_LEN 1024
+#endif
+
+/** Messages that can be reassembled at the same time */
+#ifdef FRAG_CONF_BUFFERS
+#define FRAG_BUFFERS FRAG_CONF_BUFFERS
+#else
+#define FRAG_BUFFERS 2
+#endif
+
+/** Time a partial message is kept without new fragments, in clock ticks */
+#ifdef FRAG_CONF_REASSEMBLY_TIMEOUT
+#define FRAG_REASSEMBLY_TIMEOUT FRAG_CONF_REASSEMBLY_TIMEOUT
+#else
+#define FRAG_REASSEMBLY_TIMEOUT (5 * CLOCK_SECOND)
+#endif
+
+/** Wait for an acknowledgement on top of the time on air of the fragments
+ * queued with the last one and of the acknowledgement, in clock ticks */
+#ifdef FRAG_CONF_ACK_TIMEOUT
+#define FRAG_ACK_TIMEOUT FRAG_CONF_ACK_TIMEOUT
+#else
+#define FRAG_ACK_TIMEOUT (CLOCK_SECOND / 4)
+#endif
+
+/** Rounds sent after the first before giving a message up */
+#ifdef FRAG_CONF_RETRIES
+#define FRAG_RETRIES FRAG_CONF_RETRIES
+#else
+#define FRAG_RETRIES 4
+#endif
+
+#define FRAG_HDR_LEN       4
+#define FRAG_PAYLOAD_LEN   (LINK_MAX_DATA_LEN - FRAG_HDR_LEN)
+/** Fragments of a message, bounded by the acknowledgement bitmap */
+#define FRAG_MAX_COUNT     32
+
+/** \name Ports @{ */
+/** Messages to and from the host, see HOST_CMD_SEND_MESSAGE */
+#define FRAG_PORT_APP      0
+/** Firmware updates, see ota.h */
+#define FRAG_PORT_OTA      1
+#define FRAG_PORT_COUNT    2
+/** @} */
+/*---------------------------------------------------------------------------*/
+/**
+ * Called once a message has been sent.
+ * \param status 0 if every fragment was acknowledged, -1 otherwise
+ */
+typedef void (*frag_sent_callback_t)(const linkaddr_t *dst, int status);
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Allocate the reassembly buffers and the message being sent.
+ */
+void frag_init(void);
+
+/**
+ * \brief Set the function receiving reassembled messages for a port.
+ */
+void frag_set_input_callback(uint8_t port, link_input_callback_t callback);
+
+/**
+ * \brief Set the function told about the outcome of every message sent
+ *        from a port.
+ */
+void frag_set_sent_callback(uint8_t port, frag_sent_callback_t callback);
+
+/**
+ * \brief Process a received LINK_TYPE_FRAG frame, then free it.
+ */
+void frag_input(struct frame *frame, const struct link_hdr *hdr);
+
+/**
+ * \brief Buffer of the next message to send, to be filled by the caller.
+ * \return The buffer, FRAG_MAX_LEN bytes long, or NULL while a message is
+ *         being sent.
+ */
+uint8_t *frag_buffer(void);
+
+/**
+ * \brief Start sending the message in frag_buffer() to a port of dst.
+ * \return 0 if started, -1 if busy or the length or port is invalid.
+ */
+int frag_send(const linkaddr_t *dst, uint8_t port, uint16_t len);
+/*---------------------------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FRAG_H */
@@ -0,0 +1,89 @@
+/**
+ * \file
+ *         Frame buffers shared with the RF core
+ */
+#include "contiki.h"
+#include "frame-pool.h"
+#include "arena.h"
+#include "lib/list.h"
+#include "stats.h"
+
+#include <stddef.h>
+/*---------------------------------------------------------------------------*/
+/* The RF core requires the entry data to follow its header directly */
+_Static_assert(offsetof(struct frame, data) ==
+               offsetof(struct frame, entry) + FRAME_ENTRY_HDR_LEN,
+               "frame data must follow the data entry header");
+
+_Static_assert(FRAME_POOL_SIZE * ARENA_SIZEOF(sizeof(struct frame)) <=
+               ARENA_QUOTA_FRAME_POOL,
+               "FRAME_POOL_CONF_SIZE frames do not fit in "
+               "ARENA_CONF_QUOTA_FRAME_POOL");
+/*---------------------------------------------------------------------------*/
+/* Frames not owned by anyone, linked through their next field */
+LIST(free_frames);
+static int free_count;
+
+static void (*release_hook)(void);
+/*---------------------------------------------------------------------------*/
+void
+frame_pool_init(void)
+{
+  struct frame *frame;
+  unsigned i;
+
+  list_init(free_frames);
+  free_count = 0;
+
+  for(i = 0; i < FRAME_POOL_SIZE; i++) {
+    frame = arena_alloc(ARENA_FRAME_POOL, sizeof(struct frame));
+    if(frame == NULL) {
+      break;
+    }
+    list_push(free_frames, frame);
+    free_count++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+struct frame *
+frame_pool_alloc(void)
+{
+  struct frame *frame = list_pop(free_frames);
+
+  if(frame != NULL) {
+    free_count--;
+    STATS_MAX(FRAME_POOL_HWM, FRAME_POOL_SIZE - free_count);
+    frame->next = NULL;
+    frame->len = 0;
+  }
+
+  return frame;
+}
+/*---------------------------------------------------------------------------*/
+void
+frame_pool_free(struct frame *frame)
+{
+  if(frame == NULL) {
+    return;
+  }
+
+  list_push(free_frames, frame);
+  free_count++;
+
+  if(release_hook != NULL) {
+    release_hook();
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+frame_pool_available(void)
+{
+  return free_count;
+}
+/*---------------------------------------------------------------------------*/
+void
+frame_pool_set_release_hook(void (*hook)(void))
+{
+  release_hook = hook;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,112 @@
+/**
+ * \file
+ *         Frame buffers shared with the RF core
+ *
+ *         Every frame buffer is laid out as an RF core data entry, so the
+ *         RF core receives straight into it and transmits straight out of
+ *         it. Frames are handed around by reference: whoever holds a frame
+ *         owns it and must either pass it on or return it with
+ *         frame_pool_free(). The buffers come out of the ARENA_FRAME_POOL
+ *         region of the arena.
+ *
+ *         The payload sits at the same offset for received and outgoing
+ *         frames, so a received frame can be edited and forwarded in place.
+ */
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#include "contiki.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------*/
+#ifdef FRAME_POOL_CONF_SIZE
+#define FRAME_POOL_SIZE FRAME_POOL_CONF_SIZE
+#else
+#define FRAME_POOL_SIZE 8
+#endif
+
+/** Largest PSDU the firmware will send or accept, in bytes */
+#ifdef FRAME_CONF_MAX_LEN
+#define FRAME_MAX_LEN FRAME_CONF_MAX_LEN
+#else
+#define FRAME_MAX_LEN 255
+#endif
+
+/** Size of the RF core data entry header preceding the entry data */
+#define FRAME_ENTRY_HDR_LEN 8
+
+/**
+ * Entry data layout: [entry length (2)] [PHR (2)] [payload] [RX trailer].
+ * The entry length is only written by the RF core on RX, on TX the packet
+ * pointer starts at the PHR.
+ */
+#define FRAME_PHR_OFFSET     2
+#define FRAME_PAYLOAD_OFFSET 4
+#define FRAME_RX_TRAILER_LEN 6
+
+#define FRAME_DATA_LEN (FRAME_PAYLOAD_OFFSET + FRAME_MAX_LEN + \
+                        FRAME_RX_TRAILER_LEN)
+/*---------------------------------------------------------------------------*/
+/** Metadata appended by the RF core to every received frame */
+struct frame_rx_meta {
+  /** RAT timestamp of the end of the sync word */
+  uint32_t timestamp;
+  /** Received signal strength, in dBm */
+  int8_t rssi;
+  /** Raw status byte from the RF core */
+  uint8_t status;
+};
+
+struct frame {
+  /** List linkage, for whoever currently owns the frame */
+  struct frame *next;
+  struct frame_rx_meta meta;
+  /** Payload length, PHR and CRC excluded */
+  uint16_t len;
+  /** RF core data entry header, the RF core writes data right after it */
+  uint8_t entry[FRAME_ENTRY_HDR_LEN] __attribute__((aligned(4)));
+  uint8_t data[FRAME_DATA_LEN];
+};
+
+/** Pointer to the payload of a frame */
+#define frame_payload(f) (&(f)->data[FRAME_PAYLOAD_OFFSET])
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Initialize the frame pool, must run before any allocation.
+ */
+void frame_pool_init(void);
+
+/**
+ * \brief Take a frame from the pool.
+ * \return A frame with len set to 0, or NULL if the pool is exhausted.
+ */
+struct frame *frame_pool_alloc(void);
+
+/**
+ * \brief Return a frame to the pool.
+ */
+void frame_pool_free(struct frame *frame);
+
+/**
+ * \brief Number of frames currently available.
+ */
+int frame_pool_available(void);
+
+/**
+ * \brief Set a function called every time a frame is returned to the pool.
+ *
+ * Used by the RF core to refill its RX queue after running dry.
+ */
+void frame_pool_set_release_hook(void (*hook)(void));
+/*---------------------------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FRAME_POOL_H */
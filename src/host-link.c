@@ -0,0 +1,450 @@
+/**
+ * \file
+ *         Framed serial link to the host MCU
+ */
+#include "contiki.h"
+#include "host-link.h"
+#include "arena.h"
+#include "lib/crc16.h"
+#include "lib/list.h"
+#include "stats.h"
+#include "sys/int-master.h"
+
+#include "Board.h"
+#include <ti/drivers/PIN.h>
+#include <ti/drivers/UART.h>
+#include <ti/drivers/uart/UARTCC26XX.h>
+
+#include <stdbool.h>
+#include <string.h>
+/*---------------------------------------------------------------------------*/
+#define CRC_LEN     2
+#define RX_CHUNK    64
+#define TX_MASK     (HOST_LINK_TX_BUF_SIZE - 1)
+#define FRAME_BUF_LEN (HOST_LINK_MAX_FRAME_LEN + CRC_LEN)
+
+_Static_assert(ARENA_SIZEOF(2 * RX_CHUNK) + ARENA_SIZEOF(FRAME_BUF_LEN) +
+               ARENA_SIZEOF(HOST_LINK_TX_BUF_SIZE) <= ARENA_QUOTA_HOST_LINK,
+               "host link buffers do not fit in ARENA_CONF_QUOTA_HOST_LINK");
+/*---------------------------------------------------------------------------*/
+static UART_Handle uart;
+
+LIST(handlers);
+
+/* Raw RX chunks, the driver fills one while the process decodes the other */
+static uint8_t (*rx_buf)[RX_CHUNK];
+static volatile uint16_t rx_len[2];
+static volatile uint8_t rx_index;
+static volatile bool rx_stalled;
+
+/* Frame being decoded */
+static uint8_t *frame_buf;
+static uint16_t frame_len;
+static bool frame_escaped;
+static bool frame_overflow;
+
+/* Encoded output, head is only written by host_link_send() and tail only
+ * from the UART write callback */
+static uint8_t *tx_ring;
+static volatile uint16_t tx_head;
+static volatile uint16_t tx_tail;
+static volatile bool tx_busy;
+static struct process *drain_waiter;
+
+#if HOST_LINK_IDLE_TIMEOUT
+/* UART closed, the RX pin armed to open it again */
+static volatile bool asleep;
+/* Set while the pending read is cancelled to close the UART */
+static volatile bool closing;
+static volatile bool wake_pending;
+static struct etimer idle_timer;
+
+static PIN_State wake_pin_state;
+static PIN_Handle wake_pin;
+static const PIN_Config wake_pin_config[] = {
+  Board_UART0_RX | PIN_INPUT_EN | PIN_PULLUP | PIN_IRQ_NEGEDGE,
+  PIN_TERMINATE
+};
+#endif
+/*---------------------------------------------------------------------------*/
+PROCESS(host_link_process, "Host link process");
+/*---------------------------------------------------------------------------*/
+static void
+tx_kick(void)
+{
+  int_master_status_t status = int_master_read_and_disable();
+  uint16_t len;
+
+#if HOST_LINK_IDLE_TIMEOUT
+  if(asleep) {
+    /* The process opens the UART, then kicks again */
+    wake_pending = true;
+    int_master_status_set(status);
+    process_poll(&host_link_process);
+    return;
+  }
+#endif
+
+  if(!tx_busy && tx_head != tx_tail) {
+    len = MIN((uint16_t)(tx_head - tx_tail),
+              HOST_LINK_TX_BUF_SIZE - (tx_tail & TX_MASK));
+    tx_busy = true;
+    int_master_status_set(status);
+    UART_write(uart, &tx_ring[tx_tail & TX_MASK], len);
+    return;
+  }
+
+  int_master_status_set(status);
+}
+/*---------------------------------------------------------------------------*/
+static void
+write_callback(UART_Handle handle, void *buf, size_t count)
+{
+  tx_tail += count;
+  tx_busy = false;
+
+  if(tx_tail == tx_head && drain_waiter != NULL) {
+    process_poll(drain_waiter);
+    drain_waiter = NULL;
+  }
+
+  tx_kick();
+}
+/*---------------------------------------------------------------------------*/
+static void
+read_callback(UART_Handle handle, void *buf, size_t count)
+{
+#if HOST_LINK_IDLE_TIMEOUT
+  if(closing) {
+    /* Cancelled, keep what came in but do not read on */
+    if(count > 0) {
+      rx_len[rx_index] = count;
+      rx_index ^= 1;
+      process_poll(&host_link_process);
+    }
+    return;
+  }
+#endif
+
+  rx_len[rx_index] = count;
+  rx_index ^= 1;
+
+  if(rx_len[rx_index] == 0) {
+    UART_read(uart, rx_buf[rx_index], RX_CHUNK);
+  } else {
+    /* The process has not caught up, it restarts reading once it has */
+    rx_stalled = true;
+  }
+
+  process_poll(&host_link_process);
+}
+/*---------------------------------------------------------------------------*/
+static void
+dispatch(void)
+{
+  struct host_link_handler *handler;
+  uint16_t crc;
+
+  if(frame_len < 1 + CRC_LEN) {
+    return;
+  }
+
+  frame_len -= CRC_LEN;
+  crc = frame_buf[frame_len] | (frame_buf[frame_len + 1] << 8);
+  if(crc16_data(frame_buf, frame_len, 0) != crc) {
+    return;
+  }
+
+  for(handler = list_head(handlers); handler != NULL;
+      handler = list_item_next(handler)) {
+    if(handler->cmd == frame_buf[0]) {
+      handler->input(&frame_buf[1], frame_len - 1);
+      return;
+    }
+  }
+
+  host_link_send_result(frame_buf[0], HOST_STATUS_UNSUPPORTED);
+}
+/*---------------------------------------------------------------------------*/
+static void
+decode(const uint8_t *data, uint16_t len)
+{
+  uint16_t i;
+  uint8_t c;
+
+  for(i = 0; i < len; i++) {
+    c = data[i];
+
+    if(c == HOST_LINK_FLAG) {
+      if(!frame_overflow && !frame_escaped) {
+        dispatch();
+      }
+      frame_len = 0;
+      frame_escaped = false;
+      frame_overflow = false;
+      continue;
+    }
+
+    if(c == HOST_LINK_ESC) {
+      frame_escaped = true;
+      continue;
+    }
+
+    if(frame_escaped) {
+      c ^= 0x20;
+      frame_escaped = false;
+    }
+
+    if(frame_len < FRAME_BUF_LEN) {
+      frame_buf[frame_len++] = c;
+    } else {
+      frame_overflow = true;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+put_escaped(uint16_t *at, uint8_t c)
+{
+  if(c == HOST_LINK_FLAG || c == HOST_LINK_ESC) {
+    tx_ring[(*at)++ & TX_MASK] = HOST_LINK_ESC;
+    c ^= 0x20;
+  }
+  tx_ring[(*at)++ & TX_MASK] = c;
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+put_block(uint16_t *at, const void *block, uint16_t len, uint16_t crc)
+{
+  const uint8_t *bytes = block;
+  uint16_t i;
+
+  for(i = 0; i < len; i++) {
+    put_escaped(at, bytes[i]);
+    crc = crc16_add(bytes[i], crc);
+  }
+
+  return crc;
+}
+/*---------------------------------------------------------------------------*/
+static int
+open_uart(void)
+{
+  UART_Params params;
+
+  UART_Params_init(&params);
+  params.baudRate = HOST_LINK_BAUD_RATE;
+  params.readMode = UART_MODE_CALLBACK;
+  params.writeMode = UART_MODE_CALLBACK;
+  params.readCallback = read_callback;
+  params.writeCallback = write_callback;
+  params.readDataMode = UART_DATA_BINARY;
+  params.writeDataMode = UART_DATA_BINARY;
+  params.readReturnMode = UART_RETURN_FULL;
+  params.readEcho = UART_ECHO_OFF;
+
+  uart = UART_open(Board_UART0, &params);
+  if(uart == NULL) {
+    return -1;
+  }
+
+  /* Hand over whatever has arrived when the line goes idle, instead of
+   * waiting for a full chunk */
+  UART_control(uart, UARTCC26XX_CMD_RETURN_PARTIAL_ENABLE, NULL);
+
+  UART_read(uart, rx_buf[rx_index], RX_CHUNK);
+
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+#if HOST_LINK_IDLE_TIMEOUT
+static void
+wake_callback(PIN_Handle handle, PIN_Id pin)
+{
+  PIN_setInterrupt(handle, pin | PIN_IRQ_DIS);
+  wake_pending = true;
+  process_poll(&host_link_process);
+}
+/*---------------------------------------------------------------------------*/
+/* Close the UART if nothing is under way in either direction */
+static void
+sleep_uart(void)
+{
+  if(tx_busy || tx_head != tx_tail || rx_len[0] > 0 || rx_len[1] > 0 ||
+     rx_stalled || frame_len > 0) {
+    etimer_restart(&idle_timer);
+    return;
+  }
+
+  closing = true;
+  UART_readCancel(uart);
+  closing = false;
+
+  if(rx_len[0] > 0 || rx_len[1] > 0) {
+    /* Something came in after all, go on reading */
+    UART_read(uart, rx_buf[rx_index], RX_CHUNK);
+    etimer_restart(&idle_timer);
+    return;
+  }
+
+  UART_close(uart);
+
+  wake_pin = PIN_open(&wake_pin_state, wake_pin_config);
+  if(wake_pin == NULL) {
+    /* Without a wake-up the link would be gone for good */
+    open_uart();
+    etimer_restart(&idle_timer);
+    return;
+  }
+  PIN_registerIntCb(wake_pin, wake_callback);
+  asleep = true;
+}
+/*---------------------------------------------------------------------------*/
+static void
+wake_uart(void)
+{
+  wake_pending = false;
+  if(!asleep) {
+    return;
+  }
+
+  PIN_close(wake_pin);
+  if(open_uart() != 0) {
+    /* Try again on the next edge */
+    wake_pin = PIN_open(&wake_pin_state, wake_pin_config);
+    PIN_registerIntCb(wake_pin, wake_callback);
+    return;
+  }
+  asleep = false;
+  STATS_INC(HOST_LINK_WAKEUPS);
+
+  etimer_set(&idle_timer, HOST_LINK_IDLE_TIMEOUT);
+  tx_kick();
+}
+#endif /* HOST_LINK_IDLE_TIMEOUT */
+/*---------------------------------------------------------------------------*/
+int
+host_link_init(void)
+{
+  rx_buf = arena_alloc(ARENA_HOST_LINK, 2 * RX_CHUNK);
+  frame_buf = arena_alloc(ARENA_HOST_LINK, FRAME_BUF_LEN);
+  tx_ring = arena_alloc(ARENA_HOST_LINK, HOST_LINK_TX_BUF_SIZE);
+  if(rx_buf == NULL || frame_buf == NULL || tx_ring == NULL) {
+    return -1;
+  }
+
+  rx_index = 0;
+  if(open_uart() != 0) {
+    return -1;
+  }
+
+  process_start(&host_link_process, NULL);
+
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+host_link_register(struct host_link_handler *handler)
+{
+  list_add(handlers, handler);
+}
+/*---------------------------------------------------------------------------*/
+int
+host_link_send(uint8_t cmd, const void *hdr, uint16_t hdr_len,
+               const void *data, uint16_t len)
+{
+  /* Worst case, every byte escaped, plus both flags */
+  const uint16_t worst = 2 * (1 + hdr_len + len + CRC_LEN) + 2;
+  uint16_t at = tx_head;
+  uint16_t crc;
+  uint8_t crc_bytes[CRC_LEN];
+
+  if((uint16_t)(HOST_LINK_TX_BUF_SIZE - (uint16_t)(at - tx_tail)) < worst) {
+    return -1;
+  }
+
+  tx_ring[at++ & TX_MASK] = HOST_LINK_FLAG;
+  crc = put_block(&at, &cmd, 1, 0);
+  crc = put_block(&at, hdr, hdr_len, crc);
+  crc = put_block(&at, data, len, crc);
+  crc_bytes[0] = crc & 0xFF;
+  crc_bytes[1] = crc >> 8;
+  put_block(&at, crc_bytes, CRC_LEN, 0);
+  tx_ring[at++ & TX_MASK] = HOST_LINK_FLAG;
+
+  tx_head = at;
+  STATS_MAX(HOST_LINK_TX_HWM, (uint16_t)(at - tx_tail));
+  tx_kick();
+
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+host_link_poll_when_drained(struct process *p)
+{
+  int_master_status_t status = int_master_read_and_disable();
+
+  if(tx_head == tx_tail) {
+    int_master_status_set(status);
+    process_poll(p);
+    return;
+  }
+
+  drain_waiter = p;
+  int_master_status_set(status);
+}
+/*---------------------------------------------------------------------------*/
+void
+host_link_send_result(uint8_t cmd, uint8_t status)
+{
+  const uint8_t result[] = { cmd, status };
+
+  host_link_send(HOST_CMD_RESULT, result, sizeof(result), NULL, 0);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(host_link_process, ev, data)
+{
+  static uint8_t decode_index;
+  int_master_status_t status;
+
+  PROCESS_BEGIN();
+
+  decode_index = 0;
+#if HOST_LINK_IDLE_TIMEOUT
+  etimer_set(&idle_timer, HOST_LINK_IDLE_TIMEOUT);
+#endif
+
+  while(1) {
+    PROCESS_YIELD_UNTIL(ev == PROCESS_EVENT_POLL ||
+                        ev == PROCESS_EVENT_TIMER);
+
+#if HOST_LINK_IDLE_TIMEOUT
+    if(wake_pending) {
+      wake_uart();
+    } else if(ev == PROCESS_EVENT_TIMER && data == &idle_timer) {
+      sleep_uart();
+    }
+    if(rx_len[decode_index] > 0) {
+      etimer_set(&idle_timer, HOST_LINK_IDLE_TIMEOUT);
+    }
+#endif
+
+    while(rx_len[decode_index] > 0) {
+      decode(rx_buf[decode_index], rx_len[decode_index]);
+      rx_len[decode_index] = 0;
+      decode_index ^= 1;
+
+      status = int_master_read_and_disable();
+      if(rx_stalled) {
+        rx_stalled = false;
+        int_master_status_set(status);
+        UART_read(uart, rx_buf[rx_index], RX_CHUNK);
+      } else {
+        int_master_status_set(status);
+      }
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,265 @@
+/**
+ * \file
+ *         Framed serial link to the host MCU
+ *
+ *         Frames are HDLC-like: delimited by HOST_LINK_FLAG, with
+ *         HOST_LINK_ESC followed by the byte xor 0x20 standing in for a flag
+ *         or escape byte in the content. Content is
+ *         [command (1)] [arguments] [CRC-16 (2)], the CRC being Contiki's
+ *         crc16_data() over command and arguments, little endian.
+ *
+ *         The UART is driven in callback mode in both directions, whole
+ *         blocks are moved per driver call and nothing waits on it.
+ *
+ *         A pending UART read keeps the CPU out of standby. With a non-zero
+ *         HOST_LINK_IDLE_TIMEOUT the UART is closed once the link has been
+ *         quiet that long, and a falling edge on the RX pin opens it again.
+ *         The byte carrying that edge is lost: after a quiet spell the host
+ *         sends a lone HOST_LINK_FLAG, which framing ignores, and waits
+ *         HOST_LINK_WAKE_TIME before the next frame. Frames towards the host
+ *         open the UART by themselves.
+ */
+#ifndef HOST_LINK_H
+#define HOST_LINK_H
+
+#include "contiki.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------*/
+#ifdef HOST_LINK_CONF_BAUD_RATE
+#define HOST_LINK_BAUD_RATE HOST_LINK_CONF_BAUD_RATE
+#else
+#define HOST_LINK_BAUD_RATE 921600
+#endif
+
+/** Largest command plus arguments accepted from the host */
+#ifdef HOST_LINK_CONF_MAX_FRAME_LEN
+#define HOST_LINK_MAX_FRAME_LEN HOST_LINK_CONF_MAX_FRAME_LEN
+#else
+#define HOST_LINK_MAX_FRAME_LEN 300
+#endif
+
+/** Encoded output buffered towards the host, must be a power of two */
+#ifdef HOST_LINK_CONF_TX_BUF_SIZE
+#define HOST_LINK_TX_BUF_SIZE HOST_LINK_CONF_TX_BUF_SIZE
+#else
+#define HOST_LINK_TX_BUF_SIZE 1024
+#endif
+
+/** Quiet time after which the UART is closed, in clock ticks, 0 never */
+#ifdef HOST_LINK_CONF_IDLE_TIMEOUT
+#define HOST_LINK_IDLE_TIMEOUT HOST_LINK_CONF_IDLE_TIMEOUT
+#else
+#define HOST_LINK_IDLE_TIMEOUT 0
+#endif
+
+/** Time the host leaves between its wake-up flag and a frame, in ms */
+#define HOST_LINK_WAKE_TIME 5
+
+#if (HOST_LINK_TX_BUF_SIZE & (HOST_LINK_TX_BUF_SIZE - 1)) != 0
+#error "HOST_LINK_TX_BUF_SIZE must be a power of two"
+#endif
+
+#define HOST_LINK_FLAG 0x7E
+#define HOST_LINK_ESC  0x7D
+/*---------------------------------------------------------------------------*/
+/**
+ * \name Commands
+ *
+ * Direction and arguments of every command, multi-byte values are little
+ * endian.
+ * @{
+ */
+/** radio -> host: [command (1)] [status (1)], outcome of a host command */
+#define HOST_CMD_RESULT       0x00
+/** host -> radio: [destination (2)] [data] */
+#define HOST_CMD_SEND_FRAME   0x01
+/** radio -> host: [source (2)] [RSSI (1)] [data] */
+#define HOST_CMD_RECV_FRAME   0x02
+/** host -> radio: [parameter (1)], answered with HOST_CMD_CONFIG_VALUE */
+#define HOST_CMD_CONFIG_GET   0x03
+/** host -> radio: [parameter (1)] [value (4)] */
+#define HOST_CMD_CONFIG_SET   0x04
+/** radio -> host: [parameter (1)] [value (4)] */
+#define HOST_CMD_CONFIG_VALUE 0x05
+/** radio -> host: binary log records, see log-ring.h */
+#define HOST_CMD_LOG          0x06
+/**
+ * host -> radio: [reset (1), optional], answered with HOST_CMD_PROF_DATA
+ * and HOST_CMD_PROF_COUNTERS. A non-zero reset clears the statistics once
+ * they have been sent.
+ */
+#define HOST_CMD_PROF_DUMP    0x07
+/**
+ * radio -> host: per profiling point, see prof.h,
+ * [point (1)] [count (4)] [min (4)] [max (4)] [sum (8)], all in cycles
+ */
+#define HOST_CMD_PROF_DATA    0x08
+/**
+ * host -> radio, benchmark image only:
+ * [peer (2)] [count (2)] [length (1)] [interval ms (2)], starts sending
+ * count requests of length bytes to the peer. Answered with
+ * HOST_CMD_RESULT, followed by HOST_CMD_BENCH_REPORT once the run is over.
+ */
+#define HOST_CMD_BENCH_START  0x09
+/** host -> radio, benchmark image only: answered with HOST_CMD_BENCH_REPORT */
+#define HOST_CMD_BENCH_GET    0x0A
+/**
+ * radio -> host: results of the last benchmark run, see src/bench.cpp,
+ * [role (1)] [sent (2)] [received (2)] [expected (2)] [length (1)]
+ * [elapsed us (4)] [RTT min, p50, p90, p99, max in us (4 each)]
+ * [TX cycles per frame (4)] [RX cycles per frame (4)]
+ * [airtime per frame in us (4)], cycles of the CPU only, the airtime is
+ * that of the frames sent, long preamble of low-power listening included
+ */
+#define HOST_CMD_BENCH_REPORT 0x0B
+/** radio -> host: per profiling counter, [counter (1)] [value (4)] */
+#define HOST_CMD_PROF_COUNTERS 0x0C
+/**
+ * host -> radio: [data], floods data to every node of the mesh, see mesh.h.
+ * Answered with HOST_CMD_RESULT.
+ */
+#define HOST_CMD_FLOOD        0x0D
+/**
+ * host -> radio: [destination (2)] [data], sends data over as many hops as
+ * it takes, see route.h. Answered with HOST_CMD_RESULT once sent or parked
+ * until a route is found.
+ */
+#define HOST_CMD_ROUTE_SEND   0x0E
+/**
+ * host -> radio: [destination (2)] [offset (2)] [total (2)] [data], one
+ * chunk of a message of up to FRAG_MAX_LEN bytes for a neighbor, see
+ * frag.h. Chunks come in order from offset 0, each is answered with
+ * HOST_CMD_RESULT, and the last one starts sending the message.
+ */
+#define HOST_CMD_SEND_MESSAGE 0x0F
+/** radio -> host: [destination (2)] [status (1)], outcome of a message */
+#define HOST_CMD_MESSAGE_SENT 0x10
+/**
+ * radio -> host: [source (2)] [offset (2)] [total (2)] [data], one chunk
+ * of a message received, chunks are sent in order.
+ */
+#define HOST_CMD_RECV_MESSAGE 0x11
+/**
+ * host -> radio: [reset (1), optional], answered with HOST_CMD_STATS. A
+ * non-zero reset clears the statistics as they are read.
+ */
+#define HOST_CMD_STATS_GET    0x12
+/**
+ * radio -> host: [version (2)] [count (2)] [uptime s (4)] [word (4)]...,
+ * the statistics block of stats.h
+ */
+#define HOST_CMD_STATS        0x13
+/**
+ * host -> radio: [destination (2)] [offset (2)] [total (2)] [data], one
+ * chunk of a firmware update message, see ota.h, sent like
+ * HOST_CMD_SEND_MESSAGE. A destination of this node updates it.
+ */
+#define HOST_CMD_OTA_SEND     0x14
+/**
+ * radio -> host: [target (2)] [OTA_MSG_STATUS message], answer of the node
+ * being updated
+ */
+#define HOST_CMD_OTA_STATUS   0x15
+/**
+ * host -> radio: [clear (1), optional], answered with HOST_CMD_FAULT, or
+ * HOST_CMD_RESULT when no stall was captured. A non-zero clear forgets the
+ * snapshot once sent.
+ */
+#define HOST_CMD_FAULT_GET    0x16
+/**
+ * radio -> host: [count (2)] [flags (1)] [events queued (1)]
+ * [free frames (1)] [frames queued per class (1 each)] [uptime s (4)]
+ * [cycles (4)] [stall us (4)] [process (4)] [name (MONITOR_NAME_LEN)]
+ * [sp (4)] [words (1)] [stack word (4)]..., the snapshot of monitor.h
+ */
+#define HOST_CMD_FAULT        0x17
+/** @} */
+
+/**
+ * \name Configuration parameters
+ *
+ * Parameter IDs for HOST_CMD_CONFIG_GET and HOST_CMD_CONFIG_SET, values
+ * are carried as 32-bit integers.
+ * @{
+ */
+/** Link address of the node, read only */
+#define HOST_PARAM_NODE_ADDR      0x00
+/** Largest data length accepted by HOST_CMD_SEND_FRAME, read only */
+#define HOST_PARAM_MAX_DATA_LEN   0x01
+/** Radio channel, read only, see chan.h for how it changes */
+#define HOST_PARAM_CHANNEL        0x02
+/** Default and highest TX power in dBm, signed */
+#define HOST_PARAM_TX_POWER       0x03
+/** RX sniff interval in ms, 0 keeps RX always on */
+#define HOST_PARAM_SNIFF_INTERVAL 0x04
+/** Per neighbor TX power control, 0 or 1 */
+#define HOST_PARAM_POWER_CTRL     0x05
+/** @} */
+
+/** \name HOST_CMD_RESULT status codes @{ */
+#define HOST_STATUS_OK          0
+#define HOST_STATUS_ERROR       1
+#define HOST_STATUS_UNSUPPORTED 2
+#define HOST_STATUS_INVALID     3
+/** @} */
+/*---------------------------------------------------------------------------*/
+/** Handler for one command received from the host */
+struct host_link_handler {
+  struct host_link_handler *next;
+  uint8_t cmd;
+  /** Called with the arguments of the command, CRC already checked */
+  void (*input)(const uint8_t *args, uint16_t len);
+};
+/*---------------------------------------------------------------------------*/
+PROCESS_NAME(host_link_process);
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Open the UART and start listening for host frames.
+ *
+ * Handlers registered before are kept.
+ *
+ * \return 0 on success, -1 if the UART could not be opened.
+ */
+int host_link_init(void);
+
+/**
+ * \brief Register the handler of a host command.
+ */
+void host_link_register(struct host_link_handler *handler);
+
+/**
+ * \brief Queue a frame towards the host.
+ *
+ * The arguments are given in two parts that are sent back to back, either
+ * can be empty. Never blocks.
+ *
+ * \return 0 if queued, -1 if there is not enough room in the TX buffer.
+ */
+int host_link_send(uint8_t cmd, const void *hdr, uint16_t hdr_len,
+                   const void *data, uint16_t len);
+
+/**
+ * \brief Poll a process once the TX buffer has drained.
+ *
+ * For a sender host_link_send() turned away, instead of retrying on a
+ * timer. Only one process can wait at a time.
+ */
+void host_link_poll_when_drained(struct process *p);
+
+/**
+ * \brief Answer a host command with HOST_CMD_RESULT.
+ */
+void host_link_send_result(uint8_t cmd, uint8_t status);
+/*---------------------------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOST_LINK_H */
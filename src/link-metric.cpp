@@ -0,0 +1,98 @@
+/**
+ * \file
+ *         Link quality estimators of the neighbor table
+ */
+
+extern "C" {
+#include "contiki.h"
+}
+
+#include "link-metric.h"
+#include "link-metric.hpp"
+#include "neighbor.h"
+
+namespace
+{
+
+template <unsigned window>
+struct PrrEstimator
+{
+    using type = metric::PrrWindow<window>;
+};
+
+template <>
+struct PrrEstimator<0>
+{
+    using type = metric::PrrEwma<LINK_METRIC_PRR_SHIFT>;
+};
+
+using Rssi = metric::Ewma<LINK_METRIC_RSSI_SHIFT, 4>;
+using Prr = PrrEstimator<LINK_METRIC_PRR_WINDOW>::type;
+using Etx = metric::EtxFromPrr<NEIGHBOR_ETX_DIVISOR, NEIGHBOR_ETX_MAX>;
+
+static_assert(metric::PRR_ONE == LINK_METRIC_PRR_ONE,
+              "LINK_METRIC_PRR_ONE does not match the kernels");
+static_assert(Rssi::value(Rssi::fromValue(INT8_MIN)) == INT8_MIN,
+              "RSSI averages must hold every dBm value");
+
+/* The kernels on known points, checked by every build of the image */
+using EwmaCheck = metric::Ewma<3, 4>;
+using PrrEwmaCheck = metric::PrrEwma<3>;
+using PrrWindowCheck = metric::PrrWindow<8>;
+using EtxCheck = metric::EtxFromPrr<128, 1024>;
+
+static_assert(EwmaCheck::value(EwmaCheck::update(EwmaCheck::fromValue(-80),
+                                                 -72)) == -79,
+              "Ewma moves by 1/2^shift of the difference");
+static_assert(PrrEwmaCheck::update(metric::PRR_ONE, 0) == metric::PRR_ONE &&
+                  PrrEwmaCheck::update(0x8000, 1) == 33279,
+              "PrrEwma weighs every frame 1/2^shift");
+static_assert(PrrWindowCheck::fromRatio(metric::PRR_ONE) == 0xFF &&
+                  PrrWindowCheck::ratio(0xFF) == metric::PRR_ONE &&
+                  PrrWindowCheck::update(0xFF, 3) == 0xF1 &&
+                  PrrWindowCheck::update(0xFF, 8) == 1 &&
+                  PrrWindowCheck::ratio(0x0F) == 4 * PrrWindowCheck::step,
+              "PrrWindow keeps one bit per frame");
+static_assert(EtxCheck::etx(metric::PRR_ONE) == 128 &&
+                  EtxCheck::etx(49151) == 171 &&
+                  EtxCheck::etx(32768) == 256 &&
+                  EtxCheck::etx(16384) == 512 &&
+                  EtxCheck::etx(0) == 1024,
+              "EtxFromPrr strays from divisor / PRR");
+
+} // namespace
+
+int16_t link_metric_rssi_init(int8_t dbm)
+{
+    return Rssi::fromValue(dbm);
+}
+
+int16_t link_metric_rssi_update(int16_t avg, int8_t dbm)
+{
+    return Rssi::update(avg, dbm);
+}
+
+int8_t link_metric_rssi(int16_t avg)
+{
+    return Rssi::value(avg);
+}
+
+uint16_t link_metric_prr_init(uint16_t ratio)
+{
+    return Prr::fromRatio(ratio);
+}
+
+uint16_t link_metric_prr_update(uint16_t state, uint8_t lost)
+{
+    return Prr::update(state, lost);
+}
+
+uint16_t link_metric_prr(uint16_t state)
+{
+    return Prr::ratio(state);
+}
+
+uint16_t link_metric_etx(uint16_t state)
+{
+    return Etx::etx(Prr::ratio(state));
+}
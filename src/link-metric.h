@@ -0,0 +1,82 @@
+/**
+ * \file
+ *         Link quality estimators of the neighbor table
+ *
+ *         C interface to the kernels of link-metric.hpp, instantiated with
+ *         the weights and window sizes configured here. RSSI averages are
+ *         kept in 1/16 dBm. The reception ratio is estimated either as a
+ *         moving average or, with LINK_METRIC_PRR_WINDOW set, as the share
+ *         of the last LINK_METRIC_PRR_WINDOW frames received; the state of
+ *         both fits in 16 bits and only means something to the functions
+ *         below.
+ */
+#ifndef LINK_METRIC_H
+#define LINK_METRIC_H
+
+#include "contiki.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------*/
+/** Weight of a new RSSI sample, as a shift: 2 is 1/4 */
+#ifdef LINK_METRIC_CONF_RSSI_SHIFT
+#define LINK_METRIC_RSSI_SHIFT LINK_METRIC_CONF_RSSI_SHIFT
+#else
+#define LINK_METRIC_RSSI_SHIFT 2
+#endif
+
+/** Weight of a frame in the moving average reception ratio, as a shift */
+#ifdef LINK_METRIC_CONF_PRR_SHIFT
+#define LINK_METRIC_PRR_SHIFT LINK_METRIC_CONF_PRR_SHIFT
+#else
+#define LINK_METRIC_PRR_SHIFT 3
+#endif
+
+/** Frames the reception ratio is counted over, 2 to 16, or 0 for the
+ * moving average */
+#ifdef LINK_METRIC_CONF_PRR_WINDOW
+#define LINK_METRIC_PRR_WINDOW LINK_METRIC_CONF_PRR_WINDOW
+#else
+#define LINK_METRIC_PRR_WINDOW 0
+#endif
+
+/** Reception ratio of 100 % */
+#define LINK_METRIC_PRR_ONE 0xFFFF
+/*---------------------------------------------------------------------------*/
+/** \brief RSSI average starting from one sample */
+int16_t link_metric_rssi_init(int8_t dbm);
+
+/** \brief Account for one RSSI sample */
+int16_t link_metric_rssi_update(int16_t avg, int8_t dbm);
+
+/** \brief RSSI average rounded to dBm */
+int8_t link_metric_rssi(int16_t avg);
+
+/** \brief Reception ratio state from a ratio in 1/65535 */
+uint16_t link_metric_prr_init(uint16_t ratio);
+
+/**
+ * \brief Account for one frame received.
+ * \param lost Frames lost right before it
+ */
+uint16_t link_metric_prr_update(uint16_t state, uint8_t lost);
+
+/** \brief Estimated reception ratio, in 1/65535 */
+uint16_t link_metric_prr(uint16_t state);
+
+/**
+ * \brief ETX from the reception ratio state, scaled by
+ *        NEIGHBOR_ETX_DIVISOR and at most NEIGHBOR_ETX_MAX.
+ */
+uint16_t link_metric_etx(uint16_t state);
+/*---------------------------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LINK_METRIC_H */
@@ -0,0 +1,167 @@
+/**
+ * \file
+ *         Fixed-point link quality kernels
+ *
+ *         The estimators the neighbor table runs on every received frame,
+ *         with their weights and window sizes as template parameters.
+ *         They only shift, add and multiply by constants: no float, so no
+ *         FPU context to save if they ever run from an interrupt, and no
+ *         division, which takes up to 12 cycles on the Cortex-M4.
+ *
+ *         Reception ratios are in 1/65535, PRR_ONE being 100 %. Every PRR
+ *         estimator keeps a 16-bit state and converts it to and from such
+ *         a ratio, so that they are interchangeable in the same storage.
+ */
+#ifndef LINK_METRIC_HPP
+#define LINK_METRIC_HPP
+
+#include <stdint.h>
+
+namespace metric
+{
+
+constexpr uint16_t PRR_ONE = 0xFFFF;
+
+/**
+ * Exponentially weighted moving average of integer samples, each weighing
+ * 1/2^shift, kept with frac_bits fractional bits so that it can settle on
+ * values in between samples.
+ */
+template <unsigned shift, unsigned frac_bits>
+struct Ewma
+{
+    static_assert(shift < 8 && frac_bits < 8, "shift or frac_bits too large");
+
+    static constexpr int16_t fromValue(int value)
+    {
+        return value * (1 << frac_bits);
+    }
+
+    /** Rounded to the nearest integer */
+    static constexpr int value(int16_t avg)
+    {
+        return (avg + (1 << frac_bits >> 1)) >> frac_bits;
+    }
+
+    static constexpr int16_t update(int16_t avg, int sample)
+    {
+        return avg + ((fromValue(sample) - avg) >> shift);
+    }
+};
+
+/**
+ * Reception ratio as a moving average, every frame lost or received
+ * weighing 1/2^shift.
+ */
+template <unsigned shift>
+struct PrrEwma
+{
+    static_assert(shift > 0 && shift < 16, "shift out of range");
+
+    static constexpr uint16_t fromRatio(uint16_t ratio)
+    {
+        return ratio;
+    }
+
+    static constexpr uint16_t ratio(uint16_t state)
+    {
+        return state;
+    }
+
+    /** One frame received after lost ones */
+    static constexpr uint16_t update(uint16_t state, uint8_t lost)
+    {
+        for (; lost > 0; lost--)
+        {
+            state -= state >> shift;
+        }
+        return state + ((PRR_ONE - state) >> shift);
+    }
+};
+
+/**
+ * Reception ratio over the last frames, one bit each in a window, the
+ * latest in bit 0.
+ */
+template <unsigned frames>
+struct PrrWindow
+{
+    static_assert(frames >= 2 && frames <= 16, "window of 2 to 16 frames");
+
+    static constexpr uint16_t mask = (1UL << frames) - 1;
+    /** Ratio of one received frame of the window */
+    static constexpr uint16_t step = PRR_ONE / frames;
+
+    /** Nearest bit count, the received frames taken as the latest */
+    static constexpr uint16_t fromRatio(uint16_t ratio)
+    {
+        return (1UL << ((ratio * frames + PRR_ONE / 2) >> 16)) - 1;
+    }
+
+    static constexpr uint16_t ratio(uint16_t state)
+    {
+        const unsigned received = __builtin_popcount(state);
+
+        return received == frames ? PRR_ONE : received * step;
+    }
+
+    static constexpr uint16_t update(uint16_t state, uint8_t lost)
+    {
+        /* Lost frames past the window length clear it all the same */
+        if (lost >= frames)
+        {
+            return 1;
+        }
+        return ((uint32_t)state << (lost + 1) | 1) & mask;
+    }
+};
+
+/**
+ * ETX from a reception ratio, scaled by divisor and capped at max, by
+ * linear interpolation in a table of 2^index_bits + 1 points spread
+ * evenly over the ratios, held with 4 more fractional bits. 1/PRR curves
+ * the most where it is capped, so the error stays within a fraction of a
+ * percent.
+ */
+template <uint16_t divisor, uint16_t max, unsigned index_bits = 6>
+struct EtxFromPrr
+{
+    static_assert(index_bits >= 2 && index_bits <= 8,
+                  "index_bits out of range");
+    static_assert(max <= 0xFFFF >> 4, "max too large for the table");
+
+    static constexpr unsigned frac_bits = 16 - index_bits;
+    static constexpr unsigned points = (1U << index_bits) + 1;
+
+    struct Table
+    {
+        uint16_t etx[points];
+
+        constexpr Table() : etx()
+        {
+            for (unsigned i = 0; i < points; i++)
+            {
+                const uint64_t ratio = (uint64_t)i << frac_bits;
+                const uint64_t value = ratio == 0 ? max << 4 :
+                    (((uint64_t)divisor * PRR_ONE << 4) + ratio / 2) / ratio;
+                etx[i] = value > (max << 4) ? max << 4 : value;
+            }
+        }
+    };
+
+    static constexpr Table table{};
+
+    static constexpr uint16_t etx(uint16_t ratio)
+    {
+        const unsigned i = ratio >> frac_bits;
+        const uint32_t frac = ratio & ((1U << frac_bits) - 1);
+        const uint32_t value = ((uint32_t)table.etx[i] << frac_bits) -
+                               (table.etx[i] - table.etx[i + 1]) * frac;
+
+        return (value + (1U << (frac_bits + 3))) >> (frac_bits + 4);
+    }
+};
+
+} // namespace metric
+
+#endif // LINK_METRIC_HPP
@@ -0,0 +1,190 @@
+/**
+ * \file
+ *         Link layer encryption and authentication
+ */
+#include "contiki.h"
+#include "link-sec.h"
+#include "byteorder.h"
+#include "link.h"
+#include "persist.h"
+#include "prof.h"
+
+#include "Board.h"
+#include <ti/drivers/AESCCM.h>
+#include <ti/drivers/cryptoutils/cryptokey/CryptoKeyPlaintext.h>
+
+#include <string.h>
+/*---------------------------------------------------------------------------*/
+/* After IEEE 802.15.4, little endian:
+ * [source (8, short address zero padded)] [counter (4)] [security level] */
+#define NONCE_LEN          13
+#define NONCE_COUNTER      8
+#define NONCE_LEVEL        12
+
+/* IEEE 802.15.4 ENC-MIC-32/64/128 */
+#define SECURITY_LEVEL     (4 + (LINK_SEC_MIC_LEN == 4 ? 1 : \
+                                 LINK_SEC_MIC_LEN == 8 ? 2 : 3))
+
+#if LINK_SEC_ENABLED && !PERSIST_ENABLED
+#error "LINK_SEC_CONF_ENABLED needs PERSIST_CONF_ENABLED for the frame counter"
+#endif
+
+_Static_assert(LINK_SEC_MIC_LEN == 4 || LINK_SEC_MIC_LEN == 8 ||
+               LINK_SEC_MIC_LEN == 16,
+               "LINK_SEC_CONF_MIC_LEN must be 4, 8 or 16");
+/*---------------------------------------------------------------------------*/
+#ifdef LINK_SEC_CONF_KEY
+static uint8_t key_material[LINK_SEC_KEY_LEN] = LINK_SEC_CONF_KEY;
+#elif LINK_SEC_ENABLED
+#error "LINK_SEC_CONF_ENABLED needs a LINK_SEC_CONF_KEY"
+#else
+static uint8_t key_material[LINK_SEC_KEY_LEN];
+#endif
+
+static CryptoKey key;
+static AESCCM_Handle aesccm;
+static uint32_t tx_counter;
+/* End of the block of counter values reserved in flash */
+static uint32_t counter_limit;
+
+static void save(void);
+static void restore(uint16_t len);
+
+static struct persist_handler persist_handler = {
+  NULL, PERSIST_TX_COUNTER, save, restore
+};
+/*---------------------------------------------------------------------------*/
+static void
+make_nonce(uint8_t *nonce, const uint8_t *src, uint32_t counter)
+{
+  memset(nonce, 0, NONCE_LEN);
+  memcpy(nonce, src, LINKADDR_SIZE);
+  put_le32(&nonce[NONCE_COUNTER], counter);
+  nonce[NONCE_LEVEL] = SECURITY_LEVEL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+prepare(AESCCM_Operation *op, struct frame *frame, uint8_t *nonce,
+        uint16_t data_len)
+{
+  uint8_t *data = link_data(frame);
+
+  AESCCM_Operation_init(op);
+  op->key = &key;
+  op->aad = frame_payload(frame);
+  op->aadLength = LINK_HDR_LEN;
+  /* Same buffer in and out, the driver streams it through the engine */
+  op->input = data;
+  op->output = data;
+  op->inputLength = data_len;
+  op->nonce = nonce;
+  op->nonceLength = NONCE_LEN;
+  op->mac = data + data_len + LINK_SEC_COUNTER_LEN;
+  op->macLength = LINK_SEC_MIC_LEN;
+}
+/*---------------------------------------------------------------------------*/
+static void
+save(void)
+{
+  uint8_t buf[LINK_SEC_COUNTER_LEN];
+
+  put_le32(buf, counter_limit);
+  persist_put(buf, sizeof(buf));
+}
+/*---------------------------------------------------------------------------*/
+static void
+restore(uint16_t len)
+{
+  uint8_t buf[LINK_SEC_COUNTER_LEN];
+
+  /* Values up to the saved limit may have been used before the reset */
+  if(persist_get(buf, sizeof(buf)) == 0) {
+    tx_counter = get_le32(buf);
+    counter_limit = tx_counter;
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+link_sec_init(void)
+{
+  AESCCM_Params params;
+
+  AESCCM_init();
+  AESCCM_Params_init(&params);
+  /* Frames are secured from process context on the data path, polling
+   * costs less than a semaphore round trip for a few blocks */
+  params.returnBehavior = AESCCM_RETURN_BEHAVIOR_POLLING;
+
+  aesccm = AESCCM_open(Board_AESCCM0, &params);
+  if(aesccm == NULL) {
+    return -1;
+  }
+
+  CryptoKeyPlaintext_initKey(&key, key_material, sizeof(key_material));
+  tx_counter = 0;
+  counter_limit = 0;
+  persist_register(&persist_handler);
+
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+link_sec_encrypt(struct frame *frame, uint16_t data_len)
+{
+  PROF_BEGIN(LINK_SEC_ENCRYPT);
+  uint8_t *data = link_data(frame);
+  uint8_t nonce[NONCE_LEN];
+  AESCCM_Operation op;
+  int_fast16_t status;
+
+  /* A block not in flash would be used again after a reset, reusing
+   * nonces under the same key: nothing is sent until it is saved */
+  if(tx_counter == counter_limit) {
+    counter_limit = tx_counter + LINK_SEC_COUNTER_BLOCK;
+    if(persist_save(&persist_handler) != 0) {
+      counter_limit = tx_counter;
+      PROF_END(LINK_SEC_ENCRYPT);
+      return -1;
+    }
+  }
+  tx_counter++;
+  put_le32(data + data_len, tx_counter);
+  make_nonce(nonce, (const uint8_t *)&linkaddr_node_addr, tx_counter);
+
+  prepare(&op, frame, nonce, data_len);
+  status = AESCCM_oneStepEncrypt(aesccm, &op);
+
+  frame->len = LINK_HDR_LEN + data_len + LINK_SEC_OVERHEAD;
+  PROF_END(LINK_SEC_ENCRYPT);
+
+  return status == AESCCM_STATUS_SUCCESS ? 0 : -1;
+}
+/*---------------------------------------------------------------------------*/
+int
+link_sec_decrypt(struct frame *frame, uint32_t *counter)
+{
+  PROF_BEGIN(LINK_SEC_DECRYPT);
+  uint8_t *data = link_data(frame);
+  uint8_t nonce[NONCE_LEN];
+  AESCCM_Operation op;
+  uint16_t data_len;
+  int_fast16_t status = AESCCM_STATUS_ERROR;
+
+  if(frame->len >= LINK_HDR_LEN + LINK_SEC_COUNTER_LEN + LINK_SEC_MIC_LEN) {
+    data_len = frame->len - LINK_HDR_LEN - LINK_SEC_COUNTER_LEN -
+      LINK_SEC_MIC_LEN;
+    *counter = get_le32(data + data_len);
+    /* Source address of the link header */
+    make_nonce(nonce, &frame_payload(frame)[2 + LINKADDR_SIZE], *counter);
+
+    prepare(&op, frame, nonce, data_len);
+    status = AESCCM_oneStepDecrypt(aesccm, &op);
+    if(status == AESCCM_STATUS_SUCCESS) {
+      frame->len = LINK_HDR_LEN + data_len;
+    }
+  }
+  PROF_END(LINK_SEC_DECRYPT);
+
+  return status == AESCCM_STATUS_SUCCESS ? 0 : -1;
+}
+/*---------------------------------------------------------------------------*/
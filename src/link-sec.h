@@ -0,0 +1,104 @@
+/**
+ * \file
+ *         Link layer encryption and authentication
+ *
+ *         With LINK_SEC_CONF_ENABLED set, every frame is secured with
+ *         AES-CCM under the network key LINK_SEC_CONF_KEY, on the AES
+ *         engine of the CC1312R. Encryption and decryption run in place
+ *         in the frame buffer: the plaintext never exists anywhere else,
+ *         and forwarded frames are decrypted and encrypted again in the
+ *         buffer they arrived in.
+ *
+ *         A secured frame is laid out as
+ *         [link header] [encrypted data] [frame counter (4)] [MIC]
+ *         with LINK_FLAG_SECURED set in the header, which is authenticated
+ *         along with the data. The nonce is built after IEEE 802.15.4 from
+ *         the source address and the frame counter, and a neighbor only
+ *         accepts counters above the last one it took from the sender,
+ *         see neighbor_check_counter().
+ *
+ *         The frame counter goes on across resets: blocks of
+ *         LINK_SEC_COUNTER_BLOCK values are reserved in flash, see
+ *         persist.h, before the first of them is used, and a reset skips
+ *         to the next block. Receivers keep taking the frames of a rebooted
+ *         neighbor, and save the counters they took in blocks too, see
+ *         NEIGHBOR_COUNTER_BLOCK. The key must be changed before a counter
+ *         value can repeat. Without the flash, or when a block cannot be saved,
+ *         encryption fails and nothing is sent.
+ */
+#ifndef LINK_SEC_H
+#define LINK_SEC_H
+
+#include "contiki.h"
+#include "frame-pool.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------*/
+#ifdef LINK_SEC_CONF_ENABLED
+#define LINK_SEC_ENABLED LINK_SEC_CONF_ENABLED
+#else
+#define LINK_SEC_ENABLED 0
+#endif
+
+/** Bytes of the message integrity code, 4, 8 or 16 */
+#ifdef LINK_SEC_CONF_MIC_LEN
+#define LINK_SEC_MIC_LEN LINK_SEC_CONF_MIC_LEN
+#else
+#define LINK_SEC_MIC_LEN 8
+#endif
+
+/** Frame counter values reserved in flash at a time */
+#ifdef LINK_SEC_CONF_COUNTER_BLOCK
+#define LINK_SEC_COUNTER_BLOCK LINK_SEC_CONF_COUNTER_BLOCK
+#else
+#define LINK_SEC_COUNTER_BLOCK 1024
+#endif
+
+#define LINK_SEC_KEY_LEN     16
+#define LINK_SEC_COUNTER_LEN 4
+
+/** Bytes a secured frame carries on top of its data */
+#if LINK_SEC_ENABLED
+#define LINK_SEC_OVERHEAD (LINK_SEC_COUNTER_LEN + LINK_SEC_MIC_LEN)
+#else
+#define LINK_SEC_OVERHEAD 0
+#endif
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Open the AES engine, load the network key and restore the frame
+ *        counter. Only needed with LINK_SEC_ENABLED.
+ * \return 0 on success, -1 if the crypto driver could not be opened.
+ */
+int link_sec_init(void);
+
+/**
+ * \brief Secure a frame in place.
+ *
+ * The link header must already be written, with LINK_FLAG_SECURED set.
+ *
+ * \param frame Frame with data_len bytes of data at link_data()
+ * \return 0 on success with frame->len covering the secured frame, -1 on
+ *         error or when the next block of frame counters could not be
+ *         saved.
+ */
+int link_sec_encrypt(struct frame *frame, uint16_t data_len);
+
+/**
+ * \brief Authenticate and decrypt a received frame in place.
+ * \param counter Set to the frame counter of the frame
+ * \return 0 on success with frame->len trimmed to header and data, -1 if
+ *         the frame is malformed or does not authenticate.
+ */
+int link_sec_decrypt(struct frame *frame, uint32_t *counter);
+/*---------------------------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LINK_SEC_H */
@@ -0,0 +1,260 @@
+/**
+ * \file
+ *         Link layer framing
+ */
+#include "contiki.h"
+#include "link.h"
+#include "chan.h"
+#include "compress.h"
+#include "frag.h"
+#include "frame-pool.h"
+#include "link-sec.h"
+#include "log-ring.h"
+#include "mesh.h"
+#include "neighbor.h"
+#include "power-ctrl.h"
+#include "route.h"
+#include "rf-core.h"
+#include "slots.h"
+#include "stats.h"
+#include "store.h"
+#include "tx-sched.h"
+
+#include <string.h>
+/*---------------------------------------------------------------------------*/
+static link_input_callback_t input_callback;
+static uint8_t seqno;
+/*---------------------------------------------------------------------------*/
+static void
+deliver_aggregate(const struct link_hdr *hdr, const uint8_t *data,
+                  uint16_t len)
+{
+  uint16_t sublen;
+
+  while(len > 0) {
+    sublen = data[0];
+    if(sublen == 0 || sublen + 1 > len) {
+      LOG_RECORD(LINK_BAD_AGGREGATE, len);
+      return;
+    }
+
+    input_callback(hdr, data + 1, sublen);
+
+    data += sublen + 1;
+    len -= sublen + 1;
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+link_set_input_callback(link_input_callback_t callback)
+{
+  input_callback = callback;
+}
+/*---------------------------------------------------------------------------*/
+int
+link_parse(const struct frame *frame, struct link_hdr *hdr)
+{
+  const uint8_t *p = frame_payload(frame);
+
+  if(frame->len < LINK_HDR_LEN) {
+    return -1;
+  }
+
+  hdr->rx_meta = &frame->meta;
+  hdr->type = p[0] & LINK_TYPE_MASK;
+  hdr->flags = p[0] & ~LINK_TYPE_MASK;
+  hdr->seqno = p[1];
+  memcpy(&hdr->dst, &p[2], LINKADDR_SIZE);
+  memcpy(&hdr->src, &p[2 + LINKADDR_SIZE], LINKADDR_SIZE);
+
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+link_input(struct frame *frame)
+{
+  struct link_hdr hdr;
+  struct frame *plain = NULL;
+  const uint8_t *data;
+  uint16_t len;
+  int ret;
+#if LINK_SEC_ENABLED
+  uint32_t counter;
+#endif
+
+  if(link_parse(frame, &hdr) != 0) {
+    LOG_RECORD(LINK_RUNT, frame->len);
+    STATS_INC(DROP_RUNT);
+    frame_pool_free(frame);
+    return;
+  }
+
+#if LINK_SEC_ENABLED
+  if(!(hdr.flags & LINK_FLAG_SECURED) ||
+     link_sec_decrypt(frame, &counter) != 0) {
+    LOG_RECORD(LINK_UNSECURED, hdr.src.u16, hdr.flags);
+    STATS_INC(DROP_UNSECURED);
+    frame_pool_free(frame);
+    return;
+  }
+
+  /* Before the update, a replayed frame must neither move the link
+   * metrics nor take the entry of a neighbor */
+  if(neighbor_check_counter(&hdr.src, counter) != 0) {
+    LOG_RECORD(LINK_REPLAY, hdr.src.u16, counter);
+    STATS_INC(DROP_REPLAY);
+    frame_pool_free(frame);
+    return;
+  }
+#endif
+
+  /* Whoever the frame is for, it tells how well we hear its sender */
+  neighbor_update(&hdr.src, hdr.seqno,
+                  linkaddr_cmp(&hdr.dst, &linkaddr_null), hdr.rx_meta);
+
+#if LINK_SEC_ENABLED
+  /* Only after the update, which adds senders not known yet */
+  neighbor_set_counter(&hdr.src, counter);
+#endif
+
+  /* Payloads held for the sender can go now */
+  store_neighbor_input(&hdr.src);
+  chan_heard();
+
+#if TX_SCHED_MODE == TX_SCHED_MODE_SLOTTED
+  /* Frames of the time source keep the slots in line, whoever they are for */
+  slots_input(&hdr);
+#endif
+
+  if(!linkaddr_cmp(&hdr.dst, &linkaddr_node_addr) &&
+     !linkaddr_cmp(&hdr.dst, &linkaddr_null)) {
+    frame_pool_free(frame);
+    return;
+  }
+
+#if TX_SCHED_MODE == TX_SCHED_MODE_SLOTTED
+  if(hdr.type == LINK_TYPE_BEACON) {
+    slots_beacon_input(frame, &hdr);
+    return;
+  }
+#endif
+
+#if CHAN_ENABLED
+  if(hdr.type == LINK_TYPE_CHANNEL) {
+    chan_input(frame, &hdr);
+    return;
+  }
+#endif
+
+  if(hdr.type == LINK_TYPE_FLOOD) {
+    /* Floods are forwarded even without anyone listening here */
+    mesh_input(frame, &hdr);
+    return;
+  }
+
+  if(hdr.type == LINK_TYPE_ROUTE || hdr.type == LINK_TYPE_ROUTED) {
+    route_input(frame, &hdr);
+    return;
+  }
+
+  if(hdr.type == LINK_TYPE_FRAG) {
+    frag_input(frame, &hdr);
+    return;
+  }
+
+  data = link_data(frame);
+  len = frame->len - LINK_HDR_LEN;
+
+  if(input_callback != NULL && (hdr.flags & LINK_FLAG_COMPRESSED)) {
+    /* Delivered out of a second frame, the header still points at this one */
+    plain = frame_pool_alloc();
+    ret = plain != NULL ?
+      decompress(data, len, link_data(plain), LINK_MAX_DATA_LEN) : -1;
+    if(ret < 0) {
+      LOG_RECORD(LINK_BAD_COMPRESSED, hdr.src.u16, len);
+      STATS_INC(DROP_DECOMPRESS);
+      if(plain != NULL) {
+        frame_pool_free(plain);
+      }
+      frame_pool_free(frame);
+      return;
+    }
+    data = link_data(plain);
+    len = ret;
+  }
+
+  if(input_callback != NULL) {
+    switch(hdr.type) {
+    case LINK_TYPE_DATA:
+      input_callback(&hdr, data, len);
+      break;
+    case LINK_TYPE_AGGREGATE:
+      deliver_aggregate(&hdr, data, len);
+      break;
+    default:
+      LOG_RECORD(LINK_UNKNOWN_TYPE, hdr.type);
+      break;
+    }
+  }
+
+  if(plain != NULL) {
+    frame_pool_free(plain);
+  }
+  frame_pool_free(frame);
+}
+/*---------------------------------------------------------------------------*/
+int
+link_send(struct frame *frame, uint8_t type, const linkaddr_t *dst,
+          uint16_t data_len, uint8_t tx_class)
+{
+  uint8_t *p = frame_payload(frame);
+
+  if(data_len > LINK_MAX_DATA_LEN) {
+    frame_pool_free(frame);
+    return -1;
+  }
+
+  /* Sequence number and source are only filled in by link_seal() */
+  p[0] = type;
+  memcpy(&p[2], dst, LINKADDR_SIZE);
+  frame->len = LINK_HDR_LEN + data_len;
+
+  return tx_sched_send(frame, tx_class);
+}
+/*---------------------------------------------------------------------------*/
+int
+link_seal(struct frame *frame)
+{
+  uint8_t *p = frame_payload(frame);
+
+  p[1] = seqno++;
+  memcpy(&p[2 + LINKADDR_SIZE], &linkaddr_node_addr, LINKADDR_SIZE);
+
+#if LINK_SEC_ENABLED
+  p[0] |= LINK_FLAG_SECURED;
+  return link_sec_encrypt(frame, frame->len - LINK_HDR_LEN);
+#else
+  return 0;
+#endif
+}
+/*---------------------------------------------------------------------------*/
+int
+link_transmit(struct frame *frame)
+{
+  linkaddr_t dst;
+
+  memcpy(&dst, &frame_payload(frame)[2], LINKADDR_SIZE);
+
+  return rf_core_transmit_at(frame, power_ctrl_tx_power(&dst));
+}
+/*---------------------------------------------------------------------------*/
+int
+link_transmit_scheduled(struct frame *frame, uint32_t start)
+{
+  linkaddr_t dst;
+
+  memcpy(&dst, &frame_payload(frame)[2], LINKADDR_SIZE);
+
+  return rf_core_transmit_scheduled(frame, power_ctrl_tx_power(&dst), start);
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,154 @@
+/**
+ * \file
+ *         Link layer framing
+ *
+ *         Every frame starts with a fixed link header followed by the data
+ *         of the layer above. Frames are built and parsed in place in frame
+ *         pool buffers.
+ *
+ *         Header layout, little endian:
+ *         [type and flags (1)] [seqno (1)] [destination] [source]
+ *
+ *         A null destination address means broadcast. With link security
+ *         enabled the data is encrypted and followed by the fields listed
+ *         in link-sec.h.
+ */
+#ifndef LINK_H
+#define LINK_H
+
+#include "contiki.h"
+#include "frame-pool.h"
+#include "link-sec.h"
+#include "tx-sched.h"
+#include "net/linkaddr.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------*/
+#define LINK_HDR_LEN               (2 + 2 * LINKADDR_SIZE)
+
+/** Longest frame of the radio configuration, see radio-config.hpp */
+#if defined(RADIO_CONF_MAX_FRAME_LEN) && \
+    RADIO_CONF_MAX_FRAME_LEN < FRAME_MAX_LEN
+#define LINK_MAX_FRAME_LEN         RADIO_CONF_MAX_FRAME_LEN
+#else
+#define LINK_MAX_FRAME_LEN         FRAME_MAX_LEN
+#endif
+
+#define LINK_MAX_DATA_LEN          (LINK_MAX_FRAME_LEN - LINK_HDR_LEN - \
+                                    LINK_SEC_OVERHEAD)
+
+/** Frame types, low bits of the first header byte */
+#define LINK_TYPE_MASK             0x07
+#define LINK_TYPE_DATA             0x00
+/** Several upper layer payloads, each prefixed with its length */
+#define LINK_TYPE_AGGREGATE        0x01
+/** Mesh flood, see mesh.h */
+#define LINK_TYPE_FLOOD            0x02
+/** Route discovery control message, see route.h */
+#define LINK_TYPE_ROUTE            0x03
+/** Payload routed over several hops, see route.h */
+#define LINK_TYPE_ROUTED           0x04
+/** Fragment of a message or its acknowledgement, see frag.h */
+#define LINK_TYPE_FRAG             0x05
+/** Slot timing of the slotted MAC mode, see slots.h */
+#define LINK_TYPE_BEACON           0x06
+/** Channel migration announcement, see chan.h */
+#define LINK_TYPE_CHANNEL          0x07
+
+/** Flags, high bits of the first header byte */
+/** Data encrypted and authenticated, see link-sec.h */
+#define LINK_FLAG_SECURED          0x08
+/** Data compressed, DATA and AGGREGATE frames only, see compress.h */
+#define LINK_FLAG_COMPRESSED       0x10
+
+/** Pointer to the data following the link header */
+#define link_data(f) (frame_payload(f) + LINK_HDR_LEN)
+/*---------------------------------------------------------------------------*/
+struct link_hdr {
+  /** RF core metadata of the frame, NULL for frames not received */
+  const struct frame_rx_meta *rx_meta;
+  uint8_t type;
+  uint8_t flags;
+  uint8_t seqno;
+  linkaddr_t dst;
+  linkaddr_t src;
+};
+
+/**
+ * Upper layer input function, called once per received payload.
+ * Aggregated frames result in one call per payload they carry. Data is
+ * only valid for the duration of the call.
+ */
+typedef void (*link_input_callback_t)(const struct link_hdr *hdr,
+                                      const uint8_t *data, uint16_t len);
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Set the function receiving payloads addressed to this node.
+ */
+void link_set_input_callback(link_input_callback_t callback);
+
+/**
+ * \brief Process a frame received by the RF core, then free it.
+ *
+ * Suitable as the RF core input callback.
+ */
+void link_input(struct frame *frame);
+
+/**
+ * \brief Write the link header and queue a frame for transmission.
+ *
+ * Ownership of the frame passes to the TX scheduler, which frees it once
+ * sent. It is freed right away on error.
+ *
+ * \param frame Frame with data_len bytes of data at link_data()
+ * \param type One of the LINK_TYPE_* values, optionally or-ed with flags
+ * \param dst Destination, &linkaddr_null for broadcast
+ * \param data_len Length of the data following the header
+ * \param tx_class Traffic class, one of the TX_CLASS_* values of tx-sched.h
+ * \return 0 if the frame was queued, -1 if it was dropped.
+ */
+int link_send(struct frame *frame, uint8_t type, const linkaddr_t *dst,
+              uint16_t data_len, uint8_t tx_class);
+
+/**
+ * \brief Give a queued frame its sequence number and secure it.
+ *
+ * Called by the TX scheduler once per frame, right before its first
+ * transmission attempt, so frames go on air in counter order.
+ *
+ * \return 0 on success, -1 on error.
+ */
+int link_seal(struct frame *frame);
+
+/**
+ * \brief Start transmitting a sealed frame at the TX power of its
+ *        destination.
+ * \return What rf_core_transmit_at() returns. The caller keeps the frame,
+ *         the TX callback of rf-core.h tells when it is done with it.
+ */
+int link_transmit(struct frame *frame);
+
+/**
+ * \brief Transmit a sealed frame like link_transmit(), starting at a given
+ *        RF core time.
+ * \return What rf_core_transmit_scheduled() returns.
+ */
+int link_transmit_scheduled(struct frame *frame, uint32_t start);
+
+/**
+ * \brief Parse the link header at the start of a received frame.
+ * \return 0 on success, -1 if the frame is too short.
+ */
+int link_parse(const struct frame *frame, struct link_hdr *hdr);
+/*---------------------------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LINK_H */
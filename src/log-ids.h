@@ -0,0 +1,70 @@
+/**
+ * \file
+ *         Binary log record identifiers
+ *
+ *         Every record written with LOG_RECORD() carries one of these IDs
+ *         and up to LOG_RING_MAX_ARGS 32-bit arguments. The format strings
+ *         never reach the firmware image, tools/log-decode.py reads them
+ *         from this file to format records on the host.
+ *
+ *         Only append to this list, reordering it breaks decoding of logs
+ *         captured from older images.
+ */
+#ifndef LOG_IDS_H
+#define LOG_IDS_H
+
+#define LOG_RING_IDS(X) \
+  X(LOG_DROPPED, "log ring overflow, %u records dropped") \
+  X(BOOT,        "boot complete") \
+  X(RX_FRAME,    "rx len=%u rssi=%d status=0x%x") \
+  X(TX_FRAME,    "tx len=%u result=%d") \
+  X(LINK_RUNT,   "link: runt frame, %u bytes") \
+  X(LINK_UNKNOWN_TYPE, "link: unknown frame type %u") \
+  X(LINK_BAD_AGGREGATE, "link: malformed aggregate, %u bytes left") \
+  X(TX_QUEUE_FLUSH, "txq: flush payloads=%u bytes=%u result=%d") \
+  X(TX_QUEUE_DROP, "txq: dropped %u byte payload") \
+  X(APP_RX,      "app: rx from 0x%04x, %u bytes") \
+  X(APP_HOST_DROP, "app: host link full, dropped %u bytes from 0x%04x") \
+  X(RF_SNIFF_INTERVAL, "rf: sniff interval %u ms") \
+  X(NEIGHBOR_NEW, "nbr: new neighbor 0x%04x rssi=%d") \
+  X(NEIGHBOR_EVICT, "nbr: evicted stalest neighbor 0x%04x") \
+  X(MESH_FORWARD, "mesh: rebroadcast seqno=%u result=%d") \
+  X(ROUTE_DISCOVERED, "route: 0x%04x via 0x%04x, %u hops, sent %u parked") \
+  X(ROUTE_DISCOVERY_FAILED, "route: no reply from 0x%04x, %u parked, %u held") \
+  X(ROUTE_NO_ROUTE, "route: cannot forward to 0x%04x, %u hops left") \
+  X(ROUTE_EXPIRED, "route: 0x%04x expired") \
+  X(LINK_UNSECURED, "link: dropped unauthenticated frame from 0x%04x, flags 0x%x") \
+  X(LINK_REPLAY, "link: dropped replayed frame from 0x%04x, counter %u") \
+  X(FRAG_SENT,   "frag: message to 0x%04x, %u bytes, %u retries, result=%d") \
+  X(FRAG_TIMEOUT, "frag: gave up message 0x%04x/%u, had fragments 0x%08x") \
+  X(FRAG_BAD,    "frag: bad fragment from 0x%04x, %u of %u, %u bytes") \
+  X(FRAG_NO_BUFFER, "frag: no buffer for message 0x%04x/%u") \
+  X(TX_SCHED_DROP, "txs: class %u queue full, dropped %u byte frame") \
+  X(TX_SCHED_BUSY, "txs: channel busy, dropped class %u frame of %u bytes") \
+  X(PERSIST_RESTORED, "persist: restored type %u, %u bytes") \
+  X(PERSIST_COMPACTED, "persist: bank %u generation %u, %u bytes kept") \
+  X(PERSIST_FAILED, "persist: could not save type %u, %u bytes") \
+  X(OTA_BEGIN, "ota: session %u, %u byte image from a %u byte delta") \
+  X(OTA_DONE, "ota: session %u, %u byte image written") \
+  X(OTA_FAILED, "ota: session %u failed at image byte %u") \
+  X(LINK_BAD_COMPRESSED, "link: dropped compressed frame from 0x%04x, %u bytes") \
+  X(SLOTS_TIME_SOURCE, "slots: time from 0x%04x, root 0x%04x, %u hops") \
+  X(SLOTS_SOURCE_LOST, "slots: lost time source 0x%04x, now root") \
+  X(STORE_HELD, "store: holding %u bytes for 0x%04x, %u held") \
+  X(STORE_FLUSH, "store: 0x%04x reachable via 0x%04x, sending %u held") \
+  X(CHAN_SCAN, "chan: channel %u, %u of %u samples busy, floor %d dBm") \
+  X(CHAN_ANNOUNCE, "chan: epoch %u from 0x%04x, channel %u in %u ms") \
+  X(CHAN_SWITCH, "chan: channel %u to %u, epoch %u") \
+  X(CHAN_SEARCH, "chan: no frames heard, trying channel %u") \
+  X(MONITOR_STALL, "monitor: loop ran %u us late, budget %u us, captured=%u") \
+  X(MONITOR_FAULT_KEPT, "monitor: kept %u us stall in process 0x%08x, flags 0x%x, %u captures") \
+  X(TX_SCHED_DUTY, "txs: duty cycle, held class %u frame of %u bytes for %u ticks")
+
+#define LOG_RING_ID_ENUM(name, fmt) LOG_ID_##name,
+enum {
+  LOG_RING_IDS(LOG_RING_ID_ENUM)
+  LOG_ID_COUNT
+};
+#undef LOG_RING_ID_ENUM
+
+#endif /* LOG_IDS_H */
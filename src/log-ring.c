@@ -0,0 +1,148 @@
+/**
+ * \file
+ *         Deferred binary logging
+ */
+#include "contiki.h"
+#include "log-ring.h"
+#include "host-link.h"
+#include "arena.h"
+
+#include <string.h>
+/*---------------------------------------------------------------------------*/
+#define RECORD_HDR_LEN 8
+#define RING_MASK      (LOG_RING_SIZE - 1)
+/* A chunk as host_link_send() reserves it: command, data and CRC (2) all
+ * escaped, and both flags */
+#define CHUNK_WORST    (2 * (1 + LOG_RING_CHUNK + 2) + 2)
+/*---------------------------------------------------------------------------*/
+_Static_assert(LOG_RING_SIZE <= ARENA_QUOTA_LOG_RING,
+               "LOG_RING_CONF_SIZE does not fit in ARENA_CONF_QUOTA_LOG_RING");
+/* Otherwise the drain waits for room that never comes */
+_Static_assert(LOG_RING_CHUNK <= HOST_LINK_MAX_FRAME_LEN &&
+               CHUNK_WORST <= HOST_LINK_TX_BUF_SIZE,
+               "LOG_RING_CONF_CHUNK does not fit in a host link frame");
+
+static uint8_t *ring;
+
+/* Free running indexes, head is only written by the producer and tail
+ * only by the consumer */
+static volatile uint16_t head;
+static volatile uint16_t tail;
+
+static uint32_t dropped;
+/* Set while the drain waits for room in the host link TX ring */
+static volatile uint8_t waiting;
+/*---------------------------------------------------------------------------*/
+PROCESS(log_ring_process, "Log ring drain process");
+/*---------------------------------------------------------------------------*/
+static void
+put(uint16_t at, const void *src, uint16_t len)
+{
+  const uint8_t *bytes = src;
+  uint16_t i;
+
+  for(i = 0; i < len; i++) {
+    ring[(at + i) & RING_MASK] = bytes[i];
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+append(uint16_t id, uint8_t nargs, const uint32_t *args)
+{
+  const uint16_t len = RECORD_HDR_LEN + nargs * sizeof(uint32_t);
+  const uint16_t at = head;
+  uint8_t hdr[RECORD_HDR_LEN];
+  rtimer_clock_t now = RTIMER_NOW();
+
+  if((uint16_t)(LOG_RING_SIZE - (uint16_t)(at - tail)) < len) {
+    return 0;
+  }
+
+  hdr[0] = LOG_RING_MAGIC;
+  hdr[1] = id & 0xFF;
+  hdr[2] = id >> 8;
+  hdr[3] = nargs;
+  memcpy(&hdr[4], &now, sizeof(uint32_t));
+
+  put(at, hdr, sizeof(hdr));
+  put(at + RECORD_HDR_LEN, args, nargs * sizeof(uint32_t));
+
+  /* The record must be complete before the consumer can see it */
+  __sync_synchronize();
+  head = at + len;
+
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+log_ring_init(void)
+{
+  ring = arena_alloc(ARENA_LOG_RING, LOG_RING_SIZE);
+  head = 0;
+  tail = 0;
+  dropped = 0;
+  waiting = 0;
+
+  process_start(&log_ring_process, NULL);
+}
+/*---------------------------------------------------------------------------*/
+void
+log_ring_write(uint16_t id, uint8_t nargs, const uint32_t *args)
+{
+  if(nargs > LOG_RING_MAX_ARGS) {
+    nargs = LOG_RING_MAX_ARGS;
+  }
+
+  if(dropped > 0) {
+    if(!append(LOG_ID_LOG_DROPPED, 1, &dropped)) {
+      dropped++;
+      return;
+    }
+    dropped = 0;
+  }
+
+  if(!append(id, nargs, args)) {
+    dropped++;
+    return;
+  }
+
+  /* The host link polls the drain once it has room again */
+  if(!waiting) {
+    process_poll(&log_ring_process);
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(log_ring_process, ev, data)
+{
+  static uint16_t len;
+
+  PROCESS_BEGIN();
+
+  while(1) {
+    PROCESS_YIELD_UNTIL(ev == PROCESS_EVENT_POLL);
+
+    while(head != tail) {
+      /* Send at most one chunk, never wrapping around the end of the ring,
+       * and give every other process a turn before the next one. Records
+       * may straddle chunks, the host reassembles the stream. */
+      len = MIN((uint16_t)(head - tail), LOG_RING_CHUNK);
+      len = MIN(len, LOG_RING_SIZE - (tail & RING_MASK));
+
+      if(host_link_send(HOST_CMD_LOG, &ring[tail & RING_MASK], len,
+                        NULL, 0) != 0) {
+        /* Host link TX buffer is full, come back once it has drained */
+        waiting = 1;
+        host_link_poll_when_drained(&log_ring_process);
+        PROCESS_YIELD_UNTIL(ev == PROCESS_EVENT_POLL);
+        waiting = 0;
+        continue;
+      }
+      tail += len;
+
+      PROCESS_PAUSE();
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
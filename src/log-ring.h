@@ -0,0 +1,87 @@
+/**
+ * \file
+ *         Deferred binary logging
+ *
+ *         LOG_RECORD() only copies an ID, a timestamp and a few words into
+ *         a ring buffer, it never touches the UART. log_ring_process drains
+ *         the ring to the host link in HOST_CMD_LOG frames of at most
+ *         LOG_RING_CHUNK bytes, yielding between them so the radio processes
+ *         keep running while the log is written out. A turn of the drain
+ *         only copies one chunk, escaped, into the host link TX ring, which
+ *         the UART driver writes out from its interrupts: the drain never
+ *         waits for the UART. When the TX ring is full it waits for the
+ *         host link to poll it once there is room, and records written
+ *         meanwhile leave it alone.
+ *
+ *         Record layout, little endian:
+ *         [LOG_RING_MAGIC] [id (2)] [argument count (1)] [RTIMER timestamp (4)]
+ *         [arguments (4 each)]
+ */
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include "contiki.h"
+#include "log-ids.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------*/
+/** Ring buffer size in bytes, must be a power of two */
+#ifdef LOG_RING_CONF_SIZE
+#define LOG_RING_SIZE LOG_RING_CONF_SIZE
+#else
+#define LOG_RING_SIZE 512
+#endif
+
+/** Largest number of bytes sent per HOST_CMD_LOG frame */
+#ifdef LOG_RING_CONF_CHUNK
+#define LOG_RING_CHUNK LOG_RING_CONF_CHUNK
+#else
+#define LOG_RING_CHUNK 64
+#endif
+
+#define LOG_RING_MAGIC    0xA5
+#define LOG_RING_MAX_ARGS 4
+
+#if (LOG_RING_SIZE & (LOG_RING_SIZE - 1)) != 0
+#error "LOG_RING_SIZE must be a power of two"
+#endif
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Log a record with up to LOG_RING_MAX_ARGS integer arguments.
+ *
+ * Records that do not fit are dropped and accounted for by a
+ * LOG_ID_LOG_DROPPED record once there is room again.
+ */
+#define LOG_RECORD(id, ...) do { \
+    const uint32_t log_ring_args_[] = { 0, ##__VA_ARGS__ }; \
+    log_ring_write(LOG_ID_##id, \
+                   sizeof(log_ring_args_) / sizeof(log_ring_args_[0]) - 1, \
+                   &log_ring_args_[1]); \
+  } while(0)
+/*---------------------------------------------------------------------------*/
+PROCESS_NAME(log_ring_process);
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Reset the ring and start the drain process.
+ */
+void log_ring_init(void);
+
+/**
+ * \brief Append one record, see LOG_RECORD().
+ *
+ * Must only be called from the Contiki thread context, the ring has a
+ * single producer.
+ */
+void log_ring_write(uint16_t id, uint8_t nargs, const uint32_t *args);
+/*---------------------------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LOG_RING_H */
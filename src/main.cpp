@@ -32,35 +32,544 @@
 
 /**
  * \file
- *         A very simple Contiki application showing how Contiki programs look
- * \author
- *         Adam Dunkels <adam@sics.se>
+ *         Radio firmware application core
  */
 
+extern "C" {
 #include "contiki.h"
+#include "sys/log.h"
+}
+
+#include "byteorder.h"
+#include "chan.h"
+#include "compress.h"
+#include "frag.h"
+#include "frame-pool.h"
+#include "host-link.h"
+#include "link.h"
+#include "link-sec.h"
+#include "log-ring.h"
+#include "mesh.h"
+#include "monitor.h"
+#include "neighbor.h"
+#include "ota.h"
+#include "persist.h"
+#include "power-ctrl.h"
+#include "prof.h"
+#include "radio-config.hpp"
+#include "rf-core.h"
+#include "route.h"
+#include "slots.h"
+#include "stats.h"
+#include "store.h"
+#include "tx-queue.h"
+#include "tx-sched.h"
+
+#include <string.h>
+
+#define LOG_MODULE "App"
+#define LOG_LEVEL LOG_LEVEL_APP
+
+namespace
+{
+
+using Radio = radio::ActiveConfig;
+
+constexpr rf_core_params rf_params = radio::rfCoreParams<Radio>();
+
+static_assert(TX_SCHED_MODE != TX_SCHED_MODE_SLOTTED ||
+                  SLOTS_TX_OFFSET + Radio::airtimeUs(Radio::max_frame_len) <
+                      SLOTS_SLOT_LEN,
+              "the largest frame does not fit in a slot");
+static_assert(!CHAN_ENABLED ||
+                  (Radio::channel >= CHAN_FIRST &&
+                   (Radio::channel - CHAN_FIRST) % CHAN_STRIDE == 0 &&
+                   (Radio::channel - CHAN_FIRST) / CHAN_STRIDE < CHAN_COUNT),
+              "the boot channel is not a candidate channel");
+static_assert(!CHAN_ENABLED ||
+                  CHAN_FIRST + (CHAN_COUNT - 1) * CHAN_STRIDE <
+                      Radio::Plan::channel_count,
+              "candidate channels are outside of the band plan");
+static_assert(Radio::max_frame_len == LINK_MAX_FRAME_LEN,
+              "link payloads are not sized for the largest frame");
+
+/** Message data per HOST_CMD_RECV_MESSAGE chunk */
+constexpr uint16_t message_chunk_len = 240;
+
+class Application
+{
+public:
+    int init();
+    void input(const struct link_hdr *hdr, const uint8_t *data, uint16_t len);
+    void messageInput(const struct link_hdr *hdr, const uint8_t *data,
+                      uint16_t len);
+    void messageSent(const linkaddr_t *dst, int status);
+
+    void hostSendFrame(const uint8_t *args, uint16_t len);
+    void hostFlood(const uint8_t *args, uint16_t len);
+    void hostRouteSend(const uint8_t *args, uint16_t len);
+    void hostSendMessage(uint8_t cmd, const uint8_t *args, uint16_t len);
+    void hostConfigGet(const uint8_t *args, uint16_t len);
+    void hostConfigSet(const uint8_t *args, uint16_t len);
+
+private:
+    bool getParam(uint8_t param, uint32_t &value);
+    uint8_t setParam(uint8_t param, uint32_t value);
+
+    /**
+     * Message being passed on by the host, see HOST_CMD_SEND_MESSAGE and
+     * HOST_CMD_OTA_SEND
+     */
+    uint8_t message_cmd_ = HOST_CMD_SEND_MESSAGE;
+    linkaddr_t message_dst_;
+    uint16_t message_len_ = 0;
+    uint16_t message_offset_ = 0;
+};
+
+Application app;
+
+void inputCallback(const struct link_hdr *hdr, const uint8_t *data,
+                   uint16_t len)
+{
+    app.input(hdr, data, len);
+}
+
+void messageInputCallback(const struct link_hdr *hdr, const uint8_t *data,
+                          uint16_t len)
+{
+    app.messageInput(hdr, data, len);
+}
+
+void messageSentCallback(const linkaddr_t *dst, int status)
+{
+    app.messageSent(dst, status);
+}
+
+void sendFrameCallback(const uint8_t *args, uint16_t len)
+{
+    app.hostSendFrame(args, len);
+}
+
+void floodCallback(const uint8_t *args, uint16_t len)
+{
+    app.hostFlood(args, len);
+}
+
+void routeSendCallback(const uint8_t *args, uint16_t len)
+{
+    app.hostRouteSend(args, len);
+}
+
+void sendMessageCallback(const uint8_t *args, uint16_t len)
+{
+    app.hostSendMessage(HOST_CMD_SEND_MESSAGE, args, len);
+}
+
+void otaSendCallback(const uint8_t *args, uint16_t len)
+{
+    app.hostSendMessage(HOST_CMD_OTA_SEND, args, len);
+}
+
+void configGetCallback(const uint8_t *args, uint16_t len)
+{
+    app.hostConfigGet(args, len);
+}
+
+void configSetCallback(const uint8_t *args, uint16_t len)
+{
+    app.hostConfigSet(args, len);
+}
+
+host_link_handler send_frame_handler = {
+    nullptr, HOST_CMD_SEND_FRAME, sendFrameCallback
+};
+host_link_handler flood_handler = {
+    nullptr, HOST_CMD_FLOOD, floodCallback
+};
+host_link_handler route_send_handler = {
+    nullptr, HOST_CMD_ROUTE_SEND, routeSendCallback
+};
+host_link_handler send_message_handler = {
+    nullptr, HOST_CMD_SEND_MESSAGE, sendMessageCallback
+};
+host_link_handler ota_send_handler = {
+    nullptr, HOST_CMD_OTA_SEND, otaSendCallback
+};
+host_link_handler config_get_handler = {
+    nullptr, HOST_CMD_CONFIG_GET, configGetCallback
+};
+host_link_handler config_set_handler = {
+    nullptr, HOST_CMD_CONFIG_SET, configSetCallback
+};
+
+int Application::init()
+{
+    /* Ahead of every module that counts */
+    stats_init();
+    log_ring_init();
+    /* Ahead of every module that restores its state */
+    if (persist_init() != 0)
+    {
+        LOG_WARN("NVS region unusable, starting from scratch\n");
+#if LINK_SEC_ENABLED
+        LOG_WARN("No frame counter storage, secured frames refused\n");
+#endif
+    }
+    frame_pool_init();
+    neighbor_init();
+    mesh_init();
+    route_init();
+    store_init();
+    frag_init();
+    if (ota_init() != 0)
+    {
+        LOG_WARN("No secondary slot or update key, updates refused\n");
+    }
+    compress_init();
+    tx_queue_init();
+    tx_sched_init();
+
+    if (host_link_init() != 0)
+    {
+        return -1;
+    }
+#if LINK_SEC_ENABLED
+    /* Frames in the clear need no crypto driver */
+    if (link_sec_init() != 0)
+    {
+        return -1;
+    }
+#endif
+    prof_init();
+    monitor_init();
+    host_link_register(&send_frame_handler);
+    host_link_register(&flood_handler);
+    host_link_register(&route_send_handler);
+    host_link_register(&send_message_handler);
+    host_link_register(&ota_send_handler);
+    host_link_register(&config_get_handler);
+    host_link_register(&config_set_handler);
+
+    link_set_input_callback(inputCallback);
+    mesh_set_input_callback(inputCallback);
+    route_set_input_callback(inputCallback);
+    frag_set_input_callback(FRAG_PORT_APP, messageInputCallback);
+    frag_set_sent_callback(FRAG_PORT_APP, messageSentCallback);
+    rf_core_set_input_callback(link_input);
+    if (rf_core_init(&rf_params) != 0)
+    {
+        return -1;
+    }
+#if TX_SCHED_MODE == TX_SCHED_MODE_SLOTTED
+    slots_init(rf_params.sync_us);
+#endif
+    if (chan_init() != 0)
+    {
+        LOG_WARN("Boot channel not a candidate, channel selection off\n");
+    }
+    return 0;
+}
+
+void Application::input(const struct link_hdr *hdr, const uint8_t *data,
+                        uint16_t len)
+{
+    PROF_BEGIN(APP_INPUT);
+    uint8_t info[LINKADDR_SIZE + 1];
+
+    memcpy(info, &hdr->src, LINKADDR_SIZE);
+    info[LINKADDR_SIZE] = static_cast<uint8_t>(hdr->rx_meta->rssi);
+
+    if (host_link_send(HOST_CMD_RECV_FRAME, info, sizeof(info), data, len) != 0)
+    {
+        LOG_RECORD(APP_HOST_DROP, len, hdr->src.u16);
+        STATS_INC(DROP_HOST_LINK);
+    }
+    PROF_END(APP_INPUT);
+}
+
+void Application::messageInput(const struct link_hdr *hdr,
+                               const uint8_t *data, uint16_t len)
+{
+    uint8_t info[LINKADDR_SIZE + 4];
+    uint16_t offset;
+    uint16_t chunk;
+
+    memcpy(info, &hdr->src, LINKADDR_SIZE);
+    put_le16(&info[LINKADDR_SIZE + 2], len);
+
+    for (offset = 0; offset < len; offset += chunk)
+    {
+        chunk = MIN(len - offset, message_chunk_len);
+        put_le16(&info[LINKADDR_SIZE], offset);
+        if (host_link_send(HOST_CMD_RECV_MESSAGE, info, sizeof(info),
+                           data + offset, chunk) != 0)
+        {
+            LOG_RECORD(APP_HOST_DROP, len, hdr->src.u16);
+            STATS_INC(DROP_HOST_LINK);
+            return;
+        }
+    }
+}
+
+void Application::messageSent(const linkaddr_t *dst, int status)
+{
+    uint8_t reply[LINKADDR_SIZE + 1];
+
+    memcpy(reply, dst, LINKADDR_SIZE);
+    reply[LINKADDR_SIZE] = status == 0 ? HOST_STATUS_OK : HOST_STATUS_ERROR;
+    host_link_send(HOST_CMD_MESSAGE_SENT, reply, sizeof(reply), nullptr, 0);
+}
+
+void Application::hostSendFrame(const uint8_t *args, uint16_t len)
+{
+    linkaddr_t dst;
+
+    if (len <= LINKADDR_SIZE)
+    {
+        host_link_send_result(HOST_CMD_SEND_FRAME, HOST_STATUS_INVALID);
+        return;
+    }
+
+    memcpy(&dst, args, LINKADDR_SIZE);
+    if (tx_queue_send(&dst, args + LINKADDR_SIZE, len - LINKADDR_SIZE) != 0)
+    {
+        host_link_send_result(HOST_CMD_SEND_FRAME, HOST_STATUS_ERROR);
+        return;
+    }
+
+    host_link_send_result(HOST_CMD_SEND_FRAME, HOST_STATUS_OK);
+}
+
+void Application::hostFlood(const uint8_t *args, uint16_t len)
+{
+    if (len == 0 || len > MESH_MAX_DATA_LEN)
+    {
+        host_link_send_result(HOST_CMD_FLOOD, HOST_STATUS_INVALID);
+        return;
+    }
+
+    host_link_send_result(HOST_CMD_FLOOD, mesh_flood(args, len) == 0
+                                              ? HOST_STATUS_OK
+                                              : HOST_STATUS_ERROR);
+}
+
+void Application::hostRouteSend(const uint8_t *args, uint16_t len)
+{
+    linkaddr_t dst;
+
+    if (len <= LINKADDR_SIZE || len - LINKADDR_SIZE > ROUTE_MAX_DATA_LEN)
+    {
+        host_link_send_result(HOST_CMD_ROUTE_SEND, HOST_STATUS_INVALID);
+        return;
+    }
+
+    memcpy(&dst, args, LINKADDR_SIZE);
+    if (route_send(&dst, args + LINKADDR_SIZE, len - LINKADDR_SIZE) != 0)
+    {
+        host_link_send_result(HOST_CMD_ROUTE_SEND, HOST_STATUS_ERROR);
+        return;
+    }
+
+    host_link_send_result(HOST_CMD_ROUTE_SEND, HOST_STATUS_OK);
+}
+
+void Application::hostSendMessage(uint8_t cmd, const uint8_t *args,
+                                  uint16_t len)
+{
+    constexpr uint16_t hdr_len = LINKADDR_SIZE + 4;
+    uint8_t *buf = frag_buffer();
+    uint16_t offset;
+    uint16_t total;
+
+    if (len <= hdr_len)
+    {
+        host_link_send_result(cmd, HOST_STATUS_INVALID);
+        return;
+    }
+
+    offset = get_le16(&args[LINKADDR_SIZE]);
+    total = get_le16(&args[LINKADDR_SIZE + 2]);
+    len -= hdr_len;
+
+    if (buf == nullptr)
+    {
+        host_link_send_result(cmd, HOST_STATUS_ERROR);
+        return;
+    }
+
+    if (offset == 0)
+    {
+        message_cmd_ = cmd;
+        memcpy(&message_dst_, args, LINKADDR_SIZE);
+        message_len_ = total;
+        message_offset_ = 0;
+    }
+
+    if (total == 0 || total > FRAG_MAX_LEN || cmd != message_cmd_ ||
+        total != message_len_ || offset != message_offset_ ||
+        offset + len > total)
+    {
+        host_link_send_result(cmd, HOST_STATUS_INVALID);
+        return;
+    }
+
+    memcpy(buf + offset, args + hdr_len, len);
+    message_offset_ += len;
+
+    if (message_offset_ < total)
+    {
+        host_link_send_result(cmd, HOST_STATUS_OK);
+        return;
+    }
+
+    if (cmd == HOST_CMD_OTA_SEND &&
+        linkaddr_cmp(&message_dst_, &linkaddr_node_addr))
+    {
+        /* Updating this very node, the answer goes straight to the host */
+        host_link_send_result(cmd, HOST_STATUS_OK);
+        ota_input(&linkaddr_node_addr, buf, total);
+        return;
+    }
+
+    if (frag_send(&message_dst_,
+                  cmd == HOST_CMD_OTA_SEND ? FRAG_PORT_OTA : FRAG_PORT_APP,
+                  total) != 0)
+    {
+        host_link_send_result(cmd, HOST_STATUS_ERROR);
+        return;
+    }
+
+    host_link_send_result(cmd, HOST_STATUS_OK);
+}
+
+void Application::hostConfigGet(const uint8_t *args, uint16_t len)
+{
+    uint8_t reply[5];
+    uint32_t value;
+
+    if (len != 1)
+    {
+        host_link_send_result(HOST_CMD_CONFIG_GET, HOST_STATUS_INVALID);
+        return;
+    }
+
+    if (!getParam(args[0], value))
+    {
+        host_link_send_result(HOST_CMD_CONFIG_GET, HOST_STATUS_UNSUPPORTED);
+        return;
+    }
+
+    reply[0] = args[0];
+    put_le32(&reply[1], value);
+    host_link_send(HOST_CMD_CONFIG_VALUE, reply, sizeof(reply), nullptr, 0);
+}
+
+void Application::hostConfigSet(const uint8_t *args, uint16_t len)
+{
+    if (len != 5)
+    {
+        host_link_send_result(HOST_CMD_CONFIG_SET, HOST_STATUS_INVALID);
+        return;
+    }
+
+    host_link_send_result(HOST_CMD_CONFIG_SET,
+                          setParam(args[0], get_le32(&args[1])));
+}
+
+bool Application::getParam(uint8_t param, uint32_t &value)
+{
+    switch (param)
+    {
+    case HOST_PARAM_NODE_ADDR:
+        value = linkaddr_node_addr.u16;
+        return true;
+    case HOST_PARAM_MAX_DATA_LEN:
+        value = LINK_MAX_DATA_LEN;
+        return true;
+    case HOST_PARAM_CHANNEL:
+        value = rf_core_get_channel();
+        return true;
+    case HOST_PARAM_TX_POWER:
+        value = static_cast<uint32_t>(rf_core_get_tx_power());
+        return true;
+    case HOST_PARAM_SNIFF_INTERVAL:
+        value = rf_core_get_sniff_interval();
+        return true;
+    case HOST_PARAM_POWER_CTRL:
+        value = power_ctrl_enabled();
+        return true;
+    default:
+        return false;
+    }
+}
+
+uint8_t Application::setParam(uint8_t param, uint32_t value)
+{
+    switch (param)
+    {
+    case HOST_PARAM_TX_POWER:
+        if (static_cast<int32_t>(value) > Radio::tx_power_dbm ||
+            rf_core_set_tx_power(static_cast<int8_t>(value)) != 0)
+        {
+            return HOST_STATUS_INVALID;
+        }
+        return HOST_STATUS_OK;
+    case HOST_PARAM_SNIFF_INTERVAL:
+        /* Slots are far shorter than any sniff preamble */
+        if (value > RF_CORE_SNIFF_INTERVAL_MAX ||
+            (TX_SCHED_MODE == TX_SCHED_MODE_SLOTTED && value != 0))
+        {
+            return HOST_STATUS_INVALID;
+        }
+        if (rf_core_set_sniff_interval(static_cast<uint16_t>(value)) != 0)
+        {
+            return HOST_STATUS_ERROR;
+        }
+        tx_sched_sniff_changed();
+        monitor_sniff_changed();
+        return HOST_STATUS_OK;
+    case HOST_PARAM_POWER_CTRL:
+        if (value > 1)
+        {
+            return HOST_STATUS_INVALID;
+        }
+        power_ctrl_set_enabled(value);
+        return HOST_STATUS_OK;
+    case HOST_PARAM_NODE_ADDR:
+    case HOST_PARAM_MAX_DATA_LEN:
+    case HOST_PARAM_CHANNEL:
+        return HOST_STATUS_INVALID;
+    default:
+        return HOST_STATUS_UNSUPPORTED;
+    }
+}
+
+} // namespace
 
-#include <stdio.h> /* For printf() */
 /*---------------------------------------------------------------------------*/
-PROCESS(hello_world_process, "Hello world process");
-AUTOSTART_PROCESSES(&hello_world_process);
+extern "C" {
+PROCESS(app_process, "Radio firmware application");
+}
 /*---------------------------------------------------------------------------*/
-PROCESS_THREAD(hello_world_process, ev, data)
+PROCESS_THREAD(app_process, ev, data)
 {
-  static struct etimer timer;
-
-  PROCESS_BEGIN();
+    PROCESS_BEGIN();
 
-  /* Setup a periodic timer that expires after 10 seconds. */
-  etimer_set(&timer, CLOCK_SECOND * 10);
+    if (app.init() != 0)
+    {
+        LOG_ERR("RF core initialization failed\n");
+        PROCESS_EXIT();
+    }
 
-  while(1) {
-    printf("Hello, world\n");
+    LOG_RECORD(BOOT);
 
-    /* Wait for the periodic timer to expire and then restart the timer. */
-    PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&timer));
-    etimer_reset(&timer);
-  }
+    /* Everything from here on is driven by RF core events, the process
+     * has nothing periodic to do. */
+    while (1)
+    {
+        PROCESS_YIELD();
+    }
 
-  PROCESS_END();
+    PROCESS_END();
 }
-/*---------------------------------------------------------------------------*/
\ No newline at end of file
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,145 @@
+/**
+ * \file
+ *         Flooding of payloads to every node of the mesh
+ */
+#include "contiki.h"
+#include "mesh.h"
+#include "byteorder.h"
+#include "dup-cache.h"
+#include "frame-pool.h"
+#include "lib/list.h"
+#include "lib/random.h"
+#include "log-ring.h"
+#include "stats.h"
+
+#include <string.h>
+/*---------------------------------------------------------------------------*/
+#define HDR_ORIGIN 0
+#define HDR_SEQNO  LINKADDR_SIZE
+#define HDR_TTL    (LINKADDR_SIZE + 2)
+/*---------------------------------------------------------------------------*/
+static link_input_callback_t input_callback;
+static uint16_t seqno;
+
+/* Frames waiting for their rebroadcast, the head goes when timer fires */
+LIST(forward_list);
+static uint8_t forward_count;
+static struct ctimer forward_timer;
+
+static void forward_timeout(void *ptr);
+/*---------------------------------------------------------------------------*/
+static void
+arm_forward_timer(void)
+{
+  ctimer_set(&forward_timer, 1 + random_rand() % MESH_FORWARD_JITTER,
+             forward_timeout, NULL);
+}
+/*---------------------------------------------------------------------------*/
+static void
+forward_timeout(void *ptr)
+{
+  struct frame *frame = list_pop(forward_list);
+  const uint16_t id = get_le16(&link_data(frame)[HDR_SEQNO]);
+  int ret;
+
+  forward_count--;
+
+  ret = link_send(frame, LINK_TYPE_FLOOD, &linkaddr_null,
+                  frame->len - LINK_HDR_LEN, TX_CLASS_INTERACTIVE);
+  LOG_RECORD(MESH_FORWARD, id, ret);
+
+  if(list_head(forward_list) != NULL) {
+    arm_forward_timer();
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+mesh_init(void)
+{
+  dup_cache_init();
+  list_init(forward_list);
+  forward_count = 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+mesh_set_input_callback(link_input_callback_t callback)
+{
+  input_callback = callback;
+}
+/*---------------------------------------------------------------------------*/
+void
+mesh_input(struct frame *frame, const struct link_hdr *hdr)
+{
+  uint8_t *p = link_data(frame);
+  uint16_t len = frame->len - LINK_HDR_LEN;
+  struct link_hdr flood_hdr;
+
+  if(len < MESH_HDR_LEN) {
+    LOG_RECORD(LINK_RUNT, frame->len);
+    STATS_INC(DROP_RUNT);
+    frame_pool_free(frame);
+    return;
+  }
+
+  flood_hdr = *hdr;
+  memcpy(&flood_hdr.src, &p[HDR_ORIGIN], LINKADDR_SIZE);
+  linkaddr_copy(&flood_hdr.dst, &linkaddr_null);
+
+  /* Copies of our own floods come back too, mesh_flood() cached them */
+  if(dup_cache_check(&flood_hdr.src, get_le16(&p[HDR_SEQNO]))) {
+    frame_pool_free(frame);
+    return;
+  }
+
+  if(input_callback != NULL) {
+    input_callback(&flood_hdr, p + MESH_HDR_LEN, len - MESH_HDR_LEN);
+  }
+
+  if(p[HDR_TTL] <= 1 || forward_count >= MESH_FORWARD_QUEUE) {
+    frame_pool_free(frame);
+    return;
+  }
+
+  /* The frame is forwarded in place, link_send() rewrites the link header */
+  p[HDR_TTL]--;
+  list_add(forward_list, frame);
+  if(forward_count++ == 0) {
+    arm_forward_timer();
+  }
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+mesh_next_seqno(void)
+{
+  return ++seqno;
+}
+/*---------------------------------------------------------------------------*/
+int
+mesh_flood(const uint8_t *data, uint16_t len)
+{
+  struct frame *frame;
+  uint16_t id;
+  uint8_t *p;
+
+  if(len == 0 || len > MESH_MAX_DATA_LEN) {
+    return -1;
+  }
+
+  frame = frame_pool_alloc();
+  if(frame == NULL) {
+    return -1;
+  }
+
+  id = mesh_next_seqno();
+  p = link_data(frame);
+  memcpy(&p[HDR_ORIGIN], &linkaddr_node_addr, LINKADDR_SIZE);
+  put_le16(&p[HDR_SEQNO], id);
+  p[HDR_TTL] = MESH_TTL;
+  memcpy(p + MESH_HDR_LEN, data, len);
+
+  dup_cache_check(&linkaddr_node_addr, id);
+
+  return link_send(frame, LINK_TYPE_FLOOD, &linkaddr_null, MESH_HDR_LEN + len,
+                   TX_CLASS_INTERACTIVE);
+}
+/*---------------------------------------------------------------------------*/
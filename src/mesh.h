@@ -0,0 +1,90 @@
+/**
+ * \file
+ *         Flooding of payloads to every node of the mesh
+ *
+ *         Flooded payloads travel in LINK_TYPE_FLOOD frames broadcast to
+ *         all neighbors, prefixed with a mesh header:
+ *         [origin (2)] [seqno (2)] [TTL (1)]
+ *
+ *         Every node delivers a flooded payload once and rebroadcasts it
+ *         once, after a random jitter, as long as its TTL allows. Copies
+ *         heard again from other neighbors are recognized by their origin
+ *         and sequence number in the duplicate cache, see dup-cache.h, and
+ *         dropped without being delivered or rebroadcast.
+ */
+#ifndef MESH_H
+#define MESH_H
+
+#include "contiki.h"
+#include "frame-pool.h"
+#include "link.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------*/
+/** Hops a flood originated by this node travels */
+#ifdef MESH_CONF_TTL
+#define MESH_TTL MESH_CONF_TTL
+#else
+#define MESH_TTL 4
+#endif
+
+/** Longest random delay before a rebroadcast, in clock ticks */
+#ifdef MESH_CONF_FORWARD_JITTER
+#define MESH_FORWARD_JITTER MESH_CONF_FORWARD_JITTER
+#else
+#define MESH_FORWARD_JITTER (CLOCK_SECOND / 16)
+#endif
+
+/** Frames that can wait for their rebroadcast at the same time */
+#ifdef MESH_CONF_FORWARD_QUEUE
+#define MESH_FORWARD_QUEUE MESH_CONF_FORWARD_QUEUE
+#else
+#define MESH_FORWARD_QUEUE 2
+#endif
+
+#define MESH_HDR_LEN      (LINKADDR_SIZE + 3)
+#define MESH_MAX_DATA_LEN (LINK_MAX_DATA_LEN - MESH_HDR_LEN)
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Set up the duplicate cache and the rebroadcast queue.
+ */
+void mesh_init(void);
+
+/**
+ * \brief Set the function receiving flooded payloads.
+ *
+ * The header passed to it carries the origin of the flood as source and
+ * the broadcast address as destination.
+ */
+void mesh_set_input_callback(link_input_callback_t callback);
+
+/**
+ * \brief Process a received LINK_TYPE_FLOOD frame, taking ownership of it.
+ */
+void mesh_input(struct frame *frame, const struct link_hdr *hdr);
+
+/**
+ * \brief Take the next flood sequence number of this node.
+ *
+ * For other protocols flooding the mesh on their own, like route requests,
+ * so that the duplicate cache tells their messages apart from floods.
+ */
+uint16_t mesh_next_seqno(void);
+
+/**
+ * \brief Flood a payload, originated by this node, to the whole mesh.
+ * \return 0 on success, -1 on error.
+ */
+int mesh_flood(const uint8_t *data, uint16_t len);
+/*---------------------------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MESH_H */
@@ -0,0 +1,284 @@
+/**
+ * \file
+ *         Event loop latency monitor and stall capture
+ */
+#include "contiki.h"
+#include "monitor.h"
+#include "byteorder.h"
+#include "frame-pool.h"
+#include "host-link.h"
+#include "lib/crc16.h"
+#include "log-ring.h"
+#include "prof.h"
+#include "rf-core.h"
+#include "stats.h"
+#include "tx-sched.h"
+
+#include <stddef.h>
+#include <string.h>
+/*---------------------------------------------------------------------------*/
+#define MAGIC        0x4D4F4E31UL
+
+#define PERIOD_TICKS \
+  ((rtimer_clock_t)((uint64_t)MONITOR_PERIOD * RTIMER_SECOND / CLOCK_SECOND))
+#define BUDGET_TICKS \
+  ((rtimer_clock_t)((uint64_t)MONITOR_BUDGET * RTIMER_SECOND / 1000000))
+
+/* As sent to the host: [count (2)] [flags (1)] [events (1)] [free frames
+ * (1)] [queued per class (1 each)] [uptime s (4)] [cycles (4)] [stall us
+ * (4)] [process (4)] [name] [sp (4)] [words (1)] [stack word (4)]... */
+#define FAULT_LEN \
+  (5 + TX_CLASS_COUNT + 16 + MONITOR_NAME_LEN + 5 + 4 * MONITOR_STACK_WORDS)
+
+_Static_assert(FAULT_LEN <= HOST_LINK_MAX_FRAME_LEN,
+               "MONITOR_CONF_STACK_WORDS do not fit in one host link frame");
+_Static_assert(BUDGET_TICKS > 0, "MONITOR_CONF_BUDGET below an rtimer tick");
+/*---------------------------------------------------------------------------*/
+struct fault {
+  uint32_t magic;
+  /* crc16_data() of everything after it */
+  uint16_t crc;
+  /* Captures since the host last cleared the snapshot */
+  uint16_t count;
+  uint8_t flags;
+  uint8_t nevents;
+  uint8_t pool_free;
+  uint8_t queued[TX_CLASS_COUNT];
+  uint32_t uptime;
+  uint32_t cycles;
+  /* Until the loop ran again, or until the capture if it never did */
+  uint32_t stall_us;
+  /* Address of the process running or last run, 0 if none */
+  uint32_t process;
+  char name[MONITOR_NAME_LEN];
+  /* Address of stack[0] */
+  uint32_t sp;
+  uint8_t stack_len;
+  uint32_t stack[MONITOR_STACK_WORDS];
+};
+
+#define SEALED_OFFSET (offsetof(struct fault, crc) + sizeof(uint16_t))
+/*---------------------------------------------------------------------------*/
+/* Left alone by the startup code, so a capture outlives the reset */
+static struct fault fault __attribute__((section(MONITOR_SECTION)));
+
+/* Fires at the end of the budget unless the monitor ran before */
+static struct rtimer deadline;
+/* Time the monitor is due to wake */
+static volatile rtimer_clock_t expected;
+/* Set by a capture, cleared by the monitor once the loop runs again */
+static volatile uint8_t captured;
+/* Set while low-power listening is on, the deadline armed last is then
+ * left to fire for nothing */
+static volatile uint8_t paused;
+/* Highest stack address a capture reads, taken from the monitor process,
+ * as deep in the call chain as any other process */
+static uintptr_t stack_top;
+
+PROCESS(monitor_process, "Latency monitor process");
+
+static void get_input(const uint8_t *args, uint16_t len);
+
+static struct host_link_handler get_handler = {
+  NULL, HOST_CMD_FAULT_GET, get_input
+};
+/*---------------------------------------------------------------------------*/
+static uint32_t
+ticks_to_us(rtimer_clock_t ticks)
+{
+  return (uint32_t)(((uint64_t)ticks * 1000000) / RTIMER_SECOND);
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+crc(const struct fault *f)
+{
+  return crc16_data((const uint8_t *)f + SEALED_OFFSET,
+                    sizeof(*f) - SEALED_OFFSET, 0);
+}
+/*---------------------------------------------------------------------------*/
+static int
+valid(const struct fault *f)
+{
+  return f->magic == MAGIC && f->stack_len <= MONITOR_STACK_WORDS &&
+         f->crc == crc(f);
+}
+/*---------------------------------------------------------------------------*/
+static void
+seal(void)
+{
+  fault.magic = MAGIC;
+  fault.crc = crc(&fault);
+}
+/*---------------------------------------------------------------------------*/
+/* From the rtimer interrupt, with the loop stuck past the budget */
+static void
+capture(struct rtimer *t, void *ptr)
+{
+  const uintptr_t sp = (uintptr_t)__builtin_frame_address(0);
+  struct process *p = process_current;
+  const uint16_t count = valid(&fault) ? fault.count : 0;
+  unsigned i;
+
+  if(paused) {
+    return;
+  }
+
+  memset(&fault, 0, sizeof(fault));
+  fault.count = count < UINT16_MAX ? count + 1 : count;
+  fault.nevents = process_nevents();
+  fault.pool_free = frame_pool_available();
+  for(i = 0; i < TX_CLASS_COUNT; i++) {
+    fault.queued[i] = tx_sched_queued(i);
+  }
+  fault.uptime = clock_seconds();
+  fault.cycles = PROF_CYCLES();
+  fault.stall_us = ticks_to_us(RTIMER_NOW() - expected);
+
+  if(p != NULL) {
+    fault.process = (uint32_t)(uintptr_t)p;
+    strncpy(fault.name, PROCESS_NAME_STRING(p), MONITOR_NAME_LEN);
+  }
+
+  /* The interrupt frame and the stack of whatever it interrupted, never
+   * past the frames the loop itself lives in */
+  fault.sp = (uint32_t)sp;
+  if(sp < stack_top) {
+    fault.stack_len = MIN((stack_top - sp) / sizeof(uint32_t),
+                          MONITOR_STACK_WORDS);
+    memcpy(fault.stack, (const void *)sp,
+           fault.stack_len * sizeof(uint32_t));
+  }
+
+  seal();
+  captured = 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+get_input(const uint8_t *args, uint16_t len)
+{
+  struct fault f;
+  uint8_t out[FAULT_LEN];
+  uint8_t *pos = out;
+  unsigned i;
+
+  /* A capture may land halfway through the copy, the CRC tells */
+  memcpy(&f, &fault, sizeof(f));
+  if(!valid(&f)) {
+    host_link_send_result(HOST_CMD_FAULT_GET, HOST_STATUS_ERROR);
+    return;
+  }
+
+  put_le16(pos, f.count);
+  pos += 2;
+  *pos++ = f.flags;
+  *pos++ = f.nevents;
+  *pos++ = f.pool_free;
+  for(i = 0; i < TX_CLASS_COUNT; i++) {
+    *pos++ = f.queued[i];
+  }
+  put_le32(pos, f.uptime);
+  put_le32(pos + 4, f.cycles);
+  put_le32(pos + 8, f.stall_us);
+  put_le32(pos + 12, f.process);
+  pos += 16;
+  memcpy(pos, f.name, MONITOR_NAME_LEN);
+  pos += MONITOR_NAME_LEN;
+  put_le32(pos, f.sp);
+  pos += 4;
+  *pos++ = f.stack_len;
+  for(i = 0; i < f.stack_len; i++) {
+    put_le32(pos, f.stack[i]);
+    pos += 4;
+  }
+
+  if(host_link_send(HOST_CMD_FAULT, out, pos - out, NULL, 0) != 0) {
+    host_link_send_result(HOST_CMD_FAULT_GET, HOST_STATUS_ERROR);
+    return;
+  }
+
+  if(len > 0 && args[0] != 0) {
+    memset(&fault, 0, sizeof(fault));
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+monitor_init(void)
+{
+#if MONITOR_ENABLED
+  if(valid(&fault)) {
+    fault.flags |= MONITOR_FAULT_PREVIOUS;
+    seal();
+    LOG_RECORD(MONITOR_FAULT_KEPT, fault.stall_us, fault.process,
+               fault.flags, fault.count);
+  } else {
+    memset(&fault, 0, sizeof(fault));
+  }
+
+  host_link_register(&get_handler);
+  process_start(&monitor_process, NULL);
+#endif
+}
+/*---------------------------------------------------------------------------*/
+void
+monitor_sniff_changed(void)
+{
+  process_poll(&monitor_process);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(monitor_process, ev, data)
+{
+  static struct etimer et;
+  static rtimer_clock_t now;
+  uint32_t us;
+
+  PROCESS_BEGIN();
+
+  stack_top = (uintptr_t)__builtin_frame_address(0);
+
+  now = RTIMER_NOW();
+  rtimer_set(&deadline, now + PERIOD_TICKS + BUDGET_TICKS, 0, capture, NULL);
+  while(1) {
+    expected = now + PERIOD_TICKS;
+    etimer_set(&et, MONITOR_PERIOD);
+
+    PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+
+    now = RTIMER_NOW();
+    /* Overrides the deadline of this round, which cannot fire from here */
+    rtimer_set(&deadline, now + PERIOD_TICKS + BUDGET_TICKS, 0, capture,
+               NULL);
+
+    /* The timer expires on a clock tick, up to a tick ahead of time */
+    us = RTIMER_CLOCK_LT(now, expected) ? 0 : ticks_to_us(now - expected);
+
+    STATS_MAX(MONITOR_LATENCY_HWM, us);
+    STATS_HIST(MONITOR_LATENCY_US, us);
+    if(us > MONITOR_BUDGET) {
+      STATS_INC(MONITOR_VIOLATIONS);
+      LOG_RECORD(MONITOR_STALL, us, MONITOR_BUDGET, captured);
+    }
+
+    if(captured) {
+      captured = 0;
+      fault.flags |= MONITOR_FAULT_RECOVERED;
+      fault.stall_us = us;
+      seal();
+      STATS_INC(MONITOR_CAPTURES);
+    }
+
+    /* Waking 4 times a second would cost more than the sniff windows
+     * save, see monitor_sniff_changed() */
+    if(rf_core_get_sniff_interval() != 0) {
+      paused = 1;
+      PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_POLL &&
+                               rf_core_get_sniff_interval() == 0);
+      paused = 0;
+      now = RTIMER_NOW();
+      rtimer_set(&deadline, now + PERIOD_TICKS + BUDGET_TICKS, 0, capture,
+                 NULL);
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
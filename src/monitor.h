@@ -0,0 +1,108 @@
+/**
+ * \file
+ *         Event loop latency monitor and stall capture
+ *
+ *         Contiki processes never preempt each other: an event waits for
+ *         whatever runs before it, so the time a process of the loop goes
+ *         without running bounds the time any other one, the application
+ *         process included, waits for its events. monitor_process wakes
+ *         every MONITOR_PERIOD and measures how late it runs, to a clock
+ *         tick, into the MONITOR_* statistics words; a wake later than
+ *         MONITOR_BUDGET counts as a violation and is logged.
+ *
+ *         An rtimer armed for the end of the budget catches the loop while
+ *         it is still stuck. From its interrupt it captures into a retained
+ *         snapshot the process running, or the one that last ran, the
+ *         event and frame queue depths, the cycle counter and the top of
+ *         the stack, saved registers of the interrupted code included.
+ *         Once the loop runs again, the capture gets the length of the
+ *         stall. Past the watchdog timeout the chip resets instead:
+ *         the capture is kept in MONITOR_SECTION, which the startup code
+ *         neither loads nor clears, checked with a CRC on the next boot and
+ *         read with HOST_CMD_FAULT_GET until the host clears it. Only the
+ *         latest capture is kept.
+ *
+ *         Both timers keep the CPU out of standby on a period, so the
+ *         monitor pauses while low-power listening is on, and is left out
+ *         of images that boot with it.
+ */
+#ifndef MONITOR_H
+#define MONITOR_H
+
+#include "contiki.h"
+#include "rf-core.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------*/
+/** Measure the event loop and capture stalls, off by default in images
+ * booting with low-power listening */
+#ifdef MONITOR_CONF_ENABLED
+#define MONITOR_ENABLED MONITOR_CONF_ENABLED
+#else
+#define MONITOR_ENABLED (RF_CORE_SNIFF_INTERVAL == 0)
+#endif
+
+/** Time between two measurements, in clock ticks */
+#ifdef MONITOR_CONF_PERIOD
+#define MONITOR_PERIOD MONITOR_CONF_PERIOD
+#else
+#define MONITOR_PERIOD (CLOCK_SECOND / 4)
+#endif
+
+/** Longest the loop may keep an event waiting, in us */
+#ifdef MONITOR_CONF_BUDGET
+#define MONITOR_BUDGET MONITOR_CONF_BUDGET
+#else
+#define MONITOR_BUDGET 50000UL
+#endif
+
+/** Stack words copied from the capture up */
+#ifdef MONITOR_CONF_STACK_WORDS
+#define MONITOR_STACK_WORDS MONITOR_CONF_STACK_WORDS
+#else
+#define MONITOR_STACK_WORDS 32
+#endif
+
+/** Linker section surviving a reset, must be left out of the startup code
+ * copy and clear loops */
+#ifdef MONITOR_CONF_SECTION
+#define MONITOR_SECTION MONITOR_CONF_SECTION
+#else
+#define MONITOR_SECTION ".noinit"
+#endif
+
+/** Bytes of process name kept, NUL terminated if shorter */
+#define MONITOR_NAME_LEN 12
+
+/** \name Flags of the snapshot @{ */
+/** The loop ran again after the stall, clear if it ended in a reset */
+#define MONITOR_FAULT_RECOVERED 0x01
+/** Captured before the last reset */
+#define MONITOR_FAULT_PREVIOUS  0x02
+/** @} */
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Check the snapshot of before the reset, register the host link
+ *        command and start measuring.
+ *
+ * Must be called after log_ring_init() and host_link_init().
+ */
+void monitor_init(void);
+
+/**
+ * \brief Resume measuring once low-power listening was turned off, see
+ *        rf_core_set_sniff_interval().
+ */
+void monitor_sniff_changed(void);
+/*---------------------------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MONITOR_H */
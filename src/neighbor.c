@@ -0,0 +1,380 @@
+/**
+ * \file
+ *         Neighbor table with link quality estimation
+ */
+#include "contiki.h"
+#include "neighbor.h"
+#include "arena.h"
+#include "byteorder.h"
+#include "link-metric.h"
+#include "log-ring.h"
+#include "persist.h"
+#include "prof.h"
+/*---------------------------------------------------------------------------*/
+#define MASK        (NEIGHBOR_SIZE - 1)
+/* Marks a free slot, the null address is broadcast and never a sender */
+#define EMPTY       0x0000
+
+/* New neighbors start at ETX 2 like in Contiki's link-stats */
+#define PRR_INIT    (LINK_METRIC_PRR_ONE / 2)
+
+/* Sequence gaps up to this long count as losses, a longer gap means the
+ * neighbor went away for a while or rebooted */
+#define MAX_GAP     16
+
+/* Saved per neighbor: [address (2)] [reception ratio (2)] [RSSI]
+ * [reference RSSI] [sequence number] [last security counter of its block
+ * (4)] */
+#define SAVED_LEN   11
+
+#define ARRAY_LEN(type) ARENA_SIZEOF(NEIGHBOR_SIZE * sizeof(type))
+
+_Static_assert(LINKADDR_SIZE == 2,
+               "neighbor hashing assumes two byte link addresses");
+_Static_assert(3 * ARRAY_LEN(uint16_t) +
+               2 * ARRAY_LEN(int16_t) + ARRAY_LEN(uint8_t) +
+               ARRAY_LEN(clock_time_t) + ARRAY_LEN(uint32_t) <=
+               ARENA_QUOTA_NEIGHBOR,
+               "NEIGHBOR_CONF_SIZE entries do not fit in "
+               "ARENA_CONF_QUOTA_NEIGHBOR");
+/*---------------------------------------------------------------------------*/
+static uint16_t *addrs;
+/* Estimator states, see link-metric.h */
+static uint16_t *prr;
+static uint16_t *etx;
+static int16_t *rssi;
+static int16_t *ref_rssi;
+static uint8_t *seqnos;
+static clock_time_t *last_seen;
+static uint32_t *counters;
+
+static int count;
+
+static void save(void);
+static void restore(uint16_t len);
+
+static struct persist_handler persist_handler = {
+  NULL, PERSIST_NEIGHBORS, save, restore
+};
+/*---------------------------------------------------------------------------*/
+static unsigned
+hash(uint16_t addr)
+{
+  const uint32_t h = addr * 40503UL;
+
+  return (h ^ (h >> 8)) & MASK;
+}
+/*---------------------------------------------------------------------------*/
+static int
+lookup(uint16_t addr)
+{
+  unsigned i = hash(addr);
+  unsigned probes;
+
+  if(addr == EMPTY) {
+    return -1;
+  }
+
+  /* The table is never full, every probe sequence ends on a free slot */
+  for(probes = 0; probes < NEIGHBOR_SIZE; probes++) {
+    if(addrs[i] == addr) {
+      return i;
+    }
+    if(addrs[i] == EMPTY) {
+      return -1;
+    }
+    i = (i + 1) & MASK;
+  }
+
+  return -1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+move(unsigned to, unsigned from)
+{
+  addrs[to] = addrs[from];
+  prr[to] = prr[from];
+  etx[to] = etx[from];
+  rssi[to] = rssi[from];
+  ref_rssi[to] = ref_rssi[from];
+  seqnos[to] = seqnos[from];
+  last_seen[to] = last_seen[from];
+  counters[to] = counters[from];
+}
+/*---------------------------------------------------------------------------*/
+/* Backward shift deletion: entries further down the probe sequence move
+ * up into the hole if their home slot allows, so no tombstones are needed
+ * and lookups keep stopping at the first free slot */
+static void
+remove_at(unsigned hole)
+{
+  unsigned i = hole;
+  unsigned home;
+
+  for(;;) {
+    i = (i + 1) & MASK;
+    if(addrs[i] == EMPTY) {
+      break;
+    }
+    home = hash(addrs[i]);
+    if(((i - home) & MASK) >= ((i - hole) & MASK)) {
+      move(hole, i);
+      hole = i;
+    }
+  }
+
+  addrs[hole] = EMPTY;
+  count--;
+}
+/*---------------------------------------------------------------------------*/
+static void
+evict_stalest(void)
+{
+  const clock_time_t now = clock_time();
+  clock_time_t age;
+  clock_time_t oldest = 0;
+  unsigned victim = 0;
+  unsigned i;
+
+  for(i = 0; i < NEIGHBOR_SIZE; i++) {
+    age = now - last_seen[i];
+    if(addrs[i] != EMPTY && age >= oldest) {
+      oldest = age;
+      victim = i;
+    }
+  }
+
+  LOG_RECORD(NEIGHBOR_EVICT, addrs[victim]);
+  remove_at(victim);
+}
+/*---------------------------------------------------------------------------*/
+/* Slot for an address not in the table, which must have room */
+static int
+place(uint16_t addr)
+{
+  unsigned i;
+
+  for(i = hash(addr); addrs[i] != EMPTY; i = (i + 1) & MASK);
+
+  addrs[i] = addr;
+  count++;
+
+  return i;
+}
+/*---------------------------------------------------------------------------*/
+static int
+insert(uint16_t addr, uint8_t seqno, int8_t frame_rssi)
+{
+  int i;
+
+  if(count >= NEIGHBOR_MAX) {
+    evict_stalest();
+  }
+
+  i = place(addr);
+  prr[i] = link_metric_prr_init(PRR_INIT);
+  etx[i] = link_metric_etx(prr[i]);
+  rssi[i] = link_metric_rssi_init(frame_rssi);
+  ref_rssi[i] = link_metric_rssi_init(NEIGHBOR_RSSI_UNKNOWN);
+  /* Accounted for as the next one in sequence by update() */
+  seqnos[i] = seqno - 1;
+  counters[i] = 0;
+
+  LOG_RECORD(NEIGHBOR_NEW, addr, frame_rssi);
+
+  return i;
+}
+/*---------------------------------------------------------------------------*/
+static void
+update(const linkaddr_t *addr, uint8_t seqno, int broadcast,
+       const struct frame_rx_meta *meta)
+{
+  int i;
+  uint8_t gap;
+
+  if(addr->u16 == EMPTY) {
+    return;
+  }
+
+  i = lookup(addr->u16);
+  if(i < 0) {
+    i = insert(addr->u16, seqno, meta->rssi);
+  }
+
+  last_seen[i] = clock_time();
+  persist_changed();
+
+  if(broadcast) {
+    if(link_metric_rssi(ref_rssi[i]) == NEIGHBOR_RSSI_UNKNOWN) {
+      ref_rssi[i] = link_metric_rssi_init(meta->rssi);
+    } else {
+      ref_rssi[i] = link_metric_rssi_update(ref_rssi[i], meta->rssi);
+    }
+  }
+
+  gap = seqno - seqnos[i];
+  if(gap == 0) {
+    /* Duplicate */
+    return;
+  }
+  seqnos[i] = seqno;
+
+  prr[i] = link_metric_prr_update(prr[i], gap <= MAX_GAP ? gap - 1 : 0);
+  etx[i] = link_metric_etx(prr[i]);
+
+  rssi[i] = link_metric_rssi_update(rssi[i], meta->rssi);
+}
+/*---------------------------------------------------------------------------*/
+static void
+save(void)
+{
+  uint8_t buf[SAVED_LEN];
+  unsigned i;
+
+  for(i = 0; i < NEIGHBOR_SIZE; i++) {
+    if(addrs[i] == EMPTY) {
+      continue;
+    }
+    put_le16(&buf[0], addrs[i]);
+    put_le16(&buf[2], link_metric_prr(prr[i]));
+    buf[4] = link_metric_rssi(rssi[i]);
+    buf[5] = link_metric_rssi(ref_rssi[i]);
+    buf[6] = seqnos[i];
+    put_le32(&buf[7], counters[i] | (NEIGHBOR_COUNTER_BLOCK - 1));
+    persist_put(buf, sizeof(buf));
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+restore(uint16_t len)
+{
+  const clock_time_t now = clock_time();
+  uint8_t buf[SAVED_LEN];
+  uint16_t addr;
+  int i;
+
+  while(count < NEIGHBOR_MAX && persist_get(buf, sizeof(buf)) == 0) {
+    addr = get_le16(&buf[0]);
+    if(addr == EMPTY || lookup(addr) >= 0) {
+      continue;
+    }
+
+    i = place(addr);
+    prr[i] = link_metric_prr_init(get_le16(&buf[2]));
+    etx[i] = link_metric_etx(prr[i]);
+    rssi[i] = link_metric_rssi_init(buf[4]);
+    ref_rssi[i] = link_metric_rssi_init(buf[5]);
+    seqnos[i] = buf[6];
+    /* Counters up to the end of the block may have been taken since */
+    counters[i] = get_le32(&buf[7]);
+    /* Clock time does not survive the reset */
+    last_seen[i] = now;
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+neighbor_init(void)
+{
+  addrs = arena_alloc(ARENA_NEIGHBOR, NEIGHBOR_SIZE * sizeof(*addrs));
+  prr = arena_alloc(ARENA_NEIGHBOR, NEIGHBOR_SIZE * sizeof(*prr));
+  etx = arena_alloc(ARENA_NEIGHBOR, NEIGHBOR_SIZE * sizeof(*etx));
+  rssi = arena_alloc(ARENA_NEIGHBOR, NEIGHBOR_SIZE * sizeof(*rssi));
+  ref_rssi = arena_alloc(ARENA_NEIGHBOR, NEIGHBOR_SIZE * sizeof(*ref_rssi));
+  seqnos = arena_alloc(ARENA_NEIGHBOR, NEIGHBOR_SIZE * sizeof(*seqnos));
+  last_seen = arena_alloc(ARENA_NEIGHBOR, NEIGHBOR_SIZE * sizeof(*last_seen));
+  counters = arena_alloc(ARENA_NEIGHBOR, NEIGHBOR_SIZE * sizeof(*counters));
+  count = 0;
+
+  persist_register(&persist_handler);
+}
+/*---------------------------------------------------------------------------*/
+void
+neighbor_update(const linkaddr_t *addr, uint8_t seqno, int broadcast,
+                const struct frame_rx_meta *meta)
+{
+  PROF_BEGIN(NEIGHBOR_UPDATE);
+  update(addr, seqno, broadcast, meta);
+  PROF_END(NEIGHBOR_UPDATE);
+}
+/*---------------------------------------------------------------------------*/
+int
+neighbor_find(const linkaddr_t *addr)
+{
+  return lookup(addr->u16);
+}
+/*---------------------------------------------------------------------------*/
+int8_t
+neighbor_rssi(int index)
+{
+  return link_metric_rssi(rssi[index]);
+}
+/*---------------------------------------------------------------------------*/
+int8_t
+neighbor_ref_rssi(int index)
+{
+  return link_metric_rssi(ref_rssi[index]);
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+neighbor_prr(int index)
+{
+  return link_metric_prr(prr[index]) >> 8;
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+neighbor_etx(int index)
+{
+  return etx[index];
+}
+/*---------------------------------------------------------------------------*/
+clock_time_t
+neighbor_last_seen(int index)
+{
+  return last_seen[index];
+}
+/*---------------------------------------------------------------------------*/
+int
+neighbor_check_counter(const linkaddr_t *addr, uint32_t counter)
+{
+  const int i = lookup(addr->u16);
+
+  /* Unknown neighbors would start at 0 */
+  return counter > (i < 0 ? 0 : counters[i]) ? 0 : -1;
+}
+/*---------------------------------------------------------------------------*/
+void
+neighbor_set_counter(const linkaddr_t *addr, uint32_t counter)
+{
+  const int i = lookup(addr->u16);
+  uint32_t last;
+
+  if(i < 0) {
+    return;
+  }
+
+  last = counters[i];
+  counters[i] = counter;
+
+  /* A new neighbor, or a counter past the saved block, must be in flash
+   * before a reset could take the frame again */
+  if(last == 0 || (counter ^ last) >= NEIGHBOR_COUNTER_BLOCK) {
+    persist_save(&persist_handler);
+  } else {
+    persist_changed();
+  }
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+neighbor_link_etx(const linkaddr_t *addr)
+{
+  const int i = lookup(addr->u16);
+
+  return i < 0 ? NEIGHBOR_ETX_MAX : etx[i];
+}
+/*---------------------------------------------------------------------------*/
+int
+neighbor_count(void)
+{
+  return count;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,157 @@
+/**
+ * \file
+ *         Neighbor table with link quality estimation
+ *
+ *         Fixed capacity, open addressed table keyed by link address and
+ *         updated on every frame heard, whoever it is addressed to. Entries
+ *         are found with a hash and a short linear probe, so a lookup on
+ *         the forwarding path costs the same with 4 or 40 neighbors. Each
+ *         field lives in its own array, out of the ARENA_NEIGHBOR region,
+ *         so a probe only walks the address array.
+ *
+ *         Link quality is estimated from what arrives: RSSI is averaged,
+ *         and gaps in the per-sender link sequence numbers give a
+ *         reception ratio, from which ETX is derived. Without link layer
+ *         acknowledgements this is the inbound ratio, assumed symmetric.
+ *         The estimators are the fixed-point kernels of link-metric.h.
+ *
+ *         The table is saved to flash, see persist.h, and comes back at
+ *         boot with every entry just seen, and with the security counters
+ *         of the last save.
+ */
+#ifndef NEIGHBOR_H
+#define NEIGHBOR_H
+
+#include "contiki.h"
+#include "frame-pool.h"
+#include "net/linkaddr.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------*/
+/** Table capacity, a power of two */
+#ifdef NEIGHBOR_CONF_SIZE
+#define NEIGHBOR_SIZE NEIGHBOR_CONF_SIZE
+#else
+#define NEIGHBOR_SIZE 64
+#endif
+
+#if (NEIGHBOR_SIZE & (NEIGHBOR_SIZE - 1)) != 0
+#error "NEIGHBOR_SIZE must be a power of two"
+#endif
+
+/**
+ * Link security frame counters taken from a neighbor before its entry is
+ * saved again, a power of two. The saved counter is the end of the block,
+ * so after a reset every neighbor has to move past it.
+ */
+#ifdef NEIGHBOR_CONF_COUNTER_BLOCK
+#define NEIGHBOR_COUNTER_BLOCK NEIGHBOR_CONF_COUNTER_BLOCK
+#else
+#define NEIGHBOR_COUNTER_BLOCK 1024
+#endif
+
+#if (NEIGHBOR_COUNTER_BLOCK & (NEIGHBOR_COUNTER_BLOCK - 1)) != 0
+#error "NEIGHBOR_COUNTER_BLOCK must be a power of two"
+#endif
+
+/**
+ * Neighbors kept at most. Past this the stalest one makes room, which
+ * keeps enough free slots for probes to stay short.
+ */
+#define NEIGHBOR_MAX ((NEIGHBOR_SIZE * 3) / 4)
+
+/** Fixed point scale of ETX values, as in Contiki's link-stats */
+#define NEIGHBOR_ETX_DIVISOR 128
+/** ETX reported for an unknown neighbor and the highest one estimated */
+#define NEIGHBOR_ETX_MAX     (8 * NEIGHBOR_ETX_DIVISOR)
+/** RSSI of a neighbor not heard in the right conditions yet */
+#define NEIGHBOR_RSSI_UNKNOWN INT8_MIN
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Allocate the table and fill it from the last save.
+ */
+void neighbor_init(void);
+
+/**
+ * \brief Account for one frame heard from a neighbor.
+ * \param addr Sender of the frame
+ * \param seqno Link sequence number of the frame
+ * \param broadcast Non-zero for broadcast frames, always sent at the
+ *                  default TX power
+ * \param meta RF core metadata of the frame
+ */
+void neighbor_update(const linkaddr_t *addr, uint8_t seqno, int broadcast,
+                     const struct frame_rx_meta *meta);
+
+/**
+ * \brief Find a neighbor.
+ * \return Its index for the accessors below, or -1 if unknown. Indexes
+ *         stay valid until the next neighbor_update().
+ */
+int neighbor_find(const linkaddr_t *addr);
+
+/** \brief Averaged RSSI of a neighbor, in dBm */
+int8_t neighbor_rssi(int index);
+
+/**
+ * \brief Averaged RSSI of the broadcasts of a neighbor, in dBm.
+ *
+ * Unlike unicast frames, broadcasts are sent at the default TX power, so
+ * this tells the path loss. NEIGHBOR_RSSI_UNKNOWN until one is heard.
+ */
+int8_t neighbor_ref_rssi(int index);
+
+/** \brief Estimated reception ratio of a neighbor, 255 meaning 100 % */
+uint8_t neighbor_prr(int index);
+
+/** \brief Estimated ETX of a neighbor, scaled by NEIGHBOR_ETX_DIVISOR */
+uint16_t neighbor_etx(int index);
+
+/** \brief clock_time() of the last frame heard from a neighbor */
+clock_time_t neighbor_last_seen(int index);
+
+/**
+ * \brief Check the link security frame counter of a frame from a neighbor.
+ *
+ * Neighbors start at counter 0, a neighbor dropped from the table
+ * starts over when heard again. After a reset, a neighbor starts at the end
+ * of the NEIGHBOR_COUNTER_BLOCK its last counter was in, a sender that did
+ * not reset meanwhile loses what is left of that block.
+ *
+ * Only checks, so that a replayed frame is refused before it counts
+ * towards the link metrics or takes an entry, see neighbor_set_counter().
+ *
+ * \return 0 if the counter is above the last one recorded, -1 if it is not.
+ */
+int neighbor_check_counter(const linkaddr_t *addr, uint32_t counter);
+
+/**
+ * \brief Record the frame counter of a frame that passed
+ *        neighbor_check_counter(), once neighbor_update() added its sender.
+ *
+ * Saves the table right away when the counter enters a new block, blocking
+ * while the flash is programmed.
+ */
+void neighbor_set_counter(const linkaddr_t *addr, uint32_t counter);
+
+/**
+ * \brief ETX towards a link address, NEIGHBOR_ETX_MAX if it is unknown.
+ */
+uint16_t neighbor_link_etx(const linkaddr_t *addr);
+
+/**
+ * \brief Number of neighbors in the table.
+ */
+int neighbor_count(void);
+/*---------------------------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NEIGHBOR_H */
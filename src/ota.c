@@ -0,0 +1,708 @@
+/**
+ * \file
+ *         Firmware updates over the air, as deltas against the running image
+ */
+#include "contiki.h"
+#include "ota.h"
+#include "arena.h"
+#include "byteorder.h"
+#include "dev/watchdog.h"
+#include "frag.h"
+#include "host-link.h"
+#include "lib/crc16.h"
+#include "log-ring.h"
+
+#include <ti/drivers/ECDSA.h>
+#include <ti/drivers/NVS.h>
+#include <ti/drivers/SHA2.h>
+#include <ti/drivers/cryptoutils/cryptokey/CryptoKeyPlaintext.h>
+#include <ti/drivers/cryptoutils/ecc/ECCParams.h>
+
+#include "Board.h"
+
+#include <string.h>
+/*---------------------------------------------------------------------------*/
+/* Largest delta chunk of an OTA_MSG_DATA message */
+#define BUF_LEN       (FRAG_MAX_LEN - OTA_DATA_HDR_LEN)
+#define BUFFERS       2
+
+/* The running image is read through a buffer of this size on the stack
+ * when checking its CRC, and this much of it per pass of the process */
+#define CHUNK_LEN     32
+#define CHECK_LEN     1024
+
+/* Varints are at most 32 bits */
+#define VARINT_SHIFT_MAX 28
+
+/* verify_status while the crypto engine checks the signature */
+#define VERIFY_PENDING 1
+
+enum {
+  STATE_IDLE,
+  /* The base named by the delta is being checked */
+  STATE_CHECKING,
+  STATE_RECEIVING,
+  /* The whole delta is in, the image is being checked */
+  STATE_VERIFYING,
+  STATE_DONE,
+  STATE_FAILED,
+};
+
+enum {
+  DEC_OP,
+  DEC_OFFSET,
+  DEC_LITERAL,
+  DEC_COPY,
+};
+
+struct buffer {
+  /* 0 while free */
+  uint16_t len;
+  uint16_t pos;
+  uint8_t *data;
+};
+
+_Static_assert(OTA_SLOT_HDR_LEN <= OTA_SLOT_IMAGE &&
+               OTA_SLOT_HDR_LEN <= OTA_WRITE_LEN,
+               "The slot header does not fit before the image or in a page");
+_Static_assert(OTA_IMAGE_BASE < OTA_FLASH_SIZE,
+               "OTA_CONF_IMAGE_BASE past the end of the internal flash");
+_Static_assert(BUFFERS * ARENA_SIZEOF(BUF_LEN) + ARENA_SIZEOF(OTA_WRITE_LEN) <=
+               ARENA_QUOTA_OTA,
+               "Two FRAG_CONF_MAX_LEN buffers and an OTA_CONF_WRITE_LEN page "
+               "do not fit in ARENA_CONF_QUOTA_OTA");
+/*---------------------------------------------------------------------------*/
+static NVS_Handle nvs;
+static uint32_t slot_size;
+static uint32_t sector_size;
+
+static SHA2_Handle sha2;
+static ECDSA_Handle ecdsa;
+static CryptoKey public_key;
+static ECDSA_OperationVerify verify_op;
+/* Result of the last verification, VERIFY_PENDING until it is known */
+static volatile int_fast16_t verify_status;
+
+#ifdef OTA_CONF_PUBLIC_KEY
+static uint8_t public_key_material[OTA_PUBLIC_KEY_LEN] = OTA_CONF_PUBLIC_KEY;
+#endif
+
+/* Cached CRC of the running image, its length is only known from the
+ * deltas */
+static uint32_t cached_crc_len;
+static uint16_t cached_crc;
+
+/* Session */
+static uint8_t state;
+static uint8_t session;
+static linkaddr_t sender;
+static uint32_t image_len;
+static uint8_t digest[OTA_DIGEST_LEN];
+static uint8_t signature[OTA_SIGNATURE_LEN];
+static uint32_t base_len;
+static uint16_t base_crc;
+static uint32_t delta_len;
+/* Bumped by every new session, a check in progress starts over */
+static uint8_t generation;
+/* Status of a failed session */
+static uint8_t failure;
+/* Delta bytes accepted so far */
+static uint32_t rx_offset;
+
+static struct buffer buffers[BUFFERS];
+static uint8_t fill_index;
+static uint8_t decode_index;
+
+/* Decoder */
+static uint8_t dec_state;
+static uint32_t varint;
+static uint8_t varint_shift;
+static uint32_t op_len;
+/* Next byte of the running image to copy */
+static uint32_t copy_pos;
+static uint32_t out_len;
+
+/* Page being filled, at out_offset in the slot */
+static uint8_t *page;
+static uint16_t page_fill;
+static uint32_t out_offset;
+static uint32_t erased_end;
+
+static struct ctimer reboot_timer;
+/*---------------------------------------------------------------------------*/
+PROCESS(ota_process, "OTA update");
+/*---------------------------------------------------------------------------*/
+static void
+image_read(uint32_t offset, uint8_t *buf, uint16_t len)
+{
+  /* The image starts at address 0, keep the compiler from treating the
+   * pointer as null */
+  const volatile uint8_t *p =
+    (const volatile uint8_t *)(uintptr_t)(OTA_IMAGE_BASE + offset);
+
+  while(len--) {
+    *buf++ = *p++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+running_crc(uint32_t offset, uint32_t len, uint16_t acc)
+{
+  uint8_t buf[CHUNK_LEN];
+  uint16_t chunk;
+
+  for(; len > 0; offset += chunk, len -= chunk) {
+    chunk = MIN(len, sizeof(buf));
+    image_read(offset, buf, chunk);
+    acc = crc16_data(buf, chunk, acc);
+  }
+
+  return acc;
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_status(const linkaddr_t *dst, uint8_t status)
+{
+  uint8_t msg[OTA_STATUS_LEN];
+  uint8_t *buf;
+
+  msg[0] = OTA_MSG_STATUS;
+  msg[1] = session;
+  msg[2] = status;
+  put_le32(&msg[3], rx_offset);
+
+  if(linkaddr_cmp(dst, &linkaddr_node_addr)) {
+    host_link_send(HOST_CMD_OTA_STATUS, dst, LINKADDR_SIZE, msg, sizeof(msg));
+    return;
+  }
+
+  /* Lost while a message is being sent, the sender repeats itself */
+  buf = frag_buffer();
+  if(buf != NULL) {
+    memcpy(buf, msg, sizeof(msg));
+    frag_send(dst, FRAG_PORT_OTA, sizeof(msg));
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Answer to a message that does not move the session forward */
+static uint8_t
+state_status(void)
+{
+  switch(state) {
+  case STATE_CHECKING:
+    return OTA_STATUS_BUSY;
+  case STATE_RECEIVING:
+  case STATE_VERIFYING:
+    return OTA_STATUS_OK;
+  case STATE_DONE:
+    return OTA_STATUS_DONE;
+  case STATE_FAILED:
+    return failure;
+  default:
+    return OTA_STATUS_SESSION;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+fail(void)
+{
+  state = STATE_FAILED;
+  failure = OTA_STATUS_ERROR;
+  LOG_RECORD(OTA_FAILED, session, out_len);
+  send_status(&sender, OTA_STATUS_ERROR);
+}
+/*---------------------------------------------------------------------------*/
+static int
+flush(void)
+{
+  while(out_offset + page_fill > erased_end) {
+    if(NVS_erase(nvs, erased_end, sector_size) != NVS_STATUS_SUCCESS) {
+      return -1;
+    }
+    erased_end += sector_size;
+  }
+
+  if(NVS_write(nvs, out_offset, page, page_fill, NVS_WRITE_POST_VERIFY) !=
+     NVS_STATUS_SUCCESS) {
+    return -1;
+  }
+
+  out_offset += page_fill;
+  page_fill = 0;
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Start an operation once its varint is complete */
+static int
+start_op(void)
+{
+  int32_t delta;
+
+  if(dec_state == DEC_OP) {
+    op_len = (varint >> 1) + 1;
+    dec_state = varint & 1 ? DEC_OFFSET : DEC_LITERAL;
+  } else {
+    delta = (int32_t)((varint >> 1) ^ -(varint & 1));
+    copy_pos += delta;
+    if(copy_pos > base_len || op_len > base_len - copy_pos) {
+      return -1;
+    }
+    dec_state = DEC_COPY;
+  }
+
+  if(op_len > image_len - out_len) {
+    return -1;
+  }
+
+  varint = 0;
+  varint_shift = 0;
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Decode until the page is full or the buffer, if any, is used up */
+static int
+decode(struct buffer *b)
+{
+  uint16_t room;
+  uint16_t n;
+  uint8_t byte;
+
+  while((room = OTA_WRITE_LEN - page_fill) > 0) {
+    switch(dec_state) {
+    case DEC_COPY:
+      n = MIN(op_len, room);
+      image_read(copy_pos, &page[page_fill], n);
+      copy_pos += n;
+      break;
+    case DEC_LITERAL:
+      if(b == NULL || b->pos == b->len) {
+        return 0;
+      }
+      n = MIN(MIN(op_len, room), b->len - b->pos);
+      memcpy(&page[page_fill], &b->data[b->pos], n);
+      b->pos += n;
+      break;
+    default:
+      if(b == NULL || b->pos == b->len) {
+        return 0;
+      }
+      byte = b->data[b->pos++];
+      if(varint_shift > VARINT_SHIFT_MAX) {
+        return -1;
+      }
+      varint |= (uint32_t)(byte & 0x7F) << varint_shift;
+      varint_shift += 7;
+      if(!(byte & 0x80) && start_op() != 0) {
+        return -1;
+      }
+      continue;
+    }
+
+    page_fill += n;
+    out_len += n;
+    op_len -= n;
+    if(op_len == 0) {
+      dec_state = DEC_OP;
+    }
+  }
+
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+begin(const linkaddr_t *src, const uint8_t *msg, uint16_t len)
+{
+  uint32_t new_image_len;
+  uint32_t new_base_len;
+  uint32_t new_delta_len;
+
+  if(len != OTA_BEGIN_LEN) {
+    return;
+  }
+
+  new_image_len = get_le32(&msg[2]);
+  new_base_len = get_le32(&msg[6]);
+  new_delta_len = get_le32(&msg[12]);
+
+  if(state != STATE_IDLE && msg[1] == session &&
+     new_image_len == image_len && new_base_len == base_len &&
+     new_delta_len == delta_len &&
+     memcmp(&msg[16], digest, OTA_DIGEST_LEN) == 0 &&
+     memcmp(&msg[16 + OTA_DIGEST_LEN], signature, OTA_SIGNATURE_LEN) == 0) {
+    /* Repeated, resume */
+    linkaddr_copy(&sender, src);
+    send_status(src, state_status());
+    return;
+  }
+
+  /* The crypto engine still reads the digest and signature */
+  if(verify_status == VERIFY_PENDING) {
+    send_status(src, OTA_STATUS_BUSY);
+    return;
+  }
+
+  state = STATE_IDLE;
+  session = msg[1];
+  linkaddr_copy(&sender, src);
+  rx_offset = 0;
+  generation++;
+
+  /* The base is read from the internal flash, never past its end */
+  if(nvs == NULL || ecdsa == NULL || new_image_len == 0 ||
+     new_image_len > slot_size - OTA_SLOT_IMAGE || new_delta_len == 0 ||
+     new_base_len > OTA_FLASH_SIZE - OTA_IMAGE_BASE) {
+    send_status(src, OTA_STATUS_ERROR);
+    return;
+  }
+
+  image_len = new_image_len;
+  base_len = new_base_len;
+  base_crc = get_le16(&msg[10]);
+  delta_len = new_delta_len;
+  memcpy(digest, &msg[16], OTA_DIGEST_LEN);
+  memcpy(signature, &msg[16 + OTA_DIGEST_LEN], OTA_SIGNATURE_LEN);
+
+  /* The process answers once the signature and the base check out */
+  state = STATE_CHECKING;
+  process_poll(&ota_process);
+  send_status(src, OTA_STATUS_BUSY);
+}
+/*---------------------------------------------------------------------------*/
+static void
+data_input(const linkaddr_t *src, const uint8_t *msg, uint16_t len)
+{
+  struct buffer *b = &buffers[fill_index];
+
+  if(state == STATE_IDLE || msg[1] != session) {
+    send_status(src, OTA_STATUS_SESSION);
+    return;
+  }
+
+  /* Anything but the next chunk only tells the sender where we are */
+  if(state != STATE_RECEIVING || len <= OTA_DATA_HDR_LEN ||
+     get_le32(&msg[2]) != rx_offset) {
+    send_status(src, state_status());
+    return;
+  }
+
+  len -= OTA_DATA_HDR_LEN;
+  if(len > BUF_LEN || len > delta_len - rx_offset) {
+    fail();
+    return;
+  }
+
+  if(b->len != 0) {
+    send_status(src, OTA_STATUS_BUSY);
+    return;
+  }
+
+  memcpy(b->data, &msg[OTA_DATA_HDR_LEN], len);
+  b->pos = 0;
+  b->len = len;
+  fill_index ^= 1;
+  rx_offset += len;
+  process_poll(&ota_process);
+
+  /* Before it is written, the sender goes on with the next one */
+  send_status(src, OTA_STATUS_OK);
+}
+/*---------------------------------------------------------------------------*/
+static int
+write_header(void)
+{
+  uint8_t *hdr = page;
+
+  memset(hdr, 0xFF, OTA_SLOT_HDR_LEN);
+  put_le32(&hdr[0], OTA_SLOT_MAGIC);
+  hdr[4] = OTA_SLOT_VERSION;
+  put_le32(&hdr[8], image_len);
+  memcpy(&hdr[12], digest, OTA_DIGEST_LEN);
+  memcpy(&hdr[12 + OTA_DIGEST_LEN], signature, OTA_SIGNATURE_LEN);
+
+  return NVS_write(nvs, 0, hdr, OTA_SLOT_HDR_LEN, NVS_WRITE_POST_VERIFY) ==
+         NVS_STATUS_SUCCESS ? 0 : -1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+commit_slot(void)
+{
+  uint8_t flags = (uint8_t)~OTA_SLOT_COMMITTED;
+
+  return NVS_write(nvs, OTA_SLOT_FLAGS, &flags, 1, NVS_WRITE_POST_VERIFY) ==
+         NVS_STATUS_SUCCESS ? 0 : -1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+verify_done(ECDSA_Handle handle, int_fast16_t status,
+            ECDSA_Operation operation, ECDSA_OperationType type)
+{
+  verify_status = status;
+  process_poll(&ota_process);
+}
+/*---------------------------------------------------------------------------*/
+static void
+reboot(void *ptr)
+{
+  watchdog_reboot();
+}
+/*---------------------------------------------------------------------------*/
+static void
+commit(const linkaddr_t *src, const uint8_t *msg)
+{
+  if(state == STATE_IDLE || msg[1] != session) {
+    send_status(src, OTA_STATUS_SESSION);
+    return;
+  }
+
+  /* Over the header written at the end of the verification */
+  if(state == STATE_DONE && commit_slot() != 0) {
+    state = STATE_FAILED;
+    failure = OTA_STATUS_ERROR;
+    LOG_RECORD(OTA_FAILED, session, out_len);
+  }
+
+  send_status(src, state_status());
+  if(state == STATE_DONE) {
+    /* Long enough for the answer to go out */
+    ctimer_set(&reboot_timer, OTA_REBOOT_DELAY, reboot, NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+frag_input_callback(const struct link_hdr *hdr, const uint8_t *data,
+                    uint16_t len)
+{
+  ota_input(&hdr->src, data, len);
+}
+/*---------------------------------------------------------------------------*/
+int
+ota_init(void)
+{
+  NVS_Params params;
+  NVS_Attrs attrs;
+  SHA2_Params sha2_params;
+  ECDSA_Params ecdsa_params;
+
+  buffers[0].data = arena_alloc(ARENA_OTA, BUF_LEN);
+  buffers[1].data = arena_alloc(ARENA_OTA, BUF_LEN);
+  page = arena_alloc(ARENA_OTA, OTA_WRITE_LEN);
+
+  /* Even without a slot of its own a node relays the status of others */
+  frag_set_input_callback(FRAG_PORT_OTA, frag_input_callback);
+  process_start(&ota_process, NULL);
+
+#ifdef OTA_CONF_PUBLIC_KEY
+  CryptoKeyPlaintext_initKey(&public_key, public_key_material,
+                             sizeof(public_key_material));
+#else
+  return -1;
+#endif
+
+  NVS_init();
+  NVS_Params_init(&params);
+  nvs = NVS_open(Board_NVSEXTERNAL, &params);
+  if(nvs == NULL) {
+    return -1;
+  }
+
+  NVS_getAttrs(nvs, &attrs);
+  slot_size = attrs.regionSize;
+  sector_size = attrs.sectorSize;
+  if(slot_size <= OTA_SLOT_IMAGE) {
+    NVS_close(nvs);
+    nvs = NULL;
+    return -1;
+  }
+
+  SHA2_init();
+  SHA2_Params_init(&sha2_params);
+  sha2_params.returnBehavior = SHA2_RETURN_BEHAVIOR_POLLING;
+  sha2 = SHA2_open(Board_SHA20, &sha2_params);
+
+  /* A P-256 verification takes tens of ms, the loop runs meanwhile */
+  ECDSA_init();
+  ECDSA_Params_init(&ecdsa_params);
+  ecdsa_params.returnBehavior = ECDSA_RETURN_BEHAVIOR_CALLBACK;
+  ecdsa_params.callbackFxn = verify_done;
+  ecdsa = ECDSA_open(Board_ECDSA0, &ecdsa_params);
+  if(sha2 == NULL || ecdsa == NULL) {
+    ecdsa = NULL;
+    return -1;
+  }
+
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+ota_input(const linkaddr_t *src, const uint8_t *data, uint16_t len)
+{
+  if(len < OTA_HDR_LEN) {
+    return;
+  }
+
+  switch(data[0]) {
+  case OTA_MSG_BEGIN:
+    begin(src, data, len);
+    break;
+  case OTA_MSG_DATA:
+    data_input(src, data, len);
+    break;
+  case OTA_MSG_COMMIT:
+    commit(src, data);
+    break;
+  case OTA_MSG_STATUS:
+    if(len == OTA_STATUS_LEN) {
+      host_link_send(HOST_CMD_OTA_STATUS, src, LINKADDR_SIZE, data, len);
+    }
+    break;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+start_receiving(void)
+{
+  buffers[0].len = 0;
+  buffers[1].len = 0;
+  fill_index = 0;
+  decode_index = 0;
+  dec_state = DEC_OP;
+  varint = 0;
+  varint_shift = 0;
+  copy_pos = 0;
+  out_len = 0;
+  page_fill = 0;
+  /* The first flush erases the header of the image before */
+  out_offset = OTA_SLOT_IMAGE;
+  erased_end = 0;
+  state = STATE_RECEIVING;
+
+  LOG_RECORD(OTA_BEGIN, session, image_len, delta_len);
+  send_status(&sender, OTA_STATUS_OK);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(ota_process, ev, data)
+{
+  static struct buffer *b;
+  static uint32_t offset;
+  static uint16_t chunk;
+  static uint16_t acc;
+  static uint8_t gen;
+
+  PROCESS_BEGIN();
+
+  while(1) {
+    /* A session begun during one of the pauses below had its poll taken
+     * by the pause, and gets no other */
+    if(state != STATE_CHECKING) {
+      PROCESS_YIELD_UNTIL(ev == PROCESS_EVENT_POLL);
+    }
+
+    /* Signature, then CRC of the base, CHECK_LEN bytes per pass. A new
+     * session meanwhile starts the check over. */
+    while(state == STATE_CHECKING) {
+      gen = generation;
+
+      ECDSA_OperationVerify_init(&verify_op);
+      verify_op.curve = &ECCParams_NISTP256;
+      verify_op.theirPublicKey = &public_key;
+      verify_op.hash = digest;
+      verify_op.r = signature;
+      verify_op.s = &signature[OTA_SIGNATURE_LEN / 2];
+      verify_status = VERIFY_PENDING;
+      if(ECDSA_verify(ecdsa, &verify_op) != ECDSA_STATUS_SUCCESS) {
+        verify_status = ECDSA_STATUS_ERROR;
+      }
+      PROCESS_WAIT_UNTIL(verify_status != VERIFY_PENDING);
+      if(verify_status != ECDSA_STATUS_SUCCESS) {
+        state = STATE_FAILED;
+        failure = OTA_STATUS_SIGNATURE;
+        LOG_RECORD(OTA_FAILED, session, 0);
+        send_status(&sender, OTA_STATUS_SIGNATURE);
+        continue;
+      }
+
+      if(base_len != cached_crc_len) {
+        acc = 0;
+        for(offset = 0; gen == generation && offset < base_len;
+            offset += chunk) {
+          chunk = MIN(base_len - offset, CHECK_LEN);
+          acc = running_crc(offset, chunk, acc);
+          PROCESS_PAUSE();
+        }
+        if(gen != generation) {
+          continue;
+        }
+        cached_crc_len = base_len;
+        cached_crc = acc;
+      }
+
+      if(cached_crc != base_crc) {
+        state = STATE_FAILED;
+        failure = OTA_STATUS_BASE;
+        send_status(&sender, OTA_STATUS_BASE);
+      } else {
+        start_receiving();
+      }
+    }
+
+    /* One page per pass, the RX path runs in between */
+    while(state == STATE_RECEIVING &&
+          (buffers[decode_index].len != 0 || dec_state == DEC_COPY)) {
+      b = buffers[decode_index].len != 0 ? &buffers[decode_index] : NULL;
+      if(decode(b) != 0 ||
+         (page_fill == OTA_WRITE_LEN && flush() != 0)) {
+        fail();
+        break;
+      }
+      if(b != NULL && b->pos == b->len) {
+        b->len = 0;
+        decode_index ^= 1;
+      }
+      PROCESS_PAUSE();
+    }
+
+    if(state != STATE_RECEIVING || rx_offset != delta_len ||
+       buffers[decode_index].len != 0 || dec_state == DEC_COPY) {
+      continue;
+    }
+
+    if(dec_state != DEC_OP || varint_shift != 0 || out_len != image_len ||
+       (page_fill > 0 && flush() != 0)) {
+      fail();
+      continue;
+    }
+
+    /* Hash the whole image read back, a page at a time */
+    state = STATE_VERIFYING;
+    SHA2_reset(sha2);
+    for(offset = 0; state == STATE_VERIFYING && offset < image_len;
+        offset += chunk) {
+      chunk = MIN(image_len - offset, OTA_WRITE_LEN);
+      if(NVS_read(nvs, OTA_SLOT_IMAGE + offset, page, chunk) !=
+         NVS_STATUS_SUCCESS ||
+         SHA2_addData(sha2, page, chunk) != SHA2_STATUS_SUCCESS) {
+        break;
+      }
+      PROCESS_PAUSE();
+    }
+
+    /* A new session may have started meanwhile */
+    if(state != STATE_VERIFYING) {
+      continue;
+    }
+
+    if(offset < image_len ||
+       SHA2_finalize(sha2, page) != SHA2_STATUS_SUCCESS ||
+       memcmp(page, digest, OTA_DIGEST_LEN) != 0 || write_header() != 0) {
+      fail();
+      continue;
+    }
+
+    state = STATE_DONE;
+    LOG_RECORD(OTA_DONE, session, image_len);
+    send_status(&sender, OTA_STATUS_DONE);
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,173 @@
+/**
+ * \file
+ *         Firmware updates over the air, as deltas against the running image
+ *
+ *         An update travels as a delta that rebuilds the new image out of
+ *         the running one, generated by tools/ota-delta.py. It is made of
+ *         operations, each starting with a varint v, an LZ-style copy from
+ *         the running image when v is odd and a literal run otherwise, of
+ *         (v >> 1) + 1 bytes:
+ *         copy:    [v] [zigzag varint source offset, relative to the end of
+ *                      the previous copy]
+ *         literal: [v] [bytes]
+ *         Once linked, most of a new image is code that did not move or
+ *         moved as a block, so a delta takes a fraction of the image.
+ *
+ *         The delta is carried in FRAG_PORT_OTA messages, see frag.h, from
+ *         a node whose host pushes it, HOST_CMD_OTA_SEND, to a neighbor or
+ *         to itself. Every message starts with [kind (1)] [session (1)]:
+ *         OTA_MSG_BEGIN  [image length (4)] [base length (4)]
+ *                        [base CRC (2)] [delta length (4)]
+ *                        [image SHA-256 (32)] [signature (64)]
+ *         OTA_MSG_DATA   [delta offset (4)] [delta]
+ *         OTA_MSG_COMMIT
+ *         and the target answers each with
+ *         OTA_MSG_STATUS [status (1)] [next delta offset (4)]
+ *         which the sending node hands to its host, HOST_CMD_OTA_STATUS.
+ *
+ *         The signature is ECDSA over P-256 of the image SHA-256, r then s,
+ *         big endian, made by tools/ota-delta.py with the private key of
+ *         OTA_CONF_PUBLIC_KEY. Without a key updates are refused. The base
+ *         CRC is crc16_data() over the whole running image, a delta only
+ *         applies to the image whose length and CRC it names as its base.
+ *         The target answers OTA_MSG_BEGIN with OTA_STATUS_BUSY while it
+ *         checks the signature on the crypto engine, before any flash is
+ *         erased, and reads the base back a little at a time, then with
+ *         OTA_STATUS_OK, OTA_STATUS_SIGNATURE or OTA_STATUS_BASE.
+ *
+ *         The new image is written to the secondary slot in the external
+ *         flash, at OTA_SLOT_IMAGE. Data messages are copied into one of
+ *         two buffers and acknowledged right away, and the update process
+ *         decodes and programs them one flash page at a time, yielding in
+ *         between. The sender has the next message on the air while the
+ *         previous one is being written, and the RF core keeps receiving
+ *         during the flash writes.
+ *
+ *         Once the image read back from the slot hashes to the signed
+ *         SHA-256, the slot header the boot loader looks for is written
+ *         at the start of the slot, little endian:
+ *         [magic (4)] [version (1)] [flags (1)] [0xFFFF (2)]
+ *         [image length (4)] [image SHA-256 (32)] [signature (64)]
+ *         Flags are set by clearing their bit, the way flash programs:
+ *         OTA_MSG_COMMIT clears OTA_SLOT_COMMITTED and resets the node. The
+ *         boot loader installs a committed image whose OTA_SLOT_INSTALLED
+ *         is still set at OTA_IMAGE_BASE, then clears it; it can check the
+ *         signature again with the same key. The first page of a new
+ *         session erases the header, so a slot with a header holds a whole,
+ *         signed image.
+ *
+ *         Lost messages and answers are repeated by the sender: every
+ *         status names the delta offset the target expects next, and a
+ *         repeated OTA_MSG_BEGIN of the session being received resumes it.
+ */
+#ifndef OTA_H
+#define OTA_H
+
+#include "contiki.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------*/
+/** Bytes programmed at a time, flash writes yield to the RX path in between */
+#ifdef OTA_CONF_WRITE_LEN
+#define OTA_WRITE_LEN OTA_CONF_WRITE_LEN
+#else
+#define OTA_WRITE_LEN 256
+#endif
+
+/** Address of the running image in the internal flash */
+#ifdef OTA_CONF_IMAGE_BASE
+#define OTA_IMAGE_BASE OTA_CONF_IMAGE_BASE
+#else
+#define OTA_IMAGE_BASE 0x00000000UL
+#endif
+
+/** Size of the internal flash, no base of a delta is read past it */
+#ifdef OTA_CONF_FLASH_SIZE
+#define OTA_FLASH_SIZE OTA_CONF_FLASH_SIZE
+#else
+#define OTA_FLASH_SIZE 0x00058000UL
+#endif
+
+/** Time between a commit and the reset into the new image, in clock ticks */
+#ifdef OTA_CONF_REBOOT_DELAY
+#define OTA_REBOOT_DELAY OTA_CONF_REBOOT_DELAY
+#else
+#define OTA_REBOOT_DELAY CLOCK_SECOND
+#endif
+
+/** Public key updates are signed with, P-256 as 0x04 || X || Y, see
+ * tools/ota-delta.py --export-key. Updates are refused without one. */
+#define OTA_PUBLIC_KEY_LEN 65
+
+/** \name Slot header, read by the boot loader @{ */
+#define OTA_SLOT_MAGIC      0x4941544FUL /* "OTAI" */
+#define OTA_SLOT_VERSION    1
+/** Offset of the flags in the header */
+#define OTA_SLOT_FLAGS      5
+#define OTA_SLOT_HDR_LEN    108
+/** Offset of the image in the slot */
+#define OTA_SLOT_IMAGE      0x100
+/** Cleared by OTA_MSG_COMMIT, install at the next reset */
+#define OTA_SLOT_COMMITTED  0x01
+/** Cleared by the boot loader once the image is installed */
+#define OTA_SLOT_INSTALLED  0x02
+/** @} */
+
+/** \name Message kinds @{ */
+#define OTA_MSG_BEGIN  0
+#define OTA_MSG_DATA   1
+#define OTA_MSG_COMMIT 2
+#define OTA_MSG_STATUS 3
+/** @} */
+
+#define OTA_HDR_LEN        2
+#define OTA_DIGEST_LEN     32
+#define OTA_SIGNATURE_LEN  64
+#define OTA_BEGIN_LEN      (OTA_HDR_LEN + 14 + OTA_DIGEST_LEN + \
+                            OTA_SIGNATURE_LEN)
+#define OTA_DATA_HDR_LEN   (OTA_HDR_LEN + 4)
+#define OTA_STATUS_LEN     (OTA_HDR_LEN + 5)
+
+/** \name OTA_MSG_STATUS codes @{ */
+/** Send the delta from the offset given */
+#define OTA_STATUS_OK       0
+/** Both buffers are full, repeat the message later */
+#define OTA_STATUS_BUSY     1
+/** The whole image is written and hashes to the signed SHA-256 */
+#define OTA_STATUS_DONE     2
+/** The delta is corrupt, or the flash could not be written */
+#define OTA_STATUS_ERROR    3
+/** The delta was made for another running image */
+#define OTA_STATUS_BASE     4
+/** No OTA_MSG_BEGIN for this session */
+#define OTA_STATUS_SESSION  5
+/** The signature does not verify with OTA_CONF_PUBLIC_KEY */
+#define OTA_STATUS_SIGNATURE 6
+/** @} */
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Open the secondary slot and the crypto drivers, and allocate the
+ *        receive buffers.
+ * \return 0 on success, -1 without OTA_CONF_PUBLIC_KEY or if the external
+ *         flash or the crypto engine cannot be used, updates are refused
+ *         then.
+ */
+int ota_init(void);
+
+/**
+ * \brief Handle an update message, from a neighbor or from the host of
+ *        this node.
+ */
+void ota_input(const linkaddr_t *src, const uint8_t *data, uint16_t len);
+/*---------------------------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OTA_H */
@@ -0,0 +1,436 @@
+/**
+ * \file
+ *         Network state kept in on-chip flash across resets
+ */
+#include "contiki.h"
+#include "persist.h"
+#include "byteorder.h"
+#include "lib/crc16.h"
+#include "lib/list.h"
+#include "log-ring.h"
+
+#include <ti/drivers/NVS.h>
+
+#include "Board.h"
+
+#include <string.h>
+/*---------------------------------------------------------------------------*/
+#define BANK_MAGIC    0x54535250UL /* "PRST" */
+#define BANK_HDR_LEN  8
+
+#define REC_TYPE      0
+#define REC_ZERO      1
+#define REC_LEN       2
+#define REC_CRC       4
+#define REC_RESERVED  6
+#define REC_HDR_LEN   8
+
+#define ALIGN(len)    (((len) + 3UL) & ~3UL)
+
+/* Flash is read and copied through a buffer of this size on the stack */
+#define CHUNK_LEN     32
+
+#define WRITE_FLAGS   (NVS_WRITE_PRE_VERIFY | NVS_WRITE_POST_VERIFY)
+/*---------------------------------------------------------------------------*/
+struct record {
+  /* Of the data within the bank, 0 if there is no record of the type */
+  uint32_t offset;
+  uint16_t len;
+  uint16_t crc;
+};
+
+static NVS_Handle nvs;
+static uint32_t bank_size;
+static uint8_t bank;
+static uint32_t generation;
+/* First free byte of the active bank, the bank size once a write failed
+ * so that the next save compacts */
+static uint32_t end;
+
+static struct record records[PERSIST_TYPE_COUNT];
+
+/* Record streamed by persist_put() or persist_get(), in the region */
+static uint32_t cursor;
+static uint32_t limit;
+static uint16_t stream_len;
+static uint16_t stream_crc;
+static uint8_t writing;
+static uint8_t write_failed;
+
+LIST(handlers);
+static struct ctimer save_timer;
+static uint8_t save_pending;
+/*---------------------------------------------------------------------------*/
+static uint32_t
+bank_base(uint8_t b)
+{
+  return b * bank_size;
+}
+/*---------------------------------------------------------------------------*/
+static int
+read_bank_header(uint8_t b, uint32_t *gen)
+{
+  uint8_t hdr[BANK_HDR_LEN];
+
+  if(NVS_read(nvs, bank_base(b), hdr, sizeof(hdr)) != NVS_STATUS_SUCCESS ||
+     get_le32(&hdr[0]) != BANK_MAGIC) {
+    return -1;
+  }
+
+  *gen = get_le32(&hdr[4]);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+write_bank_header(uint8_t b, uint32_t gen)
+{
+  uint8_t hdr[BANK_HDR_LEN];
+
+  put_le32(&hdr[0], BANK_MAGIC);
+  put_le32(&hdr[4], gen);
+
+  return NVS_write(nvs, bank_base(b), hdr, sizeof(hdr), WRITE_FLAGS) ==
+         NVS_STATUS_SUCCESS ? 0 : -1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+write_record_header(uint32_t offset, uint8_t type, uint16_t len, uint16_t crc)
+{
+  uint8_t hdr[REC_HDR_LEN];
+
+  hdr[REC_TYPE] = type;
+  hdr[REC_ZERO] = 0;
+  put_le16(&hdr[REC_LEN], len);
+  put_le16(&hdr[REC_CRC], crc);
+  /* Left erased */
+  hdr[REC_RESERVED] = 0xFF;
+  hdr[REC_RESERVED + 1] = 0xFF;
+
+  return NVS_write(nvs, offset, hdr, sizeof(hdr), WRITE_FLAGS) ==
+         NVS_STATUS_SUCCESS ? 0 : -1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+check_crc(uint32_t offset, uint16_t len, uint16_t crc)
+{
+  uint8_t buf[CHUNK_LEN];
+  uint16_t acc = 0;
+  uint16_t chunk;
+
+  for(; len > 0; len -= chunk, offset += chunk) {
+    chunk = MIN(len, sizeof(buf));
+    if(NVS_read(nvs, offset, buf, chunk) != NVS_STATUS_SUCCESS) {
+      return -1;
+    }
+    acc = crc16_data(buf, chunk, acc);
+  }
+
+  return acc == crc ? 0 : -1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+erased(const uint8_t *data, unsigned len)
+{
+  while(len-- > 0) {
+    if(*data++ != 0xFF) {
+      return 0;
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Walk the log of the active bank up to the first erased header */
+static void
+scan(void)
+{
+  const uint32_t base = bank_base(bank);
+  uint8_t hdr[REC_HDR_LEN];
+  uint32_t offset = BANK_HDR_LEN;
+  uint16_t len;
+  uint16_t crc;
+
+  memset(records, 0, sizeof(records));
+
+  while(offset + REC_HDR_LEN <= bank_size) {
+    if(NVS_read(nvs, base + offset, hdr, sizeof(hdr)) != NVS_STATUS_SUCCESS) {
+      offset = bank_size;
+      break;
+    }
+    if(erased(hdr, sizeof(hdr))) {
+      break;
+    }
+
+    len = get_le16(&hdr[REC_LEN]);
+    crc = get_le16(&hdr[REC_CRC]);
+    if(hdr[REC_ZERO] != 0 || offset + REC_HDR_LEN + len > bank_size ||
+       check_crc(base + offset + REC_HDR_LEN, len, crc) != 0) {
+      /* Nothing after a bad header can be trusted, nor written to */
+      offset = bank_size;
+      break;
+    }
+
+    /* Types unknown to this image are skipped and left out of compaction */
+    if(hdr[REC_TYPE] < PERSIST_TYPE_COUNT) {
+      records[hdr[REC_TYPE]].offset = offset + REC_HDR_LEN;
+      records[hdr[REC_TYPE]].len = len;
+      records[hdr[REC_TYPE]].crc = crc;
+    }
+    offset += REC_HDR_LEN + ALIGN(len);
+  }
+
+  end = MIN(offset, bank_size);
+}
+/*---------------------------------------------------------------------------*/
+static int
+format(void)
+{
+  bank = 0;
+  generation = 1;
+  memset(records, 0, sizeof(records));
+  end = BANK_HDR_LEN;
+
+  if(NVS_erase(nvs, bank_base(bank), bank_size) != NVS_STATUS_SUCCESS) {
+    return -1;
+  }
+  return write_bank_header(bank, generation);
+}
+/*---------------------------------------------------------------------------*/
+static int
+copy(uint32_t to, uint32_t from, uint16_t len)
+{
+  uint8_t buf[CHUNK_LEN];
+  uint16_t chunk;
+
+  for(; len > 0; len -= chunk, to += chunk, from += chunk) {
+    chunk = MIN(len, sizeof(buf));
+    if(NVS_read(nvs, from, buf, chunk) != NVS_STATUS_SUCCESS ||
+       NVS_write(nvs, to, buf, chunk, WRITE_FLAGS) != NVS_STATUS_SUCCESS) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Move the latest records to the other bank and make it the active one */
+static int
+compact(void)
+{
+  const uint8_t to = bank ^ 1;
+  const uint32_t from_base = bank_base(bank);
+  const uint32_t to_base = bank_base(to);
+  struct record moved[PERSIST_TYPE_COUNT];
+  uint32_t offset = BANK_HDR_LEN;
+  unsigned type;
+
+  if(NVS_erase(nvs, to_base, bank_size) != NVS_STATUS_SUCCESS) {
+    return -1;
+  }
+
+  memset(moved, 0, sizeof(moved));
+  for(type = 0; type < PERSIST_TYPE_COUNT; type++) {
+    if(records[type].offset == 0) {
+      continue;
+    }
+    if(copy(to_base + offset + REC_HDR_LEN,
+            from_base + records[type].offset, records[type].len) != 0 ||
+       write_record_header(to_base + offset, type, records[type].len,
+                           records[type].crc) != 0) {
+      return -1;
+    }
+    moved[type] = records[type];
+    moved[type].offset = offset + REC_HDR_LEN;
+    offset += REC_HDR_LEN + ALIGN(records[type].len);
+  }
+
+  if(write_bank_header(to, generation + 1) != 0) {
+    return -1;
+  }
+
+  bank = to;
+  generation++;
+  end = offset;
+  memcpy(records, moved, sizeof(records));
+  LOG_RECORD(PERSIST_COMPACTED, bank, generation, end);
+
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Run save(), writing from offset in the region if write is set */
+static void
+stream(struct persist_handler *handler, int write, uint32_t offset)
+{
+  cursor = offset;
+  stream_len = 0;
+  stream_crc = 0;
+  writing = write;
+  write_failed = 0;
+
+  handler->save();
+
+  writing = 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+append(struct persist_handler *handler, uint16_t len, uint16_t crc)
+{
+  const uint32_t base = bank_base(bank);
+
+  if(end + REC_HDR_LEN + len > bank_size) {
+    return -1;
+  }
+
+  stream(handler, 1, base + end + REC_HDR_LEN);
+  if(write_failed || stream_len != len || stream_crc != crc ||
+     write_record_header(base + end, handler->type, len, crc) != 0) {
+    /* Whatever was programmed stays in the way */
+    end = bank_size;
+    return -1;
+  }
+
+  records[handler->type].offset = end + REC_HDR_LEN;
+  records[handler->type].len = len;
+  records[handler->type].crc = crc;
+  end += REC_HDR_LEN + ALIGN(len);
+
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+save_timeout(void *ptr)
+{
+  struct persist_handler *handler;
+
+  save_pending = 0;
+
+  for(handler = list_head(handlers); handler != NULL;
+      handler = list_item_next(handler)) {
+    persist_save(handler);
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+persist_init(void)
+{
+  NVS_Params params;
+  NVS_Attrs attrs;
+  uint32_t gen[2];
+  int valid[2];
+  uint8_t b;
+
+  if(!PERSIST_ENABLED) {
+    return 0;
+  }
+
+  NVS_init();
+  NVS_Params_init(&params);
+  nvs = NVS_open(Board_NVSINTERNAL, &params);
+  if(nvs == NULL) {
+    return -1;
+  }
+
+  /* Banks of whole sectors, so that each is erased on its own */
+  NVS_getAttrs(nvs, &attrs);
+  bank_size = (attrs.regionSize / 2 / attrs.sectorSize) * attrs.sectorSize;
+  if(bank_size == 0) {
+    NVS_close(nvs);
+    nvs = NULL;
+    return -1;
+  }
+
+  for(b = 0; b < 2; b++) {
+    valid[b] = read_bank_header(b, &gen[b]) == 0;
+  }
+
+  if(valid[0] || valid[1]) {
+    bank = !valid[0] || (valid[1] && (int32_t)(gen[1] - gen[0]) > 0);
+    generation = gen[bank];
+    scan();
+  } else if(format() != 0) {
+    NVS_close(nvs);
+    nvs = NULL;
+    return -1;
+  }
+
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+persist_register(struct persist_handler *handler)
+{
+  const struct record *r = &records[handler->type];
+
+  list_add(handlers, handler);
+
+  if(nvs == NULL || r->offset == 0) {
+    return;
+  }
+
+  cursor = bank_base(bank) + r->offset;
+  limit = cursor + r->len;
+  handler->restore(r->len);
+  LOG_RECORD(PERSIST_RESTORED, handler->type, r->len);
+}
+/*---------------------------------------------------------------------------*/
+int
+persist_save(struct persist_handler *handler)
+{
+  const struct record *r = &records[handler->type];
+  uint16_t len;
+  uint16_t crc;
+
+  if(nvs == NULL) {
+    return -1;
+  }
+
+  stream(handler, 0, 0);
+  len = stream_len;
+  crc = stream_crc;
+  if(r->offset != 0 && r->len == len && r->crc == crc) {
+    return 0;
+  }
+
+  if(append(handler, len, crc) == 0 ||
+     (compact() == 0 && append(handler, len, crc) == 0)) {
+    return 0;
+  }
+
+  LOG_RECORD(PERSIST_FAILED, handler->type, len);
+  return -1;
+}
+/*---------------------------------------------------------------------------*/
+void
+persist_changed(void)
+{
+  if(nvs != NULL && !save_pending) {
+    save_pending = 1;
+    ctimer_set(&save_timer, PERSIST_INTERVAL, save_timeout, NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+persist_put(const void *data, uint16_t len)
+{
+  if(writing && !write_failed &&
+     NVS_write(nvs, cursor, (void *)data, len, WRITE_FLAGS) !=
+     NVS_STATUS_SUCCESS) {
+    write_failed = 1;
+  }
+
+  stream_crc = crc16_data((const unsigned char *)data, len, stream_crc);
+  stream_len += len;
+  cursor += len;
+}
+/*---------------------------------------------------------------------------*/
+int
+persist_get(void *data, uint16_t len)
+{
+  if(cursor + len > limit ||
+     NVS_read(nvs, cursor, data, len) != NVS_STATUS_SUCCESS) {
+    return -1;
+  }
+
+  cursor += len;
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
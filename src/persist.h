@@ -0,0 +1,134 @@
+/**
+ * \file
+ *         Network state kept in on-chip flash across resets
+ *
+ *         Modules that take a while to learn their state, the neighbor
+ *         table, the route cache, the radio settings from the host, the
+ *         link security frame counter, the payloads held for destinations
+ *         out of reach and the channel the mesh moved to, save it in the
+ *         NVS region of the internal flash and get it back at boot. After
+ *         a brown-out a relay is forwarding again as soon as the radio is
+ *         up, instead of relearning its neighborhood and rediscovering
+ *         every route.
+ *
+ *         The region is split in two banks used as an append-only log. A
+ *         record is its header
+ *         [type (1)] [0 (1)] [length (2)] [CRC-16 (2)] [0xFFFF (2)]
+ *         followed by the data, the CRC being crc16_data() over the data.
+ *         Records start on four byte boundaries, and the header is
+ *         programmed after the data so a record torn by a reset reads as
+ *         erased flash. The last valid record of a type is the one restored.
+ *
+ *         When the active bank is full the latest record of every type is
+ *         copied to the other bank, which is erased first, and its header
+ *         [magic (4)] [generation (4)] is written last of all. The bank
+ *         with the highest generation is the active one, so a compaction
+ *         interrupted by a reset leaves the old bank in use. Erases
+ *         alternate between the banks, and saving a state that did not
+ *         change since its last record writes nothing.
+ *
+ *         Modules call persist_changed() as their state changes, and
+ *         everything is saved PERSIST_INTERVAL after the first change, so
+ *         the save timer only runs on a busy network. Restored state only
+ *         goes back to the last save. Modules that must never go back in
+ *         time, like the frame counter, save at the moment it matters with
+ *         persist_save().
+ */
+#ifndef PERSIST_H
+#define PERSIST_H
+
+#include "contiki.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------*/
+#ifdef PERSIST_CONF_ENABLED
+#define PERSIST_ENABLED PERSIST_CONF_ENABLED
+#else
+#define PERSIST_ENABLED 1
+#endif
+
+/** Longest time a changed state waits to be saved, in clock ticks */
+#ifdef PERSIST_CONF_INTERVAL
+#define PERSIST_INTERVAL PERSIST_CONF_INTERVAL
+#else
+#define PERSIST_INTERVAL (600UL * CLOCK_SECOND)
+#endif
+
+/** \name Record types, one per module @{ */
+#define PERSIST_RADIO      0
+#define PERSIST_NEIGHBORS  1
+#define PERSIST_ROUTES     2
+#define PERSIST_TX_COUNTER 3
+#define PERSIST_STORE      4
+#define PERSIST_CHANNEL    5
+#define PERSIST_TYPE_COUNT 6
+/** @} */
+/*---------------------------------------------------------------------------*/
+/**
+ * State saved by a module. Both callbacks stream the state, save() with
+ * persist_put() and restore() with persist_get(), and run from
+ * persist_register() and persist_save() only.
+ *
+ * save() is called twice per save, once to find out whether the state
+ * changed, and must produce the same bytes both times.
+ */
+struct persist_handler {
+  struct persist_handler *next;
+  uint8_t type;
+  void (*save)(void);
+  /** len is the length of the saved state */
+  void (*restore)(uint16_t len);
+};
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Open the NVS region and find the latest records.
+ *
+ * Called before the modules register, the state is restored as they do.
+ * An unreadable region is formatted. Without a call registering does
+ * nothing and saving fails.
+ *
+ * \return 0 on success, -1 if the flash cannot be used.
+ */
+int persist_init(void);
+
+/**
+ * \brief Register the state of a module and restore its last record.
+ */
+void persist_register(struct persist_handler *handler);
+
+/**
+ * \brief Save the state of a module now, if it changed.
+ *
+ * Blocks while the flash is programmed, and erased if the bank fills up.
+ *
+ * \return 0 once saved or when unchanged, -1 if it could not be written.
+ */
+int persist_save(struct persist_handler *handler);
+
+/**
+ * \brief Note that a registered state changed, cheap enough for every frame.
+ */
+void persist_changed(void);
+
+/**
+ * \brief Append state data to the record being saved.
+ */
+void persist_put(const void *data, uint16_t len);
+
+/**
+ * \brief Read the next state data of the record being restored.
+ * \return 0 on success, -1 past the end of the record or on a read error.
+ */
+int persist_get(void *data, uint16_t len);
+/*---------------------------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PERSIST_H */
@@ -0,0 +1,48 @@
+/**
+ * \file
+ *         Per neighbor TX power control
+ */
+#include "contiki.h"
+#include "power-ctrl.h"
+#include "neighbor.h"
+#include "rf-core.h"
+/*---------------------------------------------------------------------------*/
+static int enabled = POWER_CTRL_ENABLED;
+/*---------------------------------------------------------------------------*/
+int8_t
+power_ctrl_tx_power(const linkaddr_t *dst)
+{
+  const int8_t full = rf_core_get_tx_power();
+  int8_t heard;
+  int i;
+
+  if(!enabled || linkaddr_cmp(dst, &linkaddr_null)) {
+    return full;
+  }
+
+  i = neighbor_find(dst);
+  if(i < 0 || neighbor_prr(i) < POWER_CTRL_MIN_PRR) {
+    return full;
+  }
+
+  heard = neighbor_ref_rssi(i);
+  if(heard == NEIGHBOR_RSSI_UNKNOWN || heard <= POWER_CTRL_TARGET_RSSI) {
+    return full;
+  }
+
+  /* rf_core_transmit_at() rounds up to the next power it has */
+  return full - (heard - POWER_CTRL_TARGET_RSSI);
+}
+/*---------------------------------------------------------------------------*/
+void
+power_ctrl_set_enabled(int on)
+{
+  enabled = on;
+}
+/*---------------------------------------------------------------------------*/
+int
+power_ctrl_enabled(void)
+{
+  return enabled;
+}
+/*---------------------------------------------------------------------------*/
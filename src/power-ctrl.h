@@ -0,0 +1,70 @@
+/**
+ * \file
+ *         Per neighbor TX power control
+ *
+ *         Unicast frames go out at the lowest TX power expected to reach
+ *         their destination at POWER_CTRL_TARGET_RSSI. Broadcasts are
+ *         always sent at the default power, so the RSSI of the broadcasts
+ *         heard from a neighbor gives the path loss towards it, assuming a
+ *         symmetric link; the power is lowered by whatever the neighbor is
+ *         heard above the target.
+ *
+ *         There is no acknowledgement telling how the lowered power does,
+ *         the reception ratio of the frames heard from the neighbor
+ *         stands in for it. Below POWER_CTRL_MIN_PRR, or for neighbors
+ *         whose broadcasts were not heard yet, frames go at full power.
+ */
+#ifndef POWER_CTRL_H
+#define POWER_CTRL_H
+
+#include "contiki.h"
+#include "net/linkaddr.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------*/
+#ifdef POWER_CTRL_CONF_ENABLED
+#define POWER_CTRL_ENABLED POWER_CTRL_CONF_ENABLED
+#else
+#define POWER_CTRL_ENABLED 1
+#endif
+
+/** RSSI unicast frames should arrive with, in dBm */
+#ifdef POWER_CTRL_CONF_TARGET_RSSI
+#define POWER_CTRL_TARGET_RSSI POWER_CTRL_CONF_TARGET_RSSI
+#else
+#define POWER_CTRL_TARGET_RSSI (-95)
+#endif
+
+/** Reception ratio below which a neighbor gets full power, 255 is 100 % */
+#ifdef POWER_CTRL_CONF_MIN_PRR
+#define POWER_CTRL_MIN_PRR POWER_CTRL_CONF_MIN_PRR
+#else
+#define POWER_CTRL_MIN_PRR 230
+#endif
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief TX power for a frame to a destination, in dBm.
+ */
+int8_t power_ctrl_tx_power(const linkaddr_t *dst);
+
+/**
+ * \brief Turn power control on or off at runtime.
+ */
+void power_ctrl_set_enabled(int enabled);
+
+/**
+ * \brief Whether power control is on.
+ */
+int power_ctrl_enabled(void);
+/*---------------------------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* POWER_CTRL_H */
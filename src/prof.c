@@ -0,0 +1,140 @@
+/**
+ * \file
+ *         Hot path cycle profiling on the Cortex-M4F DWT cycle counter
+ */
+#include "contiki.h"
+#include "prof.h"
+#include "byteorder.h"
+#include "host-link.h"
+#include "sys/int-master.h"
+
+#include <string.h>
+/*---------------------------------------------------------------------------*/
+#define DEMCR           (*(volatile uint32_t *)0xE000EDFC)
+#define DEMCR_TRCENA    (1UL << 24)
+#define DWT_CTRL        (*(volatile uint32_t *)0xE0001000)
+#define DWT_CTRL_CYCENA (1UL << 0)
+
+/* Per point entry of HOST_CMD_PROF_DATA */
+#define DUMP_ENTRY_LEN  21
+/* Per counter entry of HOST_CMD_PROF_COUNTERS */
+#define COUNTER_ENTRY_LEN 5
+/*---------------------------------------------------------------------------*/
+static struct prof_stats stats[PROF_POINT_COUNT];
+static uint32_t counters[PROF_COUNTER_COUNT];
+
+static void dump_input(const uint8_t *args, uint16_t len);
+
+static struct host_link_handler dump_handler = {
+  NULL, HOST_CMD_PROF_DUMP, dump_input
+};
+/*---------------------------------------------------------------------------*/
+static void
+dump_input(const uint8_t *args, uint16_t len)
+{
+  uint8_t out[PROF_POINT_COUNT * DUMP_ENTRY_LEN];
+  uint8_t counts[PROF_COUNTER_COUNT * COUNTER_ENTRY_LEN];
+  struct prof_stats snapshot;
+  uint8_t *p = out;
+  uint8_t i;
+
+  for(i = 0; i < PROF_POINT_COUNT; i++) {
+    prof_get(i, &snapshot);
+    p[0] = i;
+    put_le32(&p[1], snapshot.count);
+    put_le32(&p[5], snapshot.min);
+    put_le32(&p[9], snapshot.max);
+    put_le32(&p[13], (uint32_t)snapshot.sum);
+    put_le32(&p[17], (uint32_t)(snapshot.sum >> 32));
+    p += DUMP_ENTRY_LEN;
+  }
+
+  p = counts;
+  for(i = 0; i < PROF_COUNTER_COUNT; i++) {
+    p[0] = i;
+    put_le32(&p[1], prof_counter(i));
+    p += COUNTER_ENTRY_LEN;
+  }
+
+  if(host_link_send(HOST_CMD_PROF_DATA, out, sizeof(out), NULL, 0) != 0 ||
+     host_link_send(HOST_CMD_PROF_COUNTERS, counts, sizeof(counts),
+                    NULL, 0) != 0) {
+    host_link_send_result(HOST_CMD_PROF_DUMP, HOST_STATUS_ERROR);
+    return;
+  }
+
+  if(len > 0 && args[0] != 0) {
+    prof_reset();
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+prof_init(void)
+{
+#ifndef PROF_CONF_CYCLES
+  DEMCR |= DEMCR_TRCENA;
+  PROF_DWT_CYCCNT = 0;
+  DWT_CTRL |= DWT_CTRL_CYCENA;
+#endif
+
+  prof_reset();
+
+  host_link_register(&dump_handler);
+}
+/*---------------------------------------------------------------------------*/
+void
+prof_record(uint8_t point, uint32_t cycles)
+{
+  struct prof_stats *s = &stats[point];
+  int_master_status_t status = int_master_read_and_disable();
+
+  if(s->count == 0 || cycles < s->min) {
+    s->min = cycles;
+  }
+  if(cycles > s->max) {
+    s->max = cycles;
+  }
+  s->sum += cycles;
+  s->count++;
+
+  int_master_status_set(status);
+}
+/*---------------------------------------------------------------------------*/
+void
+prof_get(uint8_t point, struct prof_stats *out)
+{
+  int_master_status_t status = int_master_read_and_disable();
+
+  *out = stats[point];
+
+  int_master_status_set(status);
+}
+/*---------------------------------------------------------------------------*/
+void
+prof_count(uint8_t counter)
+{
+  int_master_status_t status = int_master_read_and_disable();
+
+  counters[counter]++;
+
+  int_master_status_set(status);
+}
+/*---------------------------------------------------------------------------*/
+uint32_t
+prof_counter(uint8_t counter)
+{
+  /* Aligned word reads are atomic on the Cortex-M */
+  return counters[counter];
+}
+/*---------------------------------------------------------------------------*/
+void
+prof_reset(void)
+{
+  int_master_status_t status = int_master_read_and_disable();
+
+  memset(stats, 0, sizeof(stats));
+  memset(counters, 0, sizeof(counters));
+
+  int_master_status_set(status);
+}
+/*---------------------------------------------------------------------------*/
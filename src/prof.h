@@ -0,0 +1,131 @@
+/**
+ * \file
+ *         Hot path cycle profiling on the Cortex-M4F DWT cycle counter
+ *
+ *         Wrap a code section in PROF_BEGIN()/PROF_END() with one of the
+ *         points listed in PROF_POINTS and the number of CPU cycles it takes
+ *         is folded into that point's min/max/sum/count. The host reads the
+ *         statistics with HOST_CMD_PROF_DUMP.
+ *
+ *         Sections must begin and end in the same block, and may not span a
+ *         protothread yield. Events that take no time worth measuring are
+ *         counted with PROF_COUNT() on one of the PROF_COUNTERS instead.
+ *         With PROF_CONF_ENABLED set to 0 the macros compile to nothing.
+ */
+#ifndef PROF_H
+#define PROF_H
+
+#include "contiki.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------*/
+#ifdef PROF_CONF_ENABLED
+#define PROF_ENABLED PROF_CONF_ENABLED
+#else
+#define PROF_ENABLED 1
+#endif
+
+/**
+ * Profiled sections. Only append, the host tools identify points by
+ * position.
+ */
+#define PROF_POINTS(X) \
+  X(RF_RX_ISR)   /* RF driver callback */ \
+  X(RF_RX_DRAIN) /* One pass of the RF RX process over the queue */ \
+  X(APP_INPUT)   /* Application handling of one received payload */ \
+  X(TX_QUEUE)    /* Queueing one payload for transmission */ \
+  X(RF_TX)       /* Starting one RF core transmission */ \
+  X(NEIGHBOR_UPDATE) /* Neighbor table update for one received frame */ \
+  X(LINK_SEC_ENCRYPT) /* AES-CCM encryption of one outgoing frame */ \
+  X(LINK_SEC_DECRYPT) /* AES-CCM decryption of one received frame */
+
+#define PROF_POINT_ENUM(name) PROF_##name,
+enum {
+  PROF_POINTS(PROF_POINT_ENUM)
+  PROF_POINT_COUNT
+};
+#undef PROF_POINT_ENUM
+
+/** Event counters. Only append, like PROF_POINTS. */
+#define PROF_COUNTERS(X) \
+  X(DUP_HIT)  /* Flooded packet dropped as already seen */ \
+  X(DUP_MISS) /* Flooded packet seen for the first time */
+
+#define PROF_COUNTER_ENUM(name) PROF_COUNTER_##name,
+enum {
+  PROF_COUNTERS(PROF_COUNTER_ENUM)
+  PROF_COUNTER_COUNT
+};
+#undef PROF_COUNTER_ENUM
+/*---------------------------------------------------------------------------*/
+/** Cycle statistics of one point */
+struct prof_stats {
+  uint32_t count;
+  uint32_t min;
+  uint32_t max;
+  uint64_t sum;
+};
+/*---------------------------------------------------------------------------*/
+#define PROF_DWT_CYCCNT (*(volatile uint32_t *)0xE0001004)
+
+/** Current value of the free running cycle counter. Targets without a DWT,
+ * like the native simulation, provide their own with PROF_CONF_CYCLES(). */
+#ifdef PROF_CONF_CYCLES
+#define PROF_CYCLES() PROF_CONF_CYCLES()
+#else
+#define PROF_CYCLES() PROF_DWT_CYCCNT
+#endif
+
+#if PROF_ENABLED
+#define PROF_BEGIN(point) const uint32_t prof_begin_##point = PROF_CYCLES()
+#define PROF_END(point) \
+  prof_record(PROF_##point, PROF_CYCLES() - prof_begin_##point)
+#define PROF_COUNT(counter) prof_count(PROF_COUNTER_##counter)
+#else
+#define PROF_BEGIN(point)
+#define PROF_END(point)
+#define PROF_COUNT(counter)
+#endif
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Start the cycle counter, clear all statistics and register the
+ *        host link command.
+ */
+void prof_init(void);
+
+/**
+ * \brief Fold one measurement into a point. Safe to call from interrupts.
+ */
+void prof_record(uint8_t point, uint32_t cycles);
+
+/**
+ * \brief Copy the statistics of a point.
+ */
+void prof_get(uint8_t point, struct prof_stats *stats);
+
+/**
+ * \brief Increment a counter. Safe to call from interrupts.
+ */
+void prof_count(uint8_t counter);
+
+/**
+ * \brief Current value of a counter.
+ */
+uint32_t prof_counter(uint8_t counter);
+
+/**
+ * \brief Clear the statistics of every point and every counter.
+ */
+void prof_reset(void);
+/*---------------------------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PROF_H */
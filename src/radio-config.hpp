@@ -0,0 +1,186 @@
+/**
+ * \file
+ *         Compile-time radio configuration
+ *
+ *         The band plan, PHY mode, channel, TX power and frame size are
+ *         template parameters, so everything derived from them is a
+ *         constant and code for bands or modes that are not selected is
+ *         never instantiated. The active configuration is taken from the
+ *         RADIO_CONF_* macros in project-conf.h.
+ */
+#ifndef RADIO_CONFIG_HPP
+#define RADIO_CONFIG_HPP
+
+#include "frame-pool.h"
+#include "rf-core.h"
+
+#include <stdint.h>
+
+namespace radio
+{
+
+enum class Band
+{
+    Eu868,
+    Us915,
+};
+
+enum class PhyMode
+{
+    Fsk50kbps,
+};
+
+/**
+ * Channel plan of a band. Channel 0 frequency and spacing follow the
+ * IEEE 802.15.4g SUN FSK operating mode 1 tables.
+ */
+template <Band band>
+struct BandPlan;
+
+template <>
+struct BandPlan<Band::Eu868>
+{
+    static constexpr uint32_t chan0_khz = 863125;
+    static constexpr uint32_t spacing_khz = 200;
+    static constexpr uint8_t channel_count = 34;
+    static constexpr int8_t max_tx_power_dbm = 14;
+    /** ETSI EN 300 220 duty cycle limit, in per mille of airtime,
+     * enforced by the TX scheduler */
+    static constexpr uint16_t duty_cycle_permille = 10;
+};
+
+template <>
+struct BandPlan<Band::Us915>
+{
+    static constexpr uint32_t chan0_khz = 902200;
+    static constexpr uint32_t spacing_khz = 200;
+    static constexpr uint8_t channel_count = 129;
+    static constexpr int8_t max_tx_power_dbm = 14;
+    static constexpr uint16_t duty_cycle_permille = 1000;
+};
+
+/**
+ * On-air properties of a PHY mode. Only modes with a matching RF core
+ * setup in rf/settings.h can be listed here.
+ */
+template <PhyMode mode>
+struct PhyTraits;
+
+template <>
+struct PhyTraits<PhyMode::Fsk50kbps>
+{
+    static constexpr uint32_t bitrate = 50000;
+    static constexpr uint16_t preamble_bytes = 4;
+    static constexpr uint16_t sync_bytes = 3;
+};
+
+template <Band band_, PhyMode phy_, uint8_t channel_, int8_t tx_power_dbm_,
+          uint16_t max_frame_len_>
+struct RadioConfig
+{
+    using Plan = BandPlan<band_>;
+    using Phy = PhyTraits<phy_>;
+
+    static_assert(channel_ < Plan::channel_count,
+                  "channel is outside of the band plan");
+    static_assert(tx_power_dbm_ <= Plan::max_tx_power_dbm,
+                  "TX power exceeds the band limit");
+    static_assert(max_frame_len_ <= FRAME_MAX_LEN,
+                  "frame size does not fit in the frame pool buffers");
+    static_assert(Plan::duty_cycle_permille > 0 &&
+                  Plan::duty_cycle_permille <= 1000,
+                  "duty cycle out of range");
+
+    static constexpr Band band = band_;
+    static constexpr PhyMode phy = phy_;
+    static constexpr uint8_t channel = channel_;
+    static constexpr int8_t tx_power_dbm = tx_power_dbm_;
+    static constexpr uint16_t max_frame_len = max_frame_len_;
+
+    /** Centre frequency of the boot channel, the RF core works it out
+     * from the band plan so that it can change channels */
+    static constexpr uint32_t frequency_khz =
+        Plan::chan0_khz + channel_ * Plan::spacing_khz;
+
+    /**
+     * Time on air of a frame carrying len payload bytes, in microseconds.
+     * Counts preamble, sync word, PHR and CRC.
+     */
+    static constexpr uint32_t airtimeUs(uint16_t len)
+    {
+        return ((Phy::preamble_bytes + Phy::sync_bytes + 2 + len + 2) *
+                8 * 1000000ULL) / Phy::bitrate;
+    }
+
+    /** Duration of one preamble byte, in microseconds */
+    static constexpr uint16_t preamble_byte_us = (8 * 1000000UL) /
+                                                 Phy::bitrate;
+
+    /**
+     * Carrier sense time of a low-power listening window, in microseconds.
+     * Twice the regular preamble and sync word, enough for the RF core to
+     * see a couple of correlation tops.
+     */
+    static constexpr uint32_t sniff_window_us =
+        2 * (Phy::preamble_bytes + Phy::sync_bytes) * preamble_byte_us;
+
+    /** Start of a transmission to the end of its sync word, in us */
+    static constexpr uint32_t sync_us =
+        (Phy::preamble_bytes + Phy::sync_bytes) * preamble_byte_us;
+};
+
+/** RF core parameters of a configuration */
+template <typename Config>
+constexpr rf_core_params rfCoreParams()
+{
+    return {
+        Config::Plan::chan0_khz,
+        Config::Plan::spacing_khz,
+        Config::Plan::channel_count,
+        Config::channel,
+        Config::tx_power_dbm,
+        Config::max_frame_len,
+        Config::airtimeUs(Config::max_frame_len),
+        Config::preamble_byte_us,
+        Config::sniff_window_us,
+        Config::sync_us,
+        Config::Plan::duty_cycle_permille,
+    };
+}
+
+} // namespace radio
+
+/*---------------------------------------------------------------------------*/
+#ifndef RADIO_CONF_BAND
+#define RADIO_CONF_BAND Eu868
+#endif
+
+#ifndef RADIO_CONF_PHY_MODE
+#define RADIO_CONF_PHY_MODE Fsk50kbps
+#endif
+
+#ifndef RADIO_CONF_CHANNEL
+#define RADIO_CONF_CHANNEL 0
+#endif
+
+#ifndef RADIO_CONF_TX_POWER_DBM
+#define RADIO_CONF_TX_POWER_DBM 14
+#endif
+
+#ifndef RADIO_CONF_MAX_FRAME_LEN
+#define RADIO_CONF_MAX_FRAME_LEN FRAME_MAX_LEN
+#endif
+
+namespace radio
+{
+
+/** The configuration this image is built for */
+using ActiveConfig = RadioConfig<Band::RADIO_CONF_BAND,
+                                 PhyMode::RADIO_CONF_PHY_MODE,
+                                 RADIO_CONF_CHANNEL,
+                                 RADIO_CONF_TX_POWER_DBM,
+                                 RADIO_CONF_MAX_FRAME_LEN>;
+
+} // namespace radio
+
+#endif // RADIO_CONFIG_HPP
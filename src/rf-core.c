@@ -0,0 +1,1010 @@
+/**
+ * \file
+ *         Direct access to the CC1312R RF core in proprietary mode
+ */
+#include "contiki.h"
+#include "rf-core.h"
+#include "frame-pool.h"
+#include "byteorder.h"
+#include "log-ring.h"
+#include "persist.h"
+#include "prof.h"
+#include "stats.h"
+#include "lib/list.h"
+#include "rf/settings.h"
+
+#include <ti/devices/DeviceFamily.h>
+#include DeviceFamily_constructPath(driverlib/rf_data_entry.h)
+#include DeviceFamily_constructPath(driverlib/rf_mailbox.h)
+#include DeviceFamily_constructPath(driverlib/rf_common_cmd.h)
+#include DeviceFamily_constructPath(driverlib/rf_prop_mailbox.h)
+#include DeviceFamily_constructPath(driverlib/rf_prop_cmd.h)
+#include <ti/drivers/rf/RF.h>
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "sys/log.h"
+#define LOG_MODULE "RF"
+#define LOG_LEVEL LOG_LEVEL_APP
+/*---------------------------------------------------------------------------*/
+/* 802.15.4g PHY header, the format prop-mode setups are configured for */
+#define PHR_LEN              2
+#define PHR_FCS_16           0x10
+#define PHR_DATA_WHITENING   0x08
+#define CRC_LEN              2
+
+/* Length prefix the RF core writes at the start of every data entry */
+#define ENTRY_LEN_SIZE       2
+
+#define frame_entry(f) ((rfc_dataEntryGeneral_t *)(f)->entry)
+
+/* Carrier sense gives up after this many correlation periods without a
+ * preamble, and calls the channel busy after one correlation top */
+#define SNIFF_CORR_INVALID   3
+#define SNIFF_CORR_BUSY      1
+
+/* Sets of RX command and output used in turn */
+#define RX_CMDS              2
+/*---------------------------------------------------------------------------*/
+static RF_Object rf_object;
+static RF_Handle rf_handle;
+static RF_CmdHandle rx_handle;
+
+/* Frames queued to the RF core, oldest first */
+LIST(rx_frames);
+static dataQueue_t rx_queue;
+static uint8_t rx_queued;
+
+/* The RX command a transmission cuts short winds down on its own, while
+ * the next one is already being prepared: each RX command is posted with
+ * the other set of command and output than the one before */
+static rfc_CMD_PROP_RX_ADV_t rx_adv[RX_CMDS];
+static rfc_CMD_PROP_RX_ADV_SNIFF_t rx_adv_sniff[RX_CMDS];
+static rfc_propRxOutput_t rx_stats[RX_CMDS];
+/* Command or chain each set was last posted with */
+static RF_CmdHandle rx_cmd_handle[RX_CMDS];
+/* Set of the latest RX command */
+static uint8_t rx_cur;
+/* RF core error counts already folded into the statistics block */
+static uint16_t rx_crc_errors[RX_CMDS];
+static uint8_t rx_buf_full[RX_CMDS];
+
+static rf_core_input_callback_t input_callback;
+static rf_core_tx_callback_t tx_callback;
+
+/* Default and highest TX power, and the one the RF core is set to */
+static int8_t tx_power_dbm;
+static int8_t applied_tx_power_dbm = RF_TxPowerTable_INVALID_DBM;
+
+/* Sniff interval in ms, 0 when RX is always on */
+static uint16_t sniff_interval;
+/* RAT time the next sniff window opens at */
+static ratmr_t sniff_next;
+/* Set while a window opening at sniff_next is posted, the next one is due
+ * an interval later once it has ended */
+static bool sniff_scheduled;
+static uint32_t sniff_window_us;
+static uint32_t max_airtime_us;
+static uint16_t preamble_byte_us;
+static uint32_t sync_us;
+/* Longest frame sent or received, at most FRAME_MAX_LEN */
+static uint16_t max_frame_len;
+static uint16_t duty_cycle_permille;
+/* Copied into rx_adv_sniff, like rf_cmd_prop_rx_adv into rx_adv */
+static rfc_CMD_PROP_RX_ADV_SNIFF_t rf_cmd_prop_rx_adv_sniff;
+
+/* Band plan and the channel tuned to */
+static uint32_t chan0_khz;
+static uint16_t spacing_khz;
+static uint8_t channel_count;
+static uint8_t channel;
+
+/* Carrier sense chained ahead of the TX command */
+static rfc_CMD_PROP_CS_t rf_cmd_prop_cs;
+
+/* Saved as [TX power (1)] [sniff interval (2)] */
+#define SAVED_LEN 3
+
+static void save(void);
+static void restore(uint16_t len);
+
+static struct persist_handler persist_handler = {
+  NULL, PERSIST_RADIO, save, restore
+};
+
+/* Set while RX is being stopped on purpose, e.g. to transmit */
+static volatile bool rx_stopping;
+/* Set from the RF callback when the RX command ended on its own */
+static volatile bool rx_ended;
+/* RX command a transmission cut short, its end is not worth restarting */
+static volatile RF_CmdHandle rx_stale = RF_ALLOC_ERROR;
+
+/* Frame of the transmission in flight, NULL if none, and its chain */
+static struct frame *tx_frame;
+static RF_CmdHandle tx_handle;
+static bool tx_rx_chained;
+/* Cleared from the RF callback once the TX part of the chain is over,
+ * which then sets tx_finished for the process to report it */
+static volatile bool tx_pending;
+static volatile bool tx_finished;
+/*---------------------------------------------------------------------------*/
+PROCESS(rf_core_rx_process, "RF core RX process");
+/*---------------------------------------------------------------------------*/
+static void
+prepare_entry(struct frame *frame)
+{
+  rfc_dataEntryGeneral_t *entry = frame_entry(frame);
+
+  entry->pNextEntry = NULL;
+  entry->status = DATA_ENTRY_PENDING;
+  entry->config.type = DATA_ENTRY_TYPE_GEN;
+  entry->config.lenSz = ENTRY_LEN_SIZE;
+  entry->length = FRAME_DATA_LEN;
+}
+/*---------------------------------------------------------------------------*/
+/* Top the RX queue up to RF_CORE_RX_BUF_CNT frames. Entries are appended
+ * with CMD_ADD_DATA_ENTRY, which is safe while RX is running. */
+static void
+refill_rx_queue(void)
+{
+  rfc_CMD_ADD_DATA_ENTRY_t cmd;
+  struct frame *frame;
+
+  while(rx_queued < RF_CORE_RX_BUF_CNT) {
+    frame = frame_pool_alloc();
+    if(frame == NULL) {
+      break;
+    }
+
+    prepare_entry(frame);
+
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.commandNo = CMD_ADD_DATA_ENTRY;
+    cmd.pQueue = &rx_queue;
+    cmd.pEntry = frame->entry;
+
+    if(RF_runImmediateCmd(rf_handle, (uint32_t *)&cmd) != RF_StatCmdDoneSuccess) {
+      LOG_ERR("Unable to queue RX entry\n");
+      frame_pool_free(frame);
+      break;
+    }
+
+    list_add(rx_frames, frame);
+    rx_queued++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+release_hook(void)
+{
+  if(rx_queued < RF_CORE_RX_BUF_CNT) {
+    process_poll(&rf_core_rx_process);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* The RF core only keeps 8 and 16-bit counts, which wrap */
+static void
+fold_rx_stats(void)
+{
+  uint16_t crc_errors;
+  uint8_t buf_full;
+  unsigned i;
+
+  for(i = 0; i < RX_CMDS; i++) {
+    crc_errors = rx_stats[i].nRxNok;
+    buf_full = rx_stats[i].nRxBufFull;
+    STATS_ADD(RX_CRC_ERRORS, (uint16_t)(crc_errors - rx_crc_errors[i]));
+    STATS_ADD(RX_NO_BUFFER, (uint8_t)(buf_full - rx_buf_full[i]));
+    rx_crc_errors[i] = crc_errors;
+    rx_buf_full[i] = buf_full;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Whether the TX command of the chain is done with, sent, failed or
+ * skipped by carrier sense */
+static bool
+tx_over(void)
+{
+  if(rf_cmd_prop_tx_adv.status > ACTIVE) {
+    return true;
+  }
+
+#if RF_CORE_CCA_ENABLED
+  return rf_cmd_prop_cs.status == PROP_DONE_BUSY ||
+         rf_cmd_prop_cs.status == PROP_DONE_BUSYTIMEOUT;
+#else
+  return false;
+#endif
+}
+/*---------------------------------------------------------------------------*/
+static void
+rx_callback(RF_Handle client, RF_CmdHandle command, RF_EventMask events)
+{
+  const uint32_t begin = PROF_CYCLES();
+  PROF_BEGIN(RF_RX_ISR);
+
+  if(events & RF_EventRxEntryDone) {
+    process_poll(&rf_core_rx_process);
+  }
+
+  if(tx_pending && command != rx_stale &&
+     ((events & RF_EventLastCmdDone) || tx_over())) {
+    tx_pending = false;
+    tx_finished = true;
+    process_poll(&rf_core_rx_process);
+  }
+
+  if((events & RF_EventLastCmdDone) && !rx_stopping && command != rx_stale) {
+    /* The endless RX command only ends on errors such as running out of
+     * entries, a sniff ends after every window. Either way the process
+     * restarts it once it has refilled the queue. */
+    rx_ended = true;
+    process_poll(&rf_core_rx_process);
+  }
+
+  PROF_END(RF_RX_ISR);
+  STATS_HIST(RX_ISR_CYCLES, PROF_CYCLES() - begin);
+}
+/*---------------------------------------------------------------------------*/
+/* Fill in the sniff command from the endless RX command, whose fields it
+ * shares, plus carrier sense on preamble correlation */
+static void
+prepare_sniff(const struct rf_core_params *params)
+{
+  rfc_CMD_PROP_RX_ADV_SNIFF_t *cmd = &rf_cmd_prop_rx_adv_sniff;
+
+  memcpy(cmd, &rf_cmd_prop_rx_adv, sizeof(rf_cmd_prop_rx_adv));
+  cmd->commandNo = CMD_PROP_RX_ADV_SNIFF;
+  cmd->startTrigger.triggerType = TRIG_ABSTIME;
+  cmd->startTrigger.pastTrig = 1;
+  /* One frame per window, the next one has its own long preamble */
+  cmd->pktConf.bRepeatOk = 0;
+  cmd->pktConf.bRepeatNok = 0;
+  cmd->endTrigger.triggerType = TRIG_REL_START;
+
+  cmd->csConf.bEnaRssi = 0;
+  cmd->csConf.bEnaCorr = 1;
+  /* Keep receiving on a busy channel, end the window on an idle one */
+  cmd->csConf.busyOp = 0;
+  cmd->csConf.idleOp = 1;
+  /* An undecided channel at the end of the window counts as idle */
+  cmd->csConf.timeoutRes = 1;
+  cmd->corrPeriod = RF_convertUsToRatTicks(params->preamble_byte_us);
+  cmd->corrConfig.numCorrInv = SNIFF_CORR_INVALID;
+  cmd->corrConfig.numCorrBusy = SNIFF_CORR_BUSY;
+  cmd->csEndTrigger.triggerType = TRIG_REL_START;
+  cmd->csEndTime = RF_convertUsToRatTicks(params->sniff_window_us);
+
+  sniff_window_us = params->sniff_window_us;
+  max_airtime_us = params->max_airtime_us;
+  preamble_byte_us = params->preamble_byte_us;
+  sync_us = params->sync_us;
+}
+/*---------------------------------------------------------------------------*/
+/* Copy the RX commands into their sets, each writing its own output */
+static void
+prepare_rx(void)
+{
+  unsigned i;
+
+  for(i = 0; i < RX_CMDS; i++) {
+    memcpy(&rx_adv[i], &rf_cmd_prop_rx_adv, sizeof(rx_adv[i]));
+    memcpy(&rx_adv_sniff[i], &rf_cmd_prop_rx_adv_sniff,
+           sizeof(rx_adv_sniff[i]));
+    rx_adv[i].pOutput = (uint8_t *)&rx_stats[i];
+    rx_adv_sniff[i].pOutput = (uint8_t *)&rx_stats[i];
+    rx_cmd_handle[i] = RF_ALLOC_ERROR;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* RSSI based carrier sense, which runs the TX command on an idle channel
+ * and ends the chain on a busy one */
+static void
+prepare_cca(void)
+{
+  rfc_CMD_PROP_CS_t *cmd = &rf_cmd_prop_cs;
+
+  memset(cmd, 0, sizeof(*cmd));
+  cmd->commandNo = CMD_PROP_CS;
+  cmd->startTrigger.triggerType = TRIG_NOW;
+  cmd->condition.rule = COND_STOP_ON_FALSE;
+  cmd->pNextOp = &rf_cmd_prop_tx_adv;
+  /* Keep the synthesizer running for the TX that follows */
+  cmd->csFsConf.bFsOffIdle = 0;
+  cmd->csFsConf.bFsOffBusy = 0;
+  cmd->csConf.bEnaRssi = 1;
+  cmd->csConf.bEnaCorr = 0;
+  /* Decide on the first sample either way */
+  cmd->csConf.busyOp = 1;
+  cmd->csConf.idleOp = 1;
+  cmd->csConf.timeoutRes = 0;
+  cmd->rssiThr = RF_CORE_CCA_THRESHOLD;
+  cmd->numRssiIdle = 1;
+  cmd->numRssiBusy = 1;
+  cmd->csEndTrigger.triggerType = TRIG_REL_START;
+  cmd->csEndTime = RF_convertUsToRatTicks(RF_CORE_CCA_TIMEOUT);
+}
+/*---------------------------------------------------------------------------*/
+/* Lock the synthesizer on a channel, with RX stopped */
+static int
+tune(uint8_t ch)
+{
+  const uint32_t khz = chan0_khz + (uint32_t)ch * spacing_khz;
+  RF_EventMask events;
+
+  rf_cmd_prop_fs.frequency = khz / 1000;
+  rf_cmd_prop_fs.fractFreq = ((khz % 1000) * 65536) / 1000;
+  rf_cmd_prop_fs.status = IDLE;
+
+  events = RF_runCmd(rf_handle, (RF_Op *)&rf_cmd_prop_fs, RF_PriorityNormal,
+                     NULL, 0);
+  if(!(events & RF_EventLastCmdDone) || rf_cmd_prop_fs.status != DONE_OK) {
+    LOG_ERR("Synthesizer did not lock on channel %u (status 0x%04x)\n", ch,
+            rf_cmd_prop_fs.status);
+    return -1;
+  }
+
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+configure_sniff(uint16_t interval_ms)
+{
+  const uint32_t preamble_us = (uint32_t)interval_ms * 1000 + sniff_window_us;
+  unsigned i;
+
+  sniff_interval = interval_ms;
+  sniff_next = RF_getCurrentTime();
+
+  /* Receivers wake at most one interval apart, a preamble that long is
+   * sure to overlap one of their windows. A window that caught it stays
+   * open until the frame that follows is in. */
+  rf_cmd_prop_tx_adv.preTime = interval_ms == 0 ? 0 :
+                               RF_convertUsToRatTicks(preamble_us);
+  for(i = 0; i < RX_CMDS; i++) {
+    rx_adv_sniff[i].endTime =
+      RF_convertUsToRatTicks(preamble_us + max_airtime_us);
+  }
+
+  LOG_RECORD(RF_SNIFF_INTERVAL, interval_ms);
+}
+/*---------------------------------------------------------------------------*/
+static RF_Op *
+rx_command(void)
+{
+  const ratmr_t now = RF_getCurrentTime();
+
+  if(sniff_interval == 0) {
+    rx_adv[rx_cur].status = IDLE;
+    return (RF_Op *)&rx_adv[rx_cur];
+  }
+
+  /* Windows missed while RX was stopped are not made up for, the sender
+   * preamble spans a whole interval so the phase does not matter */
+  if((int32_t)(sniff_next - now) < 0) {
+    sniff_next = now;
+  }
+
+  rx_adv_sniff[rx_cur].status = IDLE;
+  rx_adv_sniff[rx_cur].startTime = sniff_next;
+  sniff_scheduled = true;
+  return (RF_Op *)&rx_adv_sniff[rx_cur];
+}
+/*---------------------------------------------------------------------------*/
+/* Get the next RX command ready to be posted, alone or chained */
+static RF_Op *
+rx_prepare(void)
+{
+  /* The set was last used two RX commands ago, which is over as the one
+   * in between only starts once it has ended: this returns right away */
+  rx_cur = (rx_cur + 1) % RX_CMDS;
+  if(rx_cmd_handle[rx_cur] >= 0) {
+    RF_pendCmd(rf_handle, rx_cmd_handle[rx_cur], 0);
+  }
+
+  /* Counts restart from zero with the next RX command */
+  fold_rx_stats();
+  memset(&rx_stats[rx_cur], 0, sizeof(rx_stats[rx_cur]));
+  rx_crc_errors[rx_cur] = 0;
+  rx_buf_full[rx_cur] = 0;
+
+  rx_ended = false;
+  rx_stopping = false;
+
+  return rx_command();
+}
+/*---------------------------------------------------------------------------*/
+static int
+rx_start(void)
+{
+  if(rx_queued == 0) {
+    /* Retried from release_hook() once a frame comes back to the pool */
+    LOG_WARN("No frames left for RX\n");
+    rx_ended = true;
+    return -1;
+  }
+
+  rx_handle = RF_postCmd(rf_handle, rx_prepare(), RF_PriorityNormal,
+                         rx_callback, RF_EventRxEntryDone);
+  rx_cmd_handle[rx_cur] = rx_handle;
+  if(rx_handle < 0) {
+    LOG_ERR("Unable to start RX\n");
+    sniff_scheduled = false;
+    return -1;
+  }
+
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+rx_stop(void)
+{
+  rx_stopping = true;
+  sniff_scheduled = false;
+  RF_cancelCmd(rf_handle, rx_handle, RF_ABORT_GRACEFULLY);
+  RF_pendCmd(rf_handle, rx_handle, 0);
+}
+/*---------------------------------------------------------------------------*/
+/* Like rx_stop() without waiting, whatever is posted next is queued behind
+ * the RX command and runs as soon as it has wound down. The command and
+ * its output are left alone meanwhile, see rx_prepare(). */
+static void
+rx_abort(void)
+{
+  rx_stale = rx_handle;
+  sniff_scheduled = false;
+  RF_cancelCmd(rf_handle, rx_handle, RF_ABORT_GRACEFULLY);
+}
+/*---------------------------------------------------------------------------*/
+/* Fill in len and meta from the entry the RF core wrote, returns false if
+ * the frame is not worth delivering */
+static bool
+parse_entry(struct frame *frame)
+{
+  const uint8_t *data = frame->data;
+  const uint16_t entry_len = data[0] | (data[1] << 8);
+  const uint8_t *trailer;
+
+  if(entry_len < PHR_LEN + FRAME_RX_TRAILER_LEN) {
+    LOG_WARN("Dropping runt entry (%u bytes)\n", entry_len);
+    return false;
+  }
+
+  frame->len = entry_len - PHR_LEN - FRAME_RX_TRAILER_LEN;
+  if(frame->len > max_frame_len) {
+    LOG_WARN("Dropping oversized frame (%u bytes)\n", frame->len);
+    return false;
+  }
+
+  trailer = frame_payload(frame) + frame->len;
+  frame->meta.rssi = (int8_t)trailer[0];
+  memcpy(&frame->meta.timestamp, &trailer[1], sizeof(frame->meta.timestamp));
+  frame->meta.status = trailer[5];
+
+  return true;
+}
+/*---------------------------------------------------------------------------*/
+static void
+save(void)
+{
+  uint8_t buf[SAVED_LEN];
+
+  buf[0] = tx_power_dbm;
+  put_le16(&buf[1], sniff_interval);
+  persist_put(buf, sizeof(buf));
+}
+/*---------------------------------------------------------------------------*/
+/* Runs before RX is started, with the boot parameters applied */
+static void
+restore(uint16_t len)
+{
+  uint8_t buf[SAVED_LEN];
+  uint16_t interval_ms;
+
+  if(persist_get(buf, sizeof(buf)) != 0) {
+    return;
+  }
+
+  /* Never above the default power, which may be lower in this image */
+  if((int8_t)buf[0] <= tx_power_dbm) {
+    rf_core_set_tx_power((int8_t)buf[0]);
+  }
+
+  interval_ms = get_le16(&buf[1]);
+  if(interval_ms <= RF_CORE_SNIFF_INTERVAL_MAX &&
+     interval_ms != sniff_interval) {
+    configure_sniff(interval_ms);
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+rf_core_init(const struct rf_core_params *params)
+{
+  RF_Params rf_params;
+
+  chan0_khz = params->chan0_khz;
+  spacing_khz = params->spacing_khz;
+  channel_count = params->channel_count;
+  channel = params->channel;
+  max_frame_len = MIN(params->max_frame_len, FRAME_MAX_LEN);
+  duty_cycle_permille = params->duty_cycle_permille;
+  rf_cmd_prop_radio_div_setup.centerFreq =
+    (chan0_khz + (uint32_t)channel * spacing_khz) / 1000;
+
+  RF_Params_init(&rf_params);
+  rf_params.nInactivityTimeout = RF_CORE_INACTIVITY_TIMEOUT;
+  rf_handle = RF_open(&rf_object, &rf_prop_mode,
+                      (RF_RadioSetup *)&rf_cmd_prop_radio_div_setup,
+                      &rf_params);
+  if(rf_handle == NULL) {
+    LOG_ERR("Unable to open the RF driver\n");
+    return -1;
+  }
+
+  if(rf_core_set_tx_power(params->tx_power_dbm) != 0) {
+    LOG_WARN("TX power %d dBm not supported\n", params->tx_power_dbm);
+  }
+
+  if(tune(channel) != 0) {
+    return -1;
+  }
+
+  list_init(rx_frames);
+  rx_queue.pCurrEntry = NULL;
+  rx_queue.pLastEntry = NULL;
+  rx_queued = 0;
+  refill_rx_queue();
+  frame_pool_set_release_hook(release_hook);
+
+  rf_cmd_prop_rx_adv.pQueue = &rx_queue;
+  rf_cmd_prop_rx_adv.maxPktLen = max_frame_len + CRC_LEN;
+  rf_cmd_prop_rx_adv.pktConf.bRepeatOk = 1;
+  rf_cmd_prop_rx_adv.pktConf.bRepeatNok = 1;
+  rf_cmd_prop_rx_adv.rxConf.bAutoFlushCrcErr = 1;
+  rf_cmd_prop_rx_adv.rxConf.bAutoFlushIgnored = 1;
+  rf_cmd_prop_rx_adv.rxConf.bIncludeHdr = 1;
+  rf_cmd_prop_rx_adv.rxConf.bIncludeCrc = 0;
+  rf_cmd_prop_rx_adv.rxConf.bAppendRssi = 1;
+  rf_cmd_prop_rx_adv.rxConf.bAppendTimestamp = 1;
+  rf_cmd_prop_rx_adv.rxConf.bAppendStatus = 1;
+  rf_cmd_prop_rx_adv.endTrigger.triggerType = TRIG_NEVER;
+
+  prepare_sniff(params);
+  prepare_rx();
+  prepare_cca();
+  rf_cmd_prop_tx_adv.preTrigger.triggerType = TRIG_REL_START;
+
+  process_start(&rf_core_rx_process, NULL);
+
+  configure_sniff(RF_CORE_SNIFF_INTERVAL);
+  persist_register(&persist_handler);
+
+  return rx_start();
+}
+/*---------------------------------------------------------------------------*/
+void
+rf_core_set_input_callback(rf_core_input_callback_t callback)
+{
+  input_callback = callback;
+}
+/*---------------------------------------------------------------------------*/
+void
+rf_core_set_tx_callback(rf_core_tx_callback_t callback)
+{
+  tx_callback = callback;
+}
+/*---------------------------------------------------------------------------*/
+static int
+apply_tx_power(int8_t dbm)
+{
+  RF_TxPowerTable_Value value;
+
+  if(dbm == applied_tx_power_dbm) {
+    return 0;
+  }
+
+  value = RF_TxPowerTable_findValue(rf_prop_tx_power_table, dbm);
+  if(value.rawValue == RF_TxPowerTable_INVALID_VALUE ||
+     RF_setTxPower(rf_handle, value) != RF_StatSuccess) {
+    return -1;
+  }
+
+  applied_tx_power_dbm = dbm;
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Lowest table entry of at least dbm, not above the default power. The
+ * table is sorted by increasing power. */
+static int8_t
+table_power_at_least(int8_t dbm)
+{
+  const RF_TxPowerTable_Entry *entry;
+
+  for(entry = rf_prop_tx_power_table;
+      entry->power != RF_TxPowerTable_INVALID_DBM &&
+      entry->power < tx_power_dbm; entry++) {
+    if(entry->power >= dbm) {
+      return entry->power;
+    }
+  }
+
+  return tx_power_dbm;
+}
+/*---------------------------------------------------------------------------*/
+int
+rf_core_set_tx_power(int8_t dbm)
+{
+  if(apply_tx_power(dbm) != 0) {
+    return -1;
+  }
+
+  tx_power_dbm = dbm;
+  persist_changed();
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+int8_t
+rf_core_get_tx_power(void)
+{
+  return tx_power_dbm;
+}
+/*---------------------------------------------------------------------------*/
+int
+rf_core_set_sniff_interval(uint16_t interval_ms)
+{
+  if(interval_ms > RF_CORE_SNIFF_INTERVAL_MAX) {
+    return -1;
+  }
+
+  rx_stop();
+  configure_sniff(interval_ms);
+  persist_changed();
+
+  return rx_start();
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+rf_core_get_sniff_interval(void)
+{
+  return sniff_interval;
+}
+/*---------------------------------------------------------------------------*/
+uint32_t
+rf_core_airtime_us(uint16_t len)
+{
+  /* PHR and CRC around the frame, as radio::Config::airtimeUs() */
+  const uint32_t us = sync_us + (uint32_t)(2 + len + 2) * preamble_byte_us;
+
+  if(sniff_interval == 0) {
+    return us;
+  }
+  return us + (uint32_t)sniff_interval * 1000 + sniff_window_us;
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+rf_core_get_duty_cycle(void)
+{
+  return duty_cycle_permille;
+}
+/*---------------------------------------------------------------------------*/
+int
+rf_core_set_channel(uint8_t ch)
+{
+  int ret = 0;
+
+  if(ch >= channel_count) {
+    return -1;
+  }
+  if(ch == channel) {
+    return 0;
+  }
+
+  rx_stop();
+  if(tune(ch) == 0) {
+    channel = ch;
+    /* The RF driver reruns the setup after powering the RF core up, from
+     * the centre frequency it holds */
+    rf_cmd_prop_radio_div_setup.centerFreq =
+      (chan0_khz + (uint32_t)ch * spacing_khz) / 1000;
+  } else {
+    tune(channel);
+    ret = -1;
+  }
+
+  return rx_start() == 0 ? ret : -1;
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+rf_core_get_channel(void)
+{
+  return channel;
+}
+/*---------------------------------------------------------------------------*/
+int
+rf_core_scan(uint8_t ch, uint32_t duration_us, struct rf_core_scan *scan)
+{
+  const ratmr_t duration = RF_convertUsToRatTicks(duration_us);
+  const bool away = ch != channel;
+  ratmr_t start;
+  int8_t rssi;
+  int ret = 0;
+
+  if(sniff_interval != 0 || ch >= channel_count) {
+    return -1;
+  }
+
+  scan->samples = 0;
+  scan->busy = 0;
+  scan->min_rssi = INT8_MAX;
+  scan->max_rssi = INT8_MIN;
+
+  /* The RSSI is only read from a running RX command */
+  if(away) {
+    rx_stop();
+    if(tune(ch) != 0 || rx_start() != 0) {
+      ret = -1;
+    }
+  }
+
+  start = RF_getCurrentTime();
+  while(ret == 0 && RF_getCurrentTime() - start < duration) {
+    rssi = RF_getRssi(rf_handle);
+    if(rssi == RF_GET_RSSI_ERROR_VAL) {
+      /* Not valid yet right after RX started */
+      continue;
+    }
+    scan->samples++;
+    scan->busy += rssi >= RF_CORE_CCA_THRESHOLD;
+    scan->min_rssi = MIN(scan->min_rssi, rssi);
+    scan->max_rssi = MAX(scan->max_rssi, rssi);
+  }
+
+  if(away) {
+    rx_stop();
+    if(tune(channel) != 0) {
+      ret = -1;
+    }
+    if(rx_start() != 0) {
+      ret = -1;
+    }
+  }
+
+  return ret == 0 && scan->samples > 0 ? 0 : -1;
+}
+/*---------------------------------------------------------------------------*/
+int
+rf_core_transmit(struct frame *frame)
+{
+  return rf_core_transmit_at(frame, tx_power_dbm);
+}
+/*---------------------------------------------------------------------------*/
+static int
+transmit(struct frame *frame, int8_t dbm, bool scheduled, ratmr_t start)
+{
+  PROF_BEGIN(RF_TX);
+  const uint16_t psdu_len = frame->len + CRC_LEN;
+  const int8_t power = table_power_at_least(dbm);
+  uint8_t *phr = &frame->data[FRAME_PHR_OFFSET];
+  RF_Op *first;
+  RF_Op *rx;
+  RF_CmdHandle handle;
+
+  if(frame->len > max_frame_len || tx_frame != NULL) {
+    PROF_END(RF_TX);
+    return -1;
+  }
+
+  phr[0] = ((psdu_len >> 8) & 0x07) | PHR_FCS_16 | PHR_DATA_WHITENING;
+  phr[1] = psdu_len & 0xFF;
+
+  rf_cmd_prop_tx_adv.pPkt = phr;
+  rf_cmd_prop_tx_adv.pktLen = PHR_LEN + frame->len;
+  rf_cmd_prop_tx_adv.status = IDLE;
+
+  /* Carrier sense takes its first sample early enough for the TX to start
+   * on time, late triggers fire right away */
+  if(scheduled) {
+    rf_cmd_prop_tx_adv.startTrigger.triggerType = TRIG_ABSTIME;
+    rf_cmd_prop_tx_adv.startTrigger.pastTrig = 1;
+    rf_cmd_prop_tx_adv.startTime = start;
+    rf_cmd_prop_cs.startTrigger.triggerType = TRIG_ABSTIME;
+    rf_cmd_prop_cs.startTrigger.pastTrig = 1;
+    rf_cmd_prop_cs.startTime = start -
+                               RF_convertUsToRatTicks(RF_CORE_CCA_TIMEOUT);
+  } else {
+    rf_cmd_prop_tx_adv.startTrigger.triggerType = TRIG_NOW;
+    rf_cmd_prop_cs.startTrigger.triggerType = TRIG_NOW;
+  }
+
+  if(power != applied_tx_power_dbm) {
+    /* Switched with RX stopped, a PA change restarts the radio setup */
+    rx_stop();
+    if(apply_tx_power(power) != 0) {
+      LOG_WARN("TX power %d dBm not applied\n", dbm);
+    }
+  } else {
+    /* The RF driver starts the chain below the moment RX has ended,
+     * without a round trip through this process */
+    rx_abort();
+  }
+
+  /* RX is chained after the TX and resumes straight from the RF core,
+   * whether the frame went out or not */
+  rx = rx_queued > 0 ? rx_prepare() : NULL;
+  rf_cmd_prop_tx_adv.pNextOp = rx;
+  rf_cmd_prop_tx_adv.condition.rule = rx != NULL ? COND_ALWAYS : COND_NEVER;
+
+#if RF_CORE_CCA_ENABLED
+  /* A busy channel skips the TX, and goes on with the RX if there is one */
+  rf_cmd_prop_cs.status = IDLE;
+  rf_cmd_prop_cs.condition.rule = rx != NULL ? COND_SKIP_ON_FALSE :
+                                  COND_STOP_ON_FALSE;
+  /* Skip counts from the CS itself, 2 lands past the TX */
+  rf_cmd_prop_cs.condition.nSkip = 2;
+  first = (RF_Op *)&rf_cmd_prop_cs;
+#else
+  first = (RF_Op *)&rf_cmd_prop_tx_adv;
+#endif
+
+  tx_pending = true;
+  handle = RF_postCmd(rf_handle, first, RF_PriorityNormal, rx_callback,
+                      RF_EventRxEntryDone | RF_EventCmdDone);
+  if(handle < 0) {
+    tx_pending = false;
+    sniff_scheduled = false;
+    LOG_ERR("Unable to start TX\n");
+    STATS_INC(TX_ERRORS);
+    LOG_RECORD(TX_FRAME, frame->len, -1);
+    rx_ended = true;
+    process_poll(&rf_core_rx_process);
+    PROF_END(RF_TX);
+    return -1;
+  }
+
+  /* The RF callback polls the process once the TX is over, this returns
+   * while the frame is on air */
+  rx_handle = handle;
+  tx_handle = handle;
+  if(rx != NULL) {
+    rx_cmd_handle[rx_cur] = handle;
+  }
+  tx_rx_chained = rx != NULL;
+  tx_frame = frame;
+  PROF_END(RF_TX);
+
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+/* From the process, once the RF callback saw the TX part of the chain end */
+static void
+finish_tx(void)
+{
+  struct frame *frame = tx_frame;
+  int ret = 0;
+
+  if(RF_CORE_CCA_ENABLED && rf_cmd_prop_tx_adv.status == IDLE &&
+     (rf_cmd_prop_cs.status == PROP_DONE_BUSY ||
+      rf_cmd_prop_cs.status == PROP_DONE_BUSYTIMEOUT)) {
+    ret = RF_CORE_TX_BUSY;
+    STATS_INC(CCA_BUSY);
+  } else if(rf_cmd_prop_tx_adv.status != PROP_DONE_OK) {
+    LOG_WARN("TX failed (status 0x%04x)\n", rf_cmd_prop_tx_adv.status);
+    ret = -1;
+    STATS_INC(TX_ERRORS);
+  } else {
+    STATS_INC(TX_FRAMES);
+  }
+
+  /* Without RX chained the chain ended with the TX, unless RX was
+   * restarted meanwhile */
+  if(!tx_rx_chained && rx_handle == tx_handle) {
+    rx_ended = true;
+  }
+
+  LOG_RECORD(TX_FRAME, frame->len, ret);
+
+  tx_frame = NULL;
+  if(tx_callback != NULL) {
+    tx_callback(frame, ret);
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+rf_core_transmit_at(struct frame *frame, int8_t dbm)
+{
+  return transmit(frame, dbm, false, 0);
+}
+/*---------------------------------------------------------------------------*/
+int
+rf_core_transmit_scheduled(struct frame *frame, int8_t dbm, uint32_t start)
+{
+  return transmit(frame, dbm, true, start);
+}
+/*---------------------------------------------------------------------------*/
+int
+rf_core_cca(void)
+{
+  int8_t rssi;
+
+  if(sniff_interval != 0) {
+    return -1;
+  }
+
+  rssi = RF_getRssi(rf_handle);
+  if(rssi == RF_GET_RSSI_ERROR_VAL) {
+    return -1;
+  }
+
+  return rssi >= RF_CORE_CCA_THRESHOLD;
+}
+/*---------------------------------------------------------------------------*/
+uint32_t
+rf_core_time(void)
+{
+  return RF_getCurrentTime();
+}
+/*---------------------------------------------------------------------------*/
+static void
+drain_rx_queue(void)
+{
+  PROF_BEGIN(RF_RX_DRAIN);
+  struct frame *frame;
+
+  /* Hand over everything the RF core has finished since the last poll.
+   * Finished entries are always at the head, the RF core fills them in
+   * order. */
+  while((frame = list_head(rx_frames)) != NULL &&
+        frame_entry(frame)->status == DATA_ENTRY_FINISHED) {
+    list_pop(rx_frames);
+    rx_queued--;
+
+    if(parse_entry(frame) && input_callback != NULL) {
+      LOG_RECORD(RX_FRAME, frame->len, frame->meta.rssi, frame->meta.status);
+      STATS_INC(RX_FRAMES);
+      STATS_HIST(RX_LATENCY_US, RF_convertRatTicksToUs(RF_getCurrentTime() -
+                                                       frame->meta.timestamp));
+      input_callback(frame);
+    } else {
+      frame_pool_free(frame);
+    }
+  }
+
+  refill_rx_queue();
+  fold_rx_stats();
+
+  PROF_END(RF_RX_DRAIN);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(rf_core_rx_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  while(1) {
+    PROCESS_YIELD_UNTIL(ev == PROCESS_EVENT_POLL);
+
+    /* Frames that arrived right before a TX are handed over first */
+    drain_rx_queue();
+
+    if(tx_finished) {
+      tx_finished = false;
+      finish_tx();
+    }
+
+    if(rx_ended) {
+      if(sniff_interval == 0) {
+        LOG_WARN("RX ended (status 0x%04x), restarting\n",
+                 rx_adv[rx_cur].status);
+      } else if(sniff_scheduled) {
+        /* Restarts that never got a window posted leave it where it
+         * was */
+        sniff_next += RF_convertMsToRatTicks(sniff_interval);
+        sniff_scheduled = false;
+      }
+      rx_start();
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
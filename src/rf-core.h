@@ -0,0 +1,319 @@
+/**
+ * \file
+ *         Direct access to the CC1312R RF core in proprietary mode
+ *
+ *         The RF core is kept in an endless RX command whose data queue is
+ *         made of frames taken from the frame pool, and is drained by
+ *         rf_core_rx_process. The process is polled from the RF driver
+ *         callback on every RX-done interrupt, so received frames are handed
+ *         to the upper layer with interrupt latency instead of on a timer
+ *         tick.
+ *
+ *         Transmissions are posted as one command chain, carrier sense,
+ *         TX and the RX command that follows, queued behind the RX they
+ *         cut short. The RF driver starts the chain as soon as RX has
+ *         wound down and the RF core goes back to RX on its own once the
+ *         frame is out, so neither turnaround waits for this process. Nor
+ *         does the caller wait for the airtime: the RF driver callback
+ *         polls rf_core_rx_process once the TX is over, which hands the
+ *         outcome to the TX callback, see rf_core_set_tx_callback().
+ *
+ *         With a non-zero sniff interval the endless RX command is replaced
+ *         by low-power listening: the RF core wakes once per interval for a
+ *         short carrier sense window and sleeps in between, and every frame
+ *         is sent with a preamble as long as the interval so receivers are
+ *         sure to catch it. All nodes of a network must use the same
+ *         interval.
+ *
+ *         The TX power and sniff interval set at run time are saved to
+ *         flash, see persist.h, and rf_core_init() applies them over the
+ *         boot parameters. The channel can also change at run time, within
+ *         the band plan of the boot parameters, but is left for the caller
+ *         to save, see chan.h.
+ */
+#ifndef RF_CORE_H
+#define RF_CORE_H
+
+#include "contiki.h"
+#include "frame-pool.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------*/
+/** Number of pool frames kept queued to the RF core for reception */
+#ifdef RF_CORE_CONF_RX_BUF_CNT
+#define RF_CORE_RX_BUF_CNT RF_CORE_CONF_RX_BUF_CNT
+#else
+#define RF_CORE_RX_BUF_CNT 4
+#endif
+
+/** RX sniff interval at boot, in ms, 0 keeps RX always on */
+#ifdef RF_CORE_CONF_SNIFF_INTERVAL
+#define RF_CORE_SNIFF_INTERVAL RF_CORE_CONF_SNIFF_INTERVAL
+#else
+#define RF_CORE_SNIFF_INTERVAL 0
+#endif
+
+/** Longest sniff interval accepted, in ms */
+#ifdef RF_CORE_CONF_SNIFF_INTERVAL_MAX
+#define RF_CORE_SNIFF_INTERVAL_MAX RF_CORE_CONF_SNIFF_INTERVAL_MAX
+#else
+#define RF_CORE_SNIFF_INTERVAL_MAX 2000
+#endif
+
+/**
+ * Idle time after which the RF driver powers the RF core down, in us.
+ * Only ever reached between sniff windows.
+ */
+#ifdef RF_CORE_CONF_INACTIVITY_TIMEOUT
+#define RF_CORE_INACTIVITY_TIMEOUT RF_CORE_CONF_INACTIVITY_TIMEOUT
+#else
+#define RF_CORE_INACTIVITY_TIMEOUT 2000
+#endif
+
+/** Clear channel assessment before every transmission */
+#ifdef RF_CORE_CONF_CCA_ENABLED
+#define RF_CORE_CCA_ENABLED RF_CORE_CONF_CCA_ENABLED
+#else
+#define RF_CORE_CCA_ENABLED 1
+#endif
+
+/** RSSI at or above which the channel is busy, in dBm */
+#ifdef RF_CORE_CONF_CCA_THRESHOLD
+#define RF_CORE_CCA_THRESHOLD RF_CORE_CONF_CCA_THRESHOLD
+#else
+#define RF_CORE_CCA_THRESHOLD (-90)
+#endif
+
+/** Longest time the assessment listens before calling the channel busy,
+ * in us */
+#ifdef RF_CORE_CONF_CCA_TIMEOUT
+#define RF_CORE_CCA_TIMEOUT RF_CORE_CONF_CCA_TIMEOUT
+#else
+#define RF_CORE_CCA_TIMEOUT 500
+#endif
+
+/** rf_core_transmit() result when the frame was held back on a busy
+ * channel */
+#define RF_CORE_TX_BUSY            (-2)
+
+/** RF core timer ticks per microsecond, see rf_core_time() */
+#define RF_CORE_TICKS_PER_US       4
+/*---------------------------------------------------------------------------*/
+/** Radio parameters, see radio-config.hpp */
+struct rf_core_params {
+  /** Centre frequency of channel 0 of the band plan, in kHz */
+  uint32_t chan0_khz;
+  /** Channel spacing of the band plan, in kHz */
+  uint16_t spacing_khz;
+  uint8_t channel_count;
+  /** Channel tuned to at boot */
+  uint8_t channel;
+  int8_t tx_power_dbm;
+  /** Largest frame sent or accepted on RX, at most FRAME_MAX_LEN and
+   * LINK_MAX_FRAME_LEN for the link layer to fill it */
+  uint16_t max_frame_len;
+  /** Time on air of a max_frame_len frame, in us */
+  uint32_t max_airtime_us;
+  /** Duration of one preamble byte, in us */
+  uint16_t preamble_byte_us;
+  /** How long a sniff listens for a preamble before giving up, in us */
+  uint32_t sniff_window_us;
+  /** Time from the start of a transmission to the end of its sync word,
+   * where received frames are timestamped, in us */
+  uint32_t sync_us;
+  /** Share of the time the band allows on air, in per mille, 1000 if it
+   * is not duty cycled */
+  uint16_t duty_cycle_permille;
+};
+
+/** Channel survey, see rf_core_scan() */
+struct rf_core_scan {
+  /** RSSI samples taken */
+  uint16_t samples;
+  /** Samples at or above RF_CORE_CCA_THRESHOLD */
+  uint16_t busy;
+  /** Lowest RSSI sampled, the noise floor, in dBm */
+  int8_t min_rssi;
+  /** Highest RSSI sampled, in dBm */
+  int8_t max_rssi;
+};
+
+/**
+ * Upper layer input function, called from rf_core_rx_process once per
+ * received frame. Ownership of the frame passes to the callee, which must
+ * eventually forward it or return it to the pool.
+ */
+typedef void (*rf_core_input_callback_t)(struct frame *frame);
+
+/**
+ * Outcome of a transmission, called from rf_core_rx_process once per
+ * frame rf_core_transmit() started, with 0 if it was sent,
+ * RF_CORE_TX_BUSY if the channel was busy or -1 on error. The frame is
+ * the caller's again.
+ */
+typedef void (*rf_core_tx_callback_t)(struct frame *frame, int result);
+/*---------------------------------------------------------------------------*/
+PROCESS_NAME(rf_core_rx_process);
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Open the RF core, tune the synthesizer and start receiving.
+ *
+ * The frame pool must have been initialized beforehand.
+ *
+ * \return 0 on success, -1 if the RF driver could not be opened.
+ */
+int rf_core_init(const struct rf_core_params *params);
+
+/**
+ * \brief Set the function receiving every frame drained from the RX queue.
+ */
+void rf_core_set_input_callback(rf_core_input_callback_t callback);
+
+/**
+ * \brief Set the function told the outcome of every transmission.
+ */
+void rf_core_set_tx_callback(rf_core_tx_callback_t callback);
+
+/**
+ * \brief Change the default TX power, also the highest used.
+ * \param dbm Output power, must be an entry of the RF TX power table
+ * \return 0 on success, -1 if the power level is not supported.
+ */
+int rf_core_set_tx_power(int8_t dbm);
+
+/**
+ * \brief Default TX power, in dBm.
+ */
+int8_t rf_core_get_tx_power(void);
+
+/**
+ * \brief Switch between always-on RX and low-power listening.
+ *
+ * Must be called after rf_core_init(). Every transmission lasts at least
+ * the interval, which on duty cycled bands quickly adds up.
+ *
+ * \param interval_ms Time between sniff windows, 0 keeps RX always on
+ * \return 0 on success, -1 if the interval is above
+ *         RF_CORE_SNIFF_INTERVAL_MAX or RX could not be restarted.
+ */
+int rf_core_set_sniff_interval(uint16_t interval_ms);
+
+/**
+ * \brief Current sniff interval in ms, 0 if RX is always on.
+ */
+uint16_t rf_core_get_sniff_interval(void);
+
+/**
+ * \brief Time on air of a frame, in us, with the long preamble of
+ *        low-power listening at the current sniff interval.
+ * \param len Frame length, as in frame->len
+ */
+uint32_t rf_core_airtime_us(uint16_t len);
+
+/**
+ * \brief Duty cycle of the band, in per mille, see tx-sched.h.
+ */
+uint16_t rf_core_get_duty_cycle(void);
+
+/**
+ * \brief Retune to another channel of the band plan.
+ *
+ * RX is stopped while the synthesizer locks on the new channel, for a few
+ * hundred microseconds, frames on their way in are lost.
+ *
+ * \return 0 on success, -1 if the channel is outside of the band plan or
+ *         the synthesizer did not lock, RX staying on the old channel.
+ */
+int rf_core_set_channel(uint8_t channel);
+
+/**
+ * \brief Channel the RF core is tuned to.
+ */
+uint8_t rf_core_get_channel(void);
+
+/**
+ * \brief Sample the RSSI of a channel for a while.
+ *
+ * Another channel than the current one is tuned to for the duration,
+ * and tuned back from after. Blocks for the whole duration, sampling in a
+ * busy loop: no other process runs, the CPU does not sleep, nothing is
+ * sent and only frames on the sampled channel are received.
+ * Like rf_core_cca(), needs RX to be always on.
+ *
+ * \param duration_us Sampling time, not counting retuning
+ * \return 0 with the survey filled in, -1 with low-power listening on,
+ *         on a channel outside of the band plan or if no sample could be
+ *         taken.
+ */
+int rf_core_scan(uint8_t channel, uint32_t duration_us,
+                 struct rf_core_scan *scan);
+
+/**
+ * \brief Start sending one frame.
+ *
+ * Returns once the RF core has the frame, the TX callback tells how it
+ * went. The RF core reads the payload straight from the frame buffer: the
+ * caller keeps ownership of the frame, and leaves it alone until the
+ * callback. RX is paused for the duration of the transmission and resumes
+ * from the RF core. Only one frame is on its way at a time. With low-power
+ * listening enabled the transmission lasts the whole extended preamble.
+ *
+ * With RF_CORE_CCA_ENABLED the RF core first measures the RSSI and only
+ * transmits on a clear channel, the callback then gets RF_CORE_TX_BUSY.
+ * Backing off is up to the caller.
+ *
+ * \return 0 if the transmission started, -1 with another one on its way,
+ *         for a frame longer than max_frame_len or on error, the callback
+ *         is not called then.
+ */
+int rf_core_transmit(struct frame *frame);
+
+/**
+ * \brief Send one frame like rf_core_transmit(), at a given TX power.
+ * \param dbm Requested power, rounded up to the next entry of the RF TX
+ *            power table and capped at the default power
+ */
+int rf_core_transmit_at(struct frame *frame, int8_t dbm);
+
+/**
+ * \brief Send one frame like rf_core_transmit_at(), starting at a given
+ *        time.
+ *
+ * RX stops as soon as the frame is handed over, and the RF core timer
+ * then triggers the carrier sense and the start, so hand it over shortly
+ * before: frames that arrive in between are lost. A start already in the
+ * past sends right away.
+ *
+ * \param start RF core time the transmission starts at, see rf_core_time()
+ */
+int rf_core_transmit_scheduled(struct frame *frame, int8_t dbm,
+                               uint32_t start);
+
+/**
+ * \brief Sample the channel like the carrier sense ahead of a transmission.
+ *
+ * Reads the RSSI of the running RX command, there is none to read in
+ * between the sniff windows of low-power listening.
+ *
+ * \return 1 with the RSSI at or above RF_CORE_CCA_THRESHOLD, 0 below it,
+ *         -1 if RX is not running.
+ */
+int rf_core_cca(void);
+
+/**
+ * \brief Current time of the RF core timer, which timestamps received
+ *        frames, in RF_CORE_TICKS_PER_US ticks per microsecond.
+ */
+uint32_t rf_core_time(void);
+/*---------------------------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RF_CORE_H */
@@ -0,0 +1,653 @@
+/**
+ * \file
+ *         On demand routing, after AODV
+ */
+#include "contiki.h"
+#include "route.h"
+#include "arena.h"
+#include "byteorder.h"
+#include "dup-cache.h"
+#include "frame-pool.h"
+#include "lib/list.h"
+#include "lib/random.h"
+#include "log-ring.h"
+#include "mesh.h"
+#include "neighbor.h"
+#include "persist.h"
+#include "stats.h"
+#include "store.h"
+
+#include <string.h>
+/*---------------------------------------------------------------------------*/
+/* Routed payload header */
+#define DATA_DST       0
+#define DATA_SRC       LINKADDR_SIZE
+#define DATA_HOPS      (2 * LINKADDR_SIZE)
+
+/* Control messages, hops and metric are the last three bytes of both */
+#define MSG_RREQ       0
+#define MSG_RREP       1
+
+#define RREQ_ID        1
+#define RREQ_ORIGIN    3
+#define RREQ_SEQNO     5
+#define RREQ_TARGET    7
+#define RREQ_LEN       12
+
+#define RREP_ORIGIN    1
+#define RREP_TARGET    3
+#define RREP_SEQNO     5
+#define RREP_LEN       10
+
+#define MSG_HOPS(len)   ((len) - 3)
+#define MSG_METRIC(len) ((len) - 2)
+
+#define SEQNO_NEWER(a, b) ((int16_t)((a) - (b)) > 0)
+
+/* Saved as [own seqno (2)] followed by [destination (2)] [next hop (2)]
+ * [seqno (2)] [metric (2)] [hops] per route */
+#define SAVED_LEN      (2 * LINKADDR_SIZE + 5)
+/*---------------------------------------------------------------------------*/
+struct route {
+  /* Null for a free entry */
+  linkaddr_t dest;
+  linkaddr_t next_hop;
+  uint16_t seqno;
+  /* Summed link ETX, scaled by NEIGHBOR_ETX_DIVISOR */
+  uint16_t metric;
+  uint8_t hops;
+  clock_time_t expires;
+};
+
+struct discovery {
+  /* Null while the entry is free */
+  linkaddr_t dest;
+  uint8_t retries;
+  uint8_t pending_count;
+  struct ctimer timer;
+  /* Routed frames waiting for the route, headers already written */
+  LIST_STRUCT(pending);
+};
+
+_Static_assert(ARENA_SIZEOF(ROUTE_SIZE * sizeof(struct route)) +
+               ARENA_SIZEOF(ROUTE_DISCOVERIES * sizeof(struct discovery)) <=
+               ARENA_QUOTA_ROUTE,
+               "ROUTE_CONF_SIZE routes and ROUTE_CONF_DISCOVERIES discoveries "
+               "do not fit in ARENA_CONF_QUOTA_ROUTE");
+/*---------------------------------------------------------------------------*/
+static struct route *routes;
+static struct discovery *discoveries;
+static link_input_callback_t input_callback;
+
+/* Destination sequence number of this node */
+static uint16_t own_seqno;
+
+/* Expires routes, set for the earliest expiry */
+static struct ctimer purge_timer;
+
+/* Route request waiting for its rebroadcast, at most one at a time */
+static struct frame *forward_frame;
+static struct ctimer forward_timer;
+
+/* Held for the next route request, so that frames parked for routes do
+ * not leave the pool empty for the requests that find them */
+static struct frame *request_frame;
+
+static void save(void);
+static void restore(uint16_t len);
+
+static struct persist_handler persist_handler = {
+  NULL, PERSIST_ROUTES, save, restore
+};
+/*---------------------------------------------------------------------------*/
+/* Null marks free entries, and there is no route to ourselves */
+static int
+valid_dest(const linkaddr_t *addr)
+{
+  return !linkaddr_cmp(addr, &linkaddr_null) &&
+         !linkaddr_cmp(addr, &linkaddr_node_addr);
+}
+/*---------------------------------------------------------------------------*/
+static int
+expired(const struct route *r, clock_time_t now)
+{
+  return (int32_t)(r->expires - now) <= 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+purge(void *ptr)
+{
+  const clock_time_t now = clock_time();
+  clock_time_t next = 0;
+  int pending = 0;
+  unsigned i;
+
+  for(i = 0; i < ROUTE_SIZE; i++) {
+    if(linkaddr_cmp(&routes[i].dest, &linkaddr_null)) {
+      continue;
+    }
+    if(expired(&routes[i], now)) {
+      LOG_RECORD(ROUTE_EXPIRED, routes[i].dest.u16);
+      linkaddr_copy(&routes[i].dest, &linkaddr_null);
+    } else if(!pending || (int32_t)(routes[i].expires - next) < 0) {
+      next = routes[i].expires;
+      pending = 1;
+    }
+  }
+
+  if(pending) {
+    ctimer_set(&purge_timer, next - now, purge, NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static struct route *
+find_route(const linkaddr_t *dest)
+{
+  unsigned i;
+
+  for(i = 0; i < ROUTE_SIZE; i++) {
+    if(linkaddr_cmp(&routes[i].dest, dest)) {
+      return &routes[i];
+    }
+  }
+
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static struct discovery *
+find_discovery(const linkaddr_t *dest)
+{
+  unsigned i;
+
+  for(i = 0; i < ROUTE_DISCOVERIES; i++) {
+    if(linkaddr_cmp(&discoveries[i].dest, dest)) {
+      return &discoveries[i];
+    }
+  }
+
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+refresh(struct route *r)
+{
+  /* Every route lives ROUTE_LIFETIME from its last use, so the one just
+   * refreshed is never the next to expire */
+  r->expires = clock_time() + ROUTE_LIFETIME;
+  if(ctimer_expired(&purge_timer)) {
+    ctimer_set(&purge_timer, ROUTE_LIFETIME, purge, NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+end_discovery(struct discovery *d, const struct route *r)
+{
+  struct frame *frame;
+  uint8_t sent = 0;
+  uint8_t held = 0;
+
+  ctimer_stop(&d->timer);
+
+  while((frame = list_pop(d->pending)) != NULL) {
+    if(r == NULL) {
+      /* Kept until the destination is reachable again */
+      if(store_put(&d->dest, link_data(frame),
+                   frame->len - LINK_HDR_LEN) == 0) {
+        held++;
+      }
+      frame_pool_free(frame);
+    } else if(link_send(frame, LINK_TYPE_ROUTED, &r->next_hop,
+                        frame->len - LINK_HDR_LEN,
+                        TX_CLASS_INTERACTIVE) == 0) {
+      sent++;
+    }
+  }
+
+  if(r == NULL) {
+    LOG_RECORD(ROUTE_DISCOVERY_FAILED, d->dest.u16, d->pending_count, held);
+  } else {
+    LOG_RECORD(ROUTE_DISCOVERED, r->dest.u16, r->next_hop.u16, r->hops, sent);
+  }
+
+  d->pending_count = 0;
+  linkaddr_copy(&d->dest, &linkaddr_null);
+}
+/*---------------------------------------------------------------------------*/
+/* Install or improve a route, NULL if what we know is fresher or better.
+ * Payloads parked for the destination leave as soon as it has a route. */
+static struct route *
+update_route(const linkaddr_t *dest, const linkaddr_t *next_hop,
+             uint16_t seqno, uint8_t hops, uint16_t metric)
+{
+  struct route *r = find_route(dest);
+  struct discovery *d;
+  unsigned i;
+
+  if(r != NULL) {
+    if(SEQNO_NEWER(r->seqno, seqno) ||
+       (r->seqno == seqno && r->metric <= metric)) {
+      return NULL;
+    }
+  } else {
+    /* Take a free entry, or else the one closest to expiring */
+    for(i = 0; i < ROUTE_SIZE; i++) {
+      if(linkaddr_cmp(&routes[i].dest, &linkaddr_null)) {
+        r = &routes[i];
+        break;
+      }
+      if(r == NULL || (int32_t)(routes[i].expires - r->expires) < 0) {
+        r = &routes[i];
+      }
+    }
+    linkaddr_copy(&r->dest, dest);
+  }
+
+  linkaddr_copy(&r->next_hop, next_hop);
+  r->seqno = seqno;
+  r->hops = hops;
+  r->metric = metric;
+  refresh(r);
+  persist_changed();
+
+  /* Payloads of an earlier failure follow, paced in the bulk class */
+  store_flush(dest, next_hop);
+
+  d = find_discovery(dest);
+  if(d != NULL) {
+    end_discovery(d, r);
+  }
+
+  return r;
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_request(struct discovery *d)
+{
+  struct frame *frame = request_frame;
+  uint8_t *p;
+  uint16_t id;
+
+  request_frame = NULL;
+  if(frame == NULL) {
+    frame = frame_pool_alloc();
+    if(frame == NULL) {
+      STATS_INC(ROUTE_NO_FRAME);
+      return;
+    }
+  }
+
+  /* Requests share the flood sequence numbers, so the duplicate cache
+   * tells them apart from floods of the same origin */
+  id = mesh_next_seqno();
+  dup_cache_check(&linkaddr_node_addr, id);
+  own_seqno++;
+  persist_changed();
+
+  p = link_data(frame);
+  p[0] = MSG_RREQ;
+  put_le16(&p[RREQ_ID], id);
+  memcpy(&p[RREQ_ORIGIN], &linkaddr_node_addr, LINKADDR_SIZE);
+  put_le16(&p[RREQ_SEQNO], own_seqno);
+  memcpy(&p[RREQ_TARGET], &d->dest, LINKADDR_SIZE);
+  p[MSG_HOPS(RREQ_LEN)] = 0;
+  put_le16(&p[MSG_METRIC(RREQ_LEN)], 0);
+
+  link_send(frame, LINK_TYPE_ROUTE, &linkaddr_null, RREQ_LEN,
+            TX_CLASS_CONTROL);
+
+  /* Taken back right away, or at the next park() if the pool is empty */
+  request_frame = frame_pool_alloc();
+}
+/*---------------------------------------------------------------------------*/
+static void
+discovery_timeout(void *ptr)
+{
+  struct discovery *d = ptr;
+
+  if(d->retries++ == ROUTE_DISCOVERY_RETRIES) {
+    end_discovery(d, NULL);
+    return;
+  }
+
+  send_request(d);
+  ctimer_set(&d->timer, ROUTE_DISCOVERY_TIMEOUT << d->retries,
+             discovery_timeout, d);
+}
+/*---------------------------------------------------------------------------*/
+static int
+park(struct frame *frame, const linkaddr_t *dst)
+{
+  struct discovery *d = find_discovery(dst);
+
+  if(request_frame == NULL) {
+    request_frame = frame_pool_alloc();
+  }
+
+  if(d == NULL) {
+    d = find_discovery(&linkaddr_null);
+    if(d == NULL) {
+      return -1;
+    }
+    linkaddr_copy(&d->dest, dst);
+    d->retries = 0;
+    send_request(d);
+    ctimer_set(&d->timer, ROUTE_DISCOVERY_TIMEOUT, discovery_timeout, d);
+  }
+
+  if(d->pending_count == ROUTE_PENDING) {
+    return -1;
+  }
+
+  list_add(d->pending, frame);
+  d->pending_count++;
+
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+forward_timeout(void *ptr)
+{
+  link_send(forward_frame, LINK_TYPE_ROUTE, &linkaddr_null,
+            forward_frame->len - LINK_HDR_LEN, TX_CLASS_CONTROL);
+  forward_frame = NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_reply(const linkaddr_t *origin, const linkaddr_t *next_hop)
+{
+  struct frame *frame = frame_pool_alloc();
+  uint8_t *p;
+
+  if(frame == NULL) {
+    STATS_INC(ROUTE_NO_FRAME);
+    return;
+  }
+
+  own_seqno++;
+  persist_changed();
+
+  p = link_data(frame);
+  p[0] = MSG_RREP;
+  memcpy(&p[RREP_ORIGIN], origin, LINKADDR_SIZE);
+  memcpy(&p[RREP_TARGET], &linkaddr_node_addr, LINKADDR_SIZE);
+  put_le16(&p[RREP_SEQNO], own_seqno);
+  p[MSG_HOPS(RREP_LEN)] = 0;
+  put_le16(&p[MSG_METRIC(RREP_LEN)], 0);
+
+  link_send(frame, LINK_TYPE_ROUTE, next_hop, RREP_LEN, TX_CLASS_CONTROL);
+}
+/*---------------------------------------------------------------------------*/
+static void
+request_input(struct frame *frame, const struct link_hdr *hdr)
+{
+  uint8_t *p = link_data(frame);
+  linkaddr_t origin, target;
+  uint8_t hops = p[MSG_HOPS(RREQ_LEN)] + 1;
+  uint16_t metric = get_le16(&p[MSG_METRIC(RREQ_LEN)]);
+
+  memcpy(&origin, &p[RREQ_ORIGIN], LINKADDR_SIZE);
+  memcpy(&target, &p[RREQ_TARGET], LINKADDR_SIZE);
+  if(!valid_dest(&origin)) {
+    /* Includes our own requests coming back */
+    frame_pool_free(frame);
+    return;
+  }
+  metric = MIN(metric + neighbor_link_etx(&hdr->src), UINT16_MAX);
+
+  /* A later copy may still bring a better way back to the origin */
+  update_route(&origin, &hdr->src, get_le16(&p[RREQ_SEQNO]), hops, metric);
+
+  if(dup_cache_check(&origin, get_le16(&p[RREQ_ID]))) {
+    frame_pool_free(frame);
+    return;
+  }
+
+  if(linkaddr_cmp(&target, &linkaddr_node_addr)) {
+    send_reply(&origin, &hdr->src);
+    frame_pool_free(frame);
+    return;
+  }
+
+  if(hops >= ROUTE_MAX_HOPS || forward_frame != NULL) {
+    frame_pool_free(frame);
+    return;
+  }
+
+  p[MSG_HOPS(RREQ_LEN)] = hops;
+  put_le16(&p[MSG_METRIC(RREQ_LEN)], metric);
+  forward_frame = frame;
+  ctimer_set(&forward_timer, 1 + random_rand() % MESH_FORWARD_JITTER,
+             forward_timeout, NULL);
+}
+/*---------------------------------------------------------------------------*/
+static void
+reply_input(struct frame *frame, const struct link_hdr *hdr)
+{
+  uint8_t *p = link_data(frame);
+  linkaddr_t origin, target;
+  uint8_t hops = p[MSG_HOPS(RREP_LEN)] + 1;
+  uint16_t metric = get_le16(&p[MSG_METRIC(RREP_LEN)]);
+  struct route *r;
+
+  memcpy(&origin, &p[RREP_ORIGIN], LINKADDR_SIZE);
+  memcpy(&target, &p[RREP_TARGET], LINKADDR_SIZE);
+  if(!valid_dest(&target)) {
+    frame_pool_free(frame);
+    return;
+  }
+  metric = MIN(metric + neighbor_link_etx(&hdr->src), UINT16_MAX);
+
+  r = update_route(&target, &hdr->src, get_le16(&p[RREP_SEQNO]), hops,
+                   metric);
+  if(r == NULL) {
+    frame_pool_free(frame);
+    return;
+  }
+
+  if(linkaddr_cmp(&origin, &linkaddr_node_addr)) {
+    /* update_route() already sent what was waiting for the target */
+    frame_pool_free(frame);
+    return;
+  }
+
+  r = find_route(&origin);
+  if(r != NULL) {
+    p[MSG_HOPS(RREP_LEN)] = hops;
+    put_le16(&p[MSG_METRIC(RREP_LEN)], metric);
+    link_send(frame, LINK_TYPE_ROUTE, &r->next_hop, RREP_LEN,
+              TX_CLASS_CONTROL);
+  } else {
+    frame_pool_free(frame);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+data_input(struct frame *frame, const struct link_hdr *hdr)
+{
+  uint8_t *p = link_data(frame);
+  uint16_t len = frame->len - LINK_HDR_LEN;
+  struct link_hdr routed_hdr;
+  linkaddr_t dst;
+  struct route *r;
+
+  memcpy(&dst, &p[DATA_DST], LINKADDR_SIZE);
+
+  if(linkaddr_cmp(&dst, &linkaddr_node_addr)) {
+    if(input_callback != NULL) {
+      routed_hdr = *hdr;
+      memcpy(&routed_hdr.src, &p[DATA_SRC], LINKADDR_SIZE);
+      input_callback(&routed_hdr, p + ROUTE_HDR_LEN, len - ROUTE_HDR_LEN);
+    }
+    frame_pool_free(frame);
+    return;
+  }
+
+  r = find_route(&dst);
+  if(r == NULL && p[DATA_HOPS] > 1) {
+    /* Held as it would be forwarded */
+    p[DATA_HOPS]--;
+    if(store_put(&dst, p, len) == 0) {
+      frame_pool_free(frame);
+      return;
+    }
+    p[DATA_HOPS]++;
+  }
+  if(r == NULL || p[DATA_HOPS] <= 1) {
+    LOG_RECORD(ROUTE_NO_ROUTE, dst.u16, p[DATA_HOPS]);
+    STATS_INC(DROP_NO_ROUTE);
+    frame_pool_free(frame);
+    return;
+  }
+
+  /* Forwarded in place, link_send() rewrites the link header */
+  p[DATA_HOPS]--;
+  refresh(r);
+  link_send(frame, LINK_TYPE_ROUTED, &r->next_hop, len, TX_CLASS_INTERACTIVE);
+}
+/*---------------------------------------------------------------------------*/
+/* Expiry times are left out, they would differ between the two calls of
+ * a save */
+static void
+save(void)
+{
+  uint8_t buf[SAVED_LEN];
+  unsigned i;
+
+  put_le16(buf, own_seqno);
+  persist_put(buf, 2);
+
+  for(i = 0; i < ROUTE_SIZE; i++) {
+    if(linkaddr_cmp(&routes[i].dest, &linkaddr_null)) {
+      continue;
+    }
+    memcpy(&buf[0], &routes[i].dest, LINKADDR_SIZE);
+    memcpy(&buf[LINKADDR_SIZE], &routes[i].next_hop, LINKADDR_SIZE);
+    put_le16(&buf[2 * LINKADDR_SIZE], routes[i].seqno);
+    put_le16(&buf[2 * LINKADDR_SIZE + 2], routes[i].metric);
+    buf[2 * LINKADDR_SIZE + 4] = routes[i].hops;
+    persist_put(buf, sizeof(buf));
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+restore(uint16_t len)
+{
+  uint8_t buf[SAVED_LEN];
+  unsigned i;
+
+  if(persist_get(buf, 2) != 0) {
+    return;
+  }
+  own_seqno = get_le16(buf);
+
+  for(i = 0; i < ROUTE_SIZE && persist_get(buf, sizeof(buf)) == 0; i++) {
+    memcpy(&routes[i].dest, &buf[0], LINKADDR_SIZE);
+    if(!valid_dest(&routes[i].dest)) {
+      /* Saved under another node address */
+      linkaddr_copy(&routes[i].dest, &linkaddr_null);
+      continue;
+    }
+    memcpy(&routes[i].next_hop, &buf[LINKADDR_SIZE], LINKADDR_SIZE);
+    routes[i].seqno = get_le16(&buf[2 * LINKADDR_SIZE]);
+    routes[i].metric = get_le16(&buf[2 * LINKADDR_SIZE + 2]);
+    routes[i].hops = buf[2 * LINKADDR_SIZE + 4];
+    refresh(&routes[i]);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+route_init(void)
+{
+  unsigned i;
+
+  routes = arena_alloc(ARENA_ROUTE, ROUTE_SIZE * sizeof(struct route));
+  discoveries = arena_alloc(ARENA_ROUTE,
+                            ROUTE_DISCOVERIES * sizeof(struct discovery));
+
+  for(i = 0; i < ROUTE_DISCOVERIES; i++) {
+    LIST_STRUCT_INIT(&discoveries[i], pending);
+  }
+
+  request_frame = frame_pool_alloc();
+
+  persist_register(&persist_handler);
+}
+/*---------------------------------------------------------------------------*/
+void
+route_set_input_callback(link_input_callback_t callback)
+{
+  input_callback = callback;
+}
+/*---------------------------------------------------------------------------*/
+void
+route_input(struct frame *frame, const struct link_hdr *hdr)
+{
+  const uint8_t *p = link_data(frame);
+  uint16_t len = frame->len - LINK_HDR_LEN;
+
+  if(hdr->type == LINK_TYPE_ROUTED && len >= ROUTE_HDR_LEN) {
+    data_input(frame, hdr);
+  } else if(hdr->type == LINK_TYPE_ROUTE && len == RREQ_LEN &&
+            p[0] == MSG_RREQ) {
+    request_input(frame, hdr);
+  } else if(hdr->type == LINK_TYPE_ROUTE && len == RREP_LEN &&
+            p[0] == MSG_RREP) {
+    reply_input(frame, hdr);
+  } else {
+    LOG_RECORD(LINK_RUNT, frame->len);
+    STATS_INC(DROP_RUNT);
+    frame_pool_free(frame);
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+route_send(const linkaddr_t *dst, const uint8_t *data, uint16_t len)
+{
+  struct frame *frame;
+  struct route *r;
+  uint8_t *p;
+
+  if(len == 0 || len > ROUTE_MAX_DATA_LEN || !valid_dest(dst)) {
+    return -1;
+  }
+
+  frame = frame_pool_alloc();
+  if(frame == NULL) {
+    return -1;
+  }
+
+  p = link_data(frame);
+  memcpy(&p[DATA_DST], dst, LINKADDR_SIZE);
+  memcpy(&p[DATA_SRC], &linkaddr_node_addr, LINKADDR_SIZE);
+  p[DATA_HOPS] = ROUTE_MAX_HOPS;
+  memcpy(p + ROUTE_HDR_LEN, data, len);
+
+  r = find_route(dst);
+  if(r == NULL) {
+    /* Parked frames have their length set as link_send() would */
+    frame->len = LINK_HDR_LEN + ROUTE_HDR_LEN + len;
+    if(park(frame, dst) != 0) {
+      frame_pool_free(frame);
+      return -1;
+    }
+    return 0;
+  }
+
+  refresh(r);
+  return link_send(frame, LINK_TYPE_ROUTED, &r->next_hop, ROUTE_HDR_LEN + len,
+                   TX_CLASS_INTERACTIVE);
+}
+/*---------------------------------------------------------------------------*/
+int
+route_lookup(const linkaddr_t *dst, linkaddr_t *next_hop)
+{
+  const struct route *r = find_route(dst);
+
+  if(r == NULL) {
+    return -1;
+  }
+
+  linkaddr_copy(next_hop, &r->next_hop);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
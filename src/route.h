@@ -0,0 +1,138 @@
+/**
+ * \file
+ *         On demand routing, after AODV
+ *
+ *         Routes are only looked for when there is traffic for them. A
+ *         payload to a destination without a route is parked while a route
+ *         request floods the mesh; every node the request crosses learns
+ *         the way back to its origin, and the destination answers with a
+ *         route reply that travels back along that reverse path, setting
+ *         up the forward route hop by hop. Routes expire after
+ *         ROUTE_LIFETIME without traffic.
+ *
+ *         Paths are chosen by summed link ETX, see neighbor.h, with
+ *         destination sequence numbers telling fresh routes from stale
+ *         ones as in AODV. Only the destination answers requests, and
+ *         broken routes are not reported upstream: they time out, and the
+ *         next payload starts a new discovery. Payloads left without a
+ *         route, on a relay or once a discovery failed, are held in the
+ *         store until a route shows up, see store.h.
+ *
+ *         Routes and the own sequence number are saved to flash, see
+ *         persist.h. Restored routes live ROUTE_LIFETIME from the boot, and
+ *         the sequence number goes on from where it was, so that replies
+ *         after a reset are not taken for stale ones.
+ *
+ *         Routed payloads travel in LINK_TYPE_ROUTED frames prefixed with
+ *         [destination (2)] [source (2)] [hops left (1)], control messages
+ *         in LINK_TYPE_ROUTE frames:
+ *         request: [0] [id (2)] [origin (2)] [origin seqno (2)]
+ *                  [target (2)] [hops (1)] [metric (2)]
+ *         reply:   [1] [origin (2)] [target (2)] [target seqno (2)]
+ *                  [hops (1)] [metric (2)]
+ */
+#ifndef ROUTE_H
+#define ROUTE_H
+
+#include "contiki.h"
+#include "frame-pool.h"
+#include "link.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------*/
+/** Destinations the route cache holds */
+#ifdef ROUTE_CONF_SIZE
+#define ROUTE_SIZE ROUTE_CONF_SIZE
+#else
+#define ROUTE_SIZE 16
+#endif
+
+/** Time a route is kept without traffic, in clock ticks */
+#ifdef ROUTE_CONF_LIFETIME
+#define ROUTE_LIFETIME ROUTE_CONF_LIFETIME
+#else
+#define ROUTE_LIFETIME (60 * CLOCK_SECOND)
+#endif
+
+/** Destinations that can be discovered at the same time */
+#ifdef ROUTE_CONF_DISCOVERIES
+#define ROUTE_DISCOVERIES ROUTE_CONF_DISCOVERIES
+#else
+#define ROUTE_DISCOVERIES 2
+#endif
+
+/** Payloads parked per destination while its route is discovered, one
+ * frame of the pool is kept back from them for the route requests */
+#ifdef ROUTE_CONF_PENDING
+#define ROUTE_PENDING ROUTE_CONF_PENDING
+#else
+#define ROUTE_PENDING 2
+#endif
+
+/** Wait for a reply to the first request, doubled on every retry */
+#ifdef ROUTE_CONF_DISCOVERY_TIMEOUT
+#define ROUTE_DISCOVERY_TIMEOUT ROUTE_CONF_DISCOVERY_TIMEOUT
+#else
+#define ROUTE_DISCOVERY_TIMEOUT (CLOCK_SECOND / 2)
+#endif
+
+/** Requests sent after the first before giving a destination up */
+#ifdef ROUTE_CONF_DISCOVERY_RETRIES
+#define ROUTE_DISCOVERY_RETRIES ROUTE_CONF_DISCOVERY_RETRIES
+#else
+#define ROUTE_DISCOVERY_RETRIES 2
+#endif
+
+/** Longest path, in hops */
+#ifdef ROUTE_CONF_MAX_HOPS
+#define ROUTE_MAX_HOPS ROUTE_CONF_MAX_HOPS
+#else
+#define ROUTE_MAX_HOPS 8
+#endif
+
+#define ROUTE_HDR_LEN      (2 * LINKADDR_SIZE + 1)
+#define ROUTE_MAX_DATA_LEN (LINK_MAX_DATA_LEN - ROUTE_HDR_LEN)
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Allocate the route cache and the discovery state.
+ */
+void route_init(void);
+
+/**
+ * \brief Set the function receiving routed payloads addressed to this node.
+ *
+ * The header passed to it carries the source of the payload, not the
+ * neighbor that forwarded it.
+ */
+void route_set_input_callback(link_input_callback_t callback);
+
+/**
+ * \brief Process a received LINK_TYPE_ROUTE or LINK_TYPE_ROUTED frame,
+ *        taking ownership of it.
+ */
+void route_input(struct frame *frame, const struct link_hdr *hdr);
+
+/**
+ * \brief Send a payload to a node of the mesh, discovering a route first
+ *        if there is none.
+ * \return 0 if sent or parked for discovery, -1 on error.
+ */
+int route_send(const linkaddr_t *dst, const uint8_t *data, uint16_t len);
+
+/**
+ * \brief Next hop towards a destination.
+ * \return 0 and the next hop if there is a route, -1 otherwise.
+ */
+int route_lookup(const linkaddr_t *dst, linkaddr_t *next_hop);
+/*---------------------------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ROUTE_H */
@@ -0,0 +1,386 @@
+/**
+ * \file
+ *         Time-slotted MAC mode
+ */
+#include "contiki.h"
+#include "slots.h"
+#include "arena.h"
+#include "byteorder.h"
+#include "frame-pool.h"
+#include "link.h"
+#include "log-ring.h"
+#include "rf-core.h"
+#include "stats.h"
+#include "tx-sched.h"
+#include "lib/random.h"
+
+#include <string.h>
+/*---------------------------------------------------------------------------*/
+#define SLOT_TICKS      (SLOTS_SLOT_LEN * RF_CORE_TICKS_PER_US)
+#define TX_OFFSET_TICKS (SLOTS_TX_OFFSET * RF_CORE_TICKS_PER_US)
+#define GUARD_TICKS     ((int32_t)(SLOTS_GUARD * RF_CORE_TICKS_PER_US))
+/* RF core ticks per clock tick */
+#define TICKS_PER_CLOCK (1000000UL * RF_CORE_TICKS_PER_US / CLOCK_SECOND)
+
+/* The scheduler wakes a clock tick ahead of a cell, the RF core timer
+ * triggers the rest */
+#define WAKE_AHEAD      1
+/* Least time between picking a cell and its start, for the RF core to
+ * wind RX down */
+#define MIN_LEAD_TICKS  (1000UL * RF_CORE_TICKS_PER_US)
+
+#define SHARED_SLOT     0
+
+/* Traffic of a link is tracked in frames per slotframe, in 1/16 */
+#define LOAD_ONE        16
+
+#define BEACON_INTERVAL \
+  ((clock_time_t)((uint64_t)SLOTS_BEACON_PERIOD * SLOTS_SLOTFRAME_LEN * \
+                  SLOTS_SLOT_LEN * CLOCK_SECOND / 1000000UL))
+
+_Static_assert(SLOTS_SLOTFRAME_LEN > 1 && SLOTS_SLOTFRAME_LEN < 256,
+               "SLOTS_CONF_SLOTFRAME_LEN out of range");
+_Static_assert(SLOTS_TX_OFFSET < SLOTS_SLOT_LEN &&
+               SLOTS_SLOT_LEN * RF_CORE_TICKS_PER_US < (1UL << 30),
+               "SLOTS_CONF_TX_OFFSET must fit in SLOTS_CONF_SLOT_LEN");
+_Static_assert(SLOTS_GUARD <= SLOTS_SLOT_LEN / 2,
+               "SLOTS_CONF_GUARD past half a slot");
+_Static_assert(SLOTS_MAX_CELLS > 0 && SLOTS_MAX_CELLS * LOAD_ONE < 256,
+               "SLOTS_CONF_MAX_CELLS out of range");
+/*---------------------------------------------------------------------------*/
+struct link_load {
+  /* Receiving end, linkaddr_null for the broadcasts of this node */
+  linkaddr_t dst;
+  /* Frames given a cell in the current slotframe */
+  uint8_t sent;
+  /* Average frames per slotframe wanted, in 1/LOAD_ONE */
+  uint8_t load;
+};
+
+_Static_assert(ARENA_SIZEOF(SLOTS_LINKS * sizeof(struct link_load)) <=
+               ARENA_QUOTA_SLOTS,
+               "SLOTS_CONF_LINKS links do not fit in ARENA_CONF_QUOTA_SLOTS");
+
+static struct link_load *links;
+/* Slotframe the loads were last updated for */
+static uint32_t load_frame;
+
+/* RF core time slot ref_asn started at, moved along as time goes by */
+static uint32_t ref_asn;
+static uint32_t ref_time;
+/* From the start of a transmission to its RX timestamp, in ticks */
+static uint32_t sync_ticks;
+
+static linkaddr_t root;
+/* Neighbor slot timing is taken from, linkaddr_null for the root */
+static linkaddr_t time_source;
+static uint8_t hops;
+static clock_time_t source_seen;
+
+static struct ctimer beacon_timer;
+/*---------------------------------------------------------------------------*/
+/* Bring the reference up to the slot going on now */
+static void
+advance(uint32_t now)
+{
+  const uint32_t slots = (now - ref_time) / SLOT_TICKS;
+
+  ref_asn += slots;
+  ref_time += slots * SLOT_TICKS;
+}
+/*---------------------------------------------------------------------------*/
+/* Distance from the nearest slot boundary to the start of a slot seen at
+ * time t, in ticks */
+static int32_t
+slot_error(uint32_t t)
+{
+  int32_t err = (int32_t)(t - ref_time) % (int32_t)SLOT_TICKS;
+
+  if(err > (int32_t)SLOT_TICKS / 2) {
+    err -= SLOT_TICKS;
+  } else if(err < -(int32_t)SLOT_TICKS / 2) {
+    err += SLOT_TICKS;
+  }
+
+  return err;
+}
+/*---------------------------------------------------------------------------*/
+static void
+count_sync(int32_t err)
+{
+  STATS_INC(SLOTS_SYNCS);
+  STATS_MAX(SLOTS_DRIFT_HWM, (err < 0 ? -err : err) / RF_CORE_TICKS_PER_US);
+  source_seen = clock_time();
+}
+/*---------------------------------------------------------------------------*/
+static void
+become_root(void)
+{
+  linkaddr_copy(&root, &linkaddr_node_addr);
+  linkaddr_copy(&time_source, &linkaddr_null);
+  hops = 0;
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t
+cells(const struct link_load *link)
+{
+  const uint8_t n = (link->load + LOAD_ONE - 1) / LOAD_ONE;
+
+  return MIN(MAX(n, 1), SLOTS_MAX_CELLS);
+}
+/*---------------------------------------------------------------------------*/
+/* Slot of cell i of the link to dst, never the shared one */
+static uint8_t
+cell_slot(const linkaddr_t *dst, uint8_t i)
+{
+  uint32_t key;
+
+  key = ((uint32_t)linkaddr_node_addr.u16 << 16) | dst->u16;
+  key = (uint32_t)((key ^ (i * 0x9E3779B9UL)) * 2654435761UL);
+
+  return 1 + (key >> 16) % (SLOTS_SLOTFRAME_LEN - 1);
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * The schedule function: once per slotframe, a link that used each of its
+ * cells asks for one more, and settles at the rate it sends at otherwise.
+ */
+static void
+update_loads(void)
+{
+  const uint32_t frame = ref_asn / SLOTS_SLOTFRAME_LEN;
+  uint32_t elapsed = frame - load_frame;
+  struct link_load *link;
+  uint8_t wanted;
+  unsigned i;
+
+  /* Quiet slotframes past a few would only decay the loads further */
+  elapsed = MIN(elapsed, 8);
+
+  for(; elapsed > 0; elapsed--) {
+    for(i = 0; i < SLOTS_LINKS; i++) {
+      link = &links[i];
+      wanted = link->sent >= cells(link) ? cells(link) + 1 : link->sent;
+      wanted = MIN(wanted, SLOTS_MAX_CELLS);
+      link->load = (3 * link->load + wanted * LOAD_ONE) / 4;
+      link->sent = 0;
+    }
+  }
+
+  load_frame = frame;
+}
+/*---------------------------------------------------------------------------*/
+static struct link_load *
+find_link(const linkaddr_t *dst)
+{
+  struct link_load *quietest = &links[0];
+  unsigned i;
+
+  for(i = 0; i < SLOTS_LINKS; i++) {
+    if(linkaddr_cmp(&links[i].dst, dst)) {
+      return &links[i];
+    }
+    if(links[i].load + links[i].sent <
+       quietest->load + quietest->sent) {
+      quietest = &links[i];
+    }
+  }
+
+  linkaddr_copy(&quietest->dst, dst);
+  quietest->sent = 0;
+  quietest->load = 0;
+  return quietest;
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_beacon(void *ptr)
+{
+  struct frame *frame;
+  uint8_t *data;
+
+  ctimer_set(&beacon_timer, BEACON_INTERVAL / 2 +
+             random_rand() % (BEACON_INTERVAL / 2 + 1), send_beacon, NULL);
+
+  if(!linkaddr_cmp(&time_source, &linkaddr_null) &&
+     clock_time() - source_seen > SLOTS_SOURCE_TIMEOUT) {
+    LOG_RECORD(SLOTS_SOURCE_LOST, time_source.u16);
+    become_root();
+  }
+
+  frame = frame_pool_alloc();
+  if(frame == NULL) {
+    return;
+  }
+
+  /* The ASN is only known once the frame has its cell */
+  data = link_data(frame);
+  put_le32(data, 0);
+  memcpy(&data[4], &root, LINKADDR_SIZE);
+  data[4 + LINKADDR_SIZE] = hops;
+
+  link_send(frame, LINK_TYPE_BEACON, &linkaddr_null, SLOTS_BEACON_LEN,
+            TX_CLASS_CONTROL);
+}
+/*---------------------------------------------------------------------------*/
+void
+slots_init(uint32_t sync_us)
+{
+  unsigned i;
+
+  links = arena_alloc(ARENA_SLOTS, SLOTS_LINKS * sizeof(struct link_load));
+  for(i = 0; i < SLOTS_LINKS; i++) {
+    linkaddr_copy(&links[i].dst, &linkaddr_null);
+    links[i].sent = 0;
+    links[i].load = 0;
+  }
+
+  sync_ticks = sync_us * RF_CORE_TICKS_PER_US;
+  ref_asn = 0;
+  ref_time = rf_core_time();
+  load_frame = 0;
+  become_root();
+
+  ctimer_set(&beacon_timer, random_rand() % (BEACON_INTERVAL + 1),
+             send_beacon, NULL);
+}
+/*---------------------------------------------------------------------------*/
+clock_time_t
+slots_next_cell(struct frame *frame, uint32_t *start)
+{
+  const uint8_t *p = frame_payload(frame);
+  const uint8_t type = p[0] & LINK_TYPE_MASK;
+  const uint32_t now = rf_core_time();
+  struct link_load *link = NULL;
+  linkaddr_t dst;
+  uint32_t asn, ahead;
+  uint8_t slot, n, i;
+  unsigned k;
+
+  advance(now);
+  update_loads();
+
+  if(type != LINK_TYPE_BEACON) {
+    memcpy(&dst, &p[2], LINKADDR_SIZE);
+    link = find_link(&dst);
+  }
+  n = link != NULL ? cells(link) : 0;
+
+  /* The first slot that starts late enough, then on to a cell */
+  asn = ref_asn;
+  if((int32_t)(ref_time + TX_OFFSET_TICKS - now) < (int32_t)MIN_LEAD_TICKS) {
+    asn++;
+  }
+  for(k = 0; k < SLOTS_SLOTFRAME_LEN; k++, asn++) {
+    slot = asn % SLOTS_SLOTFRAME_LEN;
+    if(link == NULL) {
+      if(slot == SHARED_SLOT) {
+        break;
+      }
+      continue;
+    }
+    for(i = 0; i < n && cell_slot(&link->dst, i) != slot; i++);
+    if(i < n) {
+      break;
+    }
+  }
+
+  *start = ref_time + (asn - ref_asn) * SLOT_TICKS + TX_OFFSET_TICKS;
+
+  if(link != NULL) {
+    link->sent++;
+  } else {
+    put_le32(link_data(frame), asn);
+  }
+
+  ahead = (*start - now) / TICKS_PER_CLOCK;
+  return ahead > WAKE_AHEAD ? ahead - WAKE_AHEAD : 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+slots_on_time(uint32_t start)
+{
+  return (int32_t)(start - rf_core_time()) >= (int32_t)MIN_LEAD_TICKS;
+}
+/*---------------------------------------------------------------------------*/
+void
+slots_input(const struct link_hdr *hdr)
+{
+  int32_t err;
+
+  if(hdr->rx_meta == NULL || hdr->type == LINK_TYPE_BEACON ||
+     linkaddr_cmp(&time_source, &linkaddr_null) ||
+     !linkaddr_cmp(&hdr->src, &time_source)) {
+    return;
+  }
+
+  /* Any frame of the time source started TX_OFFSET into a slot */
+  err = slot_error(hdr->rx_meta->timestamp - sync_ticks - TX_OFFSET_TICKS);
+  if(err >= -GUARD_TICKS && err <= GUARD_TICKS) {
+    ref_time += err;
+    count_sync(err);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+slots_beacon_input(struct frame *frame, const struct link_hdr *hdr)
+{
+  const uint8_t *data = link_data(frame);
+  linkaddr_t beacon_root;
+  uint8_t beacon_hops;
+  uint32_t begin;
+  int32_t err;
+  int better;
+  int follow;
+
+  if(frame->len - LINK_HDR_LEN < SLOTS_BEACON_LEN || hdr->rx_meta == NULL) {
+    frame_pool_free(frame);
+    return;
+  }
+
+  memcpy(&beacon_root, &data[4], LINKADDR_SIZE);
+  beacon_hops = data[4 + LINKADDR_SIZE];
+
+  /* Lower roots win, then shorter paths to the same root, and the time
+   * source is followed wherever it goes */
+  better = memcmp(&beacon_root, &root, LINKADDR_SIZE);
+  better = better < 0 ||
+           (better == 0 && beacon_hops + 1 < hops) ||
+           linkaddr_cmp(&hdr->src, &time_source);
+  if(!better || beacon_hops == 0xFF ||
+     linkaddr_cmp(&beacon_root, &linkaddr_node_addr)) {
+    frame_pool_free(frame);
+    return;
+  }
+
+  /* The beacon started TX_OFFSET into the slot it names. The time source
+   * only drifts, a new source or root may run on any timing. */
+  begin = hdr->rx_meta->timestamp - sync_ticks - TX_OFFSET_TICKS;
+  err = slot_error(begin);
+  follow = linkaddr_cmp(&hdr->src, &time_source) &&
+           linkaddr_cmp(&beacon_root, &root);
+  if(follow && (err < -GUARD_TICKS || err > GUARD_TICKS)) {
+    STATS_INC(SLOTS_REJECTS);
+    frame_pool_free(frame);
+    return;
+  }
+
+  if(!linkaddr_cmp(&hdr->src, &time_source)) {
+    LOG_RECORD(SLOTS_TIME_SOURCE, hdr->src.u16, beacon_root.u16,
+               beacon_hops + 1);
+  }
+  linkaddr_copy(&root, &beacon_root);
+  linkaddr_copy(&time_source, &hdr->src);
+  hops = beacon_hops + 1;
+
+  if(follow) {
+    count_sync(err);
+  } else {
+    source_seen = clock_time();
+  }
+  ref_asn = get_le32(data);
+  ref_time = begin;
+  advance(rf_core_time());
+
+  frame_pool_free(frame);
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,147 @@
+/**
+ * \file
+ *         Time-slotted MAC mode
+ *
+ *         Built with TX_SCHED_CONF_MODE set to TX_SCHED_MODE_SLOTTED, the
+ *         TX scheduler no longer sends a frame as soon as the channel is
+ *         clear but only in the cells of its link, in a slotframe of
+ *         SLOTS_SLOTFRAME_LEN slots repeating for as long as the network
+ *         runs. RX stays on outside of the node's own transmissions, a cell
+ *         only says when a link may send:
+ *         - slot 0 is shared by the beacons of every node
+ *         - the other slots are dedicated cells, that the schedule hands
+ *           out from a hash of both ends of a link, the broadcasts of a
+ *           node counting as one link. A link gets one cell, and more as
+ *           its traffic grows, up to SLOTS_MAX_CELLS, so two links only
+ *           contend where their hashes meet.
+ *
+ *         Slot timing comes from beacons, sent in the shared slot every
+ *         SLOTS_BEACON_PERIOD slotframes:
+ *         LINK_TYPE_BEACON [ASN (4)] [root (2)] [hops (1)]
+ *         where the ASN numbers the slot the beacon goes out in. Every node
+ *         follows the neighbor the fewest hops away from the lowest address
+ *         it knows of, the root, and every frame of that time source
+ *         corrects the drift, unless off by more than SLOTS_GUARD. A node
+ *         starts as its own root, and falls back to that when its time
+ *         source is not heard for SLOTS_SOURCE_TIMEOUT.
+ *
+ *         Frames start SLOTS_TX_OFFSET into their slot, triggered by the RF
+ *         core timer, see rf_core_transmit_scheduled(), which is what lets
+ *         the receivers locate slot boundaries from their RX timestamps.
+ *         Low-power listening does not mix with slots, its preamble spans
+ *         many of them.
+ */
+#ifndef SLOTS_H
+#define SLOTS_H
+
+#include "contiki.h"
+#include "frame-pool.h"
+#include "link.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------*/
+/** Slots per slotframe, a prime keeps the dedicated cells of links apart */
+#ifdef SLOTS_CONF_SLOTFRAME_LEN
+#define SLOTS_SLOTFRAME_LEN SLOTS_CONF_SLOTFRAME_LEN
+#else
+#define SLOTS_SLOTFRAME_LEN 17
+#endif
+
+/** Slot duration in us, long enough for the offset and the largest frame */
+#ifdef SLOTS_CONF_SLOT_LEN
+#define SLOTS_SLOT_LEN SLOTS_CONF_SLOT_LEN
+#else
+#define SLOTS_SLOT_LEN 50000UL
+#endif
+
+/** Start of a transmission into its slot in us, carrier sense comes first */
+#ifdef SLOTS_CONF_TX_OFFSET
+#define SLOTS_TX_OFFSET SLOTS_CONF_TX_OFFSET
+#else
+#define SLOTS_TX_OFFSET 2000UL
+#endif
+
+/** Largest correction taken from the time source in us, a frame further
+ * off carries a bad timestamp */
+#ifdef SLOTS_CONF_GUARD
+#define SLOTS_GUARD SLOTS_CONF_GUARD
+#else
+#define SLOTS_GUARD (SLOTS_SLOT_LEN / 4)
+#endif
+
+/** Most dedicated cells a busy link gets per slotframe */
+#ifdef SLOTS_CONF_MAX_CELLS
+#define SLOTS_MAX_CELLS SLOTS_CONF_MAX_CELLS
+#else
+#define SLOTS_MAX_CELLS 4
+#endif
+
+/** Links whose traffic is tracked, quiet ones make room for new ones */
+#ifdef SLOTS_CONF_LINKS
+#define SLOTS_LINKS SLOTS_CONF_LINKS
+#else
+#define SLOTS_LINKS 8
+#endif
+
+/** Slotframes between two beacons of a node */
+#ifdef SLOTS_CONF_BEACON_PERIOD
+#define SLOTS_BEACON_PERIOD SLOTS_CONF_BEACON_PERIOD
+#else
+#define SLOTS_BEACON_PERIOD 4
+#endif
+
+/** Silence of the time source after which a node is its own root again,
+ * in clock ticks */
+#ifdef SLOTS_CONF_SOURCE_TIMEOUT
+#define SLOTS_SOURCE_TIMEOUT SLOTS_CONF_SOURCE_TIMEOUT
+#else
+#define SLOTS_SOURCE_TIMEOUT (30 * CLOCK_SECOND)
+#endif
+
+#define SLOTS_BEACON_LEN (4 + LINKADDR_SIZE + 1)
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Start as the root of a network of one, and send beacons.
+ * \param sync_us Start of a transmission to its RX timestamp, see
+ *                struct rf_core_params
+ */
+void slots_init(uint32_t sync_us);
+
+/**
+ * \brief Find the next cell a frame may go out in.
+ *
+ * The frame has its link header written. A beacon gets the ASN of the cell
+ * filled in, which makes it good for that cell only.
+ *
+ * \param start Set to the RF core time the transmission starts at
+ * \return Clock ticks to wait before handing the frame to the RF core
+ */
+clock_time_t slots_next_cell(struct frame *frame, uint32_t *start);
+
+/**
+ * \brief Whether the start of a cell found by slots_next_cell() is still
+ *        far enough ahead for the RF core to make it.
+ */
+int slots_on_time(uint32_t start);
+
+/**
+ * \brief Correct the slot timing from a frame of the time source.
+ */
+void slots_input(const struct link_hdr *hdr);
+
+/**
+ * \brief Handle a received beacon, frame ownership passes to the callee.
+ */
+void slots_beacon_input(struct frame *frame, const struct link_hdr *hdr);
+/*---------------------------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SLOTS_H */
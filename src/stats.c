@@ -0,0 +1,115 @@
+/**
+ * \file
+ *         Runtime statistics block
+ */
+#include "contiki.h"
+#include "stats.h"
+#include "byteorder.h"
+#include "host-link.h"
+
+#include <string.h>
+/*---------------------------------------------------------------------------*/
+_Static_assert(sizeof(struct stats_block) == 8 + 4 * STATS_WORD_COUNT,
+               "struct stats_block must not have padding");
+_Static_assert(sizeof(struct stats_block) <= HOST_LINK_MAX_FRAME_LEN,
+               "the statistics block does not fit in one host link frame");
+/*---------------------------------------------------------------------------*/
+#define GAUGE_FLAG(name) [STATS_##name] = 1,
+#define NO_FLAG(name)
+#define NO_HIST_FLAG(name, shift)
+
+/* Gauges hold the latest value of some state, resets leave them alone */
+static const uint8_t gauge[STATS_WORD_COUNT] = {
+  STATS_WORDS(NO_FLAG, GAUGE_FLAG, NO_HIST_FLAG)
+};
+
+#undef GAUGE_FLAG
+#undef NO_FLAG
+#undef NO_HIST_FLAG
+/*---------------------------------------------------------------------------*/
+struct stats_block stats_block;
+
+static void get_input(const uint8_t *args, uint16_t len);
+
+static struct host_link_handler get_handler = {
+  NULL, HOST_CMD_STATS_GET, get_input
+};
+/*---------------------------------------------------------------------------*/
+static void
+get_input(const uint8_t *args, uint16_t len)
+{
+  struct stats_block snapshot;
+  uint8_t out[sizeof(snapshot)];
+  unsigned i;
+
+  stats_snapshot(&snapshot, len > 0 && args[0] != 0);
+
+  put_le16(&out[0], snapshot.version);
+  put_le16(&out[2], snapshot.count);
+  put_le32(&out[4], snapshot.uptime);
+  for(i = 0; i < STATS_WORD_COUNT; i++) {
+    put_le32(&out[8 + 4 * i], snapshot.words[i]);
+  }
+
+  if(host_link_send(HOST_CMD_STATS, out, sizeof(out), NULL, 0) != 0) {
+    host_link_send_result(HOST_CMD_STATS_GET, HOST_STATUS_ERROR);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+stats_init(void)
+{
+  memset(&stats_block, 0, sizeof(stats_block));
+  stats_block.version = STATS_VERSION;
+  stats_block.count = STATS_WORD_COUNT;
+
+  host_link_register(&get_handler);
+}
+/*---------------------------------------------------------------------------*/
+void
+stats_max(uint16_t word, uint32_t value)
+{
+  uint32_t seen = __atomic_load_n(&stats_block.words[word], __ATOMIC_RELAXED);
+
+  /* Retried only if someone else raised the mark in between */
+  while(value > seen &&
+        !__atomic_compare_exchange_n(&stats_block.words[word], &seen, value,
+                                     1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+/*---------------------------------------------------------------------------*/
+void
+stats_hist(uint16_t first, uint8_t shift, uint32_t value)
+{
+  /* Index of the highest set bit, 0 for a value of 0 */
+  const int top = 31 - __builtin_clz(value | 1);
+  int bin = top - shift;
+
+  if(bin < 0) {
+    bin = 0;
+  } else if(bin >= STATS_HIST_BINS) {
+    bin = STATS_HIST_BINS - 1;
+  }
+
+  stats_add(first + bin, 1);
+}
+/*---------------------------------------------------------------------------*/
+void
+stats_snapshot(struct stats_block *out, int reset)
+{
+  unsigned i;
+
+  out->version = STATS_VERSION;
+  out->count = STATS_WORD_COUNT;
+  out->uptime = clock_seconds();
+
+  for(i = 0; i < STATS_WORD_COUNT; i++) {
+    if(reset && !gauge[i]) {
+      out->words[i] = __atomic_exchange_n(&stats_block.words[i], 0,
+                                          __ATOMIC_RELAXED);
+    } else {
+      out->words[i] = __atomic_load_n(&stats_block.words[i],
+                                      __ATOMIC_RELAXED);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,180 @@
+/**
+ * \file
+ *         Runtime statistics block
+ *
+ *         Always-on counters of what the radio does, kept in a single
+ *         packed and versioned block of 32-bit words the host reads with
+ *         HOST_CMD_STATS_GET while everything keeps running. Words are
+ *         updated with single-word atomic operations, safe from interrupts
+ *         and without masking them, and the snapshot copies them one word
+ *         at a time.
+ *
+ *         Four kinds of words are listed in STATS_WORDS: plain counters,
+ *         high-water marks, named *_HWM and only ever raised, gauges, named
+ *         *_NOW and holding the latest value of some state, and histograms
+ *         of STATS_HIST_BINS words each. Histogram bin i counts
+ *         the values whose highest set bit is bit i + shift, the first and
+ *         last bins also take everything below and above.
+ */
+#ifndef STATS_H
+#define STATS_H
+
+#include "contiki.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------*/
+/** Layout version of the block, bumped when a word changes meaning */
+#define STATS_VERSION 1
+
+#define STATS_HIST_BINS 8
+
+/**
+ * Words of the block, C() for counters and high-water marks, G() for
+ * gauges, H() for histograms with the shift of their first bin. Only
+ * append, the host tools identify words by position.
+ */
+#define STATS_WORDS(C, G, H) \
+  C(RX_FRAMES)        /* Frames handed to the link layer */ \
+  C(RX_CRC_ERRORS)    /* Frames flushed by the RF core on a bad CRC */ \
+  C(RX_NO_BUFFER)     /* Frames lost to a full RX queue */ \
+  C(TX_FRAMES)        /* Frames sent */ \
+  C(TX_ERRORS)        /* Transmissions the RF core failed */ \
+  C(CCA_BUSY)         /* Transmissions held back on a busy channel */ \
+  C(DROP_CCA)         /* Frames dropped after the last backoff */ \
+  C(DROP_SCHED_FULL)  /* Frames dropped on a full TX scheduler queue */ \
+  C(DROP_TX_QUEUE)    /* Payloads dropped by the TX queue */ \
+  C(DROP_RUNT)        /* Received frames too short for their header */ \
+  C(DROP_UNSECURED)   /* Received frames failing authentication */ \
+  C(DROP_REPLAY)      /* Received frames with a replayed counter */ \
+  C(DROP_NO_ROUTE)    /* Routed payloads with nowhere to go */ \
+  C(DROP_HOST_LINK)   /* Payloads not forwarded on a full host link */ \
+  C(FRAME_POOL_HWM)   /* Most pool frames in use at once */ \
+  C(SCHED_CONTROL_HWM) /* Most control frames waiting at once */ \
+  C(SCHED_INTERACTIVE_HWM) /* Most interactive frames waiting at once */ \
+  C(SCHED_BULK_HWM)   /* Most bulk frames waiting at once */ \
+  C(HOST_LINK_TX_HWM) /* Most bytes buffered towards the host at once */ \
+  H(RX_ISR_CYCLES, 7) /* RF driver callback duration, in CPU cycles */ \
+  H(RX_LATENCY_US, 6) /* Sync word to link layer delivery, in us */ \
+  C(HOST_LINK_WAKEUPS) /* Host UART opened again after a quiet spell */ \
+  C(COMPRESS_FRAMES)  /* Frames sent compressed */ \
+  C(COMPRESS_SAVED_BYTES) /* Bytes compression took off those frames */ \
+  C(DROP_DECOMPRESS)  /* Compressed frames corrupt or without a buffer */ \
+  C(SLOTS_SYNCS)      /* Slot timing corrections from the time source */ \
+  C(SLOTS_DRIFT_HWM)  /* Largest of those corrections, in us */ \
+  C(CSMA_SAMPLES)     /* Background carrier sense samples */ \
+  C(CSMA_BUSY_SAMPLES) /* Of those, samples of a busy channel */ \
+  G(CSMA_OCCUPANCY_NOW) /* Smoothed busy ratio, in 1/256 */ \
+  G(CSMA_BE_NOW)      /* Backoff exponent of the first retry */ \
+  G(CSMA_BACKOFFS_NOW) /* Retries before a frame is dropped */ \
+  C(STORE_HELD)       /* Routed payloads held without a route */ \
+  C(STORE_SENT)       /* Held payloads sent on once reachable */ \
+  C(STORE_EXPIRED)    /* Held payloads dropped after STORE_TTL */ \
+  C(STORE_EVICTED)    /* Held payloads dropped to make room */ \
+  C(STORE_HWM)        /* Most payloads held at once */ \
+  C(CHAN_SCANS)       /* Candidate channels surveyed */ \
+  C(CHAN_SWITCHES)    /* Migrations of the mesh followed */ \
+  C(CHAN_SEARCHES)    /* Candidates listened to after a silence */ \
+  G(CHAN_OCCUPANCY_NOW) /* Smoothed busy ratio of the channel, in 1/256 */ \
+  C(MONITOR_LATENCY_HWM) /* Latest the event loop ran a process, in us */ \
+  H(MONITOR_LATENCY_US, 11) /* Event loop latency, in us */ \
+  C(MONITOR_VIOLATIONS) /* Latencies past MONITOR_BUDGET */ \
+  C(MONITOR_CAPTURES) /* Stalls captured while the loop was stuck */ \
+  C(SLOTS_REJECTS)    /* Time source beacons off by more than SLOTS_GUARD */ \
+  C(SLOTS_LATE)       /* Cells missed, the frame moved on or dropped */ \
+  C(ROUTE_NO_FRAME)   /* Route requests and replies not sent, pool empty */ \
+  C(TX_DUTY_HOLDS)    /* Frames held back by the duty cycle of the band */
+
+#define STATS_WORD_ENUM(name) STATS_##name,
+#define STATS_HIST_ENUM(name, shift) \
+  STATS_##name, STATS_##name##_LAST = STATS_##name + STATS_HIST_BINS - 1,
+enum {
+  STATS_WORDS(STATS_WORD_ENUM, STATS_WORD_ENUM, STATS_HIST_ENUM)
+  STATS_WORD_COUNT
+};
+#undef STATS_WORD_ENUM
+#undef STATS_HIST_ENUM
+
+#define STATS_HIST_SHIFT_ENUM(name, shift) STATS_SHIFT_##name = shift,
+#define STATS_NO_ENUM(name)
+enum {
+  STATS_WORDS(STATS_NO_ENUM, STATS_NO_ENUM, STATS_HIST_SHIFT_ENUM)
+};
+#undef STATS_HIST_SHIFT_ENUM
+#undef STATS_NO_ENUM
+/*---------------------------------------------------------------------------*/
+/**
+ * The block as sent to the host, little endian like the Cortex-M. Laid
+ * out without padding, which stats.c checks, so the words stay aligned
+ * for the atomic operations.
+ */
+struct stats_block {
+  uint16_t version;
+  /** Number of words, STATS_WORD_COUNT of the image */
+  uint16_t count;
+  /** Seconds since boot, at the time of the snapshot */
+  uint32_t uptime;
+  uint32_t words[STATS_WORD_COUNT];
+};
+
+extern struct stats_block stats_block;
+/*---------------------------------------------------------------------------*/
+#define STATS_INC(name) stats_add(STATS_##name, 1)
+#define STATS_ADD(name, n) stats_add(STATS_##name, n)
+#define STATS_MAX(name, value) stats_max(STATS_##name, value)
+#define STATS_SET(name, value) stats_set(STATS_##name, value)
+#define STATS_HIST(name, value) \
+  stats_hist(STATS_##name, STATS_SHIFT_##name, value)
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Clear the block and register the host link command.
+ *
+ * Must be called first, other modules may count from their own init.
+ */
+void stats_init(void);
+
+/**
+ * \brief Add n to a counter.
+ */
+static inline void
+stats_add(uint16_t word, uint32_t n)
+{
+  __atomic_fetch_add(&stats_block.words[word], n, __ATOMIC_RELAXED);
+}
+
+/**
+ * \brief Set a gauge, which resets of the block leave alone.
+ */
+static inline void
+stats_set(uint16_t word, uint32_t value)
+{
+  __atomic_store_n(&stats_block.words[word], value, __ATOMIC_RELAXED);
+}
+
+/**
+ * \brief Raise a high-water mark to value, if it is above.
+ */
+void stats_max(uint16_t word, uint32_t value);
+
+/**
+ * \brief Count value in its bin of a histogram.
+ */
+void stats_hist(uint16_t first, uint8_t shift, uint32_t value);
+
+/**
+ * \brief Copy the block, one word at a time.
+ * \param reset Clear every counter, high-water mark and histogram as it
+ *              is copied, without losing updates made in between
+ */
+void stats_snapshot(struct stats_block *out, int reset);
+/*---------------------------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STATS_H */
@@ -0,0 +1,406 @@
+/**
+ * \file
+ *         Store-and-forward of routed payloads across broken paths
+ */
+#include "contiki.h"
+#include "store.h"
+#include "arena.h"
+#include "frame-pool.h"
+#include "link.h"
+#include "lib/list.h"
+#include "log-ring.h"
+#include "persist.h"
+#include "stats.h"
+#include "tx-sched.h"
+
+#include <string.h>
+/*---------------------------------------------------------------------------*/
+#define MASK          (STORE_DESTS - 1)
+
+/* Saved per payload: [destination (2)] [length (1)] followed by the
+ * payload, destination by destination in the order they were held */
+#define SAVED_HDR_LEN (LINKADDR_SIZE + 1)
+/*---------------------------------------------------------------------------*/
+struct held {
+  struct held *next;
+  clock_time_t expires;
+  uint8_t len;
+  uint8_t data[LINK_MAX_DATA_LEN];
+};
+
+struct dest {
+  /* Next destination of the same hash bucket */
+  struct dest *next;
+  /* Null while the entry is free */
+  linkaddr_t addr;
+  /* Neighbor a flush sends to, null while there is none */
+  linkaddr_t via;
+  uint8_t count;
+  /* Last time a payload was held for it */
+  clock_time_t used;
+  /* Oldest payload first */
+  LIST_STRUCT(held);
+};
+
+_Static_assert(LINKADDR_SIZE == 2,
+               "store hashing assumes two byte link addresses");
+_Static_assert(LINK_MAX_DATA_LEN <= UINT8_MAX,
+               "held payload lengths are saved in one byte");
+_Static_assert(ARENA_SIZEOF(STORE_SIZE * sizeof(struct held)) +
+               ARENA_SIZEOF(STORE_DESTS * sizeof(struct dest)) +
+               ARENA_SIZEOF(STORE_DESTS * sizeof(struct dest *)) <=
+               ARENA_QUOTA_STORE,
+               "STORE_CONF_SIZE payloads and STORE_CONF_DESTS destinations "
+               "do not fit in ARENA_CONF_QUOTA_STORE");
+/*---------------------------------------------------------------------------*/
+static struct held *slots;
+static struct dest *dests;
+static struct dest **buckets;
+LIST(free_slots);
+static uint8_t held_count;
+
+/* Drops expired payloads, set for the earliest expiry */
+static struct ctimer purge_timer;
+/* Sends the next payload of a flush */
+static struct ctimer flush_timer;
+/* Saves the payloads held since the last save, once STORE_SAVE_GAP is up */
+static struct ctimer save_timer;
+static clock_time_t saved_at;
+
+static void save(void);
+static void restore(uint16_t len);
+
+static struct persist_handler persist_handler = {
+  NULL, PERSIST_STORE, save, restore
+};
+/*---------------------------------------------------------------------------*/
+static unsigned
+bucket(const linkaddr_t *addr)
+{
+  return (addr->u16 ^ (addr->u16 >> 8)) & MASK;
+}
+/*---------------------------------------------------------------------------*/
+static struct dest *
+find_dest(const linkaddr_t *addr)
+{
+  struct dest *d;
+
+  for(d = buckets[bucket(addr)]; d != NULL; d = d->next) {
+    if(linkaddr_cmp(&d->addr, addr)) {
+      return d;
+    }
+  }
+
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static struct dest *
+add_dest(const linkaddr_t *addr)
+{
+  const unsigned b = bucket(addr);
+  unsigned i;
+
+  for(i = 0; i < STORE_DESTS; i++) {
+    if(linkaddr_cmp(&dests[i].addr, &linkaddr_null)) {
+      linkaddr_copy(&dests[i].addr, addr);
+      linkaddr_copy(&dests[i].via, &linkaddr_null);
+      dests[i].count = 0;
+      dests[i].next = buckets[b];
+      buckets[b] = &dests[i];
+      return &dests[i];
+    }
+  }
+
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+remove_dest(struct dest *d)
+{
+  struct dest **p;
+
+  for(p = &buckets[bucket(&d->addr)]; *p != d; p = &(*p)->next);
+  *p = d->next;
+  linkaddr_copy(&d->addr, &linkaddr_null);
+}
+/*---------------------------------------------------------------------------*/
+/* Destination least recently held for, NULL if there is none */
+static struct dest *
+least_recent(void)
+{
+  struct dest *lru = NULL;
+  unsigned i;
+
+  for(i = 0; i < STORE_DESTS; i++) {
+    if(!linkaddr_cmp(&dests[i].addr, &linkaddr_null) &&
+       (lru == NULL || (int32_t)(dests[i].used - lru->used) < 0)) {
+      lru = &dests[i];
+    }
+  }
+
+  return lru;
+}
+/*---------------------------------------------------------------------------*/
+/* Release the oldest payload of a destination, and the destination with
+ * its last one */
+static void
+drop_oldest(struct dest *d)
+{
+  list_add(free_slots, list_pop(d->held));
+  held_count--;
+  if(--d->count == 0) {
+    remove_dest(d);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+purge(void *ptr)
+{
+  const clock_time_t now = clock_time();
+  clock_time_t next = 0;
+  int pending = 0;
+  struct held *h;
+  unsigned i;
+
+  for(i = 0; i < STORE_DESTS; i++) {
+    while(!linkaddr_cmp(&dests[i].addr, &linkaddr_null)) {
+      h = list_head(dests[i].held);
+      if((int32_t)(h->expires - now) > 0) {
+        if(!pending || (int32_t)(h->expires - next) < 0) {
+          next = h->expires;
+          pending = 1;
+        }
+        break;
+      }
+      STATS_INC(STORE_EXPIRED);
+      drop_oldest(&dests[i]);
+      persist_changed();
+    }
+  }
+
+  if(pending) {
+    ctimer_set(&purge_timer, next - now, purge, NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Take a slot for a destination, making room if needed */
+static struct held *
+hold(const linkaddr_t *dst, const uint8_t *data, uint16_t len)
+{
+  struct held *h;
+  struct dest *d;
+
+  if(list_head(free_slots) == NULL) {
+    STATS_INC(STORE_EVICTED);
+    drop_oldest(least_recent());
+  }
+
+  d = find_dest(dst);
+  if(d == NULL) {
+    d = add_dest(dst);
+    if(d == NULL) {
+      d = least_recent();
+      STATS_ADD(STORE_EVICTED, d->count);
+      while(d->count > 1) {
+        drop_oldest(d);
+      }
+      /* Gone with the last one */
+      drop_oldest(d);
+      d = add_dest(dst);
+    }
+  }
+
+  h = list_pop(free_slots);
+  memcpy(h->data, data, len);
+  h->len = len;
+  /* Every payload lives STORE_TTL, so the one just held is never the next
+   * to expire */
+  h->expires = clock_time() + STORE_TTL;
+  if(ctimer_expired(&purge_timer)) {
+    ctimer_set(&purge_timer, STORE_TTL, purge, NULL);
+  }
+  list_add(d->held, h);
+  d->count++;
+  d->used = clock_time();
+  held_count++;
+
+  return h;
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_next(void *ptr)
+{
+  struct frame *frame;
+  struct dest *d = NULL;
+  struct held *h;
+  unsigned i;
+
+  for(i = 0; i < STORE_DESTS; i++) {
+    if(!linkaddr_cmp(&dests[i].addr, &linkaddr_null) &&
+       !linkaddr_cmp(&dests[i].via, &linkaddr_null)) {
+      d = &dests[i];
+      break;
+    }
+  }
+  if(d == NULL) {
+    return;
+  }
+
+  /* Only as fast as the bulk class drains, live traffic goes first */
+  frame = tx_sched_queued(TX_CLASS_BULK) < TX_SCHED_BULK_LEN ?
+    frame_pool_alloc() : NULL;
+  if(frame != NULL) {
+    h = list_head(d->held);
+    memcpy(link_data(frame), h->data, h->len);
+    if(link_send(frame, LINK_TYPE_ROUTED, &d->via, h->len,
+                 TX_CLASS_BULK) == 0) {
+      STATS_INC(STORE_SENT);
+    }
+    drop_oldest(d);
+    persist_changed();
+  }
+
+  ctimer_set(&flush_timer, STORE_FLUSH_GAP, send_next, NULL);
+}
+/*---------------------------------------------------------------------------*/
+static void
+save_now(void *ptr)
+{
+  saved_at = clock_time();
+  persist_save(&persist_handler);
+}
+/*---------------------------------------------------------------------------*/
+/* Held payloads are what a reset loses, the periodic save is too late */
+static void
+save_soon(void)
+{
+  const clock_time_t since = clock_time() - saved_at;
+
+  if(!ctimer_expired(&save_timer)) {
+    return;
+  }
+
+  if(since >= STORE_SAVE_GAP) {
+    save_now(NULL);
+  } else {
+    ctimer_set(&save_timer, STORE_SAVE_GAP - since, save_now, NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+save(void)
+{
+  uint8_t buf[SAVED_HDR_LEN];
+  struct held *h;
+  unsigned i;
+
+  for(i = 0; i < STORE_DESTS; i++) {
+    if(linkaddr_cmp(&dests[i].addr, &linkaddr_null)) {
+      continue;
+    }
+    for(h = list_head(dests[i].held); h != NULL; h = list_item_next(h)) {
+      memcpy(&buf[0], &dests[i].addr, LINKADDR_SIZE);
+      buf[LINKADDR_SIZE] = h->len;
+      persist_put(buf, sizeof(buf));
+      persist_put(h->data, h->len);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+restore(uint16_t len)
+{
+  uint8_t buf[SAVED_HDR_LEN];
+  uint8_t data[LINK_MAX_DATA_LEN];
+  linkaddr_t dst;
+
+  while(held_count < STORE_SIZE && persist_get(buf, sizeof(buf)) == 0) {
+    memcpy(&dst, &buf[0], LINKADDR_SIZE);
+    if(buf[LINKADDR_SIZE] == 0 || buf[LINKADDR_SIZE] > LINK_MAX_DATA_LEN ||
+       persist_get(data, buf[LINKADDR_SIZE]) != 0) {
+      return;
+    }
+    /* Saved under another node address */
+    if(linkaddr_cmp(&dst, &linkaddr_null) ||
+       linkaddr_cmp(&dst, &linkaddr_node_addr)) {
+      continue;
+    }
+    hold(&dst, data, buf[LINKADDR_SIZE]);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+store_init(void)
+{
+  unsigned i;
+
+  if(!STORE_ENABLED) {
+    return;
+  }
+
+  slots = arena_alloc(ARENA_STORE, STORE_SIZE * sizeof(struct held));
+  dests = arena_alloc(ARENA_STORE, STORE_DESTS * sizeof(struct dest));
+  buckets = arena_alloc(ARENA_STORE, STORE_DESTS * sizeof(struct dest *));
+
+  list_init(free_slots);
+  for(i = 0; i < STORE_SIZE; i++) {
+    list_add(free_slots, &slots[i]);
+  }
+  for(i = 0; i < STORE_DESTS; i++) {
+    LIST_STRUCT_INIT(&dests[i], held);
+  }
+  held_count = 0;
+  /* The first payload held is saved right away */
+  saved_at = clock_time() - STORE_SAVE_GAP;
+
+  persist_register(&persist_handler);
+}
+/*---------------------------------------------------------------------------*/
+int
+store_put(const linkaddr_t *dst, const uint8_t *data, uint16_t len)
+{
+  /* Images never calling store_init() route all the same */
+  if(!STORE_ENABLED || slots == NULL || len == 0 ||
+     len > LINK_MAX_DATA_LEN) {
+    return -1;
+  }
+
+  hold(dst, data, len);
+  save_soon();
+
+  LOG_RECORD(STORE_HELD, dst->u16, len, held_count);
+  STATS_INC(STORE_HELD);
+  STATS_MAX(STORE_HWM, held_count);
+
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+store_flush(const linkaddr_t *dst, const linkaddr_t *next_hop)
+{
+  struct dest *d;
+
+  if(held_count == 0 || (d = find_dest(dst)) == NULL) {
+    return;
+  }
+
+  LOG_RECORD(STORE_FLUSH, dst->u16, next_hop->u16, d->count);
+  linkaddr_copy(&d->via, next_hop);
+  if(ctimer_expired(&flush_timer)) {
+    ctimer_set(&flush_timer, STORE_FLUSH_GAP, send_next, NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+store_neighbor_input(const linkaddr_t *addr)
+{
+  struct dest *d;
+
+  if(held_count == 0 || (d = find_dest(addr)) == NULL ||
+     !linkaddr_cmp(&d->via, &linkaddr_null)) {
+    return;
+  }
+
+  store_flush(addr, addr);
+}
+/*---------------------------------------------------------------------------*/
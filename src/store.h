@@ -0,0 +1,113 @@
+/**
+ * \file
+ *         Store-and-forward of routed payloads across broken paths
+ *
+ *         A routed payload with no route ahead, on a relay or after the
+ *         route discovery of its origin failed, is held here instead of
+ *         being dropped. Links come and go in the field, and keeping the
+ *         payload where it got stuck costs far less airtime than the host
+ *         sending it again end to end.
+ *
+ *         Payloads are kept in STORE_SIZE slots out of the arena and
+ *         indexed by destination, at most STORE_DESTS of them, in a small
+ *         hash table. A destination is flushed when a route to it is
+ *         installed, or when it is heard as a neighbor, its payloads then
+ *         leaving in the bulk class one every STORE_FLUSH_GAP, in the order
+ *         they arrived. A payload is dropped STORE_TTL after it was held,
+ *         and a full store makes room with the oldest payload of the
+ *         destination that was the least recently stored for.
+ *
+ *         Held payloads are saved to flash, see persist.h, as they are
+ *         held but at most once every STORE_SAVE_GAP, and come back at boot
+ *         with STORE_TTL left.
+ */
+#ifndef STORE_H
+#define STORE_H
+
+#include "contiki.h"
+#include "net/linkaddr.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------*/
+#ifdef STORE_CONF_ENABLED
+#define STORE_ENABLED STORE_CONF_ENABLED
+#else
+#define STORE_ENABLED 1
+#endif
+
+/** Payloads held at most */
+#ifdef STORE_CONF_SIZE
+#define STORE_SIZE STORE_CONF_SIZE
+#else
+#define STORE_SIZE 8
+#endif
+
+/** Destinations payloads are held for at most, a power of two */
+#ifdef STORE_CONF_DESTS
+#define STORE_DESTS STORE_CONF_DESTS
+#else
+#define STORE_DESTS 4
+#endif
+
+#if (STORE_DESTS & (STORE_DESTS - 1)) != 0
+#error "STORE_DESTS must be a power of two"
+#endif
+
+/** Time a payload is held, in clock ticks */
+#ifdef STORE_CONF_TTL
+#define STORE_TTL STORE_CONF_TTL
+#else
+#define STORE_TTL (1800UL * CLOCK_SECOND)
+#endif
+
+/** Time between two payloads of a flush, in clock ticks */
+#ifdef STORE_CONF_FLUSH_GAP
+#define STORE_FLUSH_GAP STORE_CONF_FLUSH_GAP
+#else
+#define STORE_FLUSH_GAP (CLOCK_SECOND / 4)
+#endif
+
+/** Shortest time between two saves of the held payloads, in clock ticks.
+ * A payload held is saved at most this long after, which is what a reset
+ * loses, instead of PERSIST_INTERVAL */
+#ifdef STORE_CONF_SAVE_GAP
+#define STORE_SAVE_GAP STORE_CONF_SAVE_GAP
+#else
+#define STORE_SAVE_GAP (10 * CLOCK_SECOND)
+#endif
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Allocate the slots and the index, and restore the last save.
+ */
+void store_init(void);
+
+/**
+ * \brief Hold a routed payload.
+ * \param data Payload with its routed header, see route.h
+ * \return 0 if held, -1 if it cannot be, e.g. with STORE_ENABLED off or
+ *         in an image that never called store_init(), as the benchmark.
+ */
+int store_put(const linkaddr_t *dst, const uint8_t *data, uint16_t len);
+
+/**
+ * \brief Send what is held for a destination through a neighbor.
+ */
+void store_flush(const linkaddr_t *dst, const linkaddr_t *next_hop);
+
+/**
+ * \brief Flush what is held for a neighbor just heard, cheap enough for
+ *        every frame.
+ */
+void store_neighbor_input(const linkaddr_t *addr);
+/*---------------------------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STORE_H */
@@ -0,0 +1,263 @@
+/**
+ * \file
+ *         Aggregating transmit queue
+ */
+#include "contiki.h"
+#include "tx-queue.h"
+#include "arena.h"
+#include "compress.h"
+#include "frame-pool.h"
+#include "link.h"
+#include "log-ring.h"
+#include "prof.h"
+#include "stats.h"
+
+#include <string.h>
+/*---------------------------------------------------------------------------*/
+/* Each aggregated payload is prefixed with a one byte length */
+#define SUBHDR_LEN 1
+/* Largest payload that can go into an aggregate */
+#define MAX_SUBLEN MIN(LINK_MAX_DATA_LEN - SUBHDR_LEN, 255)
+/*---------------------------------------------------------------------------*/
+struct slot {
+  /* Frame being filled, NULL if the slot is free */
+  struct frame *frame;
+  /* Time the frame goes out at the latest */
+  clock_time_t deadline;
+  linkaddr_t next_hop;
+  /* Bytes of aggregate data written so far */
+  uint16_t used;
+  uint8_t count;
+};
+
+_Static_assert(ARENA_SIZEOF(TX_QUEUE_SLOTS * sizeof(struct slot)) <=
+               ARENA_QUOTA_TX_QUEUE,
+               "TX_QUEUE_CONF_SLOTS slots do not fit in ARENA_CONF_QUOTA_TX_QUEUE");
+
+static struct slot *slots;
+/* One timer for every slot, set for the earliest deadline */
+static struct ctimer flush_timer;
+/*---------------------------------------------------------------------------*/
+static void flush_timeout(void *ptr);
+
+static void
+arm_flush_timer(void)
+{
+  const struct slot *earliest = NULL;
+  clock_time_t now;
+  unsigned i;
+
+  for(i = 0; i < TX_QUEUE_SLOTS; i++) {
+    if(slots[i].frame != NULL &&
+       (earliest == NULL ||
+        (int32_t)(slots[i].deadline - earliest->deadline) < 0)) {
+      earliest = &slots[i];
+    }
+  }
+
+  if(earliest == NULL) {
+    ctimer_stop(&flush_timer);
+    return;
+  }
+
+  now = clock_time();
+  ctimer_set(&flush_timer, (int32_t)(earliest->deadline - now) > 0 ?
+             earliest->deadline - now : 0, flush_timeout, NULL);
+}
+/*---------------------------------------------------------------------------*/
+static int
+send(struct frame *frame, uint8_t type, const linkaddr_t *next_hop,
+     uint16_t len)
+{
+#if COMPRESS_ENABLED
+  struct frame *packed = frame_pool_alloc();
+  int packed_len;
+
+  /* Without a spare frame the data simply goes out as it is */
+  if(packed != NULL) {
+    packed_len = compress(link_data(frame), len, link_data(packed), len - 1);
+    if(packed_len > 0) {
+      STATS_INC(COMPRESS_FRAMES);
+      STATS_ADD(COMPRESS_SAVED_BYTES, len - packed_len);
+      frame_pool_free(frame);
+      frame = packed;
+      type |= LINK_FLAG_COMPRESSED;
+      len = packed_len;
+    } else {
+      frame_pool_free(packed);
+    }
+  }
+#endif
+
+  return link_send(frame, type, next_hop, len, TX_CLASS_INTERACTIVE);
+}
+/*---------------------------------------------------------------------------*/
+static void
+flush(struct slot *slot)
+{
+  struct frame *frame = slot->frame;
+  uint8_t *data = link_data(frame);
+  int ret;
+
+  if(slot->count == 1) {
+    /* Nothing joined, drop the length prefix and send plain data */
+    memmove(data, data + SUBHDR_LEN, slot->used - SUBHDR_LEN);
+    ret = send(frame, LINK_TYPE_DATA, &slot->next_hop,
+               slot->used - SUBHDR_LEN);
+  } else {
+    ret = send(frame, LINK_TYPE_AGGREGATE, &slot->next_hop, slot->used);
+  }
+
+  LOG_RECORD(TX_QUEUE_FLUSH, slot->count, slot->used, ret);
+
+  slot->frame = NULL;
+  /* Never wake up for a frame already gone */
+  arm_flush_timer();
+}
+/*---------------------------------------------------------------------------*/
+static void
+flush_timeout(void *ptr)
+{
+  const clock_time_t now = clock_time();
+  unsigned i;
+
+  for(i = 0; i < TX_QUEUE_SLOTS; i++) {
+    if(slots[i].frame != NULL && (int32_t)(slots[i].deadline - now) <= 0) {
+      flush(&slots[i]);
+    }
+  }
+
+  arm_flush_timer();
+}
+/*---------------------------------------------------------------------------*/
+static struct slot *
+find_slot(const linkaddr_t *next_hop)
+{
+  unsigned i;
+
+  for(i = 0; i < TX_QUEUE_SLOTS; i++) {
+    if(slots[i].frame != NULL && linkaddr_cmp(&slots[i].next_hop, next_hop)) {
+      return &slots[i];
+    }
+  }
+
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static struct slot *
+open_slot(const linkaddr_t *next_hop)
+{
+  struct slot *slot = NULL;
+  struct slot *oldest = NULL;
+  unsigned i;
+
+  for(i = 0; i < TX_QUEUE_SLOTS; i++) {
+    if(slots[i].frame == NULL) {
+      slot = &slots[i];
+      break;
+    }
+    if(oldest == NULL ||
+       (int32_t)(slots[i].deadline - oldest->deadline) < 0) {
+      oldest = &slots[i];
+    }
+  }
+
+  if(slot == NULL) {
+    /* Every slot is busy, the one closest to its deadline goes now */
+    flush(oldest);
+    slot = oldest;
+  }
+
+  slot->frame = frame_pool_alloc();
+  if(slot->frame == NULL) {
+    return NULL;
+  }
+
+  linkaddr_copy(&slot->next_hop, next_hop);
+  slot->used = 0;
+  slot->count = 0;
+  slot->deadline = clock_time() + TX_QUEUE_FLUSH_DELAY;
+  arm_flush_timer();
+
+  return slot;
+}
+/*---------------------------------------------------------------------------*/
+void
+tx_queue_init(void)
+{
+  slots = arena_alloc(ARENA_TX_QUEUE, TX_QUEUE_SLOTS * sizeof(struct slot));
+}
+/*---------------------------------------------------------------------------*/
+static int
+enqueue(const linkaddr_t *next_hop, const uint8_t *data, uint16_t len)
+{
+  struct frame *frame;
+  struct slot *slot;
+
+  if(len == 0 || len > LINK_MAX_DATA_LEN) {
+    return -1;
+  }
+
+  if(len > MAX_SUBLEN) {
+    /* Too large to share a frame, send on its own */
+    frame = frame_pool_alloc();
+    if(frame == NULL) {
+      LOG_RECORD(TX_QUEUE_DROP, len);
+      STATS_INC(DROP_TX_QUEUE);
+      return -1;
+    }
+    memcpy(link_data(frame), data, len);
+    return send(frame, LINK_TYPE_DATA, next_hop, len);
+  }
+
+  slot = find_slot(next_hop);
+  if(slot != NULL && slot->used + SUBHDR_LEN + len > LINK_MAX_DATA_LEN) {
+    flush(slot);
+    slot = NULL;
+  }
+
+  if(slot == NULL) {
+    slot = open_slot(next_hop);
+    if(slot == NULL) {
+      LOG_RECORD(TX_QUEUE_DROP, len);
+      STATS_INC(DROP_TX_QUEUE);
+      return -1;
+    }
+  }
+
+  frame = slot->frame;
+  link_data(frame)[slot->used] = len;
+  memcpy(link_data(frame) + slot->used + SUBHDR_LEN, data, len);
+  slot->used += SUBHDR_LEN + len;
+  slot->count++;
+
+  if(slot->used + SUBHDR_LEN + 1 > LINK_MAX_DATA_LEN) {
+    /* Not even a one byte payload would fit any more */
+    flush(slot);
+  }
+
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+tx_queue_send(const linkaddr_t *next_hop, const uint8_t *data, uint16_t len)
+{
+  PROF_BEGIN(TX_QUEUE);
+  int ret = enqueue(next_hop, data, len);
+  PROF_END(TX_QUEUE);
+
+  return ret;
+}
+/*---------------------------------------------------------------------------*/
+void
+tx_queue_flush_all(void)
+{
+  unsigned i;
+
+  for(i = 0; i < TX_QUEUE_SLOTS; i++) {
+    if(slots[i].frame != NULL) {
+      flush(&slots[i]);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,62 @@
+/**
+ * \file
+ *         Aggregating transmit queue
+ *
+ *         Small payloads for the same next hop are coalesced into a single
+ *         LINK_TYPE_AGGREGATE frame, paying for preamble, sync word and
+ *         headers once. A pending frame is sent as soon as the next payload
+ *         would not fit, or TX_QUEUE_FLUSH_DELAY after its first payload was
+ *         queued, whichever comes first. A frame carrying a single payload
+ *         goes out as plain LINK_TYPE_DATA.
+ */
+#ifndef TX_QUEUE_H
+#define TX_QUEUE_H
+
+#include "contiki.h"
+#include "net/linkaddr.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------*/
+/** Number of next hops that can have a frame pending at the same time */
+#ifdef TX_QUEUE_CONF_SLOTS
+#define TX_QUEUE_SLOTS TX_QUEUE_CONF_SLOTS
+#else
+#define TX_QUEUE_SLOTS 4
+#endif
+
+/** Longest time a payload waits for company, in clock ticks */
+#ifdef TX_QUEUE_CONF_FLUSH_DELAY
+#define TX_QUEUE_FLUSH_DELAY TX_QUEUE_CONF_FLUSH_DELAY
+#else
+#define TX_QUEUE_FLUSH_DELAY (CLOCK_SECOND / 32)
+#endif
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Reset the queue.
+ */
+void tx_queue_init(void);
+
+/**
+ * \brief Queue a payload for a next hop.
+ * \param next_hop Link address of the next hop, &linkaddr_null to broadcast
+ * \return 0 if the payload was queued or sent, -1 if it was dropped
+ */
+int tx_queue_send(const linkaddr_t *next_hop, const uint8_t *data,
+                  uint16_t len);
+
+/**
+ * \brief Send every pending frame right away.
+ */
+void tx_queue_flush_all(void);
+/*---------------------------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TX_QUEUE_H */
@@ -0,0 +1,422 @@
+/**
+ * \file
+ *         Transmit scheduler with traffic classes
+ */
+#include "contiki.h"
+#include "tx-sched.h"
+#include "frame-pool.h"
+#include "link.h"
+#include "link-sec.h"
+#include "log-ring.h"
+#include "stats.h"
+#include "rf-core.h"
+#include "slots.h"
+#include "lib/list.h"
+#include "lib/random.h"
+/*---------------------------------------------------------------------------*/
+/* The interactive and bulk classes take turns, control is not part of the
+ * round-robin */
+#define DRR_FIRST TX_CLASS_INTERACTIVE
+
+/* Slots do not back off at random, there is nothing to adapt */
+#define ADAPTIVE (TX_SCHED_ADAPTIVE && TX_SCHED_MODE == TX_SCHED_MODE_CSMA)
+
+/* tx_result while the frame is on air */
+#define TX_PENDING 1
+
+_Static_assert(TX_SCHED_INTERACTIVE_QUANTUM > 0 && TX_SCHED_BULK_QUANTUM > 0,
+               "TX_SCHED_CONF_*_QUANTUM must not be zero");
+_Static_assert(STATS_SCHED_BULK_HWM - STATS_SCHED_CONTROL_HWM ==
+               TX_CLASS_BULK - TX_CLASS_CONTROL,
+               "the per class high-water marks must follow the class order");
+_Static_assert(TX_SCHED_MIN_BE <= TX_SCHED_MAX_BE && TX_SCHED_MAX_BE < 16,
+               "TX_SCHED_CONF_MIN_BE and TX_SCHED_CONF_MAX_BE out of range");
+#if ADAPTIVE
+_Static_assert(TX_SCHED_MIN_BACKOFFS <= TX_SCHED_MAX_BACKOFFS,
+               "TX_SCHED_CONF_MIN_BACKOFFS above TX_SCHED_CONF_MAX_BACKOFFS");
+_Static_assert(TX_SCHED_CCA_WINDOW <= 256 &&
+               (TX_SCHED_CCA_WINDOW & (TX_SCHED_CCA_WINDOW - 1)) == 0,
+               "TX_SCHED_CONF_CCA_WINDOW must be a power of two up to 256");
+#endif
+/*---------------------------------------------------------------------------*/
+/* List heads of the class queues, oldest frame first */
+static void *queues[TX_CLASS_COUNT];
+#define queue(c) ((list_t)&queues[c])
+
+static const uint8_t queue_len[TX_CLASS_COUNT] = {
+  TX_SCHED_CONTROL_LEN, TX_SCHED_INTERACTIVE_LEN, TX_SCHED_BULK_LEN,
+};
+static const uint16_t quantum[TX_CLASS_COUNT] = {
+  0, TX_SCHED_INTERACTIVE_QUANTUM, TX_SCHED_BULK_QUANTUM,
+};
+
+static uint8_t queued[TX_CLASS_COUNT];
+
+/* Class whose round-robin turn it is, and the bytes it has left */
+static uint8_t drr_class;
+static uint16_t deficit[TX_CLASS_COUNT];
+
+static struct etimer backoff_timer;
+
+/* Outcome of the transmission started last, see rf_core_transmit() */
+static int tx_result;
+
+/* Airtime the duty cycle still allows, in us, as of duty_updated */
+static uint32_t duty_credit;
+static clock_time_t duty_updated;
+
+#if TX_SCHED_MODE == TX_SCHED_MODE_CSMA
+/* Exponent of the first backoff, and retries before a frame is dropped */
+static uint8_t min_be = TX_SCHED_MIN_BE;
+static uint8_t max_backoffs = TX_SCHED_MAX_BACKOFFS;
+#endif
+
+#if ADAPTIVE
+static struct ctimer cca_timer;
+static uint16_t samples;
+static uint16_t busy_samples;
+/* Smoothed share of busy samples, in 1/256 */
+static uint8_t occupancy;
+#endif
+/*---------------------------------------------------------------------------*/
+PROCESS(tx_sched_process, "TX scheduler");
+/*---------------------------------------------------------------------------*/
+static void
+next_turn(void)
+{
+  drr_class = drr_class + 1 == TX_CLASS_COUNT ? DRR_FIRST : drr_class + 1;
+  deficit[drr_class] += quantum[drr_class];
+}
+/*---------------------------------------------------------------------------*/
+/* Class of the frame to send next, TX_CLASS_COUNT if nothing is waiting */
+static uint8_t
+select_class(void)
+{
+  struct frame *frame;
+
+  if(queued[TX_CLASS_CONTROL] > 0) {
+    return TX_CLASS_CONTROL;
+  }
+
+  if(queued[TX_CLASS_INTERACTIVE] == 0 && queued[TX_CLASS_BULK] == 0) {
+    return TX_CLASS_COUNT;
+  }
+
+  /* Ends as every turn adds a quantum to a class that has frames */
+  while(1) {
+    frame = list_head(queue(drr_class));
+    if(frame == NULL) {
+      /* An idle class does not save up for later */
+      deficit[drr_class] = 0;
+    } else if(frame->len <= deficit[drr_class]) {
+      deficit[drr_class] -= frame->len;
+      return drr_class;
+    }
+    next_turn();
+  }
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t
+duty_budget(void)
+{
+  return (uint32_t)rf_core_get_duty_cycle() * TX_SCHED_DUTY_WINDOW * 1000;
+}
+/*---------------------------------------------------------------------------*/
+/* Top the credit up for the time gone by, at the duty cycle */
+static void
+duty_refill(void)
+{
+  const clock_time_t now = clock_time();
+  const uint64_t credit = duty_credit +
+    (uint64_t)(now - duty_updated) * rf_core_get_duty_cycle() * 1000 /
+    CLOCK_SECOND;
+
+  duty_credit = (uint32_t)MIN(credit, duty_budget());
+  duty_updated = now;
+}
+/*---------------------------------------------------------------------------*/
+/* Clock ticks until a frame not sealed yet fits in the duty cycle */
+static clock_time_t
+duty_wait(const struct frame *frame)
+{
+  const uint16_t permille = rf_core_get_duty_cycle();
+  uint32_t airtime;
+
+  if(permille >= 1000) {
+    return 0;
+  }
+
+  duty_refill();
+  airtime = rf_core_airtime_us(frame->len + LINK_SEC_OVERHEAD);
+  if(airtime <= duty_credit) {
+    return 0;
+  }
+
+  /* Rounded up, the credit grows by permille us every ms */
+  return ((uint64_t)(airtime - duty_credit) * CLOCK_SECOND + permille * 1000 -
+          1) / (permille * 1000);
+}
+/*---------------------------------------------------------------------------*/
+/* Take the airtime of a frame sent, or that may have been, out of the
+ * credit */
+static void
+duty_charge(const struct frame *frame)
+{
+  uint32_t airtime;
+
+  if(rf_core_get_duty_cycle() >= 1000) {
+    return;
+  }
+
+  duty_refill();
+  airtime = rf_core_airtime_us(frame->len);
+  duty_credit -= MIN(airtime, duty_credit);
+}
+/*---------------------------------------------------------------------------*/
+#if TX_SCHED_MODE == TX_SCHED_MODE_CSMA
+static uint16_t
+backoff_delay(uint8_t backoffs)
+{
+  const uint8_t be = MIN(min_be + backoffs, TX_SCHED_MAX_BE);
+
+  return (1 + random_rand() % (1U << be)) * TX_SCHED_BACKOFF_PERIOD;
+}
+#endif
+/*---------------------------------------------------------------------------*/
+#if ADAPTIVE
+static void
+adapt(void)
+{
+  /* The latest window weighs a quarter, a lone burst moves little */
+  occupancy = (3 * occupancy + busy_samples * 256 / TX_SCHED_CCA_WINDOW) / 4;
+
+  min_be = TX_SCHED_MIN_BE +
+    ((occupancy * (TX_SCHED_MAX_BE - TX_SCHED_MIN_BE + 1)) >> 8);
+  max_backoffs = TX_SCHED_MIN_BACKOFFS +
+    ((occupancy * (TX_SCHED_MAX_BACKOFFS - TX_SCHED_MIN_BACKOFFS + 1)) >> 8);
+
+  STATS_SET(CSMA_OCCUPANCY_NOW, occupancy);
+  STATS_SET(CSMA_BE_NOW, min_be);
+  STATS_SET(CSMA_BACKOFFS_NOW, max_backoffs);
+}
+/*---------------------------------------------------------------------------*/
+static void
+cca_sample(void *ptr)
+{
+  int busy;
+
+  /* RX is off most of the time with low-power listening, and waking up
+   * for samples would cost more than the sniff windows save */
+  if(rf_core_get_sniff_interval() != 0) {
+    return;
+  }
+
+  ctimer_reset(&cca_timer);
+
+  busy = rf_core_cca();
+  /* Nothing to measure with RX off, e.g. while it restarts */
+  if(busy < 0) {
+    return;
+  }
+
+  STATS_INC(CSMA_SAMPLES);
+  if(busy) {
+    STATS_INC(CSMA_BUSY_SAMPLES);
+    busy_samples++;
+  }
+
+  if(++samples == TX_SCHED_CCA_WINDOW) {
+    adapt();
+    samples = 0;
+    busy_samples = 0;
+  }
+}
+#endif
+/*---------------------------------------------------------------------------*/
+static void
+tx_done(struct frame *frame, int result)
+{
+  tx_result = result;
+  process_poll(&tx_sched_process);
+}
+/*---------------------------------------------------------------------------*/
+void
+tx_sched_init(void)
+{
+  unsigned i;
+
+  for(i = 0; i < TX_CLASS_COUNT; i++) {
+    list_init(queue(i));
+    queued[i] = 0;
+    deficit[i] = 0;
+  }
+  drr_class = DRR_FIRST;
+
+  /* A node starts with the airtime of a whole window */
+  duty_credit = duty_budget();
+  duty_updated = clock_time();
+
+#if ADAPTIVE
+  /* Starts out assuming an idle channel */
+  samples = 0;
+  busy_samples = 0;
+  occupancy = 0;
+  adapt();
+  ctimer_set(&cca_timer, TX_SCHED_CCA_PERIOD, cca_sample, NULL);
+#endif
+
+  rf_core_set_tx_callback(tx_done);
+  process_start(&tx_sched_process, NULL);
+}
+/*---------------------------------------------------------------------------*/
+void
+tx_sched_sniff_changed(void)
+{
+#if ADAPTIVE
+  if(rf_core_get_sniff_interval() == 0 && ctimer_expired(&cca_timer)) {
+    ctimer_set(&cca_timer, TX_SCHED_CCA_PERIOD, cca_sample, NULL);
+  }
+#endif
+}
+/*---------------------------------------------------------------------------*/
+int
+tx_sched_send(struct frame *frame, uint8_t tx_class)
+{
+  if(tx_class >= TX_CLASS_COUNT || queued[tx_class] == queue_len[tx_class]) {
+    LOG_RECORD(TX_SCHED_DROP, tx_class, frame->len);
+    STATS_INC(DROP_SCHED_FULL);
+    frame_pool_free(frame);
+    return -1;
+  }
+
+  list_add(queue(tx_class), frame);
+  queued[tx_class]++;
+  stats_max(STATS_SCHED_CONTROL_HWM + tx_class, queued[tx_class]);
+  process_poll(&tx_sched_process);
+
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+tx_sched_queued(uint8_t tx_class)
+{
+  return tx_class < TX_CLASS_COUNT ? queued[tx_class] : 0;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(tx_sched_process, ev, data)
+{
+  static struct frame *frame;
+  static uint8_t tx_class;
+  static uint8_t backoffs;
+  static clock_time_t hold;
+#if TX_SCHED_MODE == TX_SCHED_MODE_SLOTTED
+  static uint32_t start;
+  static clock_time_t wait;
+#endif
+  int ret;
+
+  PROCESS_BEGIN();
+
+  while(1) {
+    PROCESS_YIELD_UNTIL(ev == PROCESS_EVENT_POLL);
+
+    while((tx_class = select_class()) != TX_CLASS_COUNT) {
+      frame = list_pop(queue(tx_class));
+      queued[tx_class]--;
+
+      /* Over the duty cycle everything waits, ahead of picking a cell */
+      if((hold = duty_wait(frame)) > 0) {
+        LOG_RECORD(TX_SCHED_DUTY, tx_class, frame->len, hold);
+        STATS_INC(TX_DUTY_HOLDS);
+        do {
+          etimer_set(&backoff_timer, hold);
+          PROCESS_YIELD_UNTIL(etimer_expired(&backoff_timer));
+        } while((hold = duty_wait(frame)) > 0);
+      }
+
+#if TX_SCHED_MODE == TX_SCHED_MODE_SLOTTED
+      /* Ahead of sealing, a beacon is stamped with its cell */
+      wait = slots_next_cell(frame, &start);
+#endif
+
+      if(link_seal(frame) != 0) {
+        frame_pool_free(frame);
+        continue;
+      }
+
+#if TX_SCHED_MODE == TX_SCHED_MODE_SLOTTED
+      for(backoffs = 0; ; ) {
+        if(wait > 0) {
+          etimer_set(&backoff_timer, wait);
+          PROCESS_YIELD_UNTIL(etimer_expired(&backoff_timer));
+        }
+        /* Sent past the start of its cell, after a stall, the frame would
+         * land in another slot than receivers time it against. A beacon
+         * names its cell, the next one is due soon enough. */
+        if(!slots_on_time(start)) {
+          STATS_INC(SLOTS_LATE);
+          if((frame_payload(frame)[0] & LINK_TYPE_MASK) == LINK_TYPE_BEACON) {
+            break;
+          }
+          wait = slots_next_cell(frame, &start);
+          continue;
+        }
+        tx_result = TX_PENDING;
+        ret = link_transmit_scheduled(frame, start);
+        if(ret == 0) {
+          PROCESS_YIELD_UNTIL(tx_result != TX_PENDING);
+          ret = tx_result;
+          if(ret != RF_CORE_TX_BUSY) {
+            duty_charge(frame);
+          }
+        }
+        if(ret != RF_CORE_TX_BUSY) {
+          break;
+        }
+        /* A beacon names the slot it was meant for, the next one is due
+         * soon enough */
+        if(backoffs++ == TX_SCHED_MAX_BACKOFFS ||
+           (frame_payload(frame)[0] & LINK_TYPE_MASK) == LINK_TYPE_BEACON) {
+          LOG_RECORD(TX_SCHED_BUSY, tx_class, frame->len);
+          STATS_INC(DROP_CCA);
+          break;
+        }
+        wait = slots_next_cell(frame, &start);
+      }
+#else
+      for(backoffs = 0; ; backoffs++) {
+        tx_result = TX_PENDING;
+        ret = link_transmit(frame);
+        if(ret == 0) {
+          /* Received frames are drained while it is on air */
+          PROCESS_YIELD_UNTIL(tx_result != TX_PENDING);
+          ret = tx_result;
+          /* Also after an error, the frame may have gone out */
+          if(ret != RF_CORE_TX_BUSY) {
+            duty_charge(frame);
+          }
+        }
+        if(ret != RF_CORE_TX_BUSY) {
+          break;
+        }
+        if(backoffs >= max_backoffs) {
+          LOG_RECORD(TX_SCHED_BUSY, tx_class, frame->len);
+          STATS_INC(DROP_CCA);
+          break;
+        }
+        etimer_set(&backoff_timer, backoff_delay(backoffs));
+        PROCESS_YIELD_UNTIL(etimer_expired(&backoff_timer));
+      }
+#endif
+
+      frame_pool_free(frame);
+
+      /* One frame per pass, received frames are drained in between */
+      process_poll(&tx_sched_process);
+      PROCESS_YIELD_UNTIL(ev == PROCESS_EVENT_POLL);
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,210 @@
+/**
+ * \file
+ *         Transmit scheduler with traffic classes
+ *
+ *         Every frame handed to link_send() waits in the queue of its
+ *         traffic class until the RF core is free. Control traffic, route
+ *         discovery and fragment acknowledgements, always goes first. The
+ *         interactive and bulk classes then share the channel by deficit
+ *         round-robin, each getting its quantum of bytes per round, so a
+ *         long fragmented transfer neither starves route maintenance nor
+ *         locks out application payloads.
+ *
+ *         Frames go out one at a time from tx_sched_process with CSMA: a
+ *         transmission the RF core calls off on a busy channel is retried
+ *         after a random backoff of up to 2^BE periods, BE growing from
+ *         TX_SCHED_MIN_BE to TX_SCHED_MAX_BE, and the frame is dropped after
+ *         TX_SCHED_MAX_BACKOFFS retries. The frame in contention stays
+ *         committed until then, as it already holds its link sequence number
+ *         and security counter.
+ *
+ *         With TX_SCHED_ADAPTIVE the backoff follows how crowded the
+ *         channel is. A background carrier sense every TX_SCHED_CCA_PERIOD
+ *         measures the share of time the channel is busy, smoothed over
+ *         windows of TX_SCHED_CCA_WINDOW samples. The first backoff grows
+ *         from 2^TX_SCHED_MIN_BE on an idle channel to 2^TX_SCHED_MAX_BE on
+ *         a saturated one, and the retries from TX_SCHED_MIN_BACKOFFS to
+ *         TX_SCHED_MAX_BACKOFFS, so quiet channels keep the latency low and
+ *         crowded ones spread the contenders out. The CSMA_*_NOW statistics
+ *         words hold the state of the controller, which keeps its last
+ *         state while low-power listening is on and sampling stops.
+ *
+ *         On a duty cycled band, frames are held once the airtime of the
+ *         node would go over the duty cycle of the band, see
+ *         rf_core_get_duty_cycle(). Airtime is accounted in a bucket
+ *         refilled at the duty cycle and holding at most a
+ *         TX_SCHED_DUTY_WINDOW worth, so the node may burst after a quiet
+ *         spell but never sends more than the limit over a window. Every
+ *         class waits, control traffic included, and TX_DUTY_HOLDS counts
+ *         the frames held.
+ *
+ *         Built with TX_SCHED_CONF_MODE set to TX_SCHED_MODE_SLOTTED, the
+ *         frames picked the same way wait for a cell of their link instead,
+ *         see slots.h, and a busy channel defers them to the next one.
+ */
+#ifndef TX_SCHED_H
+#define TX_SCHED_H
+
+#include "contiki.h"
+#include "frame-pool.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------*/
+/** \name MAC modes @{ */
+#define TX_SCHED_MODE_CSMA         0
+#define TX_SCHED_MODE_SLOTTED      1
+/** @} */
+
+/** How frames get on the air, one of the MAC modes */
+#ifdef TX_SCHED_CONF_MODE
+#define TX_SCHED_MODE TX_SCHED_CONF_MODE
+#else
+#define TX_SCHED_MODE TX_SCHED_MODE_CSMA
+#endif
+
+/** Traffic classes, in order of priority */
+#define TX_CLASS_CONTROL           0
+#define TX_CLASS_INTERACTIVE       1
+#define TX_CLASS_BULK              2
+#define TX_CLASS_COUNT             3
+
+/** Frames each class can have waiting, all of them pool frames */
+#ifdef TX_SCHED_CONF_CONTROL_LEN
+#define TX_SCHED_CONTROL_LEN TX_SCHED_CONF_CONTROL_LEN
+#else
+#define TX_SCHED_CONTROL_LEN 2
+#endif
+
+#ifdef TX_SCHED_CONF_INTERACTIVE_LEN
+#define TX_SCHED_INTERACTIVE_LEN TX_SCHED_CONF_INTERACTIVE_LEN
+#else
+#define TX_SCHED_INTERACTIVE_LEN 2
+#endif
+
+#ifdef TX_SCHED_CONF_BULK_LEN
+#define TX_SCHED_BULK_LEN TX_SCHED_CONF_BULK_LEN
+#else
+#define TX_SCHED_BULK_LEN 1
+#endif
+
+/**
+ * Bytes the interactive and bulk classes may send per round-robin round.
+ * Their ratio is how the channel is shared while both have frames waiting.
+ */
+#ifdef TX_SCHED_CONF_INTERACTIVE_QUANTUM
+#define TX_SCHED_INTERACTIVE_QUANTUM TX_SCHED_CONF_INTERACTIVE_QUANTUM
+#else
+#define TX_SCHED_INTERACTIVE_QUANTUM 256
+#endif
+
+#ifdef TX_SCHED_CONF_BULK_QUANTUM
+#define TX_SCHED_BULK_QUANTUM TX_SCHED_CONF_BULK_QUANTUM
+#else
+#define TX_SCHED_BULK_QUANTUM 128
+#endif
+
+/** CSMA backoff exponents and retries on a busy channel */
+#ifdef TX_SCHED_CONF_MIN_BE
+#define TX_SCHED_MIN_BE TX_SCHED_CONF_MIN_BE
+#else
+#define TX_SCHED_MIN_BE 1
+#endif
+
+#ifdef TX_SCHED_CONF_MAX_BE
+#define TX_SCHED_MAX_BE TX_SCHED_CONF_MAX_BE
+#else
+#define TX_SCHED_MAX_BE 4
+#endif
+
+#ifdef TX_SCHED_CONF_MAX_BACKOFFS
+#define TX_SCHED_MAX_BACKOFFS TX_SCHED_CONF_MAX_BACKOFFS
+#else
+#define TX_SCHED_MAX_BACKOFFS 4
+#endif
+
+/** Retries on an idle channel with TX_SCHED_ADAPTIVE */
+#ifdef TX_SCHED_CONF_MIN_BACKOFFS
+#define TX_SCHED_MIN_BACKOFFS TX_SCHED_CONF_MIN_BACKOFFS
+#else
+#define TX_SCHED_MIN_BACKOFFS 2
+#endif
+
+/** Adapt the CSMA backoff to the measured channel occupancy */
+#ifdef TX_SCHED_CONF_ADAPTIVE
+#define TX_SCHED_ADAPTIVE TX_SCHED_CONF_ADAPTIVE
+#else
+#define TX_SCHED_ADAPTIVE 1
+#endif
+
+/** Time between background carrier sense samples, in clock ticks */
+#ifdef TX_SCHED_CONF_CCA_PERIOD
+#define TX_SCHED_CCA_PERIOD TX_SCHED_CONF_CCA_PERIOD
+#else
+#define TX_SCHED_CCA_PERIOD (CLOCK_SECOND / 16)
+#endif
+
+/** Samples per occupancy update, a power of two up to 256 */
+#ifdef TX_SCHED_CONF_CCA_WINDOW
+#define TX_SCHED_CCA_WINDOW TX_SCHED_CONF_CCA_WINDOW
+#else
+#define TX_SCHED_CCA_WINDOW 32
+#endif
+
+/** Time the duty cycle is accounted over, in seconds, one hour as ETSI
+ * EN 300 220 */
+#ifdef TX_SCHED_CONF_DUTY_WINDOW
+#define TX_SCHED_DUTY_WINDOW TX_SCHED_CONF_DUTY_WINDOW
+#else
+#define TX_SCHED_DUTY_WINDOW 3600UL
+#endif
+
+/** One backoff period, in clock ticks */
+#ifdef TX_SCHED_CONF_BACKOFF_PERIOD
+#define TX_SCHED_BACKOFF_PERIOD TX_SCHED_CONF_BACKOFF_PERIOD
+#else
+#define TX_SCHED_BACKOFF_PERIOD 1
+#endif
+/*---------------------------------------------------------------------------*/
+PROCESS_NAME(tx_sched_process);
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Empty the queues and start the scheduler process.
+ */
+void tx_sched_init(void);
+
+/**
+ * \brief Restart the background carrier sense after low-power listening
+ *        was turned off, see rf_core_set_sniff_interval().
+ *
+ * The samples stop while low-power listening is on.
+ */
+void tx_sched_sniff_changed(void);
+
+/**
+ * \brief Queue a frame whose link header is written, see link_send().
+ *
+ * Ownership of the frame passes to the scheduler, which frees it once it
+ * has been sent, dropped on a busy channel, or right away if the queue of
+ * its class is full.
+ *
+ * \param tx_class One of the TX_CLASS_* values
+ * \return 0 if the frame was queued, -1 if it was dropped
+ */
+int tx_sched_send(struct frame *frame, uint8_t tx_class);
+
+/**
+ * \brief Number of frames waiting in a class.
+ */
+uint8_t tx_sched_queued(uint8_t tx_class);
+/*---------------------------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TX_SCHED_H */
@@ -0,0 +1,596 @@
+#!/usr/bin/env python3
+"""Host side of the framed serial link implemented by src/host-link.c.
+
+Can be used as a module (Link, encode, Decoder) or from the command line:
+
+    ./tools/hostlink.py /dev/ttyACM0 send 0x1234 "hello"
+    ./tools/hostlink.py /dev/ttyACM0 flood "hello everyone"
+    ./tools/hostlink.py /dev/ttyACM0 route 0x1234 "hello, far away"
+    ./tools/hostlink.py /dev/ttyACM0 message 0x1234 picture.jpg
+    ./tools/hostlink.py /dev/ttyACM0 get 3
+    ./tools/hostlink.py /dev/ttyACM0 set 3 10
+    ./tools/hostlink.py /dev/ttyACM0 listen
+    ./tools/hostlink.py /dev/ttyACM0 prof --reset
+    ./tools/hostlink.py /dev/ttyACM0 stats
+    ./tools/hostlink.py /dev/ttyACM0 fault --clear
+    ./tools/hostlink.py /dev/ttyACM0 bench 0x1234 --count 100 --len 64
+    ./tools/hostlink.py /dev/ttyACM0 ota 0x1234 update.delta --commit
+
+The serial port must already be configured, e.g.
+`stty -F /dev/ttyACM0 921600 raw -echo`.
+"""
+
+import argparse
+import select
+import struct
+import sys
+import time
+
+FLAG = 0x7E
+ESC = 0x7D
+
+CMD_RESULT = 0x00
+CMD_SEND_FRAME = 0x01
+CMD_RECV_FRAME = 0x02
+CMD_CONFIG_GET = 0x03
+CMD_CONFIG_SET = 0x04
+CMD_CONFIG_VALUE = 0x05
+CMD_LOG = 0x06
+CMD_PROF_DUMP = 0x07
+CMD_PROF_DATA = 0x08
+CMD_BENCH_START = 0x09
+CMD_BENCH_GET = 0x0A
+CMD_BENCH_REPORT = 0x0B
+CMD_PROF_COUNTERS = 0x0C
+CMD_FLOOD = 0x0D
+CMD_ROUTE_SEND = 0x0E
+CMD_SEND_MESSAGE = 0x0F
+CMD_MESSAGE_SENT = 0x10
+CMD_RECV_MESSAGE = 0x11
+CMD_STATS_GET = 0x12
+CMD_STATS = 0x13
+CMD_OTA_SEND = 0x14
+CMD_OTA_STATUS = 0x15
+CMD_FAULT_GET = 0x16
+CMD_FAULT = 0x17
+
+# The radio closes its UART after HOST_LINK_CONF_IDLE_TIMEOUT without host
+# frames. Past this much quiet a lone flag wakes it, HOST_LINK_WAKE_TIME
+# ahead of the frame.
+IDLE_TIME = 0.5
+WAKE_TIME = 0.005
+
+# Message data per HOST_CMD_SEND_MESSAGE chunk, fits HOST_LINK_MAX_FRAME_LEN
+MESSAGE_CHUNK = 256
+
+# Must match src/ota.h
+OTA_MSG_BEGIN = 0
+OTA_MSG_DATA = 1
+OTA_MSG_COMMIT = 2
+OTA_STATUS_OK = 0
+OTA_STATUS_BUSY = 1
+OTA_STATUS_DONE = 2
+OTA_STATUS_NAMES = {0: 'ok', 1: 'busy', 2: 'done', 3: 'error',
+                    4: 'made for another image', 5: 'unknown session',
+                    6: 'bad signature'}
+# Delta per OTA_MSG_DATA message, fills FRAG_CONF_MAX_LEN
+OTA_DATA_LEN = 1024 - 6
+# Wait for an answer before repeating a message, and how many times
+OTA_TIMEOUT = 3.0
+OTA_TRIES = 5
+# The target checks the whole image once the last message is in
+OTA_VERIFY_TIME = 30.0
+
+# Must match PROF_POINTS in src/prof.h
+PROF_POINTS = ['RF_RX_ISR', 'RF_RX_DRAIN', 'APP_INPUT', 'TX_QUEUE', 'RF_TX',
+               'NEIGHBOR_UPDATE', 'LINK_SEC_ENCRYPT', 'LINK_SEC_DECRYPT']
+# Must match PROF_COUNTERS in src/prof.h
+PROF_COUNTERS = ['DUP_HIT', 'DUP_MISS']
+
+# Must match src/monitor.h and TX_CLASS_COUNT of src/tx-sched.h
+MONITOR_NAME_LEN = 12
+TX_CLASS_COUNT = 3
+FAULT_RECOVERED = 0x01
+FAULT_PREVIOUS = 0x02
+
+# Must match STATS_WORDS in src/stats.h, histograms are (name, shift)
+STATS_VERSION = 1
+STATS_HIST_BINS = 8
+STATS_WORDS = ['RX_FRAMES', 'RX_CRC_ERRORS', 'RX_NO_BUFFER', 'TX_FRAMES',
+               'TX_ERRORS', 'CCA_BUSY', 'DROP_CCA', 'DROP_SCHED_FULL',
+               'DROP_TX_QUEUE', 'DROP_RUNT', 'DROP_UNSECURED', 'DROP_REPLAY',
+               'DROP_NO_ROUTE', 'DROP_HOST_LINK', 'FRAME_POOL_HWM',
+               'SCHED_CONTROL_HWM', 'SCHED_INTERACTIVE_HWM',
+               'SCHED_BULK_HWM', 'HOST_LINK_TX_HWM', ('RX_ISR_CYCLES', 7),
+               ('RX_LATENCY_US', 6), 'HOST_LINK_WAKEUPS', 'COMPRESS_FRAMES',
+               'COMPRESS_SAVED_BYTES', 'DROP_DECOMPRESS', 'SLOTS_SYNCS',
+               'SLOTS_DRIFT_HWM', 'CSMA_SAMPLES', 'CSMA_BUSY_SAMPLES',
+               'CSMA_OCCUPANCY_NOW', 'CSMA_BE_NOW', 'CSMA_BACKOFFS_NOW',
+               'STORE_HELD', 'STORE_SENT', 'STORE_EXPIRED', 'STORE_EVICTED',
+               'STORE_HWM', 'CHAN_SCANS', 'CHAN_SWITCHES', 'CHAN_SEARCHES',
+               'CHAN_OCCUPANCY_NOW', 'MONITOR_LATENCY_HWM',
+               ('MONITOR_LATENCY_US', 11), 'MONITOR_VIOLATIONS',
+               'MONITOR_CAPTURES', 'SLOTS_REJECTS', 'SLOTS_LATE',
+               'ROUTE_NO_FRAME', 'TX_DUTY_HOLDS']
+
+STATUS_NAMES = {0: 'ok', 1: 'error', 2: 'unsupported', 3: 'invalid'}
+
+
+def crc16(data, acc=0):
+    """Contiki's crc16_data(), CRC-16/CCITT in reflected form."""
+    for b in data:
+        acc ^= b
+        acc = ((acc >> 8) | (acc << 8)) & 0xFFFF
+        acc ^= (acc & 0xFF00) << 4 & 0xFFFF
+        acc ^= (acc >> 8) >> 4
+        acc ^= (acc & 0xFF00) >> 5
+    return acc
+
+
+def encode(cmd, args=b''):
+    """Return the on-wire bytes of one frame."""
+    content = bytes([cmd]) + bytes(args)
+    content += struct.pack('<H', crc16(content))
+    out = bytearray([FLAG])
+    for b in content:
+        if b in (FLAG, ESC):
+            out += bytes([ESC, b ^ 0x20])
+        else:
+            out.append(b)
+    out.append(FLAG)
+    return bytes(out)
+
+
+class Decoder:
+    """Incremental frame decoder, yields (cmd, args) for every good frame."""
+
+    def __init__(self):
+        self.buf = bytearray()
+        self.escaped = False
+
+    def feed(self, data):
+        for b in data:
+            if b == FLAG:
+                frame = bytes(self.buf)
+                self.buf.clear()
+                if self.escaped or len(frame) < 3:
+                    self.escaped = False
+                    continue
+                body, crc = frame[:-2], struct.unpack('<H', frame[-2:])[0]
+                if crc16(body) == crc:
+                    yield body[0], body[1:]
+            elif b == ESC:
+                self.escaped = True
+            else:
+                if self.escaped:
+                    b ^= 0x20
+                    self.escaped = False
+                self.buf.append(b)
+
+
+class Link:
+    """Blocking request/response wrapper around a serial device."""
+
+    def __init__(self, path):
+        self.dev = open(path, 'r+b', buffering=0)
+        self.decoder = Decoder()
+        self.last_send = None
+
+    def send(self, cmd, args=b''):
+        now = time.monotonic()
+        if self.last_send is None or now - self.last_send > IDLE_TIME:
+            self.dev.write(bytes([FLAG]))
+            time.sleep(WAKE_TIME)
+        self.dev.write(encode(cmd, args))
+        self.last_send = time.monotonic()
+
+    def frames(self):
+        while True:
+            data = self.dev.read(256)
+            if not data:
+                return
+            yield from self.decoder.feed(data)
+
+    def wait_for(self, cmds, timeout=None):
+        """Return the first (cmd, args) of one of cmds, None on timeout."""
+        if timeout is None:
+            for cmd, args in self.frames():
+                if cmd in cmds:
+                    return cmd, args
+            raise EOFError('link closed')
+        deadline = time.monotonic() + timeout
+        while True:
+            left = deadline - time.monotonic()
+            if left <= 0 or not select.select([self.dev], [], [], left)[0]:
+                return None
+            data = self.dev.read(256)
+            if not data:
+                raise EOFError('link closed')
+            for cmd, args in self.decoder.feed(data):
+                if cmd in cmds:
+                    return cmd, args
+
+
+def cmd_send(link, opts):
+    dst = int(opts.dst, 0)
+    link.send(CMD_SEND_FRAME, struct.pack('<H', dst) + opts.data.encode())
+    _, args = link.wait_for([CMD_RESULT])
+    print(STATUS_NAMES.get(args[1], args[1]))
+
+
+def cmd_route(link, opts):
+    dst = int(opts.dst, 0)
+    link.send(CMD_ROUTE_SEND, struct.pack('<H', dst) + opts.data.encode())
+    _, args = link.wait_for([CMD_RESULT])
+    print(STATUS_NAMES.get(args[1], args[1]))
+
+
+def cmd_message(link, opts):
+    dst = int(opts.dst, 0)
+    with open(opts.file, 'rb') as f:
+        data = f.read()
+    for off in range(0, len(data), MESSAGE_CHUNK):
+        link.send(CMD_SEND_MESSAGE, struct.pack('<HHH', dst, off, len(data)) +
+                  data[off:off + MESSAGE_CHUNK])
+        _, args = link.wait_for([CMD_RESULT])
+        if args[1] != 0:
+            print(STATUS_NAMES.get(args[1], args[1]))
+            return
+    _, args = link.wait_for([CMD_MESSAGE_SENT])
+    print(STATUS_NAMES.get(args[2], args[2]))
+
+
+def cmd_flood(link, opts):
+    link.send(CMD_FLOOD, opts.data.encode())
+    _, args = link.wait_for([CMD_RESULT])
+    print(STATUS_NAMES.get(args[1], args[1]))
+
+
+def cmd_get(link, opts):
+    link.send(CMD_CONFIG_GET, bytes([opts.param]))
+    cmd, args = link.wait_for([CMD_CONFIG_VALUE, CMD_RESULT])
+    if cmd == CMD_RESULT:
+        print(STATUS_NAMES.get(args[1], args[1]))
+    else:
+        print(struct.unpack('<i', args[1:5])[0])
+
+
+def cmd_set(link, opts):
+    link.send(CMD_CONFIG_SET, struct.pack('<Bi', opts.param, opts.value))
+    _, args = link.wait_for([CMD_RESULT])
+    print(STATUS_NAMES.get(args[1], args[1]))
+
+
+def cmd_prof(link, opts):
+    link.send(CMD_PROF_DUMP, bytes([1 if opts.reset else 0]))
+    cmd, args = link.wait_for([CMD_PROF_DATA, CMD_RESULT])
+    if cmd == CMD_RESULT:
+        print(STATUS_NAMES.get(args[1], args[1]))
+        return
+    print('%-12s %10s %10s %10s %12s' % ('point', 'count', 'min', 'max',
+                                         'mean'))
+    for off in range(0, len(args), 21):
+        point, count, lo, hi, total = struct.unpack_from('<BIIIQ', args, off)
+        name = PROF_POINTS[point] if point < len(PROF_POINTS) else point
+        mean = total / count if count else 0
+        print('%-12s %10u %10u %10u %12.1f' % (name, count, lo, hi, mean))
+    _, args = link.wait_for([CMD_PROF_COUNTERS])
+    print()
+    for off in range(0, len(args), 5):
+        counter, value = struct.unpack_from('<BI', args, off)
+        name = (PROF_COUNTERS[counter] if counter < len(PROF_COUNTERS)
+                else counter)
+        print('%-12s %10u' % (name, value))
+
+
+def parse_stats(args):
+    """Decode a CMD_STATS reply into (uptime, {name: value}).
+
+    Histograms are lists of STATS_HIST_BINS values, words unknown to this
+    version of STATS_WORDS are keyed by position. Returns None when the
+    statistics version is not supported.
+    """
+    version, count, uptime = struct.unpack_from('<HHI', args)
+    if version != STATS_VERSION:
+        return None
+    words = struct.unpack_from('<%uI' % count, args, 8)
+    values = {}
+    pos = 0
+    for word in STATS_WORDS:
+        if pos >= count:
+            break
+        if isinstance(word, tuple):
+            values[word[0]] = list(words[pos:pos + STATS_HIST_BINS])
+            pos += STATS_HIST_BINS
+        else:
+            values[word] = words[pos]
+            pos += 1
+    for i in range(pos, count):
+        values[i] = words[i]
+    return uptime, values
+
+
+def cmd_stats(link, opts):
+    link.send(CMD_STATS_GET, bytes([1 if opts.reset else 0]))
+    cmd, args = link.wait_for([CMD_STATS, CMD_RESULT])
+    if cmd == CMD_RESULT:
+        print(STATUS_NAMES.get(args[1], args[1]))
+        return
+    stats = parse_stats(args)
+    if stats is None:
+        print('unsupported statistics version %u'
+              % struct.unpack_from('<H', args)[0])
+        return
+    uptime, values = stats
+    shifts = dict(w for w in STATS_WORDS if isinstance(w, tuple))
+    print('uptime %u s' % uptime)
+    for name, value in values.items():
+        if isinstance(value, list):
+            print('%s' % name)
+            for i, count in enumerate(value):
+                low = 0 if i == 0 else 1 << (i + shifts[name])
+                print('  >= %-8u %10u' % (low, count))
+        else:
+            print('%-22s %10u' % (name, value))
+
+
+def cmd_fault(link, opts):
+    link.send(CMD_FAULT_GET, bytes([1 if opts.clear else 0]))
+    cmd, args = link.wait_for([CMD_FAULT, CMD_RESULT])
+    if cmd == CMD_RESULT:
+        print('no stall captured')
+        return
+    count, flags, nevents, pool_free = struct.unpack_from('<HBBB', args)
+    queued = args[5:5 + TX_CLASS_COUNT]
+    off = 5 + TX_CLASS_COUNT
+    uptime, cycles, stall, process = struct.unpack_from('<IIII', args, off)
+    off += 16
+    name = args[off:off + MONITOR_NAME_LEN].split(b'\0')[0].decode(
+        errors='replace')
+    off += MONITOR_NAME_LEN
+    sp, words = struct.unpack_from('<IB', args, off)
+    stack = struct.unpack_from('<%uI' % words, args, off + 5)
+
+    if flags & FAULT_RECOVERED:
+        end = 'loop ran again'
+    else:
+        end = 'ended in a reset'
+    print('%u captures, latest %s' % (count, 'before the last reset'
+                                      if flags & FAULT_PREVIOUS else
+                                      'since boot'))
+    print('stall %u us at uptime %u s, %s' % (stall, uptime, end))
+    print('process 0x%08x %r' % (process, name))
+    print('events queued %u, free frames %u, frames queued %s'
+          % (nevents, pool_free, ' '.join('%u' % q for q in queued)))
+    print('cycles %u' % cycles)
+    for i in range(0, words, 4):
+        print('  0x%08x: %s' % (sp + 4 * i, ' '.join(
+            '%08x' % w for w in stack[i:i + 4])))
+
+
+def ota_request(link, dst, session, msg, timeout=OTA_TIMEOUT):
+    """Send one update message until the target answers it.
+
+    Returns the (status, offset) of the answer, None if it never came.
+    """
+    for _ in range(OTA_TRIES):
+        sent = True
+        for off in range(0, len(msg), MESSAGE_CHUNK):
+            link.send(CMD_OTA_SEND, struct.pack('<HHH', dst, off, len(msg)) +
+                      msg[off:off + MESSAGE_CHUNK])
+            _, args = link.wait_for([CMD_RESULT])
+            if args[1] != 0:
+                # The node is still sending the previous message
+                sent = False
+                break
+        deadline = time.monotonic() + timeout
+        while sent:
+            reply = link.wait_for([CMD_OTA_STATUS],
+                                  deadline - time.monotonic())
+            if reply is None:
+                break
+            target, _, reply_session, status, offset = struct.unpack(
+                '<HBBBI', reply[1])
+            if target == dst and reply_session == session:
+                return status, offset
+        time.sleep(0.2)
+    return None
+
+
+def cmd_ota(link, opts):
+    dst = int(opts.dst, 0)
+    with open(opts.delta, 'rb') as f:
+        delta = f.read()
+    magic, image_len, base_len, base_crc, digest, sig = struct.unpack_from(
+        '<4sIIH32s64s', delta)
+    if magic != b'OTA2':
+        print('%s is not a signed delta, see tools/ota-delta.py' % opts.delta)
+        return
+    ops = delta[110:]
+    session = opts.session & 0xFF
+
+    # Busy while the target checks the signature and its image, asking
+    # again only gets its answer
+    begin = struct.pack('<BBIIHI', OTA_MSG_BEGIN, session, image_len,
+                        base_len, base_crc, len(ops)) + digest + sig
+    deadline = time.monotonic() + OTA_VERIFY_TIME
+    reply = ota_request(link, dst, session, begin)
+    while (reply is not None and reply[0] == OTA_STATUS_BUSY and
+           time.monotonic() < deadline):
+        time.sleep(0.2)
+        reply = ota_request(link, dst, session, begin)
+    offset = 0
+    start = time.monotonic()
+    while reply is not None and reply[0] in (OTA_STATUS_OK, OTA_STATUS_BUSY):
+        status, offset = reply
+        if offset == len(ops):
+            break
+        if status == OTA_STATUS_BUSY:
+            time.sleep(0.05)
+        reply = ota_request(link, dst, session,
+                            struct.pack('<BBI', OTA_MSG_DATA, session,
+                                        offset) +
+                            ops[offset:offset + OTA_DATA_LEN])
+        print('\r%u of %u bytes' % (offset, len(ops)), end='', flush=True)
+    print()
+
+    # The last answer comes before the image is checked
+    deadline = time.monotonic() + OTA_VERIFY_TIME
+    while (reply is not None and reply[0] == OTA_STATUS_OK and
+           time.monotonic() < deadline):
+        got = link.wait_for([CMD_OTA_STATUS], deadline - time.monotonic())
+        if got is not None:
+            target, _, reply_session, status, offset = struct.unpack(
+                '<HBBBI', got[1])
+            if target == dst and reply_session == session:
+                reply = status, offset
+
+    if reply is None:
+        print('no answer from 0x%04x' % dst)
+        return
+    print('%s, %u byte delta in %.1f s'
+          % (OTA_STATUS_NAMES.get(reply[0], reply[0]), len(ops),
+             time.monotonic() - start))
+
+    if opts.commit and reply[0] == OTA_STATUS_DONE:
+        reply = ota_request(link, dst, session,
+                            struct.pack('<BB', OTA_MSG_COMMIT, session))
+        print('commit %s' % ('no answer' if reply is None else
+                             OTA_STATUS_NAMES.get(reply[0], reply[0])))
+
+
+def print_bench_report(args):
+    (role, sent, received, expected, length, elapsed, rtt_min, p50, p90, p99,
+     rtt_max, tx_cycles, rx_cycles, airtime) = struct.unpack(
+         '<BHHHBIIIIIIIII', args)
+    print('role       %s' % ('sender' if role else 'echo'))
+    print('frames     sent %u, received %u of %u, %u bytes'
+          % (sent, received, expected, length))
+    if expected:
+        print('PDR        %.1f %%' % (100.0 * received / expected))
+    if elapsed:
+        print('goodput    %.0f bit/s' % (received * length * 8e6 / elapsed))
+    if role:
+        print('RTT        min %u, p50 %u, p90 %u, p99 %u, max %u us'
+              % (rtt_min, p50, p90, p99, rtt_max))
+    print('cycles     %u per TX frame, %u per RX frame, CPU only'
+          % (tx_cycles, rx_cycles))
+    print('airtime    %u us per frame' % airtime)
+
+
+def cmd_bench(link, opts):
+    if opts.peer is None:
+        link.send(CMD_BENCH_GET)
+    else:
+        link.send(CMD_BENCH_START, struct.pack('<HHBH', int(opts.peer, 0),
+                                               opts.count, opts.len,
+                                               opts.interval))
+        _, args = link.wait_for([CMD_RESULT])
+        if args[1] != 0:
+            print(STATUS_NAMES.get(args[1], args[1]))
+            return
+    _, args = link.wait_for([CMD_BENCH_REPORT])
+    print_bench_report(args)
+
+
+def cmd_listen(link, opts):
+    messages = {}
+    for cmd, args in link.frames():
+        if cmd == CMD_RECV_FRAME:
+            src, rssi = struct.unpack('<Hb', args[:3])
+            print('0x%04x %4d dBm %r' % (src, rssi, args[3:]))
+        elif cmd == CMD_RECV_MESSAGE:
+            src, off, total = struct.unpack('<HHH', args[:6])
+            if off == 0:
+                messages[src] = bytearray()
+            msg = messages.get(src)
+            if msg is None or len(msg) != off:
+                continue
+            msg += args[6:]
+            if len(msg) == total:
+                print('0x%04x message, %u bytes %r' % (src, total,
+                                                       bytes(msg)))
+                del messages[src]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('device')
+    sub = parser.add_subparsers(dest='command', required=True)
+
+    p = sub.add_parser('send', help='send data to a link address')
+    p.add_argument('dst')
+    p.add_argument('data')
+    p.set_defaults(func=cmd_send)
+
+    p = sub.add_parser('message', help='send a file to a neighbor in '
+                                      'fragments')
+    p.add_argument('dst')
+    p.add_argument('file')
+    p.set_defaults(func=cmd_message)
+
+    p = sub.add_parser('flood', help='flood data to every node of the mesh')
+    p.add_argument('data')
+    p.set_defaults(func=cmd_flood)
+
+    p = sub.add_parser('route', help='send data over multiple hops')
+    p.add_argument('dst')
+    p.add_argument('data')
+    p.set_defaults(func=cmd_route)
+
+    p = sub.add_parser('get', help='read a configuration parameter')
+    p.add_argument('param', type=int)
+    p.set_defaults(func=cmd_get)
+
+    p = sub.add_parser('set', help='write a configuration parameter')
+    p.add_argument('param', type=int)
+    p.add_argument('value', type=int)
+    p.set_defaults(func=cmd_set)
+
+    p = sub.add_parser('prof', help='dump hot path cycle counts')
+    p.add_argument('--reset', action='store_true',
+                   help='clear the statistics after reading them')
+    p.set_defaults(func=cmd_prof)
+
+    p = sub.add_parser('stats', help='read the runtime statistics')
+    p.add_argument('--reset', action='store_true',
+                   help='clear all but the *_NOW gauges as they are read')
+    p.set_defaults(func=cmd_stats)
+
+    p = sub.add_parser('fault', help='read the last stall of the event loop')
+    p.add_argument('--clear', action='store_true',
+                   help='forget the stall once read')
+    p.set_defaults(func=cmd_fault)
+
+    p = sub.add_parser('bench', help='run a benchmark (radio-bench image)')
+    p.add_argument('peer', nargs='?',
+                   help='node echoing the requests, omit to read the report '
+                        'of the last run')
+    p.add_argument('--count', type=int, default=100)
+    p.add_argument('--len', type=int, default=64, help='bytes per request')
+    p.add_argument('--interval', type=int, default=100,
+                   help='time between requests in ms')
+    p.set_defaults(func=cmd_bench)
+
+    p = sub.add_parser('ota', help='update the firmware of a node, this one '
+                                  'included')
+    p.add_argument('dst')
+    p.add_argument('delta', help='made by tools/ota-delta.py')
+    p.add_argument('--session', type=int, default=int(time.time()),
+                   help='identifies the update, the same one resumes it')
+    p.add_argument('--commit', action='store_true',
+                   help='reset into the new image once it is written')
+    p.set_defaults(func=cmd_ota)
+
+    p = sub.add_parser('listen', help='print received frames')
+    p.set_defaults(func=cmd_listen)
+
+    opts = parser.parse_args()
+    try:
+        opts.func(Link(opts.device), opts)
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == '__main__':
+    sys.exit(main())
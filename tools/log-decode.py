@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+"""Decode the binary log records written by src/log-ring.c.
+
+Reads the host link byte stream (a serial port or a capture file), takes the
+payload of every HOST_CMD_LOG frame and prints one line per record, using
+the format strings from src/log-ids.h. Other frames are ignored.
+
+    ./tools/log-decode.py /dev/ttyACM0
+    ./tools/log-decode.py capture.bin
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+import hostlink
+
+MAGIC = 0xA5
+HEADER = struct.Struct('<BHBI')
+RTIMER_SECOND = 65536
+
+IDS_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                        '..', 'src', 'log-ids.h')
+
+
+def load_formats(path):
+    """Return the list of (name, format) pairs in declaration order."""
+    with open(path) as f:
+        text = f.read()
+    return re.findall(r'X\((\w+),\s*"((?:[^"\\]|\\.)*)"\)', text)
+
+
+def format_record(fmt, args):
+    """Apply a printf style format, reinterpreting %d arguments as signed."""
+    converted = []
+    for spec, arg in zip(re.findall(r'%[-0-9]*([dux])', fmt), args):
+        if spec == 'd' and arg & 0x80000000:
+            arg -= 1 << 32
+        converted.append(arg)
+    try:
+        return fmt % tuple(converted)
+    except TypeError:
+        return '%s %r' % (fmt, args)
+
+
+def decode_records(buf, formats):
+    """Print every complete record in buf, return the unconsumed tail."""
+    while True:
+        start = buf.find(bytes([MAGIC]))
+        if start < 0:
+            return b''
+        buf = buf[start:]
+        if len(buf) < HEADER.size:
+            return buf
+        _, rid, nargs, ts = HEADER.unpack_from(buf)
+        if rid >= len(formats) or nargs > 4:
+            # Not a record header, resynchronize on the next magic byte
+            buf = buf[1:]
+            continue
+        end = HEADER.size + 4 * nargs
+        if len(buf) < end:
+            return buf
+        args = struct.unpack_from('<%dI' % nargs, buf, HEADER.size)
+        name, fmt = formats[rid]
+        print('%12.6f %-12s %s' % (ts / RTIMER_SECOND, name,
+                                   format_record(fmt, args)))
+        buf = buf[end:]
+
+
+def decode(stream, formats):
+    decoder = hostlink.Decoder()
+    buf = b''
+    while True:
+        chunk = stream.read(256)
+        if not chunk:
+            break
+        for cmd, args in decoder.feed(chunk):
+            if cmd == hostlink.CMD_LOG:
+                # Records may straddle frames, keep the partial tail
+                buf = decode_records(buf + args, formats)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('input', help='serial device or capture file')
+    parser.add_argument('--ids', default=IDS_PATH,
+                        help='path to log-ids.h (default: %(default)s)')
+    args = parser.parse_args()
+
+    formats = load_formats(args.ids)
+    with open(args.input, 'rb', buffering=0) as stream:
+        try:
+            decode(stream, formats)
+        except KeyboardInterrupt:
+            pass
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+"""Print the flash and RAM used by every firmware module.
+
+Sizes are taken from the object files of the application modules, so they
+are an upper bound on what ends up in the image once the linker has dropped
+unused sections. Arena regions, see src/arena.h, are moved from the arena
+module to the module owning them and printed next to their quota. Whatever
+the images hold beyond the application modules is Contiki and the SDK.
+
+    ./tools/mem-report.py build/simplelink/launchpad/cc1312r/obj \\
+        build/simplelink/launchpad/cc1312r/radio-firmware.simplelink
+"""
+
+import argparse
+import glob
+import os
+import re
+import subprocess
+import sys
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..')
+
+
+def modules():
+    """Names of the application modules, one per source file."""
+    paths = glob.glob(os.path.join(ROOT, '*.c'))
+    paths += glob.glob(os.path.join(ROOT, 'src', '*.c'))
+    paths += glob.glob(os.path.join(ROOT, 'src', '*.cpp'))
+    return sorted(os.path.splitext(os.path.basename(p))[0] for p in paths)
+
+
+def sizes(size_tool, paths):
+    """Map of path to (text, data, bss), from Berkeley style size output."""
+    out = subprocess.run([size_tool] + paths, check=True,
+                         capture_output=True, text=True).stdout
+    result = {}
+    for line in out.splitlines()[1:]:
+        fields = line.split()
+        result[fields[5]] = tuple(int(f) for f in fields[:3])
+    return result
+
+
+def arena_regions(nm_tool, path):
+    """Map of owning module to region size, from the arena object."""
+    out = subprocess.run([nm_tool, '-S', '--defined-only', path], check=True,
+                         capture_output=True, text=True).stdout
+    regions = {}
+    for line in out.splitlines():
+        m = re.match(r'[0-9a-f]+ ([0-9a-f]+) [bBdD] arena_([A-Z0-9_]+)$',
+                     line)
+        if m:
+            regions[m.group(2).lower().replace('_', '-')] = int(m.group(1), 16)
+    return regions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('objdir', help='directory holding the object files')
+    parser.add_argument('images', nargs='*', help='linked images')
+    parser.add_argument('--size', default='arm-none-eabi-size')
+    parser.add_argument('--nm', default='arm-none-eabi-nm')
+    opts = parser.parse_args()
+
+    objects = {}
+    for name in modules():
+        path = os.path.join(opts.objdir, name + '.o')
+        if os.path.exists(path):
+            objects[name] = path
+    if not objects:
+        sys.exit('no application objects in %s' % opts.objdir)
+
+    table = sizes(opts.size, list(objects.values()))
+    regions = {}
+    if 'arena' in objects:
+        regions = arena_regions(opts.nm, objects['arena'])
+
+    print('%-16s %8s %8s %8s' % ('module', 'flash', 'RAM', 'arena'))
+    total_flash = total_ram = total_arena = 0
+    for name, path in objects.items():
+        text, data, bss = table[path]
+        if name == 'arena':
+            bss -= sum(regions.values())
+        arena = regions.get(name, 0)
+        print('%-16s %8u %8u %8s' % (name, text + data, data + bss,
+                                      arena or ''))
+        total_flash += text + data
+        total_ram += data + bss
+        total_arena += arena
+    print('%-16s %8u %8u %8u' % ('total', total_flash, total_ram,
+                                  total_arena))
+
+    for image in opts.images:
+        text, data, bss = sizes(opts.size, [image])[image]
+        print('\n%s: %u bytes flash, %u bytes RAM, of which at least '
+              '%u flash and %u RAM are Contiki and the SDK'
+              % (os.path.basename(image), text + data, data + bss,
+                 max(text + data - total_flash, 0),
+                 max(data + bss - total_ram - total_arena, 0)))
+
+
+if __name__ == '__main__':
+    sys.exit(main())
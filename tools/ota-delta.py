@@ -0,0 +1,210 @@
+#!/usr/bin/env python3
+"""Make a firmware update delta between two images, see src/ota.h.
+
+The base is the binary image the nodes run, the target the one they are
+updated to, both as flashed. Nodes only take updates signed with the key
+they are built with, OTA_CONF_PUBLIC_KEY in project-conf.h:
+
+    openssl ecparam -name prime256v1 -genkey -noout -out ota-key.pem
+    ./tools/ota-delta.py --key ota-key.pem --export-key
+    ./tools/ota-delta.py old.bin new.bin --key ota-key.pem -o update.delta
+    ./tools/ota-delta.py old.bin update.delta --apply -o check.bin
+
+A delta file is the header [magic (4)] [image length (4)] [base length (4)]
+[base CRC (2)] [image SHA-256 (32)] [signature (64)] followed by the
+operations, and is sent with `./tools/hostlink.py <device> ota <node>
+update.delta`. Signing needs the Python cryptography package.
+"""
+
+import argparse
+import hashlib
+import struct
+import sys
+
+from hostlink import crc16
+
+MAGIC = b'OTA2'
+HEADER = struct.Struct('<4sIIH32s64s')
+
+# Shortest copy worth an operation, and the key length of the match index
+MIN_MATCH = 8
+# Positions remembered per key, the most recent ones win
+MAX_CANDIDATES = 16
+
+
+def varint(value):
+    out = bytearray()
+    while True:
+        byte = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return bytes(out)
+
+
+def zigzag(value):
+    return value << 1 if value >= 0 else ((-value) << 1) - 1
+
+
+def read_varint(data, pos):
+    value = shift = 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, pos
+
+
+def load_key(path):
+    from cryptography.hazmat.primitives import serialization
+    with open(path, 'rb') as f:
+        return serialization.load_pem_private_key(f.read(), password=None)
+
+
+def export_key(key):
+    from cryptography.hazmat.primitives import serialization
+    point = key.public_key().public_bytes(
+        serialization.Encoding.X962,
+        serialization.PublicFormat.UncompressedPoint)
+    lines = []
+    for i in range(0, len(point), 12):
+        lines.append(', '.join('0x%02x' % b for b in point[i:i + 12]))
+    return ('#define OTA_CONF_PUBLIC_KEY { \\\n  %s }'
+            % ', \\\n  '.join(lines))
+
+
+def sign(key, digest):
+    """ECDSA P-256 signature of a SHA-256, r then s, big endian"""
+    from cryptography.hazmat.primitives import hashes
+    from cryptography.hazmat.primitives.asymmetric import ec, utils
+    der = key.sign(digest, ec.ECDSA(utils.Prehashed(hashes.SHA256())))
+    r, s = utils.decode_dss_signature(der)
+    return r.to_bytes(32, 'big') + s.to_bytes(32, 'big')
+
+
+def make_delta(base, image, key):
+    index = {}
+    for i in range(len(base) - MIN_MATCH + 1):
+        index.setdefault(base[i:i + MIN_MATCH], []).append(i)
+        if len(index[base[i:i + MIN_MATCH]]) > MAX_CANDIDATES:
+            del index[base[i:i + MIN_MATCH]][0]
+
+    out = bytearray()
+    literal = bytearray()
+    copy_pos = 0
+    pos = 0
+
+    def flush_literal():
+        if literal:
+            out.extend(varint((len(literal) - 1) << 1))
+            out.extend(literal)
+            literal.clear()
+
+    while pos < len(image):
+        best_len = 0
+        best_src = 0
+        # Carrying on from the last copy costs a single offset byte
+        candidates = [copy_pos] + index.get(image[pos:pos + MIN_MATCH], [])
+        for src in candidates:
+            n = 0
+            limit = min(len(base) - src, len(image) - pos)
+            while n < limit and base[src + n] == image[pos + n]:
+                n += 1
+            if n > best_len or (n == best_len and src == copy_pos):
+                best_len, best_src = n, src
+        if best_len >= MIN_MATCH or (best_len > 2 and best_src == copy_pos):
+            flush_literal()
+            out.extend(varint(((best_len - 1) << 1) | 1))
+            out.extend(varint(zigzag(best_src - copy_pos)))
+            copy_pos = best_src + best_len
+            pos += best_len
+        else:
+            literal.append(image[pos])
+            pos += 1
+    flush_literal()
+
+    digest = hashlib.sha256(image).digest()
+    return HEADER.pack(MAGIC, len(image), len(base), crc16(base), digest,
+                       sign(key, digest)) + bytes(out)
+
+
+def apply_delta(base, delta):
+    magic, image_len, base_len, base_crc, digest, _ = HEADER.unpack_from(
+        delta)
+    if magic != MAGIC:
+        raise ValueError('not a delta')
+    if base_len > len(base) or crc16(base[:base_len]) != base_crc:
+        raise ValueError('delta made for another base image')
+    out = bytearray()
+    copy_pos = 0
+    pos = HEADER.size
+    while pos < len(delta):
+        value, pos = read_varint(delta, pos)
+        n = (value >> 1) + 1
+        if value & 1:
+            offset, pos = read_varint(delta, pos)
+            copy_pos += (offset >> 1) ^ -(offset & 1)
+            out += base[copy_pos:copy_pos + n]
+            copy_pos += n
+        else:
+            out += delta[pos:pos + n]
+            pos += n
+    if len(out) != image_len or hashlib.sha256(out).digest() != digest:
+        raise ValueError('delta does not rebuild the image')
+    return bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('base', nargs='?', help='image the nodes run')
+    parser.add_argument('target', nargs='?',
+                        help='new image, or delta with --apply')
+    parser.add_argument('-o', '--output')
+    parser.add_argument('--key', help='PEM private key to sign with')
+    parser.add_argument('--apply', action='store_true',
+                        help='rebuild the new image from a delta')
+    parser.add_argument('--export-key', action='store_true',
+                        help='print the public key for project-conf.h')
+    opts = parser.parse_args()
+
+    if opts.export_key:
+        if opts.key is None:
+            parser.error('--export-key needs --key')
+        print(export_key(load_key(opts.key)))
+        return 0
+    if opts.base is None or opts.target is None or opts.output is None:
+        parser.error('base, target and --output are needed')
+    if not opts.apply and opts.key is None:
+        parser.error('a delta has to be signed, see --key')
+
+    with open(opts.base, 'rb') as f:
+        base = f.read()
+    with open(opts.target, 'rb') as f:
+        target = f.read()
+
+    try:
+        if opts.apply:
+            out = apply_delta(base, target)
+        else:
+            out = make_delta(base, target, load_key(opts.key))
+            # Decoded as the nodes will, a delta that does not rebuild the
+            # image would go all the way to the CRC check of every node
+            apply_delta(base, out)
+    except ValueError as e:
+        print(e, file=sys.stderr)
+        return 1
+
+    with open(opts.output, 'wb') as f:
+        f.write(out)
+    if not opts.apply:
+        print('%u byte image, %u byte delta (%.1f %%)'
+              % (len(target), len(out), 100.0 * len(out) / len(target)))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,526 @@
+#!/usr/bin/env python3
+"""Run a network of simulated nodes and report how the mesh behaves.
+
+Starts one native node (`make TARGET=native`, see sim/sim.h) per virtual
+node, plays the radio medium between them and drives their host links:
+
+    ./tools/sim-run.py --nodes 100 --duration 120
+    ./tools/sim-run.py --nodes 400 --topology random --area 8000 --flows 50
+    ./tools/sim-run.py --nodes 25 --nvs-dir /tmp/nvs --json result.json
+
+The medium uses log-distance path loss with per-link shadowing. Frames are
+delivered at the end of their airtime with a probability that falls off
+around the receiver sensitivity, and are lost to overlapping transmissions
+the receiver hears within the capture margin, or when the receiver is
+itself transmitting. Time is wall clock time, the nodes run in real time.
+Nodes only hear each other on the same channel, and --interference keeps a
+channel busy for a share of the time, to watch the mesh move off it:
+
+    ./tools/sim-run.py --nodes 25 --interference 0:0.5 --duration 600
+
+Every flow sends a routed payload from one node to another every interval
+once the warmup is over. The report gives the routing convergence time, the
+time from the first payload of a flow until one is delivered, the delivery
+ratio and latency of all payloads, and the queue high water marks and drops
+from the statistics of every node.
+"""
+
+import argparse
+import json
+import math
+import os
+import random
+import selectors
+import socket
+import struct
+import subprocess
+import sys
+import time
+
+import hostlink
+
+# Must match sim/sim.h
+MSG_HELLO = 0
+MSG_CCA = 1
+MSG_TX = 2
+MSG_CCA_RESULT = 3
+MSG_RX = 4
+MSG_CHANNEL = 5
+MSG_RSSI = 6
+MSG_RSSI_RESULT = 7
+
+BINARY = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..',
+                      'build', 'native', 'radio-sim.native')
+
+# Payload of the flows, padded to --len: [src (2)] [dst (2)] [seqno (4)]
+PAYLOAD = struct.Struct('<HHI')
+
+# Statistics summed or maxed over the nodes in the report
+HWM_WORDS = ['FRAME_POOL_HWM', 'SCHED_CONTROL_HWM', 'SCHED_INTERACTIVE_HWM',
+             'SCHED_BULK_HWM', 'HOST_LINK_TX_HWM']
+
+
+def percentile(values, p):
+    if not values:
+        return None
+    values = sorted(values)
+    return values[min(len(values) - 1, int(p * len(values)))]
+
+
+class Medium:
+    """Shared radio channel, one UDP datagram per node message."""
+
+    def __init__(self, opts, positions):
+        self.opts = opts
+        self.positions = positions
+        self.rng = random.Random(opts.seed)
+        self.shadowing = {}
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.bind(('127.0.0.1', 0))
+        self.sock.setblocking(False)
+        self.port = self.sock.getsockname()[1]
+        self.peers = {}
+        self.nodes = {}
+        self.channels = {}
+        # Share of the time every interfered channel is busy
+        self.interference = dict(opts.interference)
+        # [end, sender, power, frame, start, delivered, channel] of every
+        # frame on the air, and of those that ended while another still is
+        self.on_air = []
+        self.frames = 0
+        self.collisions = 0
+
+    def rx_power(self, src, dst, power):
+        (x0, y0), (x1, y1) = self.positions[src], self.positions[dst]
+        dist = max(1.0, math.hypot(x1 - x0, y1 - y0))
+        key = (min(src, dst), max(src, dst))
+        if key not in self.shadowing:
+            self.shadowing[key] = self.rng.gauss(0, self.opts.shadowing)
+        return (power - self.opts.pl0 -
+                10 * self.opts.exponent * math.log10(dist) -
+                self.shadowing[key])
+
+    def prr(self, rssi):
+        return 1 / (1 + math.exp(-(rssi - self.opts.sensitivity) / 1.5))
+
+    def handle(self):
+        while True:
+            try:
+                msg, peer = self.sock.recvfrom(512)
+            except BlockingIOError:
+                return
+            if not msg:
+                continue
+            if msg[0] == MSG_HELLO and len(msg) == 3:
+                node = struct.unpack_from('<H', msg, 1)[0] - 1
+                if 0 <= node < len(self.positions):
+                    self.peers[peer] = node
+                    self.nodes[node] = peer
+                continue
+            node = self.peers.get(peer)
+            if node is None:
+                continue
+            if msg[0] == MSG_CCA and len(msg) == 2:
+                self.cca(node, struct.unpack_from('<b', msg, 1)[0])
+            elif msg[0] == MSG_TX and len(msg) > 6:
+                power, airtime = struct.unpack_from('<bI', msg, 1)
+                now = time.monotonic()
+                self.on_air.append([now + airtime / 1e6, node, power,
+                                    msg[6:], now, False,
+                                    self.channels.get(node, 0)])
+                self.frames += 1
+            elif msg[0] == MSG_CHANNEL and len(msg) == 2:
+                self.channels[node] = msg[1]
+            elif msg[0] == MSG_RSSI and len(msg) == 1:
+                rssi = max(-128, min(127, int(self.rssi(node))))
+                self.sock.sendto(bytes([MSG_RSSI_RESULT]) +
+                                 struct.pack('<b', rssi), self.nodes[node])
+
+    def interfered(self, channel):
+        return self.rng.random() < self.interference.get(channel, 0)
+
+    def rssi(self, node):
+        """Strongest signal the node hears on its channel right now."""
+        now = time.monotonic()
+        channel = self.channels.get(node, 0)
+        levels = [self.opts.noise_floor]
+        levels += [self.rx_power(sender, node, power)
+                   for end, sender, power, _, start, _, ch in self.on_air
+                   if start <= now < end and sender != node and ch == channel]
+        if self.interfered(channel):
+            levels.append(self.opts.interference_rssi)
+        return max(levels)
+
+    def cca(self, node, threshold):
+        busy = self.rssi(node) >= threshold
+        self.sock.sendto(bytes([MSG_CCA_RESULT, busy]), self.nodes[node])
+
+    def deliver(self):
+        """Hand out every frame whose airtime is over."""
+        now = time.monotonic()
+        for frame in self.on_air:
+            if frame[0] <= now and not frame[5]:
+                self.receive(frame)
+                frame[5] = True
+        # Kept until nothing it may collide with is still on the air
+        horizon = min((f[4] for f in self.on_air if not f[5]), default=now)
+        self.on_air = [f for f in self.on_air if not f[5] or f[0] > horizon]
+        return min((f[0] for f in self.on_air if not f[5]), default=None)
+
+    def receive(self, frame):
+        end, sender, power, data, start, _, channel = frame
+        for node, peer in self.nodes.items():
+            if node == sender or self.channels.get(node, 0) != channel:
+                continue
+            rssi = self.rx_power(sender, node, power)
+            if rssi < self.opts.sensitivity - 10:
+                continue
+            lost = self.interfered(channel)
+            for o_end, o_sender, o_power, _, o_start, _, o_ch in self.on_air:
+                if (lost or o_sender == sender or o_ch != channel or
+                        o_end <= start or o_start >= end):
+                    continue
+                if (o_sender == node or self.rx_power(o_sender, node, o_power)
+                        > rssi - self.opts.capture):
+                    lost = True
+                    break
+            if lost:
+                self.collisions += 1
+                continue
+            if self.rng.random() < self.prr(rssi):
+                self.sock.sendto(bytes([MSG_RX]) +
+                                 struct.pack('<b', max(-128, int(rssi))) +
+                                 data, peer)
+
+
+class Node:
+    """One node process and its host link."""
+
+    def __init__(self, index, opts, port):
+        self.index = index
+        self.addr = index + 1
+        self.decoder = hostlink.Decoder()
+        self.stats = None
+        self.failed = 0
+        self.closed = False
+        self.sock, child = socket.socketpair()
+        env = dict(os.environ)
+        env['SIM_NODE_ADDR'] = '0x%04x' % self.addr
+        env['SIM_MEDIUM_PORT'] = str(port)
+        env['SIM_HOST_FD'] = str(child.fileno())
+        if opts.nvs_dir:
+            env['SIM_NVS_FILE'] = os.path.join(opts.nvs_dir,
+                                               'node-%04x.nvs' % self.addr)
+        out = subprocess.DEVNULL
+        if opts.log_dir:
+            out = open(os.path.join(opts.log_dir, 'node-%04x.log' % self.addr),
+                       'wb')
+        self.proc = subprocess.Popen([opts.binary], env=env, stdout=out,
+                                     stderr=subprocess.STDOUT,
+                                     pass_fds=[child.fileno()])
+        child.close()
+        self.sock.setblocking(False)
+
+    def send(self, cmd, args=b''):
+        try:
+            self.sock.sendall(hostlink.encode(cmd, args))
+        except (BlockingIOError, BrokenPipeError):
+            self.failed += 1
+
+    def frames(self):
+        try:
+            data = self.sock.recv(4096)
+        except BlockingIOError:
+            return
+        if not data:
+            self.closed = True
+            return
+        yield from self.decoder.feed(data)
+
+    def close(self):
+        self.sock.close()
+
+
+class Scenario:
+    def __init__(self, opts):
+        self.opts = opts
+        self.rng = random.Random(opts.seed)
+        self.positions = self.place()
+        self.medium = Medium(opts, self.positions)
+        self.nodes = []
+        self.selector = selectors.DefaultSelector()
+        self.selector.register(self.medium.sock, selectors.EVENT_READ, None)
+        self.flows = []
+        self.sent = {}
+        self.delivered = {}
+
+    def place(self):
+        n = self.opts.nodes
+        if self.opts.topology == 'grid':
+            side = math.ceil(math.sqrt(n))
+            return [((i % side) * self.opts.spacing,
+                     (i // side) * self.opts.spacing) for i in range(n)]
+        return [(self.rng.uniform(0, self.opts.area),
+                 self.rng.uniform(0, self.opts.area)) for _ in range(n)]
+
+    def start(self):
+        for i in range(self.opts.nodes):
+            node = Node(i, self.opts, self.medium.port)
+            self.nodes.append(node)
+            self.selector.register(node.sock, selectors.EVENT_READ, node)
+        for _ in range(self.opts.flows):
+            src, dst = self.rng.sample(range(len(self.nodes)), 2)
+            self.flows.append((src, dst))
+
+    def poll(self, until):
+        while True:
+            now = time.monotonic()
+            if now >= until:
+                return
+            timeout = until - now
+            next_end = self.medium.deliver()
+            if next_end is not None:
+                timeout = max(0, min(timeout, next_end - now))
+            for key, _ in self.selector.select(timeout):
+                if key.data is None:
+                    self.medium.handle()
+                else:
+                    self.host_input(key.data)
+                    if key.data.closed:
+                        self.selector.unregister(key.fileobj)
+
+    def host_input(self, node):
+        for cmd, args in node.frames():
+            if cmd == hostlink.CMD_RECV_FRAME and len(args) >= 3 + PAYLOAD.size:
+                src, dst, seq = PAYLOAD.unpack_from(args, 3)
+                key = (src - 1, dst - 1, seq)
+                if (dst == node.addr and key in self.sent and
+                        key not in self.delivered):
+                    self.delivered[key] = time.monotonic()
+            elif cmd == hostlink.CMD_RESULT and len(args) == 2:
+                if (args[0] == hostlink.CMD_ROUTE_SEND and
+                        args[1] != 0):
+                    node.failed += 1
+            elif cmd == hostlink.CMD_STATS:
+                node.stats = hostlink.parse_stats(args)
+
+    def send(self, flow, seq):
+        src, dst = self.flows[flow]
+        payload = PAYLOAD.pack(src + 1, dst + 1, seq)
+        payload += bytes(max(0, self.opts.len - len(payload)))
+        self.sent[(src, dst, seq)] = time.monotonic()
+        self.nodes[src].send(hostlink.CMD_ROUTE_SEND,
+                             struct.pack('<H', dst + 1) + payload)
+
+    def run(self):
+        opts = self.opts
+        begin = time.monotonic()
+        self.start()
+        self.poll(begin + opts.warmup)
+
+        # Flows start spread over the first interval
+        seq = 0
+        start = time.monotonic()
+        offsets = [self.rng.uniform(0, opts.interval) for _ in self.flows]
+        end = start + opts.duration
+        while time.monotonic() < end:
+            round_start = start + seq * opts.interval
+            for flow in sorted(range(len(self.flows)),
+                               key=lambda f: offsets[f]):
+                self.poll(round_start + offsets[flow])
+                if time.monotonic() >= end:
+                    break
+                self.send(flow, seq)
+            seq += 1
+        self.poll(time.monotonic() + opts.drain)
+
+        for node in self.nodes:
+            node.send(hostlink.CMD_STATS_GET, b'\x00')
+        deadline = time.monotonic() + 2
+        while (time.monotonic() < deadline and
+               any(n.stats is None for n in self.nodes)):
+            self.poll(min(deadline, time.monotonic() + 0.1))
+
+        return self.report(time.monotonic() - begin)
+
+    def stop(self):
+        for node in self.nodes:
+            node.close()
+        for node in self.nodes:
+            try:
+                node.proc.wait(timeout=2)
+            except subprocess.TimeoutExpired:
+                node.proc.kill()
+                node.proc.wait()
+
+    def report(self, elapsed):
+        convergence = []
+        unconverged = 0
+        for src, dst in self.flows:
+            first = min((t for (s, d, _), t in self.sent.items()
+                         if (s, d) == (src, dst)), default=None)
+            got = min((t for (s, d, _), t in self.delivered.items()
+                       if (s, d) == (src, dst)), default=None)
+            if first is None:
+                continue
+            if got is None:
+                unconverged += 1
+            else:
+                convergence.append(got - first)
+
+        latency = [t - self.sent[k] for k, t in self.delivered.items()]
+        nodes = []
+        for node, pos in zip(self.nodes, self.positions):
+            entry = {'addr': node.addr, 'x': pos[0], 'y': pos[1],
+                     'host_errors': node.failed,
+                     'exit': node.proc.poll()}
+            if node.stats is not None:
+                entry['uptime'] = node.stats[0]
+                entry['stats'] = {str(k): v for k, v in
+                                  node.stats[1].items()}
+            nodes.append(entry)
+
+        return {
+            'nodes': len(self.nodes),
+            'flows': len(self.flows),
+            'elapsed': elapsed,
+            'sent': len(self.sent),
+            'delivered': len(self.delivered),
+            'pdr': len(self.delivered) / len(self.sent) if self.sent else None,
+            'convergence': {
+                'converged': len(convergence),
+                'unconverged': unconverged,
+                'median': percentile(convergence, 0.5),
+                'p95': percentile(convergence, 0.95),
+                'max': max(convergence, default=None),
+            },
+            'latency': {
+                'median': percentile(latency, 0.5),
+                'p95': percentile(latency, 0.95),
+                'max': max(latency, default=None),
+            },
+            'medium': {
+                'frames': self.medium.frames,
+                'collisions': self.medium.collisions,
+            },
+            'per_node': nodes,
+        }
+
+
+def fmt(value, unit='s'):
+    return '-' if value is None else '%.3f %s' % (value, unit)
+
+
+def print_report(report, per_node):
+    conv = report['convergence']
+    lat = report['latency']
+    print('nodes      %u, flows %u, %.0f s'
+          % (report['nodes'], report['flows'], report['elapsed']))
+    print('medium     %u frames, %u collisions'
+          % (report['medium']['frames'], report['medium']['collisions']))
+    print('converged  %u of %u flows, median %s, p95 %s, max %s'
+          % (conv['converged'], conv['converged'] + conv['unconverged'],
+             fmt(conv['median']), fmt(conv['p95']), fmt(conv['max'])))
+    if report['pdr'] is not None:
+        print('PDR        %.1f %% (%u of %u)'
+              % (100 * report['pdr'], report['delivered'], report['sent']))
+    print('latency    median %s, p95 %s, max %s'
+          % (fmt(lat['median']), fmt(lat['p95']), fmt(lat['max'])))
+
+    with_stats = [n for n in report['per_node'] if 'stats' in n]
+    missing = len(report['per_node']) - len(with_stats)
+    if missing:
+        print('%u nodes did not report statistics' % missing)
+    if not with_stats:
+        return
+
+    drops = sorted({k for n in with_stats for k in n['stats']
+                    if k.startswith('DROP_')})
+    print()
+    print('%-22s %10s %10s' % ('', 'mean', 'max'))
+    for word in HWM_WORDS + drops:
+        values = [n['stats'].get(word, 0) for n in with_stats]
+        print('%-22s %10.1f %10u' % (word, sum(values) / len(values),
+                                     max(values)))
+
+    if per_node:
+        cols = HWM_WORDS + drops
+        print()
+        print('addr   ' + ' '.join('%8.8s' % c.replace('SCHED_', '')
+                                   for c in cols))
+        for n in with_stats:
+            print('0x%04x ' % n['addr'] +
+                  ' '.join('%8u' % n['stats'].get(c, 0) for c in cols))
+
+
+def interference(arg):
+    channel, share = arg.split(':')
+    return int(channel), float(share)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--nodes', type=int, default=25)
+    parser.add_argument('--topology', choices=['grid', 'random'],
+                        default='grid')
+    parser.add_argument('--spacing', type=float, default=500,
+                        help='distance between grid neighbors in m')
+    parser.add_argument('--area', type=float, default=5000,
+                        help='side of the square of random placement in m')
+    parser.add_argument('--flows', type=int, default=10)
+    parser.add_argument('--interval', type=float, default=5,
+                        help='time between the payloads of a flow in s')
+    parser.add_argument('--len', type=int, default=16,
+                        help='bytes per payload')
+    parser.add_argument('--warmup', type=float, default=5,
+                        help='time before the first payload in s')
+    parser.add_argument('--duration', type=float, default=60,
+                        help='time the flows send in s')
+    parser.add_argument('--drain', type=float, default=5,
+                        help='time to wait for the last payloads in s')
+    parser.add_argument('--pl0', type=float, default=31,
+                        help='path loss at 1 m in dB')
+    parser.add_argument('--exponent', type=float, default=3,
+                        help='path loss exponent')
+    parser.add_argument('--shadowing', type=float, default=4,
+                        help='standard deviation of the shadowing in dB')
+    parser.add_argument('--sensitivity', type=float, default=-110,
+                        help='RSSI at which half the frames are received')
+    parser.add_argument('--capture', type=float, default=6,
+                        help='margin over interferers a frame needs in dB')
+    parser.add_argument('--noise-floor', type=float, default=-120,
+                        help='RSSI of an idle channel in dBm')
+    parser.add_argument('--interference', type=interference, action='append',
+                        default=[], metavar='CHANNEL:SHARE',
+                        help='keep a channel busy for a share of the time, '
+                             'may be repeated')
+    parser.add_argument('--interference-rssi', type=float, default=-80,
+                        help='RSSI of the interference in dBm')
+    parser.add_argument('--seed', type=int, default=1)
+    parser.add_argument('--binary', default=BINARY)
+    parser.add_argument('--nvs-dir',
+                        help='keep the flash of every node in this directory')
+    parser.add_argument('--log-dir', help='write the output of every node '
+                                          'to this directory')
+    parser.add_argument('--per-node', action='store_true',
+                        help='print the statistics of every node')
+    parser.add_argument('--json', help='also write the report to this file')
+    opts = parser.parse_args()
+
+    scenario = Scenario(opts)
+    try:
+        report = scenario.run()
+    except KeyboardInterrupt:
+        return 1
+    finally:
+        scenario.stop()
+
+    print_report(report, opts.per_node)
+    if opts.json:
+        with open(opts.json, 'w') as f:
+            json.dump(report, f, indent=2)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())